@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+/**
+ * @brief standard allocator returning storage aligned to Alignment bytes
+ * @detail over-aligned allocation needs C++17, so the block is over-allocated and the
+ *         pointer returned by operator new is kept right before the aligned storage
+ */
+template <typename T, size_t Alignment>
+class AlignedAllocator {
+public:
+	static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0,
+		"the alignment must be a power of two of at least the alignment of the type");
+
+	using value_type = T;
+
+	template <typename U>
+	struct rebind {
+		using other = AlignedAllocator<U, Alignment>;
+	};
+
+	/*
+	 * @brief default constructor, the allocator is stateless
+	 */
+	AlignedAllocator() = default;
+
+	/*
+	 * @brief converting constructor for rebound allocators
+	 */
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) { }
+
+	/*
+	 * @brief allocate aligned storage for n objects
+	 */
+	T* allocate(size_t n) {
+		void* block = ::operator new(n * sizeof(T) + Alignment - 1 + sizeof(void*));
+		const uintptr_t storage = (reinterpret_cast<uintptr_t>(block) + sizeof(void*) + Alignment - 1) & ~(Alignment - 1);
+		reinterpret_cast<void**>(storage)[-1] = block;
+		return reinterpret_cast<T*>(storage);
+	}
+
+	/*
+	 * @brief free storage returned by allocate
+	 */
+	void deallocate(T* pointer, size_t) {
+		::operator delete(reinterpret_cast<void**>(pointer)[-1]);
+	}
+};
+
+template <typename T, typename U, size_t Alignment>
+bool operator==(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) {
+	return true;
+}
+
+template <typename T, typename U, size_t Alignment>
+bool operator!=(const AlignedAllocator<T, Alignment>&, const AlignedAllocator<U, Alignment>&) {
+	return false;
+}
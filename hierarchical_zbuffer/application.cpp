@@ -1,9 +1,15 @@
 #include "application.h"
 
 /*
- * @brief default constructor
+ * @brief constructor, load the model or map its mesh cache and create the window
+ * @param modelPath path of the model file
  */
-Application::Application() {
+Application::Application(const std::string& modelPath)
+	: _renderer(modelPath, [&modelPath]() { return _loadMesh(modelPath); }, _windowWidth, _windowHeight, &std::cout) {
+	// the load is reported, the frames only on request
+	_renderer.setLog(nullptr);
+	_framePipeline.reset(new FramePipeline(_renderer, FramePipeline::Mode::Serial));
+
 	if (glfwInit() != GLFW_TRUE) {
 		std::cerr << "init glfw failure" << std::endl;
 		exit(EXIT_FAILURE);
@@ -36,12 +42,33 @@ Application::Application() {
 		exit(EXIT_FAILURE);
 	}
 
-	std::vector<Vertex> _vertices;
-	std::vector<uint32_t> _indices;
-	_model.getFaces(_vertices, _indices);
-	for (int i = 0; i < _indices.size(); i += 3) {
-		_triangles.push_back({ _vertices[i], _vertices[i + 1] , _vertices[i + 2] });
-	}
+	_fpsCamera.setLocalPosition(glm::vec3(0.0f, 0.0f, 6.0f));
+
+	// full screen triangle generated from gl_VertexID
+	const char* blitVsCode =
+		"#version 330 core\n"
+		"out vec2 uv;\n"
+		"void main() {\n"
+		"	vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+		"	uv = vec2(p.x, 1.0 - p.y);\n"
+		"	gl_Position = vec4(2.0 * p - 1.0, 0.0, 1.0);\n"
+		"}\n";
+	const char* blitFsCode =
+		"#version 330 core\n"
+		"in vec2 uv;\n"
+		"out vec4 color;\n"
+		"uniform sampler2D frame;\n"
+		"void main() {\n"
+		"	color = texture(frame, uv);\n"
+		"}\n";
+	_blitShader.reset(new Shader(blitVsCode, blitFsCode));
+
+	glGenVertexArrays(1, &_blitVao);
+	glGenTextures(1, &_blitTexture);
+	glBindTexture(GL_TEXTURE_2D, _blitTexture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, _windowWidth, _windowHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
 
 	_lastTimeStamp = std::chrono::high_resolution_clock::now();
 }
@@ -51,6 +78,16 @@ Application::Application() {
  * @brief default destructor
  */
 Application::~Application() {
+	if (_blitTexture != 0) {
+		glDeleteTextures(1, &_blitTexture);
+	}
+
+	if (_blitVao != 0) {
+		glDeleteVertexArrays(1, &_blitVao);
+	}
+
+	_blitShader.reset();
+
 	if (_window != nullptr) {
 		glfwDestroyWindow(_window);
 	}
@@ -77,7 +114,7 @@ void Application::run() {
  */
 void Application::_updateTime() {
 	auto currentTimeStamp = std::chrono::high_resolution_clock::now();
-	_deltaTime = 0.001f * std::chrono::duration<double, std::milli>().count();
+	_deltaTime = 0.001f * std::chrono::duration<double, std::milli>(currentTimeStamp - _lastTimeStamp).count();
 	_lastTimeStamp = currentTimeStamp;
 }
 
@@ -140,6 +177,113 @@ void Application::_keyPressedCallback(GLFWwindow* window, int key, int scancode,
  */
 void Application::_handleInput() {
 	_fpsCamera.update(_keyboardInput, _mouseInput, _deltaTime);
+
+	// the renderer settings, its overlay and the profile must not change under the frames in
+	// flight, they are dropped
+	for (int key : { GLFW_KEY_K, GLFW_KEY_T, GLFW_KEY_B, GLFW_KEY_R, GLFW_KEY_I, GLFW_KEY_V,
+		GLFW_KEY_N, GLFW_KEY_G, GLFW_KEY_L, GLFW_KEY_M, GLFW_KEY_O, GLFW_KEY_P }) {
+		if (_keyboardInput.keyPressed[key]) {
+			_framePipeline->flush();
+			break;
+		}
+	}
+
+	if (_keyboardInput.keyPressed[GLFW_KEY_1]) {
+		_renderMode = Renderer::RenderMode::ScanLineZBuffer;
+	} else if (_keyboardInput.keyPressed[GLFW_KEY_2]) {
+		_renderMode = Renderer::RenderMode::HierarchicalZBuffer;
+	} else if (_keyboardInput.keyPressed[GLFW_KEY_3]) {
+		_renderMode = Renderer::RenderMode::OctreeHierarchicalZBuffer;
+	} else if (_keyboardInput.keyPressed[GLFW_KEY_4]) {
+		_renderMode = Renderer::RenderMode::HalfSpaceRasterizer;
+	}
+
+	if (_keyboardInput.keyPressed[GLFW_KEY_K]) {
+		// cycle scalar -> sse4 -> avx2, skipping kernels the processor lacks
+		HalfSpaceRasterizer::Kernel kernel = _renderer.getHalfSpaceKernel();
+		do {
+			kernel = kernel == HalfSpaceRasterizer::Kernel::Scalar ? HalfSpaceRasterizer::Kernel::SSE4 :
+				kernel == HalfSpaceRasterizer::Kernel::SSE4 ? HalfSpaceRasterizer::Kernel::AVX2 :
+				HalfSpaceRasterizer::Kernel::Scalar;
+		} while (!HalfSpaceRasterizer::isKernelSupported(kernel));
+
+		_renderer.setHalfSpaceKernel(kernel);
+		std::cout << "half-space kernel " << HalfSpaceRasterizer::getKernelName(kernel) << std::endl;
+	}
+
+	if (_keyboardInput.keyPressed[GLFW_KEY_T]) {
+		_renderer.setTiledRendering(!_renderer.isTiledRendering());
+		std::cout << "tiled rendering " << (_renderer.isTiledRendering() ? "on, " : "off, ")
+			<< _renderer.getThreadCount() << " threads" << std::endl;
+	}
+
+	if (_keyboardInput.keyPressed[GLFW_KEY_B]) {
+		const bool backfaceCulling = _renderer.getFaceCulling() != CullingStage::FaceCulling::Back;
+		_renderer.setFaceCulling(backfaceCulling ? CullingStage::FaceCulling::Back : CullingStage::FaceCulling::None);
+		std::cout << "backface culling " << (backfaceCulling ? "on" : "off") << std::endl;
+	}
+
+	if (_keyboardInput.keyPressed[GLFW_KEY_R]) {
+		_renderer.setTemporalCulling(!_renderer.isTemporalCulling());
+		std::cout << "temporal occlusion culling " << (_renderer.isTemporalCulling() ? "on" : "off") << std::endl;
+	}
+
+	if (_keyboardInput.keyPressed[GLFW_KEY_I]) {
+		const bool bvh = _renderer.getSpatialIndex() != Renderer::SpatialIndex::Bvh;
+		_renderer.setSpatialIndex(bvh ? Renderer::SpatialIndex::Bvh : Renderer::SpatialIndex::Octree);
+		std::cout << "spatial index " << Renderer::getSpatialIndexName(_renderer.getSpatialIndex()) << std::endl;
+	}
+
+	if (_keyboardInput.keyPressed[GLFW_KEY_V]) {
+		_renderer.setVisibilityPersistence(!_renderer.isVisibilityPersistence());
+		std::cout << "visibility persistence " << (_renderer.isVisibilityPersistence() ? "on" : "off") << std::endl;
+	}
+
+	if (_keyboardInput.keyPressed[GLFW_KEY_N]) {
+		_renderer.setTrivialAccept(!_renderer.isTrivialAccept());
+		std::cout << "trivial accept " << (_renderer.isTrivialAccept() ? "on" : "off") << std::endl;
+	}
+
+	if (_keyboardInput.keyPressed[GLFW_KEY_G]) {
+		_sceneRendering = !_sceneRendering;
+		if (_sceneRendering && !_scene) {
+			_scene.reset(new Scene());
+			ThreadPool threadPool(ThreadPool::getDefaultThreadCount());
+			const uint32_t mesh = _scene->addMesh(_renderer.getMesh(), _renderer.getOctreeConfig(), threadPool);
+			generateInstanceGrid(*_scene, mesh, _sceneInstancesPerAxis);
+		}
+		std::cout << "instanced scene " << (_sceneRendering ? "on, " + std::to_string(_scene->getInstanceCount()) + " instances" : "off") << std::endl;
+	}
+
+	if (_keyboardInput.keyPressed[GLFW_KEY_M]) {
+		// cycle serial -> low latency -> throughput
+		const FramePipeline::Mode mode = _framePipeline->getMode();
+		const FramePipeline::Mode nextMode = mode == FramePipeline::Mode::Serial ? FramePipeline::Mode::LowLatency :
+			mode == FramePipeline::Mode::LowLatency ? FramePipeline::Mode::Throughput : FramePipeline::Mode::Serial;
+		_framePipeline.reset();
+		_framePipeline.reset(new FramePipeline(_renderer, nextMode));
+		std::cout << "frame pipeline " << FramePipeline::getModeName(nextMode) << ", "
+			<< _framePipeline->getFrameCount() << " frames in flight" << std::endl;
+	}
+
+	if (_keyboardInput.keyPressed[GLFW_KEY_L]) {
+		_frameLogging = !_frameLogging;
+		_renderer.setLog(_frameLogging ? &std::cout : nullptr);
+		std::cout << "frame logging " << (_frameLogging ? "on" : "off") << std::endl;
+	}
+
+	if (_keyboardInput.keyPressed[GLFW_KEY_O]) {
+		_statisticsOverlay = !_statisticsOverlay;
+	}
+
+	if (_keyboardInput.keyPressed[GLFW_KEY_P]) {
+		// the last frames of every thread, open the json in chrome://tracing or perfetto
+		std::ofstream csv("profile.csv"), trace("profile.json");
+		Profiler::getInstance().writeCsv(csv);
+		Profiler::getInstance().writeChromeTrace(trace);
+		std::cout << "profile of the last " << Profiler::getInstance().getFrameCapacity()
+			<< " frames written to profile.csv and profile.json" << std::endl;
+	}
 	
 	for (auto& keyPress : _keyboardInput.keyPressed) {
 		keyPress = false;
@@ -150,36 +294,143 @@ void Application::_handleInput() {
 }
 
 /*
- * @brief render frame with specified render mode
+ * @brief render frame with specified render mode and show it
+ * @detail the model goes through the frame pipeline: a frame is submitted with the camera
+ *         of this input whenever one is free, and the oldest finished one is shown. In the
+ *         pipelined modes a loop may submit or show nothing and only handle the input
  */
 void Application::_renderFrame() {
-	auto start = std::chrono::high_resolution_clock::now();
-	switch (_renderMode) {
-		case RenderMode::ScanLineZBuffer:
-			_renderWithScanLineZBuffer();
-			break;
-		case RenderMode::HierarchicalZBuffer:
-			_renderWithScanLineZBuffer();
-			break;
-		case RenderMode::OctreeHierarchicalZBuffer:
-			_renderWithScanLineZBuffer();
-			break;
+	const glm::mat4x4 viewProjection = _fpsCamera.getProjectionMatrix() * _fpsCamera.getViewMatrix();
+	if (_sceneRendering) {
+		_renderer.renderScene(*_scene, viewProjection, _fpsCamera.getLocalPosition());
+		if (_statisticsOverlay) {
+			drawTextOverlay(_renderer.getFrameBuffer(), _getStatisticsText(_renderer.getFrameTiming(), _renderer.getFrameStatistics()), 8, 8);
+		}
+
+		_uploadFrame();
+		_presentFrame();
+		return;
+	}
+
+	FramePipeline::Frame* frame = _framePipeline->beginFrame();
+	if (frame) {
+		frame->setup.renderMode = _renderMode;
+		frame->setup.viewProjection = viewProjection;
+		frame->setup.cameraPosition = _fpsCamera.getLocalPosition();
+		_framePipeline->submitFrame(frame);
+	}
+
+	frame = _framePipeline->acquireFrame();
+	if (!frame) {
+		std::this_thread::yield();
+		return;
+	}
+
+	if (_statisticsOverlay) {
+		std::vector<std::string> lines = _getStatisticsText(frame->timing, frame->statistics);
+		std::ostringstream line;
+		line << "pipeline " << FramePipeline::getModeName(_framePipeline->getMode()) << ": latency "
+			<< _lastLatency.getLatency() << " ms, waiting " << _lastLatency.getWaitTime() << " ms";
+		lines.push_back(line.str());
+		drawTextOverlay(_renderer.getFrameBuffer(), lines, 8, 8);
 	}
-	auto stop = std::chrono::high_resolution_clock::now();
-	auto milliseconds = std::chrono::duration<double, std::milli>().count();
 
-	std::cout << "+ render time: " << milliseconds << " ms" << std::endl;
+	// the next frame is rasterized once the frame buffer is uploaded, not once it is shown
+	_uploadFrame();
+	_framePipeline->releaseFrame(frame);
+	_lastLatency = frame->latency;
+	_presentFrame();
 }
 
-void Application::_renderWithScanLineZBuffer() {
-	/* write your code here */
+
+/*
+ * @brief copy the software frame buffer to the texture shown in the window
+ */
+void Application::_uploadFrame() {
+	glBindTexture(GL_TEXTURE_2D, _blitTexture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, _windowWidth, _windowHeight,
+		GL_RGBA, GL_UNSIGNED_BYTE, _renderer.getFrameBuffer().getColorBuffer());
 }
 
-void Application::_renderWithHierarchicalZBuffer() {
-	/* write your code here */
+
+/*
+ * @brief show the uploaded frame in the window
+ */
+void Application::_presentFrame() {
+	glBindTexture(GL_TEXTURE_2D, _blitTexture);
+	glViewport(0, 0, _windowWidth, _windowHeight);
+	_blitShader->use();
+	_blitShader->setInt("frame", 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindVertexArray(_blitVao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	glfwSwapBuffers(_window);
 }
 
-void Application::_renderWithOctreeHierarchicalZBuffer() {
-	/* write your code here */
+
+/*
+ * @brief get the statistics of a frame as overlay text
+ * @param timing times of the frame
+ * @param statistics work counters of the frame
+ * @return one line per pipeline step
+ */
+std::vector<std::string> Application::_getStatisticsText(const Renderer::FrameTiming& timing,
+	const Renderer::FrameStatistics& statistics) const {
+	std::vector<std::string> lines;
+	std::ostringstream line;
+	auto nextLine = [&]() {
+		lines.push_back(line.str());
+		line.str("");
+	};
+
+	line << (_sceneRendering ? "instances" : Renderer::getRenderModeName(_renderMode))
+		<< (_renderer.isTiledRendering() && !_sceneRendering ? " tiled" : "")
+		<< ": " << timing.frame << " ms, setup " << timing.setup << " ms, raster " << timing.raster << " ms";
+	nextLine();
+	line << "culled: " << statistics.trianglesBackfacing << " backfacing, "
+		<< statistics.trianglesDegenerate << " degenerate, " << statistics.trianglesOutsideFrustum << " outside frustum";
+	nextLine();
+	line << "hi-z: " << statistics.trianglesOccluded << "/" << statistics.trianglesSubmitted << " occluded, "
+		<< statistics.trianglesTriviallyAccepted << " trivially accepted, per level";
+	for (uint64_t occluded : statistics.trianglesOccludedPerLevel) {
+		line << " " << occluded;
+	}
+	nextLine();
+	if (_sceneRendering) {
+		line << "instances: " << statistics.instancesDrawn << " drawn, " << statistics.instancesOutside << " outside, "
+			<< statistics.instancesOccluded << " occluded, " << statistics.nodesVisited << " nodes visited, "
+			<< statistics.nodesOccluded << " occluded";
+		nextLine();
+	} else if (_renderMode == Renderer::RenderMode::OctreeHierarchicalZBuffer) {
+		line << Renderer::getSpatialIndexName(_renderer.getSpatialIndex()) << ": " << statistics.nodesVisited << " nodes visited, " << statistics.nodesOccluded << " occluded, "
+			<< statistics.nodesOutside << " outside";
+		nextLine();
+		if (_renderer.isVisibilityPersistence()) {
+			line << "visibility cache: " << statistics.visibilityCacheHits << " hits, " << statistics.nodesQueried
+				<< " queried, hit rate " << statistics.getVisibilityCacheHitRate();
+			nextLine();
+		}
+		if (_renderer.isTemporalCulling()) {
+			line << "temporal: " << statistics.nodesDeferred << " nodes, " << statistics.trianglesDeferred << " triangles deferred";
+			nextLine();
+		}
+	}
+	line << "pixels: " << statistics.pixelsWritten << "/" << statistics.pixelsTested << " written/tested, overdraw "
+		<< statistics.getOverdraw() << ", depth complexity " << statistics.getDepthComplexity();
+	nextLine();
+
+	return lines;
 }
 
+
+/*
+ * @brief load the model file as one indexed mesh
+ * @param modelPath path of the model file
+ * @return positions and indices of all meshes of the model
+ */
+IndexedMesh Application::_loadMesh(const std::string& modelPath) {
+	IndexedMesh mesh;
+	Model::loadIndexedMesh(modelPath, mesh);
+	return mesh;
+}
\ No newline at end of file
@@ -3,24 +3,40 @@
 #include <array>
 #include <chrono>
 #include <cstdlib> // exit
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "culling_stage.h"
 #include "fps_camera.h"
+#include "frame_pipeline.h"
+#include "framebuffer.h"
+#include "halfspace_rasterizer.h"
 #include "input.h"
+#include "mesh.h"
 #include "model.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "scene.h"
+#include "scene_generator.h"
+#include "shader.h"
+#include "text_overlay.h"
 
 #define SHOW_CALLBACK
 
 class Application {
 public:
 	/*
-	 * @brief default constructor
+	 * @brief constructor, load the model and create the window
 	 */
-	Application();
+	explicit Application(const std::string& modelPath);
 
 	/*
 	 * @brief default destructor
@@ -32,42 +48,47 @@ public:
 	 */
 	void run();
 
-	/*
-	 * @brief render mode
-	 */
-	enum class RenderMode {
-		ScanLineZBuffer,
-		HierarchicalZBuffer,
-		OctreeHierarchicalZBuffer
-	};
-
 private:
 	/* window */
 	GLFWwindow* _window = nullptr;
 	std::string _windowTitle = "Hierarchical Z-Buffer";
 	int _windowWidth = 1280;
 	int _windowHeight = 720;
-	glm::vec3 _clearColor = glm::vec3(0.0f, 0.0f, 0.0f);
 
 	/* time */
 	std::chrono::time_point<std::chrono::high_resolution_clock> _lastTimeStamp;
 	double _deltaTime = 0.0f;
 
-	/* model */
-	Model _model{ "../resources/bunny.obj" };
-
-	/* triangle data: local space */
-	std::vector<Triangle> _triangles;
+	/* software renderer of the model into its own frame buffer */
+	Renderer _renderer;
+
+	/* frames of the model in flight, the scene is rendered directly */
+	std::unique_ptr<FramePipeline> _framePipeline;
+	/* timestamps of the last frame shown through the pipeline */
+	FramePipeline::Latency _lastLatency;
+	/* print the statistics and stage times of every frame */
+	bool _frameLogging = false;
+	/* draw the statistics of the frame over it */
+	bool _statisticsOverlay = false;
+	/* grid of instances sharing the mesh of the model, built when first shown */
+	std::unique_ptr<Scene> _scene;
+	int _sceneInstancesPerAxis = 8;
+	bool _sceneRendering = false;
 
 	///* camera */
-	FpsCamera _fpsCamera{glm::radians(54.0f), 1.0 * _windowWidth / _windowHeight};
+	FpsCamera _fpsCamera{54.0f, 1.0f * _windowWidth / _windowHeight};
+
+	/* blit the software frame buffer to the window */
+	std::unique_ptr<Shader> _blitShader;
+	GLuint _blitTexture = 0;
+	GLuint _blitVao = 0;
 
 	/* input */
 	KeyboardInput _keyboardInput;
 	MouseInput _mouseInput;
 
 	/* render mode */
-	enum RenderMode _renderMode = RenderMode::ScanLineZBuffer;
+	Renderer::RenderMode _renderMode = Renderer::RenderMode::ScanLineZBuffer;
 
 	/*
 	 * @brief update time
@@ -90,18 +111,30 @@ private:
 	void _handleInput();
 
 	/*
-	 * @brief render frame with specified render mode
+	 * @brief render frame with specified render mode and show it
 	 */
 	void _renderFrame();
 
-	// todo
-	void _renderWithScanLineZBuffer();
+	/*
+	 * @brief copy the software frame buffer to the texture shown in the window
+	 */
+	void _uploadFrame();
 
-	// todo
-	void _renderWithHierarchicalZBuffer();
-	
-	// todo
-	void _renderWithOctreeHierarchicalZBuffer();
+	/*
+	 * @brief show the uploaded frame in the window
+	 */
+	void _presentFrame();
+
+	/*
+	 * @brief get the statistics of a frame as overlay text
+	 */
+	std::vector<std::string> _getStatisticsText(const Renderer::FrameTiming& timing,
+		const Renderer::FrameStatistics& statistics) const;
+
+	/*
+	 * @brief load the model file as one indexed mesh
+	 */
+	static IndexedMesh _loadMesh(const std::string& modelPath);
 };
 
 
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @brief read only view of a contiguous array owned elsewhere
+ * @detail lets a structure hand out its arrays the same way whether they live in its own
+ *         vectors or in a memory mapped file
+ */
+template <typename T>
+class ArrayView {
+public:
+	/*
+	 * @brief default constructor, an empty view
+	 */
+	ArrayView() = default;
+
+	/*
+	 * @brief constructor, view size elements starting at data
+	 */
+	ArrayView(const T* data, size_t size) : _data(data), _size(size) { }
+
+	/*
+	 * @brief constructor, view all elements of a container with contiguous storage
+	 */
+	template <typename Container>
+	ArrayView(const Container& container) : _data(container.data()), _size(container.size()) { }
+
+	const T* data() const {
+		return _data;
+	}
+
+	size_t size() const {
+		return _size;
+	}
+
+	bool empty() const {
+		return _size == 0;
+	}
+
+	const T& operator[](size_t index) const {
+		return _data[index];
+	}
+
+	const T* begin() const {
+		return _data;
+	}
+
+	const T* end() const {
+		return _data + _size;
+	}
+
+private:
+	const T* _data = nullptr;
+	size_t _size = 0;
+};
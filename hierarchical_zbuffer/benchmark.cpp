@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "benchmark.h"
+
+namespace {
+	/*
+	 * @brief counters of one render mode summed over the frames
+	 */
+	struct ModeTotals {
+		std::vector<double> frameTimes;
+		double rasterMilliseconds = 0.0;
+		uint64_t trianglesRasterized = 0;
+		uint64_t pixelsTested = 0;
+		uint64_t depthMismatches = 0;
+		float maxDepthError = 0.0f;
+		uint64_t edgeDifferences = 0;
+		float maxEdgeError = 0.0f;
+	};
+
+	/*
+	 * @brief check whether the reference depth is not continued linearly across a pixel
+	 * @detail the depth is linear in window space on a triangle, so a pixel whose row or
+	 *         column neighbours do not continue it, or next to the cleared background, is on
+	 *         a triangle edge of the reference. Only there may the fill rule cover it differently
+	 * @param reference depth buffer of the reference
+	 * @param width width of the depth buffer
+	 * @param height height of the depth buffer
+	 * @param x column of the pixel
+	 * @param y row of the pixel
+	 * @param tolerance largest second difference of the depths still counted as linear
+	 * @return true if a triangle edge or a silhouette of the reference passes through (x, y)
+	 */
+	bool isDepthDiscontinuity(const std::vector<float>& reference, int width, int height, int x, int y,
+		float tolerance) {
+		auto at = [&](int column, int row) {
+			return reference[static_cast<size_t>(row) * width + column];
+		};
+
+		const float depth = at(x, y);
+		for (int dy = -1; dy <= 1; ++dy) {
+			for (int dx = -1; dx <= 1; ++dx) {
+				const int x1 = x + dx;
+				const int y1 = y + dy;
+				if (x1 >= 0 && x1 < width && y1 >= 0 && y1 < height && (at(x1, y1) >= 1.0f) != (depth >= 1.0f)) {
+					return true;
+				}
+			}
+		}
+
+		return (x > 0 && x + 1 < width && std::fabs(at(x - 1, y) + at(x + 1, y) - 2.0f * depth) > tolerance) ||
+			(y > 0 && y + 1 < height && std::fabs(at(x, y - 1) + at(x, y + 1) - 2.0f * depth) > tolerance);
+	}
+
+	/*
+	 * @brief check whether a depth belongs to a surface the reference shows next to a pixel
+	 * @detail a pixel center on a triangle edge may be covered by the triangle on either side,
+	 *         its depth is then inside the range of the neighbouring depths or extrapolated by
+	 *         one pixel from two of them. Both depths of an extrapolation may be off by the tolerance
+	 * @param reference depth buffer of the reference
+	 * @param width width of the depth buffer
+	 * @param height height of the depth buffer
+	 * @param x column of the pixel
+	 * @param y row of the pixel
+	 * @param depth depth of the pixel to check
+	 * @param tolerance largest depth difference counted as equal
+	 * @return true if the depth matches the 3x3 pixels around (x, y) or continues one of them
+	 */
+	bool isNeighbourSurface(const std::vector<float>& reference, int width, int height, int x, int y,
+		float depth, float tolerance) {
+		float nearest = reference[static_cast<size_t>(y) * width + x];
+		float farthest = nearest;
+		for (int dy = -1; dy <= 1; ++dy) {
+			for (int dx = -1; dx <= 1; ++dx) {
+				const int x1 = x + dx;
+				const int y1 = y + dy;
+				if (x1 < 0 || x1 >= width || y1 < 0 || y1 >= height) {
+					continue;
+				}
+
+				const float near = reference[static_cast<size_t>(y1) * width + x1];
+				nearest = std::min(nearest, near);
+				farthest = std::max(farthest, near);
+
+				const int x2 = x1 + dx;
+				const int y2 = y1 + dy;
+				if ((dx == 0 && dy == 0) || x2 < 0 || x2 >= width || y2 < 0 || y2 >= height) {
+					continue;
+				}
+
+				const float far = reference[static_cast<size_t>(y2) * width + x2];
+				if (std::fabs(2.0f * near - far - depth) <= 3.0f * tolerance) {
+					return true;
+				}
+			}
+		}
+
+		return depth >= nearest - tolerance && depth <= farthest + tolerance;
+	}
+}
+
+/*
+ * @brief constructor
+ * @param config benchmark settings
+ */
+Benchmark::Benchmark(const Config& config) : _config(config) { }
+
+
+/*
+ * @brief render the scene along the camera path with every mode
+ * @detail the modes are interleaved frame by frame, so every mode sees the same camera
+ *         with the reference depth buffer of that frame at hand
+ * @param scene name of the scene in the results
+ * @param mesh world space mesh of the scene
+ * @param cameraPath camera path of the run
+ * @return one result per mode, the scan-line reference first
+ */
+std::vector<Benchmark::Result> Benchmark::run(const std::string& scene, const IndexedMesh& mesh,
+	const CameraPath& cameraPath) const {
+	std::vector<Renderer::RenderMode> renderModes = { Renderer::RenderMode::ScanLineZBuffer };
+	for (auto renderMode : _config.renderModes) {
+		if (std::find(renderModes.begin(), renderModes.end(), renderMode) == renderModes.end()) {
+			renderModes.push_back(renderMode);
+		}
+	}
+
+	Renderer renderer(mesh, _config.width, _config.height);
+	renderer.setTiledRendering(_config.tiledRendering);
+	renderer.setTemporalCulling(_config.temporalCulling);
+	renderer.setVisibilityPersistence(_config.visibilityPersistence);
+	renderer.setTrivialAccept(_config.trivialAccept);
+	renderer.setSpatialIndex(_config.spatialIndex);
+	const glm::mat4x4 projection = CameraPath::getProjectionMatrix(1.0f * _config.width / _config.height);
+
+	const CameraPath::Keyframe firstCamera = cameraPath.sample(0, _config.frames);
+	for (auto renderMode : renderModes) {
+		for (int i = 0; i < _config.warmupFrames; ++i) {
+			renderer.renderFrame(renderMode, projection * CameraPath::getViewMatrix(firstCamera), firstCamera.eye);
+		}
+	}
+
+	const size_t pixelCount = static_cast<size_t>(_config.width) * _config.height;
+	std::vector<float> referenceDepth(pixelCount);
+	std::vector<ModeTotals> totals(renderModes.size());
+	double depthComplexity = 0.0;
+	for (int frame = 0; frame < _config.frames; ++frame) {
+		const CameraPath::Keyframe camera = cameraPath.sample(frame, _config.frames);
+		const glm::mat4x4 viewProjection = projection * CameraPath::getViewMatrix(camera);
+		for (size_t mode = 0; mode < renderModes.size(); ++mode) {
+			renderer.renderFrame(renderModes[mode], viewProjection, camera.eye);
+
+			const Renderer::FrameStatistics& statistics = renderer.getFrameStatistics();
+			ModeTotals& modeTotals = totals[mode];
+			modeTotals.frameTimes.push_back(renderer.getFrameTiming().frame);
+			modeTotals.rasterMilliseconds += renderer.getFrameTiming().raster;
+			modeTotals.trianglesRasterized += statistics.trianglesSubmitted - statistics.trianglesOccluded;
+			modeTotals.pixelsTested += statistics.pixelsTested;
+
+			const float* depth = renderer.getFrameBuffer().getDepthBuffer();
+			if (mode == 0) {
+				std::copy(depth, depth + pixelCount, referenceDepth.begin());
+				depthComplexity += statistics.getDepthComplexity();
+				continue;
+			}
+
+			// the half-space rasterizer does not step its edges and depths like the reference, its
+			// depths differ by rounding and a pixel on a triangle edge of the reference may show
+			// the surface next to it instead
+			const bool halfSpace = renderModes[mode] == Renderer::RenderMode::HalfSpaceRasterizer;
+			const float tolerance = getDepthTolerance(renderModes[mode]);
+			for (size_t i = 0; i < pixelCount; ++i) {
+				const float error = std::fabs(depth[i] - referenceDepth[i]);
+				if (error <= tolerance) {
+					continue;
+				}
+
+				const int x = static_cast<int>(i % _config.width);
+				const int y = static_cast<int>(i / _config.width);
+				if (halfSpace && isDepthDiscontinuity(referenceDepth, _config.width, _config.height, x, y, tolerance) &&
+					isNeighbourSurface(referenceDepth, _config.width, _config.height, x, y, depth[i], tolerance)) {
+					++modeTotals.edgeDifferences;
+					modeTotals.maxEdgeError = std::max(modeTotals.maxEdgeError, error);
+				} else {
+					++modeTotals.depthMismatches;
+					modeTotals.maxDepthError = std::max(modeTotals.maxDepthError, error);
+				}
+			}
+		}
+	}
+
+	std::vector<Result> results;
+	const ModeTotals& reference = totals.front();
+	for (size_t mode = 0; mode < renderModes.size(); ++mode) {
+		ModeTotals& modeTotals = totals[mode];
+		std::sort(modeTotals.frameTimes.begin(), modeTotals.frameTimes.end());
+		double totalMilliseconds = 0.0;
+		for (double time : modeTotals.frameTimes) {
+			totalMilliseconds += time;
+		}
+
+		Result result;
+		result.scene = scene;
+		result.renderMode = renderModes[mode];
+		result.triangles = mesh.indices.size() / 3;
+		result.depthComplexity = depthComplexity / _config.frames;
+		result.p50 = getPercentile(modeTotals.frameTimes, 50.0);
+		result.p95 = getPercentile(modeTotals.frameTimes, 95.0);
+		result.p99 = getPercentile(modeTotals.frameTimes, 99.0);
+		result.mean = totalMilliseconds / _config.frames;
+		result.trianglesPerSecond = totalMilliseconds > 0.0 ?
+			1e3 * result.triangles * _config.frames / totalMilliseconds : 0.0;
+		result.depthTestsPerSecond = modeTotals.rasterMilliseconds > 0.0 ?
+			1e3 * modeTotals.pixelsTested / modeTotals.rasterMilliseconds : 0.0;
+		result.trianglesAvoided = reference.trianglesRasterized > 0 ?
+			1.0 - static_cast<double>(modeTotals.trianglesRasterized) / reference.trianglesRasterized : 0.0;
+		result.depthTestsAvoided = reference.pixelsTested > 0 ?
+			1.0 - static_cast<double>(modeTotals.pixelsTested) / reference.pixelsTested : 0.0;
+		result.depthTolerance = getDepthTolerance(renderModes[mode]);
+		result.depthMismatches = modeTotals.depthMismatches;
+		result.maxDepthError = modeTotals.maxDepthError;
+		result.edgeDifferences = modeTotals.edgeDifferences;
+		result.maxEdgeError = modeTotals.maxEdgeError;
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+
+/*
+ * @brief get the largest depth difference to the reference counted as equal in a mode
+ * @param renderMode mode compared with the reference
+ * @return the configured tolerance, at least the stated tolerance of the half-space rasterizer
+ */
+float Benchmark::getDepthTolerance(Renderer::RenderMode renderMode) const {
+	return renderMode == Renderer::RenderMode::HalfSpaceRasterizer ?
+		std::max(_config.depthTolerance, HalfSpaceRasterizer::getDepthTolerance()) : _config.depthTolerance;
+}
+
+
+/*
+ * @brief orbit around the bounding sphere of the mesh that keeps it on the screen
+ * @detail the camera circles slightly above the center at 1.6 radii, the distance the
+ *         window starts at for the bunny
+ * @param mesh mesh to look at
+ * @param keyframeCount number of keyframes on the circle
+ * @return camera path
+ */
+CameraPath Benchmark::getOrbit(const IndexedMesh& mesh, int keyframeCount) {
+	glm::vec3 boxMin(0.0f), boxMax(0.0f);
+	if (!mesh.positions.empty()) {
+		boxMin = boxMax = mesh.positions.front();
+	}
+
+	for (const glm::vec3& position : mesh.positions) {
+		boxMin = glm::min(boxMin, position);
+		boxMax = glm::max(boxMax, position);
+	}
+
+	const glm::vec3 center = 0.5f * (boxMin + boxMax);
+	float radius = 0.0f;
+	for (const glm::vec3& position : mesh.positions) {
+		radius = std::max(radius, glm::length(position - center));
+	}
+
+	return CameraPath::orbit(center, 1.6f * radius, 0.5f * radius, keyframeCount);
+}
+
+
+/*
+ * @brief get a percentile of sorted values by the nearest rank
+ * @param sorted values in ascending order
+ * @param percent percentile in (0, 100]
+ * @return smallest value with at least percent of the values not greater, 0 if empty
+ */
+double Benchmark::getPercentile(const std::vector<double>& sorted, double percent) {
+	if (sorted.empty()) {
+		return 0.0;
+	}
+
+	const size_t rank = static_cast<size_t>(std::ceil(percent / 100.0 * sorted.size()));
+	return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "camera_path.h"
+#include "mesh.h"
+#include "renderer.h"
+
+/**
+ * @brief comparison of the render modes on the same scene and camera path
+ * @detail every frame is rendered with the scan-line z-buffer as the reference first, then
+ *         with the other modes, whose depth buffers are compared with the reference before
+ *         any of their timings is trusted
+ */
+class Benchmark {
+public:
+	/*
+	 * @brief benchmark settings
+	 */
+	struct Config {
+		int width = 1280;
+		int height = 720;
+		/* frames along the camera path */
+		int frames = 60;
+		/* frames rendered per mode at the first camera before the measurement */
+		int warmupFrames = 5;
+		bool tiledRendering = false;
+		/* test the octree against the reprojected previous frame first */
+		bool temporalCulling = false;
+		/* draw the octree nodes visible in the previous frame untested */
+		bool visibilityPersistence = false;
+		/* write triangles in front of the two-sided z pyramid without depth tests */
+		bool trivialAccept = false;
+		/* spatial index traversed by the octree mode */
+		Renderer::SpatialIndex spatialIndex = Renderer::SpatialIndex::Octree;
+		/* largest depth difference to the reference still counted as equal, the half-space mode
+		   uses at least HalfSpaceRasterizer::getDepthTolerance */
+		float depthTolerance = 0.0f;
+		/* modes to measure, the scan-line z-buffer is always measured as the reference */
+		std::vector<Renderer::RenderMode> renderModes = {
+			Renderer::RenderMode::ScanLineZBuffer,
+			Renderer::RenderMode::HierarchicalZBuffer,
+			Renderer::RenderMode::OctreeHierarchicalZBuffer
+		};
+	};
+
+	/*
+	 * @brief measurements of one render mode on one scene
+	 */
+	struct Result {
+		std::string scene;
+		Renderer::RenderMode renderMode = Renderer::RenderMode::ScanLineZBuffer;
+		size_t triangles = 0;
+		/* depth tests of the reference per covered pixel, averaged over the frames */
+		double depthComplexity = 0.0;
+		/* frame time percentiles and mean in milliseconds */
+		double p50 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double mean = 0.0;
+		/* triangles of the scene per second of frame time */
+		double trianglesPerSecond = 0.0;
+		/* depth tests per second of rasterization time */
+		double depthTestsPerSecond = 0.0;
+		/* fraction of the triangles scan converted by the reference that were not */
+		double trianglesAvoided = 0.0;
+		/* fraction of the depth tests of the reference that were not done */
+		double depthTestsAvoided = 0.0;
+		/* largest depth difference to the reference counted as equal in this mode */
+		float depthTolerance = 0.0f;
+		/* pixels differing from the reference by more than the tolerance, summed over the frames */
+		uint64_t depthMismatches = 0;
+		float maxDepthError = 0.0f;
+		/* pixels on triangle edges of the reference the half-space mode covers by the surface next to them */
+		uint64_t edgeDifferences = 0;
+		float maxEdgeError = 0.0f;
+
+		/*
+		 * @brief check whether the depth buffer matched the reference within the tolerance of the mode
+		 */
+		bool isDepthVerified() const {
+			return depthMismatches == 0;
+		}
+
+		/*
+		 * @brief check whether the depth buffer was the same as the reference in every frame
+		 */
+		bool isDepthIdentical() const {
+			return depthMismatches == 0 && edgeDifferences == 0 && depthTolerance == 0.0f;
+		}
+	};
+
+	/*
+	 * @brief constructor
+	 */
+	explicit Benchmark(const Config& config);
+
+	/*
+	 * @brief default destructor
+	 */
+	~Benchmark() = default;
+
+	/*
+	 * @brief render the scene along the camera path with every mode
+	 */
+	std::vector<Result> run(const std::string& scene, const IndexedMesh& mesh, const CameraPath& cameraPath) const;
+
+	/*
+	 * @brief get the largest depth difference to the reference counted as equal in a mode
+	 */
+	float getDepthTolerance(Renderer::RenderMode renderMode) const;
+
+	/*
+	 * @brief orbit around the bounding sphere of the mesh that keeps it on the screen
+	 */
+	static CameraPath getOrbit(const IndexedMesh& mesh, int keyframeCount);
+
+	/*
+	 * @brief get a percentile of sorted values by the nearest rank
+	 */
+	static double getPercentile(const std::vector<double>& sorted, double percent);
+
+private:
+	Config _config;
+};
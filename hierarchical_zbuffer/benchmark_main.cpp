@@ -0,0 +1,374 @@
+/*
+ * comparative benchmark of the render modes, prints one CSV row per scene and mode to stdout
+ * and the fastest mode of every scene with its depth complexity to stderr. Speedups are only
+ * reported for modes whose depth buffer matches the scan-line reference within the tolerance
+ * of the mode, exactly unless a tolerance is given or the mode states one, and a previous
+ * report given as the baseline flags the modes that got slower.
+ *
+ * It is excluded from the Visual Studio build, which links main.cpp, the CMake build at the
+ * root of the repository builds it as the bench target
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark.h"
+#include "camera_path.h"
+#include "mesh.h"
+#include "model.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "scene_generator.h"
+
+namespace {
+	/*
+	 * @brief command line options
+	 */
+	struct Options {
+		Benchmark::Config config;
+		std::vector<std::string> modelPaths;
+		std::vector<int> cubeGrids;
+		std::string reportPath;
+		std::string baselinePath;
+		/* relative p50 slowdown to the baseline flagged as a regression */
+		double regressionThreshold = 0.1;
+	};
+
+	/* p50 frame time of a previous run by scene and mode */
+	using Baseline = std::map<std::pair<std::string, std::string>, double>;
+
+	/*
+	 * @brief print the usage to stderr
+	 */
+	void printUsage(const char* program) {
+		std::cerr << "usage: " << program << " [options]\n"
+			"  --scene PATH          model to benchmark, repeatable\n"
+			"  --cubes N             generated grid of N^3 cubes, repeatable\n"
+			"                        default scenes: bunny.obj, soccerball.obj, cubes 4, 8 and 16\n"
+			"  --modes LIST          comma separated scanline, hierarchical, octree, halfspace\n"
+			"                        (default scanline,hierarchical,octree), scanline is always run\n"
+			"  --width N             frame buffer width (default 1280)\n"
+			"  --height N            frame buffer height (default 720)\n"
+			"  --frames N            frames along the orbit of every scene (default 60)\n"
+			"  --warmup N            frames per mode before the measurement (default 5)\n"
+			"  --index INDEX         octree or bvh traversed by the octree mode (default octree)\n"
+			"  --tiled               render the tiles in parallel\n"
+			"  --temporal            test the octree against the reprojected previous frame first\n"
+			"  --coherent            draw the octree nodes visible in the previous frame untested\n"
+			"  --trivial-accept      write triangles in front of the z pyramid without depth tests\n"
+			"  --depth-tolerance F   largest depth difference to the reference counted as equal (default 0),\n"
+			"                        at least 1e-5 for halfspace, whose pixels covered differently on\n"
+			"                        triangle edges of the reference are counted as edge differences\n"
+			"  --report FILE         write the CSV report to FILE instead of stdout\n"
+			"  --baseline FILE       report of a previous run to compare the p50 frame times with\n"
+			"  --regression F        relative p50 slowdown flagged as a regression (default 0.1)\n";
+	}
+
+	/*
+	 * @brief parse a positive integer option value
+	 */
+	int parseCount(const std::string& option, const char* value, int minimum) {
+		char* end = nullptr;
+		const long count = std::strtol(value, &end, 10);
+		if (end == value || *end != '\0' || count < minimum || count > 1 << 16) {
+			throw std::invalid_argument("invalid value " + std::string(value) + " of " + option);
+		}
+
+		return static_cast<int>(count);
+	}
+
+	/*
+	 * @brief parse a non negative real option value
+	 */
+	double parseReal(const std::string& option, const char* value) {
+		char* end = nullptr;
+		const double real = std::strtod(value, &end);
+		if (end == value || *end != '\0' || !(real >= 0.0)) {
+			throw std::invalid_argument("invalid value " + std::string(value) + " of " + option);
+		}
+
+		return real;
+	}
+
+	/*
+	 * @brief parse a render mode by name
+	 */
+	Renderer::RenderMode parseRenderMode(const std::string& name) {
+		for (auto mode : { Renderer::RenderMode::ScanLineZBuffer, Renderer::RenderMode::HierarchicalZBuffer,
+			Renderer::RenderMode::OctreeHierarchicalZBuffer, Renderer::RenderMode::HalfSpaceRasterizer }) {
+			if (name == Renderer::getRenderModeName(mode)) {
+				return mode;
+			}
+		}
+
+		throw std::invalid_argument("unknown render mode " + name);
+	}
+
+	/*
+	 * @brief parse a spatial index by name
+	 */
+	Renderer::SpatialIndex parseSpatialIndex(const std::string& name) {
+		for (auto spatialIndex : { Renderer::SpatialIndex::Octree, Renderer::SpatialIndex::Bvh }) {
+			if (name == Renderer::getSpatialIndexName(spatialIndex)) {
+				return spatialIndex;
+			}
+		}
+
+		throw std::invalid_argument("unknown spatial index " + name);
+	}
+
+	/*
+	 * @brief parse the command line, throw std::invalid_argument on an error
+	 * @return false if the usage was requested
+	 */
+	bool parseOptions(int argc, char* argv[], Options& options) {
+		for (int i = 1; i < argc; ++i) {
+			const std::string option = argv[i];
+			if (option == "--help" || option == "-h") {
+				return false;
+			} else if (option == "--tiled") {
+				options.config.tiledRendering = true;
+				continue;
+			} else if (option == "--temporal") {
+				options.config.temporalCulling = true;
+				continue;
+			} else if (option == "--coherent") {
+				options.config.visibilityPersistence = true;
+				continue;
+			} else if (option == "--trivial-accept") {
+				options.config.trivialAccept = true;
+				continue;
+			}
+
+			if (i + 1 >= argc) {
+				throw std::invalid_argument("missing value of " + option);
+			}
+
+			const char* value = argv[++i];
+			if (option == "--scene") {
+				options.modelPaths.push_back(value);
+			} else if (option == "--cubes") {
+				options.cubeGrids.push_back(parseCount(option, value, 1));
+			} else if (option == "--width") {
+				options.config.width = parseCount(option, value, 1);
+			} else if (option == "--height") {
+				options.config.height = parseCount(option, value, 1);
+			} else if (option == "--frames") {
+				options.config.frames = parseCount(option, value, 1);
+			} else if (option == "--warmup") {
+				options.config.warmupFrames = parseCount(option, value, 0);
+			} else if (option == "--depth-tolerance") {
+				options.config.depthTolerance = static_cast<float>(parseReal(option, value));
+			} else if (option == "--report") {
+				options.reportPath = value;
+			} else if (option == "--baseline") {
+				options.baselinePath = value;
+			} else if (option == "--regression") {
+				options.regressionThreshold = parseReal(option, value);
+			} else if (option == "--modes") {
+				options.config.renderModes.clear();
+				std::istringstream names(value);
+				std::string name;
+				while (std::getline(names, name, ',')) {
+					options.config.renderModes.push_back(parseRenderMode(name));
+				}
+			} else if (option == "--index") {
+				options.config.spatialIndex = parseSpatialIndex(value);
+			} else {
+				throw std::invalid_argument("unknown option " + option);
+			}
+		}
+
+		if (options.modelPaths.empty() && options.cubeGrids.empty()) {
+			options.modelPaths = { "../resources/bunny.obj", "../resources/soccerball.obj" };
+			options.cubeGrids = { 4, 8, 16 };
+		}
+
+		return true;
+	}
+
+	/*
+	 * @brief get the scene name of a model path, the file name without the extension
+	 */
+	std::string getSceneName(const std::string& modelPath) {
+		const size_t slash = modelPath.find_last_of("/\\");
+		std::string name = slash == std::string::npos ? modelPath : modelPath.substr(slash + 1);
+		const size_t dot = name.find_last_of('.');
+		return dot == std::string::npos || dot == 0 ? name : name.substr(0, dot);
+	}
+
+	/*
+	 * @brief read the p50 frame times of a previous report
+	 */
+	Baseline readBaseline(const std::string& filepath) {
+		std::ifstream file(filepath);
+		if (!file) {
+			throw std::runtime_error("cannot open baseline " + filepath);
+		}
+
+		auto split = [](const std::string& line) {
+			std::vector<std::string> fields;
+			std::istringstream stream(line);
+			std::string field;
+			while (std::getline(stream, field, ',')) {
+				fields.push_back(field);
+			}
+
+			return fields;
+		};
+
+		std::string line;
+		std::getline(file, line);
+		const std::vector<std::string> header = split(line);
+		size_t scene = header.size(), mode = header.size(), p50 = header.size();
+		for (size_t i = 0; i < header.size(); ++i) {
+			scene = header[i] == "scene" ? i : scene;
+			mode = header[i] == "mode" ? i : mode;
+			p50 = header[i] == "p50_ms" ? i : p50;
+		}
+
+		if (scene == header.size() || mode == header.size() || p50 == header.size()) {
+			throw std::runtime_error("baseline " + filepath + " has no scene, mode and p50_ms columns");
+		}
+
+		Baseline baseline;
+		while (std::getline(file, line)) {
+			const std::vector<std::string> fields = split(line);
+			if (fields.size() == header.size()) {
+				baseline[std::make_pair(fields[scene], fields[mode])] = std::strtod(fields[p50].c_str(), nullptr);
+			}
+		}
+
+		return baseline;
+	}
+}
+
+/* benchmark entry point, see printUsage for the options */
+int main(int argc, char* argv[]) {
+	Options options;
+	try {
+		if (!parseOptions(argc, argv, options)) {
+			printUsage(argv[0]);
+			return EXIT_SUCCESS;
+		}
+	} catch (const std::invalid_argument& e) {
+		std::cerr << e.what() << std::endl;
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// the measured frame times exclude the stage timers
+	Profiler::getInstance().setEnabled(false);
+
+	bool failed = false;
+	try {
+		const Baseline baseline = options.baselinePath.empty() ? Baseline() : readBaseline(options.baselinePath);
+
+		std::ofstream reportFile;
+		if (!options.reportPath.empty()) {
+			reportFile.open(options.reportPath);
+			if (!reportFile) {
+				throw std::runtime_error("cannot open " + options.reportPath);
+			}
+		}
+		std::ostream& report = options.reportPath.empty() ? std::cout : reportFile;
+
+		std::vector<std::pair<std::string, IndexedMesh>> scenes;
+		for (const std::string& modelPath : options.modelPaths) {
+			IndexedMesh mesh;
+			Model::loadIndexedMesh(modelPath, mesh);
+			scenes.emplace_back(getSceneName(modelPath), std::move(mesh));
+		}
+
+		for (int cubesPerAxis : options.cubeGrids) {
+			scenes.emplace_back("cubes" + std::to_string(cubesPerAxis), generateCubeGrid(cubesPerAxis));
+		}
+
+		report << "scene,mode,triangles,depth_complexity,p50_ms,p95_ms,p99_ms,mean_ms,"
+			"mtriangles_per_s,mdepth_tests_per_s,triangles_avoided,depth_tests_avoided,"
+			"depth_tolerance,depth_mismatches,max_depth_error,edge_differences,max_edge_error,speedup_p50,baseline_p50_ms,regression" << std::endl;
+
+		const Benchmark benchmark(options.config);
+		for (const auto& scene : scenes) {
+			const std::vector<Benchmark::Result> results =
+				benchmark.run(scene.first, scene.second, Benchmark::getOrbit(scene.second, 16));
+			const Benchmark::Result& reference = results.front();
+			const Benchmark::Result* fastest = &reference;
+			for (const Benchmark::Result& result : results) {
+				const std::string mode = Renderer::getRenderModeName(result.renderMode);
+				const bool depthVerified = result.isDepthVerified();
+				report << result.scene << "," << mode << "," << result.triangles << "," << result.depthComplexity << ","
+					<< result.p50 << "," << result.p95 << "," << result.p99 << "," << result.mean << ","
+					<< 1e-6 * result.trianglesPerSecond << "," << 1e-6 * result.depthTestsPerSecond << ","
+					<< result.trianglesAvoided << "," << result.depthTestsAvoided << "," << result.depthTolerance << ","
+					<< result.depthMismatches << "," << result.maxDepthError << ","
+					<< result.edgeDifferences << "," << result.maxEdgeError << ",";
+				if (depthVerified && result.p50 > 0.0) {
+					report << reference.p50 / result.p50;
+				}
+				report << ",";
+
+				auto entry = baseline.find(std::make_pair(result.scene, mode));
+				if (entry != baseline.end()) {
+					const bool regression = result.p50 > entry->second * (1.0 + options.regressionThreshold);
+					report << entry->second << "," << (regression ? "yes" : "no");
+					if (regression) {
+						std::cerr << "regression: " << result.scene << " " << mode << " p50 " << result.p50
+							<< " ms, baseline " << entry->second << " ms" << std::endl;
+						failed = true;
+					}
+				} else {
+					report << ",";
+				}
+				report << "\n";
+
+				// the reference rasterizes every triangle after culling and clipping, no mode more
+				if (result.trianglesAvoided < 0.0) {
+					std::cerr << "triangle count: " << result.scene << " " << mode << " rasterized more triangles than scanline, "
+						<< "avoided " << result.trianglesAvoided << std::endl;
+					failed = true;
+				}
+
+				// pixels on triangle edges covered by the fill rule of the half-space mode are no
+				// error, but the mode does not produce the same image
+				if (result.edgeDifferences > 0) {
+					std::cerr << "edge differences: " << result.scene << " " << mode << " covers "
+						<< result.edgeDifferences << " pixels on triangle edges differently from scanline, up to "
+						<< result.maxEdgeError << std::endl;
+				}
+
+				if (result.depthMismatches > 0) {
+					std::cerr << "depth mismatch: " << result.scene << " " << mode << " differs from scanline in "
+						<< result.depthMismatches << " pixels, up to " << result.maxDepthError << std::endl;
+					failed = true;
+				} else if (result.p50 < fastest->p50) {
+					fastest = &result;
+				}
+			}
+			report.flush();
+
+			std::cerr << scene.first << " (" << reference.triangles << " triangles, depth complexity "
+				<< reference.depthComplexity << "): " << Renderer::getRenderModeName(fastest->renderMode)
+				<< " wins with p50 " << fastest->p50 << " ms, " << reference.p50 / fastest->p50
+				<< "x the scanline reference";
+			if (!fastest->isDepthIdentical()) {
+				std::cerr << ", depths within " << fastest->depthTolerance << " and "
+					<< fastest->edgeDifferences << " edge differences";
+			}
+			std::cerr << std::endl;
+		}
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <cfloat>
+
+#include <glm/common.hpp>
+
+#include "bvh.h"
+
+namespace {
+	/*
+	 * @brief triangles falling into one centroid bin during the build
+	 */
+	struct Bin {
+		glm::vec3 boxMin = glm::vec3(FLT_MAX);
+		glm::vec3 boxMax = glm::vec3(-FLT_MAX);
+		uint32_t count = 0;
+	};
+
+	/* half the surface area of a box, 0 for an empty one */
+	inline float getHalfArea(const glm::vec3& boxMin, const glm::vec3& boxMax) {
+		const glm::vec3 extent = glm::max(boxMax - boxMin, glm::vec3(0.0f));
+		return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+	}
+}
+
+/*
+ * @brief build the tree over the triangles of the mesh
+ * @param mesh world space mesh, leaf triangle indices refer to its triangles
+ * @param config build parameters
+ */
+void Bvh::build(const IndexedMesh& mesh, const Config& config) {
+	const size_t triangleCount = mesh.indices.size() / 3;
+	_config = config;
+	_config.leafSize = std::min(std::max(_config.leafSize, 1), 0xFFFF);
+	_config.binCount = std::max(_config.binCount, 2);
+	_depth = 0;
+	_nodes.clear();
+	_nodes.reserve(2 * triangleCount);
+	_triangleIndices.resize(triangleCount);
+
+	_triangleMin.resize(triangleCount);
+	_triangleMax.resize(triangleCount);
+	_centroids.resize(triangleCount);
+	for (size_t i = 0; i < triangleCount; ++i) {
+		const glm::vec3& p0 = mesh.positions[mesh.indices[3 * i]];
+		const glm::vec3& p1 = mesh.positions[mesh.indices[3 * i + 1]];
+		const glm::vec3& p2 = mesh.positions[mesh.indices[3 * i + 2]];
+		_triangleMin[i] = glm::min(glm::min(p0, p1), p2);
+		_triangleMax[i] = glm::max(glm::max(p0, p1), p2);
+		_centroids[i] = 0.5f * (_triangleMin[i] + _triangleMax[i]);
+		_triangleIndices[i] = static_cast<uint32_t>(i);
+	}
+
+	if (triangleCount > 0) {
+		_buildNode(0, static_cast<uint32_t>(triangleCount), 0);
+	}
+	_nodes.shrink_to_fit();
+
+	_triangleMin.clear();
+	_triangleMin.shrink_to_fit();
+	_triangleMax.clear();
+	_triangleMax.shrink_to_fit();
+	_centroids.clear();
+	_centroids.shrink_to_fit();
+	_nodeView = _nodes;
+	_triangleView = _triangleIndices;
+}
+
+
+/*
+ * @brief use a tree built before and stored elsewhere, it must outlive this one
+ * @detail the arrays are used in place, the nodes should be cache line aligned like built ones
+ * @param config parameters the tree was built with
+ * @param depth depth of the deepest node
+ * @param nodes flattened nodes, the root at index 0
+ * @param triangleIndices triangle indices referenced by the leaves
+ */
+void Bvh::assign(const Config& config, int depth, ArrayView<BvhNode> nodes, ArrayView<uint32_t> triangleIndices) {
+	_config = config;
+	_depth = depth;
+	_nodes.clear();
+	_triangleIndices.clear();
+	_nodeView = nodes;
+	_triangleView = triangleIndices;
+}
+
+
+/*
+ * @brief get all nodes, the root is at index 0
+ * @return the node array, empty if no triangle is in the tree
+ */
+ArrayView<BvhNode> Bvh::getNodes() const {
+	return _nodeView;
+}
+
+
+/*
+ * @brief get the triangle indices referenced by the leaves
+ * @return the triangle index array
+ */
+ArrayView<uint32_t> Bvh::getTriangleIndices() const {
+	return _triangleView;
+}
+
+
+/*
+ * @brief get the parameters of the last build
+ * @return build parameters
+ */
+const Bvh::Config& Bvh::getConfig() const {
+	return _config;
+}
+
+
+/*
+ * @brief get the deepest level reached by the last build
+ * @return depth of the deepest node, the root is at level 0
+ */
+int Bvh::getDepth() const {
+	return _depth;
+}
+
+
+/*
+ * @brief create the node over a range of the triangle index array and split it
+ * @detail the split minimizing nodeCost + triangleCost * (A_l * N_l + A_r * N_r) / A over the
+ *         bin boundaries of all three axes is taken if it is cheaper than a leaf, or if the
+ *         node holds more than leafSize triangles. Triangles whose centroids coincide are
+ *         halved by their order instead
+ * @param first first triangle of the node in the triangle index array
+ * @param count number of triangles, at least 1
+ * @param depth level of the node
+ * @return index of the created node
+ */
+uint32_t Bvh::_buildNode(uint32_t first, uint32_t count, int depth) {
+	const uint32_t index = static_cast<uint32_t>(_nodes.size());
+	_nodes.emplace_back();
+	_depth = std::max(_depth, depth);
+
+	uint32_t* triangles = &_triangleIndices[first];
+	glm::vec3 boxMin(FLT_MAX), boxMax(-FLT_MAX);
+	glm::vec3 centroidMin(FLT_MAX), centroidMax(-FLT_MAX);
+	for (uint32_t i = 0; i < count; ++i) {
+		boxMin = glm::min(boxMin, _triangleMin[triangles[i]]);
+		boxMax = glm::max(boxMax, _triangleMax[triangles[i]]);
+		centroidMin = glm::min(centroidMin, _centroids[triangles[i]]);
+		centroidMax = glm::max(centroidMax, _centroids[triangles[i]]);
+	}
+	_nodes[index].boxMin = boxMin;
+	_nodes[index].boxMax = boxMax;
+
+	const int binCount = _config.binCount;
+	const float area = getHalfArea(boxMin, boxMax);
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestBin = 0;
+	std::vector<Bin> bins(binCount);
+	std::vector<float> rightCost(binCount);
+	for (int axis = 0; axis < 3 && count > 1 && area > 0.0f; ++axis) {
+		const float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0.0f) {
+			continue;
+		}
+
+		const float scale = binCount / extent;
+		std::fill(bins.begin(), bins.end(), Bin());
+		for (uint32_t i = 0; i < count; ++i) {
+			const int bin = std::min(static_cast<int>((_centroids[triangles[i]][axis] - centroidMin[axis]) * scale), binCount - 1);
+			bins[bin].boxMin = glm::min(bins[bin].boxMin, _triangleMin[triangles[i]]);
+			bins[bin].boxMax = glm::max(bins[bin].boxMax, _triangleMax[triangles[i]]);
+			++bins[bin].count;
+		}
+
+		// rightCost[b]: area times count of the bins above b
+		Bin right;
+		for (int bin = binCount - 1; bin > 0; --bin) {
+			right.boxMin = glm::min(right.boxMin, bins[bin].boxMin);
+			right.boxMax = glm::max(right.boxMax, bins[bin].boxMax);
+			right.count += bins[bin].count;
+			rightCost[bin - 1] = right.count > 0 ? getHalfArea(right.boxMin, right.boxMax) * right.count : 0.0f;
+		}
+
+		Bin left;
+		for (int bin = 0; bin + 1 < binCount; ++bin) {
+			left.boxMin = glm::min(left.boxMin, bins[bin].boxMin);
+			left.boxMax = glm::max(left.boxMax, bins[bin].boxMax);
+			left.count += bins[bin].count;
+			if (left.count == 0 || left.count == count) {
+				continue;
+			}
+
+			const float cost = _config.nodeCost + _config.triangleCost *
+				(getHalfArea(left.boxMin, left.boxMax) * left.count + rightCost[bin]) / area;
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = bin;
+			}
+		}
+	}
+
+	const bool overfull = count > static_cast<uint32_t>(_config.leafSize);
+	if (!overfull && !(bestAxis >= 0 && bestCost < _config.triangleCost * count)) {
+		_nodes[index].offset = first;
+		_nodes[index].triangleCount = static_cast<uint16_t>(count);
+		_nodes[index].axis = 0;
+		return index;
+	}
+
+	uint32_t leftCount;
+	int axis = bestAxis;
+	if (bestAxis >= 0) {
+		const float scale = binCount / (centroidMax[axis] - centroidMin[axis]);
+		uint32_t* middle = std::partition(triangles, triangles + count, [&](uint32_t id) {
+			return std::min(static_cast<int>((_centroids[id][axis] - centroidMin[axis]) * scale), binCount - 1) <= bestBin;
+		});
+		leftCount = static_cast<uint32_t>(middle - triangles);
+	} else {
+		const glm::vec3 extent = boxMax - boxMin;
+		axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		leftCount = count / 2;
+	}
+
+	_buildNode(first, leftCount, depth + 1);
+	const uint32_t second = _buildNode(first + leftCount, count - leftCount, depth + 1);
+	_nodes[index].offset = second;
+	_nodes[index].triangleCount = 0;
+	_nodes[index].axis = static_cast<uint16_t>(axis);
+	return index;
+}
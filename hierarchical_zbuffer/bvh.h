@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#ifdef GLFW_INCLUDE_VULKAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include <glm/vec3.hpp>
+
+#include "aligned_allocator.h"
+#include "array_view.h"
+#include "mesh.h"
+
+/* 32 bytes, so two nodes share a cache line and none straddles one */
+struct BvhNode {
+	/* bounds of all triangles in the subtree */
+	glm::vec3 boxMin;
+	/* inner node: index of the second child, the first child follows the node;
+	   leaf: first triangle in the triangle index array */
+	uint32_t offset;
+	glm::vec3 boxMax;
+	/* triangles of a leaf, 0 for an inner node */
+	uint16_t triangleCount;
+	/* axis the children of an inner node were split along, the first child is on the lower side */
+	uint16_t axis;
+};
+
+static_assert(sizeof(BvhNode) == 32, "a bvh node must fill half a cache line");
+
+/**
+ * @brief bounding volume hierarchy over the triangles of an indexed mesh
+ * @detail every inner node splits its triangles in two by the surface area heuristic over
+ *         binned centroids. The nodes are flattened depth first into one cache line aligned
+ *         array, a parent always precedes its children and its first child follows it
+ */
+class Bvh {
+public:
+	/*
+	 * @brief build parameters
+	 */
+	struct Config {
+		/* a node holding more triangles is always split */
+		int leafSize = 32;
+		/* centroid bins per axis evaluated for a split */
+		int binCount = 16;
+		/* cost of a node test relative to one triangle, a test projects 8 box corners and reads
+		   the pyramid while most triangles are rejected cheaply by the backface test */
+		float nodeCost = 24.0f;
+		float triangleCost = 1.0f;
+	};
+
+	using NodeArray = std::vector<BvhNode, AlignedAllocator<BvhNode, 64>>;
+
+	/*
+	 * @brief default constructor, an empty tree
+	 */
+	Bvh() = default;
+
+	/*
+	 * @brief default destructor
+	 */
+	~Bvh() = default;
+
+	/*
+	 * @brief build the tree over the triangles of the mesh
+	 */
+	void build(const IndexedMesh& mesh, const Config& config);
+
+	/*
+	 * @brief use a tree built before and stored elsewhere, it must outlive this one
+	 */
+	void assign(const Config& config, int depth, ArrayView<BvhNode> nodes, ArrayView<uint32_t> triangleIndices);
+
+	/*
+	 * @brief get all nodes, the root is at index 0
+	 */
+	ArrayView<BvhNode> getNodes() const;
+
+	/*
+	 * @brief get the triangle indices referenced by the leaves
+	 */
+	ArrayView<uint32_t> getTriangleIndices() const;
+
+	/*
+	 * @brief get the parameters of the last build
+	 */
+	const Config& getConfig() const;
+
+	/*
+	 * @brief get the deepest level reached by the last build
+	 */
+	int getDepth() const;
+
+private:
+	Config _config;
+	int _depth = 0;
+	NodeArray _nodes;
+	std::vector<uint32_t> _triangleIndices;
+	/* the arrays handed out, the ones above or the ones given to assign */
+	ArrayView<BvhNode> _nodeView;
+	ArrayView<uint32_t> _triangleView;
+	/* bounds and centroid of each triangle during the build */
+	std::vector<glm::vec3> _triangleMin;
+	std::vector<glm::vec3> _triangleMax;
+	std::vector<glm::vec3> _centroids;
+
+	/*
+	 * @brief create the node over a range of the triangle index array and split it
+	 * @return index of the created node
+	 */
+	uint32_t _buildNode(uint32_t first, uint32_t count, int depth);
+};
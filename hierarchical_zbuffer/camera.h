@@ -55,8 +55,8 @@ public:
 
 	glm::mat4x4 getViewMatrix() {
 		glm::mat4x4 view(1.0f);
-		view = glm::translate(view, -_localPosition);
-		view = glm::mat4_cast(_localRotation) * view;
+		view = glm::translate(view, -getLocalPosition());
+		view = glm::mat4_cast(getLocalRotation()) * view;
 		return view;
 	}
 
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "camera_path.h"
+
+/*
+ * @brief constructor, load the keyframes from a text file
+ * @detail one keyframe per line as "eyeX eyeY eyeZ targetX targetY targetZ", empty
+ *         lines and lines starting with # are skipped
+ * @param filepath the camera path file path
+ */
+CameraPath::CameraPath(const std::string& filepath) {
+	std::ifstream file(filepath);
+	if (!file) {
+		throw std::runtime_error("cannot open camera path " + filepath);
+	}
+
+	std::string line;
+	for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+		const size_t first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#') {
+			continue;
+		}
+
+		std::istringstream values(line);
+		Keyframe keyframe;
+		if (!(values >> keyframe.eye.x >> keyframe.eye.y >> keyframe.eye.z
+			>> keyframe.target.x >> keyframe.target.y >> keyframe.target.z)) {
+			throw std::runtime_error(filepath + ":" + std::to_string(lineNumber) + ": expected 6 numbers");
+		}
+
+		_keyframes.push_back(keyframe);
+	}
+
+	if (_keyframes.empty()) {
+		throw std::runtime_error("no keyframe in camera path " + filepath);
+	}
+}
+
+
+/*
+ * @brief circle around a center at a fixed height, looking at the center
+ * @detail the last keyframe repeats the first, so a run ends where it starts
+ * @param center point the camera looks at
+ * @param radius distance of the camera to the vertical axis through the center
+ * @param height y of the camera above the center
+ * @param keyframeCount number of keyframes on the circle
+ * @return camera path
+ */
+CameraPath CameraPath::orbit(const glm::vec3& center, float radius, float height, int keyframeCount) {
+	CameraPath path;
+	for (int i = 0; i <= keyframeCount; ++i) {
+		const float angle = 2.0f * glm::pi<float>() * i / keyframeCount;
+		path.addKeyframe(center + glm::vec3(radius * std::sin(angle), height, radius * std::cos(angle)), center);
+	}
+
+	return path;
+}
+
+
+/*
+ * @brief append a keyframe
+ * @param eye position of the camera
+ * @param target point the camera looks at
+ */
+void CameraPath::addKeyframe(const glm::vec3& eye, const glm::vec3& target) {
+	_keyframes.push_back(Keyframe{ eye, target });
+}
+
+
+/*
+ * @brief get the number of keyframes
+ * @return keyframe count
+ */
+size_t CameraPath::getKeyframeCount() const {
+	return _keyframes.size();
+}
+
+
+/*
+ * @brief get the camera of a frame of a run
+ * @detail the first frame is at the first keyframe and the last frame at the last one
+ * @param frame index of the frame in [0, frameCount)
+ * @param frameCount number of frames of the run
+ * @return interpolated camera
+ */
+CameraPath::Keyframe CameraPath::sample(int frame, int frameCount) const {
+	if (_keyframes.size() < 2 || frameCount < 2) {
+		return _keyframes.empty() ? Keyframe{ glm::vec3(0.0f, 0.0f, 6.0f), glm::vec3(0.0f) } : _keyframes.front();
+	}
+
+	const float t = static_cast<float>(frame) * (_keyframes.size() - 1) / (frameCount - 1);
+	const size_t i = std::min(static_cast<size_t>(t), _keyframes.size() - 2);
+	const float s = t - i;
+	return Keyframe{
+		glm::mix(_keyframes[i].eye, _keyframes[i + 1].eye, s),
+		glm::mix(_keyframes[i].target, _keyframes[i + 1].target, s) };
+}
+
+
+/*
+ * @brief get the projection matrix of the window camera for an aspect ratio
+ * @detail the field of view and the clip planes are those of the FpsCamera of the application
+ * @param aspect width divided by height
+ * @return perspective projection matrix
+ */
+glm::mat4x4 CameraPath::getProjectionMatrix(float aspect) {
+	return glm::perspective(glm::radians(54.0f), aspect, 0.1f, 10000.0f);
+}
+
+
+/*
+ * @brief get the view matrix of a camera, y is up unless the camera looks along y
+ * @param camera camera position and target
+ * @return view matrix looking at negative z in camera space, like Camera::getViewMatrix
+ */
+glm::mat4x4 CameraPath::getViewMatrix(const Keyframe& camera) {
+	const glm::vec3 direction = camera.target - camera.eye;
+	glm::vec3 up(0.0f, 1.0f, 0.0f);
+	if (glm::length(glm::cross(direction, up)) <= 1e-6f * glm::length(direction)) {
+		up = glm::vec3(0.0f, 0.0f, -1.0f);
+	}
+
+	return glm::lookAt(camera.eye, camera.target, up);
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#ifdef GLFW_INCLUDE_VULKAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+/**
+ * @brief scripted camera flight through keyframes, replayable frame by frame
+ * @detail a keyframe is a camera position and the point it looks at, the frames of a run
+ *         are spread evenly over the keyframes and interpolated linearly between them
+ */
+class CameraPath {
+public:
+	/*
+	 * @brief camera position and the point it looks at
+	 */
+	struct Keyframe {
+		glm::vec3 eye;
+		glm::vec3 target;
+	};
+
+	/*
+	 * @brief constructor, empty path
+	 */
+	CameraPath() = default;
+
+	/*
+	 * @brief constructor, load the keyframes from a text file
+	 */
+	explicit CameraPath(const std::string& filepath);
+
+	/*
+	 * @brief default destructor
+	 */
+	~CameraPath() = default;
+
+	/*
+	 * @brief circle around a center at a fixed height, looking at the center
+	 */
+	static CameraPath orbit(const glm::vec3& center, float radius, float height, int keyframeCount);
+
+	/*
+	 * @brief append a keyframe
+	 */
+	void addKeyframe(const glm::vec3& eye, const glm::vec3& target);
+
+	/*
+	 * @brief get the number of keyframes
+	 */
+	size_t getKeyframeCount() const;
+
+	/*
+	 * @brief get the camera of a frame of a run
+	 */
+	Keyframe sample(int frame, int frameCount) const;
+
+	/*
+	 * @brief get the projection matrix of the window camera for an aspect ratio
+	 */
+	static glm::mat4x4 getProjectionMatrix(float aspect);
+
+	/*
+	 * @brief get the view matrix of a camera, y is up unless the camera looks along y
+	 */
+	static glm::mat4x4 getViewMatrix(const Keyframe& camera);
+
+private:
+	std::vector<Keyframe> _keyframes;
+};
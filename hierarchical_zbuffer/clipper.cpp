@@ -0,0 +1,170 @@
+#include "clipper.h"
+
+namespace {
+	/* a triangle gains at most one vertex per clipping plane */
+	const int maxPolygonVertices = 3 + 5;
+
+	/*
+	 * @brief signed distance of a clip space vertex to a plane, inside if not negative
+	 */
+	float planeDistance(const glm::vec4& v, uint8_t plane, float guardBand) {
+		switch (plane) {
+			case Clipper::Near:
+				return v.z + v.w;
+			case Clipper::Left:
+				return v.x + guardBand * v.w;
+			case Clipper::Right:
+				return guardBand * v.w - v.x;
+			case Clipper::Bottom:
+				return v.y + guardBand * v.w;
+			default:
+				return guardBand * v.w - v.y;
+		}
+	}
+
+	/*
+	 * @brief clip a convex polygon against one plane with Sutherland-Hodgman
+	 * @detail the intersection is always interpolated from the inside vertex, so an edge
+	 *         shared by two triangles is cut at the same point for both
+	 * @return number of vertices written to output
+	 */
+	int clipPolygon(const glm::vec4* input, int count, uint8_t plane, float guardBand, glm::vec4* output) {
+		int outputCount = 0;
+		for (int i = 0; i < count; ++i) {
+			const glm::vec4& a = input[i];
+			const glm::vec4& b = input[i + 1 == count ? 0 : i + 1];
+			const float da = planeDistance(a, plane, guardBand);
+			const float db = planeDistance(b, plane, guardBand);
+			if (da >= 0.0f) {
+				output[outputCount++] = a;
+			}
+
+			if ((da >= 0.0f) != (db >= 0.0f)) {
+				output[outputCount++] = da >= 0.0f ? a + (b - a) * (da / (da - db)) : b + (a - b) * (db / (db - da));
+			}
+		}
+
+		return outputCount;
+	}
+}
+
+/*
+ * @brief constructor
+ * @param guardBand extent of the guard band in normalized device coordinates, screen
+ *        coordinates of the clipped triangles stay within guardBand / 2 screens of the center
+ */
+Clipper::Clipper(float guardBand) : _guardBand(guardBand) { }
+
+
+/*
+ * @brief set the size of the screen the clipped triangles are mapped to
+ * @param width width of the screen
+ * @param height height of the screen
+ */
+void Clipper::setViewport(float width, float height) {
+	_width = width;
+	_height = height;
+}
+
+
+/*
+ * @brief get the guard band extent in normalized device coordinates
+ * @return guard band extent
+ */
+float Clipper::getGuardBand() const {
+	return _guardBand;
+}
+
+
+/*
+ * @brief compute the outcode of a clip space vertex
+ * @detail a vertex with z < -w or w <= 0 is outside the near plane, projectToScreen only maps
+ *         vertices inside it
+ * @param clip clip space position
+ * @return combination of Plane bits, 0 if the vertex can be projected as is
+ */
+uint8_t Clipper::computeOutcode(const glm::vec4& clip) const {
+	const float limit = _guardBand * clip.w;
+	return static_cast<uint8_t>(
+		(clip.z < -clip.w || clip.w <= 0.0f ? Near : 0) |
+		(clip.x < -limit ? Left : 0) | (clip.x > limit ? Right : 0) |
+		(clip.y < -limit ? Bottom : 0) | (clip.y > limit ? Top : 0));
+}
+
+
+/*
+ * @brief clip a triangle crossing the near plane or the guard band
+ * @detail the triangle is culled if all vertices are outside the same plane, otherwise it
+ *         is clipped against the planes its vertices are outside of and the polygon is
+ *         fanned into triangles with the winding of the input
+ * @param clip clip space positions of the vertices
+ * @param outcodes outcodes of the vertices
+ * @param color color of the triangle
+ * @param triangles screen space triangles, the clipped triangles are appended
+ */
+void Clipper::clipTriangle(const glm::vec4 (&clip)[3], const uint8_t (&outcodes)[3], uint32_t color,
+	std::vector<RasterTriangle>& triangles) {
+	if (outcodes[0] & outcodes[1] & outcodes[2]) {
+		++_statistics.trianglesCulled;
+		return;
+	}
+
+	++_statistics.trianglesClipped;
+	glm::vec4 polygon[2][maxPolygonVertices];
+	polygon[0][0] = clip[0];
+	polygon[0][1] = clip[1];
+	polygon[0][2] = clip[2];
+	int count = 3;
+	int current = 0;
+
+	// the planes are half-spaces of clip space and vertices are interpolated linearly in clip
+	// space, so a new vertex is only outside the planes one of the input vertices is outside of
+	const uint8_t planes = outcodes[0] | outcodes[1] | outcodes[2];
+	for (uint8_t plane = Near; plane <= Top && count >= 3; plane <<= 1) {
+		if (planes & plane) {
+			count = clipPolygon(polygon[current], count, plane, _guardBand, polygon[current ^ 1]);
+			current ^= 1;
+		}
+	}
+
+	if (count < 3) {
+		return;
+	}
+
+	glm::vec3 screen[maxPolygonVertices];
+	for (int i = 0; i < count; ++i) {
+		screen[i] = projectToScreen(polygon[current][i], _width, _height);
+	}
+
+	for (int i = 1; i + 1 < count; ++i) {
+		RasterTriangle triangle;
+		triangle.v[0] = screen[0];
+		triangle.v[1] = screen[i];
+		triangle.v[2] = screen[i + 1];
+		triangle.color = color;
+		if (isOutsideScreen(triangle, _width, _height)) {
+			++_statistics.trianglesOutsideScreen;
+			continue;
+		}
+
+		triangles.push_back(triangle);
+		++_statistics.trianglesEmitted;
+	}
+}
+
+
+/*
+ * @brief get the counters since the last reset
+ * @return clipping statistics
+ */
+const Clipper::Statistics& Clipper::getStatistics() const {
+	return _statistics;
+}
+
+
+/*
+ * @brief reset the counters
+ */
+void Clipper::resetStatistics() {
+	_statistics = Statistics();
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#ifdef GLFW_INCLUDE_VULKAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include <glm/vec4.hpp>
+
+#include "raster_triangle.h"
+
+/**
+ * @brief homogeneous clipping of triangles against the near plane and a guard band
+ * @detail x and y are not clipped to the screen but to the much wider guard band
+ *         |x|, |y| <= guardBand * w, the rasterizers cut the rest per pixel. Only triangles
+ *         crossing the near plane or the guard band, rare in practice, go through
+ *         Sutherland-Hodgman, the caller renders all others directly
+ */
+class Clipper {
+public:
+	/*
+	 * @brief outcode bits of a clip space vertex, a set bit means outside the plane
+	 */
+	enum Plane : uint8_t {
+		Near = 0x01,
+		Left = 0x02,
+		Right = 0x04,
+		Bottom = 0x08,
+		Top = 0x10
+	};
+
+	/*
+	 * @brief counters of the triangles handed to clipTriangle
+	 */
+	struct Statistics {
+		/* triangles completely outside one plane */
+		uint64_t trianglesCulled = 0;
+		/* triangles clipped by Sutherland-Hodgman */
+		uint64_t trianglesClipped = 0;
+		/* triangles of the clipped polygons handed to the rasterizers */
+		uint64_t trianglesEmitted = 0;
+		/* triangles of the clipped polygons completely outside one side of the screen */
+		uint64_t trianglesOutsideScreen = 0;
+	};
+
+	/*
+	 * @brief constructor, guardBand is the extent of the guard band in normalized device coordinates
+	 */
+	explicit Clipper(float guardBand = 8.0f);
+
+	/*
+	 * @brief default destructor
+	 */
+	~Clipper() = default;
+
+	/*
+	 * @brief set the size of the screen the clipped triangles are mapped to
+	 */
+	void setViewport(float width, float height);
+
+	/*
+	 * @brief get the guard band extent in normalized device coordinates
+	 */
+	float getGuardBand() const;
+
+	/*
+	 * @brief compute the outcode of a clip space vertex
+	 */
+	uint8_t computeOutcode(const glm::vec4& clip) const;
+
+	/*
+	 * @brief clip a triangle crossing the near plane or the guard band
+	 */
+	void clipTriangle(const glm::vec4 (&clip)[3], const uint8_t (&outcodes)[3], uint32_t color,
+		std::vector<RasterTriangle>& triangles);
+
+	/*
+	 * @brief get the counters since the last reset
+	 */
+	const Statistics& getStatistics() const;
+
+	/*
+	 * @brief reset the counters
+	 */
+	void resetStatistics();
+
+private:
+	float _guardBand;
+	float _width = 0.0f;
+	float _height = 0.0f;
+	Statistics _statistics;
+};
+
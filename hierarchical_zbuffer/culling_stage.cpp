@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define CULLING_STAGE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "culling_stage.h"
+
+namespace {
+	/*
+	 * @brief number of set bits of a batch mask
+	 */
+	int countBits(uint32_t mask) {
+		int count = 0;
+		for (; mask != 0; mask &= mask - 1) {
+			++count;
+		}
+
+		return count;
+	}
+}
+
+/*
+ * @brief add the bounds of a point set
+ * @param points points to bound
+ * @param count number of points
+ */
+void BoundingVolumes::add(const glm::vec3* points, size_t count) {
+	const size_t index = size();
+	for (auto* values : { &centerX, &centerY, &centerZ, &radius, &minX, &minY, &minZ, &maxX, &maxY, &maxZ }) {
+		values->push_back(0.0f);
+	}
+
+	set(index, points, count);
+}
+
+
+/*
+ * @brief replace the bounds at index by the bounds of a point set
+ * @detail the sphere is centered in the box and encloses the points, which makes it
+ *         tighter than the sphere around the box
+ * @param index index of the bounds, less than size()
+ * @param points points to bound
+ * @param count number of points
+ */
+void BoundingVolumes::set(size_t index, const glm::vec3* points, size_t count) {
+	glm::vec3 boxMin(0.0f), boxMax(0.0f);
+	if (count > 0) {
+		boxMin = boxMax = points[0];
+	}
+
+	for (size_t i = 1; i < count; ++i) {
+		boxMin = glm::min(boxMin, points[i]);
+		boxMax = glm::max(boxMax, points[i]);
+	}
+
+	const glm::vec3 center = 0.5f * (boxMin + boxMax);
+	float radiusSquared = 0.0f;
+	for (size_t i = 0; i < count; ++i) {
+		const glm::vec3 d = points[i] - center;
+		radiusSquared = std::max(radiusSquared, d.x * d.x + d.y * d.y + d.z * d.z);
+	}
+
+	centerX[index] = center.x;
+	centerY[index] = center.y;
+	centerZ[index] = center.z;
+	radius[index] = std::sqrt(radiusSquared);
+	minX[index] = boxMin.x;
+	minY[index] = boxMin.y;
+	minZ[index] = boxMin.z;
+	maxX[index] = boxMax.x;
+	maxY[index] = boxMax.y;
+	maxZ[index] = boxMax.z;
+}
+
+
+/*
+ * @brief remove all bounds
+ */
+void BoundingVolumes::clear() {
+	for (auto* values : { &centerX, &centerY, &centerZ, &radius, &minX, &minY, &minZ, &maxX, &maxY, &maxZ }) {
+		values->clear();
+	}
+}
+
+
+/*
+ * @brief get the number of bounds
+ * @return bounds count
+ */
+size_t BoundingVolumes::size() const {
+	return radius.size();
+}
+
+
+/*
+ * @brief select which faces to reject
+ * @param faceCulling faces to reject, None keeps all but degenerate triangles
+ */
+void CullingStage::setFaceCulling(FaceCulling faceCulling) {
+	_faceCulling = faceCulling;
+}
+
+
+/*
+ * @brief get which faces are rejected
+ * @return face culling mode
+ */
+CullingStage::FaceCulling CullingStage::getFaceCulling() const {
+	return _faceCulling;
+}
+
+
+/*
+ * @brief extract the frustum planes from the view projection matrix
+ * @detail the planes are the sums and differences of the last row of the matrix with the
+ *         other rows (Gribb and Hartmann), normalized for the sphere test
+ * @param viewProjection view projection matrix of the camera
+ */
+void CullingStage::setViewProjection(const glm::mat4x4& viewProjection) {
+	const glm::mat4x4& m = viewProjection;
+	for (int axis = 0; axis < 3; ++axis) {
+		for (int side = 0; side < 2; ++side) {
+			const float sign = side == 0 ? 1.0f : -1.0f;
+			glm::vec4 plane;
+			for (int c = 0; c < 4; ++c) {
+				plane[c] = m[c][3] + sign * m[c][axis];
+			}
+
+			const float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+			_planes[2 * axis + side] = length > 0.0f ? plane / length : plane;
+		}
+	}
+}
+
+
+/*
+ * @brief test the bounds [first, last) against the frustum
+ * @detail a batch is tested as spheres, the box test only runs if a sphere of the batch
+ *         survived. A box is outside a plane if its corner farthest along the normal is
+ *         behind the plane
+ * @param bounds bounding volumes
+ * @param first first bounds to test
+ * @param last end of the range
+ * @param visible 1 for bounds intersecting the frustum, 0 for others as output, indexed from first
+ */
+void CullingStage::cullBounds(const BoundingVolumes& bounds, size_t first, size_t last, uint8_t* visible) {
+	_statistics.boundsTested += last - first;
+	for (size_t batch = first; batch < last; batch += batchSize) {
+		const int count = static_cast<int>(std::min(static_cast<size_t>(batchSize), last - batch));
+		uint32_t sphereOutside = 0;
+		uint32_t boxOutside = 0;
+		int lane = 0;
+
+#ifdef CULLING_STAGE_SSE2
+		for (; lane + 4 <= count; lane += 4) {
+			const size_t i = batch + lane;
+			const __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+			const __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+			const __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+			const __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&bounds.radius[i]));
+			__m128 outside = _mm_setzero_ps();
+			for (const glm::vec4& plane : _planes) {
+				const __m128 distance = _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(_mm_set1_ps(plane.x), cx), _mm_mul_ps(_mm_set1_ps(plane.y), cy)),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), cz), _mm_set1_ps(plane.w)));
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+			}
+			sphereOutside |= static_cast<uint32_t>(_mm_movemask_ps(outside)) << lane;
+		}
+#endif
+
+		for (; lane < count; ++lane) {
+			const size_t i = batch + lane;
+			for (const glm::vec4& plane : _planes) {
+				const float distance = (plane.x * bounds.centerX[i] + plane.y * bounds.centerY[i]) +
+					(plane.z * bounds.centerZ[i] + plane.w);
+				if (distance < -bounds.radius[i]) {
+					sphereOutside |= 1u << lane;
+				}
+			}
+		}
+
+		const uint32_t all = (1u << count) - 1;
+		if (sphereOutside != all) {
+			lane = 0;
+#ifdef CULLING_STAGE_SSE2
+			for (; lane + 4 <= count; lane += 4) {
+				const size_t i = batch + lane;
+				__m128 outside = _mm_setzero_ps();
+				for (const glm::vec4& plane : _planes) {
+					const __m128 px = _mm_loadu_ps(plane.x >= 0.0f ? &bounds.maxX[i] : &bounds.minX[i]);
+					const __m128 py = _mm_loadu_ps(plane.y >= 0.0f ? &bounds.maxY[i] : &bounds.minY[i]);
+					const __m128 pz = _mm_loadu_ps(plane.z >= 0.0f ? &bounds.maxZ[i] : &bounds.minZ[i]);
+					const __m128 distance = _mm_add_ps(_mm_add_ps(
+						_mm_mul_ps(_mm_set1_ps(plane.x), px), _mm_mul_ps(_mm_set1_ps(plane.y), py)),
+						_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), pz), _mm_set1_ps(plane.w)));
+					outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+				}
+				boxOutside |= static_cast<uint32_t>(_mm_movemask_ps(outside)) << lane;
+			}
+#endif
+
+			for (; lane < count; ++lane) {
+				const size_t i = batch + lane;
+				for (const glm::vec4& plane : _planes) {
+					const float px = plane.x >= 0.0f ? bounds.maxX[i] : bounds.minX[i];
+					const float py = plane.y >= 0.0f ? bounds.maxY[i] : bounds.minY[i];
+					const float pz = plane.z >= 0.0f ? bounds.maxZ[i] : bounds.minZ[i];
+					if ((plane.x * px + plane.y * py) + (plane.z * pz + plane.w) < 0.0f) {
+						boxOutside |= 1u << lane;
+					}
+				}
+			}
+		}
+
+		boxOutside &= ~sphereOutside;
+		_statistics.boundsCulledSphere += countBits(sphereOutside);
+		_statistics.boundsCulledBox += countBits(boxOutside);
+		for (lane = 0; lane < count; ++lane) {
+			visible[batch - first + lane] = ((sphereOutside | boxOutside) >> lane & 1) ? 0 : 1;
+		}
+	}
+}
+
+
+/*
+ * @brief test a batch of screen space triangles for the facing and a zero area
+ * @detail with y pointing down the screen, a front face has a negative signed area
+ * @param batch corners of the triangles, lanes not in mask are ignored
+ * @param mask lanes holding a triangle
+ * @return lanes of mask holding a triangle that is neither rejected by facing nor degenerate
+ */
+uint32_t CullingStage::cullTriangles(const TriangleBatch& batch, uint32_t mask) {
+	uint32_t positive = 0;
+	uint32_t negative = 0;
+	int lane = 0;
+
+#ifdef CULLING_STAGE_SSE2
+	for (; lane < batchSize; lane += 4) {
+		const __m128 x0 = _mm_loadu_ps(&batch.x[0][lane]);
+		const __m128 y0 = _mm_loadu_ps(&batch.y[0][lane]);
+		const __m128 area = _mm_sub_ps(
+			_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&batch.x[1][lane]), x0), _mm_sub_ps(_mm_loadu_ps(&batch.y[2][lane]), y0)),
+			_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&batch.y[1][lane]), y0), _mm_sub_ps(_mm_loadu_ps(&batch.x[2][lane]), x0)));
+		positive |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpgt_ps(area, _mm_setzero_ps()))) << lane;
+		negative |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(area, _mm_setzero_ps()))) << lane;
+	}
+#endif
+
+	for (; lane < batchSize; ++lane) {
+		const float area = (batch.x[1][lane] - batch.x[0][lane]) * (batch.y[2][lane] - batch.y[0][lane]) -
+			(batch.y[1][lane] - batch.y[0][lane]) * (batch.x[2][lane] - batch.x[0][lane]);
+		positive |= (area > 0.0f ? 1u : 0u) << lane;
+		negative |= (area < 0.0f ? 1u : 0u) << lane;
+	}
+
+	const uint32_t degenerate = mask & ~(positive | negative);
+	uint32_t backfacing = 0;
+	if (_faceCulling == FaceCulling::Back) {
+		backfacing = mask & positive;
+	}
+	else if (_faceCulling == FaceCulling::Front) {
+		backfacing = mask & negative;
+	}
+
+	_statistics.trianglesTested += countBits(mask);
+	_statistics.trianglesDegenerate += countBits(degenerate);
+	_statistics.trianglesBackfacing += countBits(backfacing);
+	return mask & ~(degenerate | backfacing);
+}
+
+
+/*
+ * @brief test a clip space triangle for the facing and a zero area
+ * @detail the determinant of the rows (x, y, w) has the sign of the area in normalized
+ *         device coordinates times the signs of the w, so it also works for triangles
+ *         crossing the near plane, which have no screen space area
+ * @param clip clip space positions of the vertices
+ * @return true if the triangle is rejected
+ */
+bool CullingStage::cullTriangle(const glm::vec4 (&clip)[3]) {
+	const glm::vec4& a = clip[0];
+	const glm::vec4& b = clip[1];
+	const glm::vec4& c = clip[2];
+	const float determinant =
+		a.x * (b.y * c.w - c.y * b.w) - a.y * (b.x * c.w - c.x * b.w) + a.w * (b.x * c.y - c.x * b.y);
+
+	++_statistics.trianglesTested;
+	if (!(determinant > 0.0f || determinant < 0.0f)) {
+		++_statistics.trianglesDegenerate;
+		return true;
+	}
+
+	if ((_faceCulling == FaceCulling::Back && determinant < 0.0f) ||
+		(_faceCulling == FaceCulling::Front && determinant > 0.0f)) {
+		++_statistics.trianglesBackfacing;
+		return true;
+	}
+
+	return false;
+}
+
+
+/*
+ * @brief get the counters since the last reset
+ * @return culling statistics
+ */
+const CullingStage::Statistics& CullingStage::getStatistics() const {
+	return _statistics;
+}
+
+
+/*
+ * @brief reset the counters
+ */
+void CullingStage::resetStatistics() {
+	_statistics = Statistics();
+}
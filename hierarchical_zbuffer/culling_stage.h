@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#ifdef GLFW_INCLUDE_VULKAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+/*
+ * @brief bounding spheres and boxes as structure of arrays, tested 8 at a time
+ */
+struct BoundingVolumes {
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> radius;
+	std::vector<float> minX;
+	std::vector<float> minY;
+	std::vector<float> minZ;
+	std::vector<float> maxX;
+	std::vector<float> maxY;
+	std::vector<float> maxZ;
+
+	/*
+	 * @brief add the bounds of a point set
+	 */
+	void add(const glm::vec3* points, size_t count);
+
+	/*
+	 * @brief replace the bounds at index by the bounds of a point set
+	 */
+	void set(size_t index, const glm::vec3* points, size_t count);
+
+	/*
+	 * @brief remove all bounds
+	 */
+	void clear();
+
+	/*
+	 * @brief get the number of bounds
+	 */
+	size_t size() const;
+};
+
+/**
+ * @brief rejection of triangles and bounds that cannot produce a visible pixel
+ * @detail bounds are tested against the six frustum planes, first as spheres, then the
+ *         survivors as boxes. Screen space triangles are tested for the facing and a zero
+ *         area by their signed area. Both tests run on batches of 8 with SSE2
+ */
+class CullingStage {
+public:
+	/*
+	 * @brief which faces to reject, front faces are counter-clockwise in normalized device coordinates
+	 */
+	enum class FaceCulling {
+		None, Back, Front
+	};
+
+	/*
+	 * @brief counters of the rejected triangles and bounds, one per reason
+	 */
+	struct Statistics {
+		uint64_t trianglesTested = 0;
+		uint64_t trianglesBackfacing = 0;
+		/* triangles with a zero or undefined area */
+		uint64_t trianglesDegenerate = 0;
+		uint64_t boundsTested = 0;
+		/* bounds outside the frustum by the sphere test */
+		uint64_t boundsCulledSphere = 0;
+		/* bounds outside the frustum by the box test only */
+		uint64_t boundsCulledBox = 0;
+	};
+
+	/* number of triangles or bounds tested together */
+	static const int batchSize = 8;
+
+	/*
+	 * @brief screen space corners of a batch of triangles
+	 */
+	struct TriangleBatch {
+		float x[3][batchSize];
+		float y[3][batchSize];
+	};
+
+	/*
+	 * @brief constructor, reject back faces
+	 */
+	CullingStage() = default;
+
+	/*
+	 * @brief default destructor
+	 */
+	~CullingStage() = default;
+
+	/*
+	 * @brief select which faces to reject
+	 */
+	void setFaceCulling(FaceCulling faceCulling);
+
+	/*
+	 * @brief get which faces are rejected
+	 */
+	FaceCulling getFaceCulling() const;
+
+	/*
+	 * @brief extract the frustum planes from the view projection matrix
+	 */
+	void setViewProjection(const glm::mat4x4& viewProjection);
+
+	/*
+	 * @brief test the bounds [first, last) against the frustum
+	 */
+	void cullBounds(const BoundingVolumes& bounds, size_t first, size_t last, uint8_t* visible);
+
+	/*
+	 * @brief test a batch of screen space triangles for the facing and a zero area
+	 */
+	uint32_t cullTriangles(const TriangleBatch& batch, uint32_t mask);
+
+	/*
+	 * @brief test a clip space triangle for the facing and a zero area
+	 */
+	bool cullTriangle(const glm::vec4 (&clip)[3]);
+
+	/*
+	 * @brief get the counters since the last reset
+	 */
+	const Statistics& getStatistics() const;
+
+	/*
+	 * @brief reset the counters
+	 */
+	void resetStatistics();
+
+private:
+	FaceCulling _faceCulling = FaceCulling::Back;
+
+	/* normalized frustum planes, inside if dot(normal, p) + distance >= 0 */
+	glm::vec4 _planes[6];
+
+	Statistics _statistics;
+};
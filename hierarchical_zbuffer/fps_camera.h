@@ -10,7 +10,7 @@ public:
 
 
 	void update(const KeyboardInput& keyboardInput, const MouseInput& mouseInput, float deltaTime) {
-		glm::vec3 movement;
+		glm::vec3 movement(0.0f);
 		if (keyboardInput.keyPressed[GLFW_KEY_W]) {
 			movement += _speed * deltaTime * glm::vec3(0.0f, 0.0f, -1.0f);
 		}
@@ -0,0 +1,301 @@
+#include "frame_pipeline.h"
+#include "profiler.h"
+
+namespace {
+	/* checks of a waiting stage before it blocks */
+	const unsigned spinsBeforeBlocking = 64;
+
+	/*
+	 * @brief get the milliseconds between two timestamps in nanoseconds
+	 */
+	double milliseconds(int64_t begin, int64_t end) {
+		return 1e-6 * static_cast<double>(end - begin);
+	}
+
+	/*
+	 * @brief get the number of frames that can be in flight in a mode
+	 */
+	size_t getFramesInFlight(FramePipeline::Mode mode) {
+		switch (mode) {
+			case FramePipeline::Mode::LowLatency:
+				return 2;
+			case FramePipeline::Mode::Throughput:
+				return 4;
+			default:
+				return 1;
+		}
+	}
+}
+
+/*
+ * @brief milliseconds from the input to the screen
+ * @return latency of the frame
+ */
+double FramePipeline::Latency::getLatency() const {
+	return milliseconds(input, presented);
+}
+
+
+/*
+ * @brief milliseconds the frame waited in queues and for the frame buffer
+ * @detail everything between the input and the release that is neither setup nor rasterization,
+ *         the time the caller took to show the frame included
+ * @return wait time of the frame
+ */
+double FramePipeline::Latency::getWaitTime() const {
+	return getLatency() - milliseconds(setupBegin, setupEnd) - milliseconds(rasterBegin, rasterEnd);
+}
+
+
+/*
+ * @brief constructor, start the stage threads of the pipelined modes
+ * @param renderer renderer whose setup and rasterization are pipelined, its setters must not
+ *        be called while frames are in flight, see flush
+ * @param mode how far the front end may run ahead of the screen
+ */
+FramePipeline::FramePipeline(Renderer& renderer, Mode mode)
+	: _renderer(renderer), _mode(mode),
+	  _setupQueue(getFramesInFlight(mode)), _rasterQueue(getFramesInFlight(mode)), _finishedQueue(getFramesInFlight(mode)) {
+	for (size_t i = 0; i < getFramesInFlight(mode); ++i) {
+		_frames.emplace_back(new Frame());
+		_freeFrames.push_back(_frames.back().get());
+	}
+
+	if (_mode != Mode::Serial) {
+		_setupThread = std::thread(&FramePipeline::_setupLoop, this);
+		_rasterThread = std::thread(&FramePipeline::_rasterLoop, this);
+	}
+}
+
+
+/*
+ * @brief destructor, stop the stage threads and drop the frames in flight
+ */
+FramePipeline::~FramePipeline() {
+	_stop.store(true, std::memory_order_release);
+	_wake(_setupCondition);
+	_wake(_rasterCondition);
+	if (_setupThread.joinable()) {
+		_setupThread.join();
+	}
+
+	if (_rasterThread.joinable()) {
+		_rasterThread.join();
+	}
+}
+
+
+/*
+ * @brief get the mode of the pipeline
+ * @return mode
+ */
+FramePipeline::Mode FramePipeline::getMode() const {
+	return _mode;
+}
+
+
+/*
+ * @brief get the number of frames that can be in flight
+ * @return 1 serial, 2 low latency, 4 throughput
+ */
+size_t FramePipeline::getFrameCount() const {
+	return _frames.size();
+}
+
+
+/*
+ * @brief take a free frame to submit and stamp its input time
+ * @detail the front end handles its input right after, so a frame is only taken once it
+ *         can be submitted: in the low latency mode the input is sampled as late as the
+ *         pipeline allows
+ * @return frame to fill in and submit, nullptr if all frames are in flight
+ */
+FramePipeline::Frame* FramePipeline::beginFrame() {
+	if (_freeFrames.empty()) {
+		return nullptr;
+	}
+
+	Frame* frame = _freeFrames.back();
+	_freeFrames.pop_back();
+	frame->latency = Latency();
+	frame->latency.input = Profiler::now();
+	return frame;
+}
+
+
+/*
+ * @brief hand a frame taken by beginFrame to the setup stage
+ * @detail in the serial mode the frame is set up and rasterized before the call returns
+ * @param frame frame with the render mode and the camera of its setup filled in
+ */
+void FramePipeline::submitFrame(Frame* frame) {
+	frame->index = _submittedFrames++;
+	if (_mode == Mode::Serial) {
+		frame->latency.setupBegin = Profiler::now();
+		_renderer.setupFrame(frame->setup);
+		frame->latency.setupEnd = Profiler::now();
+		_rasterFrame(frame);
+		_finishedQueue.tryPush(frame);
+		return;
+	}
+
+	// never full, the queue holds every frame
+	_setupQueue.tryPush(frame);
+	_wake(_setupCondition);
+}
+
+
+/*
+ * @brief take the oldest finished frame, its image is in the frame buffer of the renderer
+ * @detail the frame buffer, the timing and the statistics of the frame stay valid until it
+ *         is released, the next frame is not rasterized before. Only one frame is acquired
+ *         at a time
+ * @return finished frame, nullptr if none is
+ */
+FramePipeline::Frame* FramePipeline::acquireFrame() {
+	Frame* frame = nullptr;
+	return _finishedQueue.tryPop(frame) ? frame : nullptr;
+}
+
+
+/*
+ * @brief give an acquired frame back once its frame buffer was shown
+ * @detail stamps the presentation time, call it right after the frame buffer was copied out
+ *         so the next rasterization can start as early as possible. The frame keeps its
+ *         results and complete latency until the next beginFrame
+ * @param frame frame returned by acquireFrame
+ */
+void FramePipeline::releaseFrame(Frame* frame) {
+	frame->latency.presented = Profiler::now();
+	_freeFrames.push_back(frame);
+	_releasedFrames.fetch_add(1, std::memory_order_release);
+	_wake(_rasterCondition);
+}
+
+
+/*
+ * @brief wait for the frames in flight and drop them without showing them
+ * @detail afterwards no stage touches the renderer, so its settings can be changed. An
+ *         acquired frame must have been released before
+ */
+void FramePipeline::flush() {
+	while (_freeFrames.size() < _frames.size()) {
+		Frame* frame = nullptr;
+		_wait(_finishedCondition, [&]() { return _finishedQueue.tryPop(frame); });
+		releaseFrame(frame);
+	}
+}
+
+
+/*
+ * @brief get the name of a mode
+ * @param mode mode of a pipeline
+ * @return name used on the command line
+ */
+const char* FramePipeline::getModeName(Mode mode) {
+	switch (mode) {
+		case Mode::Serial:
+			return "serial";
+		case Mode::LowLatency:
+			return "low-latency";
+		case Mode::Throughput:
+			return "throughput";
+	}
+
+	return "unknown";
+}
+
+
+/*
+ * @brief set up the queued frames until stopped
+ */
+void FramePipeline::_setupLoop() {
+	for (;;) {
+		Frame* frame = nullptr;
+		_wait(_setupCondition, [&]() {
+			return _stop.load(std::memory_order_acquire) || _setupQueue.tryPop(frame);
+		});
+		if (!frame) {
+			return;
+		}
+
+		frame->latency.setupBegin = Profiler::now();
+		_renderer.setupFrame(frame->setup);
+		frame->latency.setupEnd = Profiler::now();
+		_rasterQueue.tryPush(frame);
+		_wake(_rasterCondition);
+	}
+}
+
+
+/*
+ * @brief rasterize the set up frames until stopped
+ * @detail a frame waits until the caller released all frames before it, which frees the
+ *         single frame buffer of the renderer
+ */
+void FramePipeline::_rasterLoop() {
+	Frame* frame = nullptr;
+	for (;;) {
+		_wait(_rasterCondition, [&]() {
+			if (_stop.load(std::memory_order_acquire)) {
+				return true;
+			}
+
+			return (frame || _rasterQueue.tryPop(frame)) && _releasedFrames.load(std::memory_order_acquire) >= frame->index;
+		});
+		if (_stop.load(std::memory_order_acquire)) {
+			return;
+		}
+
+		_rasterFrame(frame);
+		_finishedQueue.tryPush(frame);
+		_wake(_finishedCondition);
+		frame = nullptr;
+	}
+}
+
+
+/*
+ * @brief rasterize a set up frame and copy the results of the renderer into it
+ * @param frame frame set up by the setup stage
+ */
+void FramePipeline::_rasterFrame(Frame* frame) {
+	frame->latency.rasterBegin = Profiler::now();
+	_renderer.rasterFrame(frame->setup);
+	frame->timing = _renderer.getFrameTiming();
+	frame->statistics = _renderer.getFrameStatistics();
+	frame->latency.rasterEnd = Profiler::now();
+}
+
+
+/*
+ * @brief wait until ready returns true, spinning first then blocking on the condition
+ * @detail ready is checked under the wait mutex before blocking, a stage making it true
+ *         wakes the condition after taking the mutex, so no wake up is lost
+ * @param condition condition the waiting stage blocks on
+ * @param ready check of the waited for state, called by the waiting thread only
+ */
+template <typename Ready>
+void FramePipeline::_wait(std::condition_variable& condition, const Ready& ready) {
+	for (unsigned spin = 0; spin < spinsBeforeBlocking; ++spin) {
+		if (ready()) {
+			return;
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(_waitMutex);
+	condition.wait(lock, ready);
+}
+
+
+/*
+ * @brief wake the stage blocked on a condition after its state changed
+ * @detail the mutex orders the change before the next check of a stage about to block
+ * @param condition condition the woken stage blocks on
+ */
+void FramePipeline::_wake(std::condition_variable& condition) {
+	{
+		std::lock_guard<std::mutex> lock(_waitMutex);
+	}
+	condition.notify_one();
+}
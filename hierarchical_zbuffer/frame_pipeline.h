@@ -0,0 +1,181 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "renderer.h"
+#include "spsc_queue.h"
+
+/**
+ * @brief frames of a renderer in flight through a setup and a rasterization stage
+ * @detail the caller is the front end: it takes a free frame, fills in the camera from the
+ *         input it just handled and submits it, later it acquires the finished frame, shows
+ *         the frame buffer and releases it. In the pipelined modes a setup thread transforms,
+ *         culls and sets up the triangles of the next frames while a raster thread rasterizes
+ *         the current one, the stages hand frames over through bounded lock-free queues and
+ *         wait by spinning briefly, then blocking until they are woken. The frame buffer is not duplicated, the rasterization of a frame
+ *         waits until the previous one was released. Every frame records when its input was
+ *         sampled and when it entered and left each stage, so the latency from input to
+ *         screen can be weighed against the frame rate of the mode.
+ *         The octree mode transforms, culls and sets up the triangles of the visible nodes
+ *         inside its traversal, against the z pyramid being rasterized, so its setup stage is
+ *         empty: the pipelined modes overlap nothing in it and only add latency
+ */
+class FramePipeline {
+public:
+	/*
+	 * @brief how far the front end may run ahead of the screen
+	 */
+	enum class Mode {
+		/* setup and rasterization on the calling thread when the frame is submitted */
+		Serial,
+		/* one frame set up while the previous one is rasterized and shown */
+		LowLatency,
+		/* one more frame queued in front of every stage, the stages never starve */
+		Throughput
+	};
+
+	/*
+	 * @brief timestamps of a frame in nanoseconds of Profiler::now
+	 */
+	struct Latency {
+		/* the front end took the frame and sampled the input */
+		int64_t input = 0;
+		int64_t setupBegin = 0;
+		int64_t setupEnd = 0;
+		/* the frame buffer was free and the rasterization began */
+		int64_t rasterBegin = 0;
+		int64_t rasterEnd = 0;
+		/* the caller released the frame after showing it */
+		int64_t presented = 0;
+
+		/* milliseconds from the input to the screen */
+		double getLatency() const;
+		/* milliseconds the frame waited in queues and for the frame buffer */
+		double getWaitTime() const;
+	};
+
+	/*
+	 * @brief a frame in flight, owned by the pipeline
+	 */
+	struct Frame {
+		/* submission order, from 0 */
+		uint64_t index = 0;
+		/* render mode and camera set by the front end, triangles by the setup stage */
+		Renderer::FrameSetup setup;
+		/* times and counters of the renderer, copied after the rasterization */
+		Renderer::FrameTiming timing;
+		Renderer::FrameStatistics statistics;
+		Latency latency;
+	};
+
+	/*
+	 * @brief constructor, start the stage threads of the pipelined modes
+	 */
+	FramePipeline(Renderer& renderer, Mode mode);
+
+	/*
+	 * @brief destructor, stop the stage threads and drop the frames in flight
+	 */
+	~FramePipeline();
+
+	FramePipeline(const FramePipeline&) = delete;
+	FramePipeline& operator=(const FramePipeline&) = delete;
+
+	/*
+	 * @brief get the mode of the pipeline
+	 */
+	Mode getMode() const;
+
+	/*
+	 * @brief get the number of frames that can be in flight
+	 */
+	size_t getFrameCount() const;
+
+	/*
+	 * @brief take a free frame to submit and stamp its input time
+	 */
+	Frame* beginFrame();
+
+	/*
+	 * @brief hand a frame taken by beginFrame to the setup stage
+	 */
+	void submitFrame(Frame* frame);
+
+	/*
+	 * @brief take the oldest finished frame, its image is in the frame buffer of the renderer
+	 */
+	Frame* acquireFrame();
+
+	/*
+	 * @brief give an acquired frame back once its frame buffer was shown
+	 */
+	void releaseFrame(Frame* frame);
+
+	/*
+	 * @brief wait for the frames in flight and drop them without showing them
+	 */
+	void flush();
+
+	/*
+	 * @brief get the name of a mode
+	 */
+	static const char* getModeName(Mode mode);
+
+private:
+	Renderer& _renderer;
+	Mode _mode;
+	std::vector<std::unique_ptr<Frame>> _frames;
+
+	/* frames the front end may take, only touched by the caller */
+	std::vector<Frame*> _freeFrames;
+	uint64_t _submittedFrames = 0;
+
+	/* front end to setup, setup to raster and raster back to the caller */
+	SpscQueue<Frame*> _setupQueue;
+	SpscQueue<Frame*> _rasterQueue;
+	SpscQueue<Frame*> _finishedQueue;
+
+	/* frames released by the caller, the raster stage waits for it to reach its frame */
+	std::atomic<uint64_t> _releasedFrames{ 0 };
+	std::atomic<bool> _stop{ false };
+	std::thread _setupThread;
+	std::thread _rasterThread;
+
+	/* blocked stages, woken by the stage or the caller that made them ready */
+	std::mutex _waitMutex;
+	std::condition_variable _setupCondition;
+	std::condition_variable _rasterCondition;
+	std::condition_variable _finishedCondition;
+
+	/*
+	 * @brief set up the queued frames until stopped
+	 */
+	void _setupLoop();
+
+	/*
+	 * @brief rasterize the set up frames until stopped
+	 */
+	void _rasterLoop();
+
+	/*
+	 * @brief rasterize a set up frame and copy the results of the renderer into it
+	 */
+	void _rasterFrame(Frame* frame);
+
+	/*
+	 * @brief wait until ready returns true, spinning first then blocking on the condition
+	 */
+	template <typename Ready>
+	void _wait(std::condition_variable& condition, const Ready& ready);
+
+	/*
+	 * @brief wake the stage blocked on a condition after its state changed
+	 */
+	void _wake(std::condition_variable& condition);
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief software frame buffer with a float depth buffer and a RGBA8 color buffer
+ * @detail both buffers are stored row by row with the origin at the top left corner,
+ *         depth is the window space depth in [0, 1], smaller value is nearer
+ */
+class FrameBuffer {
+public:
+	FrameBuffer(int width, int height)
+		: _width(width), _height(height),
+		  _depthBuffer(static_cast<size_t>(width) * height, 1.0f),
+		  _colorBuffer(static_cast<size_t>(width) * height, 0) { }
+
+	~FrameBuffer() = default;
+
+	int getWidth() const {
+		return _width;
+	}
+
+	int getHeight() const {
+		return _height;
+	}
+
+	float* getDepthBuffer() {
+		return _depthBuffer.data();
+	}
+
+	const float* getDepthBuffer() const {
+		return _depthBuffer.data();
+	}
+
+	uint32_t* getColorBuffer() {
+		return _colorBuffer.data();
+	}
+
+	const uint32_t* getColorBuffer() const {
+		return _colorBuffer.data();
+	}
+
+	void clear(float depth, uint32_t color) {
+		std::fill(_depthBuffer.begin(), _depthBuffer.end(), depth);
+		std::fill(_colorBuffer.begin(), _colorBuffer.end(), color);
+	}
+
+	/*
+	 * @brief pack a color with components in [0, 1] to RGBA8 in memory order
+	 */
+	static uint32_t packColor(float r, float g, float b, float a = 1.0f) {
+		auto toByte = [](float c) {
+			return static_cast<uint32_t>(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+		};
+
+		return toByte(r) | (toByte(g) << 8) | (toByte(b) << 16) | (toByte(a) << 24);
+	}
+
+private:
+	/* frame buffer attributes: width in pixels */
+	int _width;
+	/* frame buffer attributes: height in pixels */
+	int _height;
+	/* depth of each pixel */
+	std::vector<float> _depthBuffer;
+	/* RGBA8 color of each pixel */
+	std::vector<uint32_t> _colorBuffer;
+};
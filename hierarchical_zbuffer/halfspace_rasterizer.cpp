@@ -0,0 +1,499 @@
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define HALF_SPACE_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#include "halfspace_rasterizer.h"
+#include "profiler.h"
+
+// msvc compiles intrinsics of any instruction set, gcc and clang need them enabled per function
+#if defined(HALF_SPACE_X86) && !defined(_MSC_VER)
+#define HALF_SPACE_TARGET(isa) __attribute__((target(isa)))
+#else
+#define HALF_SPACE_TARGET(isa)
+#endif
+
+namespace {
+	/* edge function and depth increments of a triangle, the edge functions are positive inside */
+	struct TriangleSetup {
+		float dedx[3];
+		float dedy[3];
+		/* endpoint every edge is evaluated from, the same in both triangles sharing the edge */
+		float originX[3];
+		float originY[3];
+		/* pixels exactly on a left or top edge are inside */
+		bool inclusive[3];
+		float dzdx;
+		float dzdy;
+		uint32_t color;
+	};
+
+	/* pixels of a block to test, rows [rowBegin, rowEnd) of the 8 rows at depthRow/colorRow */
+	struct BlockSetup {
+		/* edge functions and depth at the top left pixel center */
+		float edge[3];
+		float z;
+		int rowBegin;
+		int rowEnd;
+		/* edges with pixels of the block outside, the others are not tested */
+		bool testEdge[3];
+		float* depthRow;
+		uint32_t* colorRow;
+		int stride;
+	};
+
+	struct PixelCounters {
+		uint64_t tested = 0;
+		uint64_t written = 0;
+	};
+
+	/* number of set bits of an 8 bit mask */
+	inline uint32_t countBits(int mask) {
+		static const uint8_t nibbleBits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+		return nibbleBits[mask & 15] + nibbleBits[(mask >> 4) & 15];
+	}
+
+	/*
+	 * edge function k at a pixel of the block, every kernel evaluates it in this order. The
+	 * result grows or shrinks monotonically along the columns and the rows
+	 */
+	inline float evaluateEdge(const TriangleSetup& setup, const BlockSetup& block, int k, int column, int row) {
+		return (block.edge[k] + setup.dedx[k] * column) + setup.dedy[k] * row;
+	}
+
+	/*
+	 * test columns [columnBegin, columnEnd) of the block pixel by pixel, every kernel evaluates
+	 * z = (z + dzdx * column) + dzdy * row
+	 */
+	void rasterizeBlockScalar(const TriangleSetup& setup, const BlockSetup& block, int columnBegin, int columnEnd,
+		PixelCounters& counters) {
+		for (int row = block.rowBegin; row < block.rowEnd; ++row) {
+			float* depthRow = block.depthRow + static_cast<ptrdiff_t>(row) * block.stride;
+			uint32_t* colorRow = block.colorRow + static_cast<ptrdiff_t>(row) * block.stride;
+			for (int column = columnBegin; column < columnEnd; ++column) {
+				bool inside = true;
+				for (int k = 0; k < 3 && inside; ++k) {
+					if (block.testEdge[k]) {
+						const float e = evaluateEdge(setup, block, k, column, row);
+						inside = setup.inclusive[k] ? e >= 0.0f : e > 0.0f;
+					}
+				}
+
+				if (!inside) {
+					continue;
+				}
+
+				++counters.tested;
+				const float depth = (block.z + setup.dzdx * column) + setup.dzdy * row;
+				if (depth < depthRow[column]) {
+					depthRow[column] = depth;
+					colorRow[column] = setup.color;
+					++counters.written;
+				}
+			}
+		}
+	}
+
+#ifdef HALF_SPACE_X86
+	/* test the 8 columns of the block as two groups of 4 */
+	HALF_SPACE_TARGET("sse4.1")
+	void rasterizeBlockSSE4(const TriangleSetup& setup, const BlockSetup& block, PixelCounters& counters) {
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 ones = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		const __m128i color = _mm_set1_epi32(static_cast<int>(setup.color));
+		for (int first = 0; first < 8; first += 4) {
+			const __m128 column = _mm_add_ps(_mm_set1_ps(static_cast<float>(first)), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+			__m128 edge[3];
+			for (int k = 0; k < 3; ++k) {
+				edge[k] = _mm_add_ps(_mm_set1_ps(block.edge[k]), _mm_mul_ps(_mm_set1_ps(setup.dedx[k]), column));
+			}
+			const __m128 z = _mm_add_ps(_mm_set1_ps(block.z), _mm_mul_ps(_mm_set1_ps(setup.dzdx), column));
+
+			for (int row = block.rowBegin; row < block.rowEnd; ++row) {
+				const float rowOffset = static_cast<float>(row);
+				__m128 inside = ones;
+				for (int k = 0; k < 3; ++k) {
+					if (block.testEdge[k]) {
+						const __m128 e = _mm_add_ps(edge[k], _mm_set1_ps(setup.dedy[k] * rowOffset));
+						inside = _mm_and_ps(inside, setup.inclusive[k] ? _mm_cmpge_ps(e, zero) : _mm_cmpgt_ps(e, zero));
+					}
+				}
+
+				const int insideBits = _mm_movemask_ps(inside);
+				if (insideBits == 0) {
+					continue;
+				}
+
+				float* depthRow = block.depthRow + static_cast<ptrdiff_t>(row) * block.stride + first;
+				__m128i* colorRow = reinterpret_cast<__m128i*>(block.colorRow + static_cast<ptrdiff_t>(row) * block.stride + first);
+				const __m128 depth = _mm_add_ps(z, _mm_set1_ps(setup.dzdy * rowOffset));
+				const __m128 oldDepth = _mm_loadu_ps(depthRow);
+				const __m128 write = _mm_and_ps(inside, _mm_cmplt_ps(depth, oldDepth));
+				const int writeBits = _mm_movemask_ps(write);
+				counters.tested += countBits(insideBits);
+				if (writeBits == 0) {
+					continue;
+				}
+
+				counters.written += countBits(writeBits);
+				_mm_storeu_ps(depthRow, _mm_blendv_ps(oldDepth, depth, write));
+				_mm_storeu_si128(colorRow, _mm_blendv_epi8(_mm_loadu_si128(colorRow), color, _mm_castps_si128(write)));
+			}
+		}
+	}
+
+	/* test the 8 columns of the block at once */
+	HALF_SPACE_TARGET("avx2")
+	void rasterizeBlockAVX2(const TriangleSetup& setup, const BlockSetup& block, PixelCounters& counters) {
+		// keep everything in locals, the color stores may alias any memory
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 ones = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		const __m256i color = _mm256_set1_epi32(static_cast<int>(setup.color));
+		const __m256 column = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+		__m256 edge[3];
+		float dedy[3];
+		bool testEdge[3];
+		bool inclusive[3];
+		for (int k = 0; k < 3; ++k) {
+			edge[k] = _mm256_add_ps(_mm256_set1_ps(block.edge[k]), _mm256_mul_ps(_mm256_set1_ps(setup.dedx[k]), column));
+			dedy[k] = setup.dedy[k];
+			testEdge[k] = block.testEdge[k];
+			inclusive[k] = setup.inclusive[k];
+		}
+		const __m256 z = _mm256_add_ps(_mm256_set1_ps(block.z), _mm256_mul_ps(_mm256_set1_ps(setup.dzdx), column));
+		const float dzdy = setup.dzdy;
+		const ptrdiff_t stride = block.stride;
+		float* const depthBlock = block.depthRow;
+		uint32_t* const colorBlock = block.colorRow;
+
+		uint64_t tested = 0;
+		uint64_t written = 0;
+		for (int row = block.rowBegin; row < block.rowEnd; ++row) {
+			const float rowOffset = static_cast<float>(row);
+			__m256 inside = ones;
+			for (int k = 0; k < 3; ++k) {
+				if (testEdge[k]) {
+					const __m256 e = _mm256_add_ps(edge[k], _mm256_set1_ps(dedy[k] * rowOffset));
+					inside = _mm256_and_ps(inside, inclusive[k] ?
+						_mm256_cmp_ps(e, zero, _CMP_GE_OQ) : _mm256_cmp_ps(e, zero, _CMP_GT_OQ));
+				}
+			}
+
+			const int insideBits = _mm256_movemask_ps(inside);
+			if (insideBits == 0) {
+				continue;
+			}
+
+			float* depthRow = depthBlock + row * stride;
+			__m256i* colorRow = reinterpret_cast<__m256i*>(colorBlock + row * stride);
+			const __m256 depth = _mm256_add_ps(z, _mm256_set1_ps(dzdy * rowOffset));
+			const __m256 oldDepth = _mm256_loadu_ps(depthRow);
+			const __m256 write = _mm256_and_ps(inside, _mm256_cmp_ps(depth, oldDepth, _CMP_LT_OQ));
+			const int writeBits = _mm256_movemask_ps(write);
+			tested += countBits(insideBits);
+			if (writeBits == 0) {
+				continue;
+			}
+
+			written += countBits(writeBits);
+			_mm256_storeu_ps(depthRow, _mm256_blendv_ps(oldDepth, depth, write));
+			_mm256_storeu_si256(colorRow, _mm256_blendv_epi8(_mm256_loadu_si256(colorRow), color, _mm256_castps_si256(write)));
+		}
+
+		counters.tested += tested;
+		counters.written += written;
+	}
+#endif
+
+	/* instruction sets of the processor, queried once */
+	struct CpuFeatures {
+		bool sse41 = false;
+		bool avx2 = false;
+
+		CpuFeatures() {
+#ifdef HALF_SPACE_X86
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 0);
+			const int maxLeaf = info[0];
+			__cpuid(info, 1);
+			sse41 = (info[2] & (1 << 19)) != 0;
+			// avx registers must also be saved by the os
+			const bool avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+			if (avx && maxLeaf >= 7) {
+				__cpuidex(info, 7, 0);
+				avx2 = (info[1] & (1 << 5)) != 0;
+			}
+#else
+			__builtin_cpu_init();
+			sse41 = __builtin_cpu_supports("sse4.1") != 0;
+			avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+#endif
+		}
+	};
+
+	const CpuFeatures& getCpuFeatures() {
+		static const CpuFeatures features;
+		return features;
+	}
+}
+
+
+/*
+ * @brief constructor, render into the whole frame buffer with the best supported kernel
+ * @param frameBuffer render target, it must outlive the rasterizer
+ */
+HalfSpaceRasterizer::HalfSpaceRasterizer(FrameBuffer& frameBuffer)
+	: HalfSpaceRasterizer(frameBuffer, { 0, frameBuffer.getWidth(), 0, frameBuffer.getHeight() }) { }
+
+
+/*
+ * @brief constructor, render only the pixels inside a region of the frame buffer
+ * @param frameBuffer render target, it must outlive the rasterizer
+ * @param region non-empty pixel region inside the frame buffer
+ */
+HalfSpaceRasterizer::HalfSpaceRasterizer(FrameBuffer& frameBuffer, const ScanRect& region)
+	: _frameBuffer(frameBuffer), _region(region), _kernel(getBestKernel()) { }
+
+
+/*
+ * @brief render the triangles in submission order
+ * @param triangles triangles in screen space
+ */
+void HalfSpaceRasterizer::render(const std::vector<RasterTriangle>& triangles) {
+	PROFILE_SCOPE(Rasterization);
+	_statistics = Statistics();
+	for (const auto& triangle : triangles) {
+		renderTriangle(triangle);
+	}
+}
+
+
+/*
+ * @brief render the triangles with the given indices in order
+ * @param triangles triangles in screen space
+ * @param indices indices of the triangles to render
+ */
+void HalfSpaceRasterizer::render(const std::vector<RasterTriangle>& triangles, const std::vector<uint32_t>& indices) {
+	PROFILE_SCOPE(Rasterization);
+	_statistics = Statistics();
+	for (uint32_t index : indices) {
+		renderTriangle(triangles[index]);
+	}
+}
+
+
+/*
+ * @brief rasterize one triangle, the counters are not reset
+ * @detail a pixel is inside if its center is strictly inside all edges, or exactly on a
+ *         left or top edge. The scan-line z-buffer follows the same rule on its stepped
+ *         edges, so the two only disagree on pixel centers within rounding of an edge
+ * @param triangle triangle in screen space
+ */
+void HalfSpaceRasterizer::renderTriangle(const RasterTriangle& triangle) {
+	const int width = _frameBuffer.getWidth();
+	const int height = _frameBuffer.getHeight();
+	ScanRect rect;
+	if (!setupScanBounds(triangle, width, height, rect)) {
+		return;
+	}
+
+	rect.xl = std::max(rect.xl, _region.xl);
+	rect.xr = std::min(rect.xr, _region.xr);
+	rect.yl = std::max(rect.yl, _region.yl);
+	rect.yr = std::min(rect.yr, _region.yr);
+	if (rect.xl >= rect.xr || rect.yl >= rect.yr) {
+		return;
+	}
+
+	++_statistics.triangles;
+	ScanPlane plane;
+	if (!setupScanPlane(triangle, plane)) {
+		return;
+	}
+
+	const glm::vec3* v = triangle.v;
+	const float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+	const float orientation = area > 0.0f ? 1.0f : -1.0f;
+
+	TriangleSetup setup;
+	for (int k = 0; k < 3; ++k) {
+		// evaluated from its upper endpoint, the left one if it is horizontal, the edge function is
+		// negated exactly in the triangle on the other side, so no pixel center is in both or neither
+		const glm::vec3* a = &v[k];
+		const glm::vec3* b = &v[(k + 1) % 3];
+		float sign = orientation;
+		if (b->y < a->y || (b->y == a->y && b->x < a->x)) {
+			std::swap(a, b);
+			sign = -sign;
+		}
+
+		setup.dedx[k] = (a->y - b->y) * sign;
+		setup.dedy[k] = (b->x - a->x) * sign;
+		setup.originX[k] = a->x;
+		setup.originY[k] = a->y;
+		setup.inclusive[k] = setup.dedx[k] > 0.0f || (setup.dedx[k] == 0.0f && setup.dedy[k] > 0.0f);
+	}
+	setup.dzdx = plane.dzdx;
+	setup.dzdy = plane.dzdy;
+	setup.color = triangle.color;
+
+	float* depthBuffer = _frameBuffer.getDepthBuffer();
+	uint32_t* colorBuffer = _frameBuffer.getColorBuffer();
+	PixelCounters counters;
+	for (int by = rect.yl & ~7; by < rect.yr; by += 8) {
+		for (int bx = rect.xl & ~7; bx < rect.xr; bx += 8) {
+			++_statistics.blocks;
+
+			// the edge functions are monotonic, their extremes over the block are at its corners
+			BlockSetup block;
+			bool reject = false;
+			for (int k = 0; k < 3; ++k) {
+				block.edge[k] = setup.dedx[k] * (bx + 0.5f - setup.originX[k]) + setup.dedy[k] * (by + 0.5f - setup.originY[k]);
+				const float e00 = evaluateEdge(setup, block, k, 0, 0);
+				const float e70 = evaluateEdge(setup, block, k, 7, 0);
+				const float e07 = evaluateEdge(setup, block, k, 0, 7);
+				const float e77 = evaluateEdge(setup, block, k, 7, 7);
+				const float emin = std::min(std::min(e00, e70), std::min(e07, e77));
+				const float emax = std::max(std::max(e00, e70), std::max(e07, e77));
+				reject = reject || emax < 0.0f;
+				block.testEdge[k] = !(emin > 0.0f);
+			}
+
+			if (reject) {
+				++_statistics.blocksRejected;
+				continue;
+			}
+
+			if (!block.testEdge[0] && !block.testEdge[1] && !block.testEdge[2]) {
+				++_statistics.blocksAccepted;
+			}
+
+			// columns outside the region are never touched, rows outside the bounds cover no pixel
+			const int xl = std::max(bx, _region.xl);
+			const int xr = std::min(bx + 8, _region.xr);
+			block.z = evaluateScanPlane(plane, bx + 0.5f, by + 0.5f);
+			block.rowBegin = std::max(by, rect.yl) - by;
+			block.rowEnd = std::min(by + 8, rect.yr) - by;
+			block.depthRow = depthBuffer + static_cast<size_t>(by) * width + bx;
+			block.colorRow = colorBuffer + static_cast<size_t>(by) * width + bx;
+			block.stride = width;
+
+			// blocks cut by the region are tested pixel by pixel
+			if (xr - xl < 8 || _kernel == Kernel::Scalar) {
+				rasterizeBlockScalar(setup, block, xl - bx, xr - bx, counters);
+			}
+#ifdef HALF_SPACE_X86
+			else if (_kernel == Kernel::AVX2) {
+				rasterizeBlockAVX2(setup, block, counters);
+			} else {
+				rasterizeBlockSSE4(setup, block, counters);
+			}
+#endif
+		}
+	}
+
+	_statistics.pixelsTested += counters.tested;
+	_statistics.pixelsWritten += counters.written;
+}
+
+
+/*
+ * @brief select the kernel, an unsupported kernel falls back to the best supported one
+ * @param kernel kernel to use
+ */
+void HalfSpaceRasterizer::setKernel(Kernel kernel) {
+	_kernel = isKernelSupported(kernel) ? kernel : getBestKernel();
+}
+
+
+/*
+ * @brief get the selected kernel
+ * @return the kernel in use
+ */
+HalfSpaceRasterizer::Kernel HalfSpaceRasterizer::getKernel() const {
+	return _kernel;
+}
+
+
+/*
+ * @brief get the counters of the last rendered frame
+ * @return per frame statistics
+ */
+const HalfSpaceRasterizer::Statistics& HalfSpaceRasterizer::getStatistics() const {
+	return _statistics;
+}
+
+
+/*
+ * @brief check whether the compiler and the processor support the kernel
+ * @param kernel kernel to check
+ * @return true if the kernel can run
+ */
+bool HalfSpaceRasterizer::isKernelSupported(Kernel kernel) {
+	switch (kernel) {
+		case Kernel::Scalar:
+			return true;
+#ifdef HALF_SPACE_X86
+		case Kernel::SSE4:
+			return getCpuFeatures().sse41;
+		case Kernel::AVX2:
+			return getCpuFeatures().avx2;
+#endif
+		default:
+			return false;
+	}
+}
+
+
+/*
+ * @brief get the widest supported kernel
+ * @return AVX2 if supported, then SSE4, then scalar
+ */
+HalfSpaceRasterizer::Kernel HalfSpaceRasterizer::getBestKernel() {
+	if (isKernelSupported(Kernel::AVX2)) {
+		return Kernel::AVX2;
+	}
+
+	if (isKernelSupported(Kernel::SSE4)) {
+		return Kernel::SSE4;
+	}
+
+	return Kernel::Scalar;
+}
+
+
+/*
+ * @brief get the display name of the kernel
+ * @param kernel kernel to name
+ * @return name of the kernel
+ */
+const char* HalfSpaceRasterizer::getKernelName(Kernel kernel) {
+	switch (kernel) {
+		case Kernel::SSE4:
+			return "sse4";
+		case Kernel::AVX2:
+			return "avx2";
+		default:
+			return "scalar";
+	}
+}
+
+
+/*
+ * @brief get the largest depth difference to the scan-line z-buffer from rounding
+ * @detail the depth plane is evaluated per pixel instead of stepped along the edges and
+ *         spans, the results differ by a few ulps of depths in [0, 1], about 1e-6 on the
+ *         default scenes
+ * @return depth tolerance of the mode against the scan-line z-buffer
+ */
+float HalfSpaceRasterizer::getDepthTolerance() {
+	return 1e-5f;
+}
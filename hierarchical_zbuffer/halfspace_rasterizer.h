@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "framebuffer.h"
+#include "raster_triangle.h"
+#include "scan_triangle.h"
+
+/**
+ * @brief half-space rasterizer walking the bounding box of a triangle in 8x8 pixel blocks
+ * @detail the three edge functions are tested at the block corners first, blocks outside
+ *         an edge are skipped and blocks inside all edges skip the per pixel edge test.
+ *         The remaining rows are evaluated 8 pixels at a time by the selected kernel.
+ *         Left and top edges are inclusive like in the scan-line z-buffer, but the edge functions
+ *         and the depth plane are evaluated at every pixel instead of stepped along the edges and
+ *         spans: depths differ from the scan-line z-buffer by rounding, up to getDepthTolerance,
+ *         and a pixel center within rounding of a triangle edge may fall on the other side of it
+ */
+class HalfSpaceRasterizer {
+public:
+	/*
+	 * @brief instruction set of the per row kernel
+	 */
+	enum class Kernel {
+		Scalar,
+		SSE4,
+		AVX2
+	};
+
+	/*
+	 * @brief per frame counters of the block walk
+	 */
+	struct Statistics {
+		/* triangles whose bounds overlap the region, the same count in every rasterizer */
+		uint64_t triangles = 0;
+		uint64_t blocks = 0;
+		/* blocks outside one of the edges */
+		uint64_t blocksRejected = 0;
+		/* blocks inside all edges */
+		uint64_t blocksAccepted = 0;
+		/* pixels inside the triangle */
+		uint64_t pixelsTested = 0;
+		uint64_t pixelsWritten = 0;
+	};
+
+	/*
+	 * @brief constructor, render into the whole frame buffer with the best supported kernel
+	 */
+	explicit HalfSpaceRasterizer(FrameBuffer& frameBuffer);
+
+	/*
+	 * @brief constructor, render only the pixels inside a region of the frame buffer
+	 */
+	HalfSpaceRasterizer(FrameBuffer& frameBuffer, const ScanRect& region);
+
+	/*
+	 * @brief default destructor
+	 */
+	~HalfSpaceRasterizer() = default;
+
+	/*
+	 * @brief render the triangles in submission order
+	 */
+	void render(const std::vector<RasterTriangle>& triangles);
+
+	/*
+	 * @brief render the triangles with the given indices in order
+	 */
+	void render(const std::vector<RasterTriangle>& triangles, const std::vector<uint32_t>& indices);
+
+	/*
+	 * @brief rasterize one triangle, the counters are not reset
+	 */
+	void renderTriangle(const RasterTriangle& triangle);
+
+	/*
+	 * @brief select the kernel, an unsupported kernel falls back to the best supported one
+	 */
+	void setKernel(Kernel kernel);
+
+	/*
+	 * @brief get the selected kernel
+	 */
+	Kernel getKernel() const;
+
+	/*
+	 * @brief get the counters of the last rendered frame
+	 */
+	const Statistics& getStatistics() const;
+
+	/*
+	 * @brief check whether the compiler and the processor support the kernel
+	 */
+	static bool isKernelSupported(Kernel kernel);
+
+	/*
+	 * @brief get the widest supported kernel
+	 */
+	static Kernel getBestKernel();
+
+	/*
+	 * @brief get the display name of the kernel
+	 */
+	static const char* getKernelName(Kernel kernel);
+
+	/*
+	 * @brief get the largest depth difference to the scan-line z-buffer from rounding
+	 */
+	static float getDepthTolerance();
+
+private:
+	FrameBuffer& _frameBuffer;
+	ScanRect _region;
+	Kernel _kernel;
+	Statistics _statistics;
+};
@@ -0,0 +1,474 @@
+/*
+ * headless benchmark driver, renders a scripted camera path into the software frame buffer
+ * without a window and prints a per frame timing and statistics report as CSV to stdout.
+ *
+ * It is excluded from the Visual Studio build, which links main.cpp, the CMake build at the
+ * root of the repository builds it as the headless target
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "benchmark.h"
+#include "camera_path.h"
+#include "frame_pipeline.h"
+#include "image_writer.h"
+#include "mesh.h"
+#include "model.h"
+#include "profiler.h"
+#include "renderer.h"
+#include "scene.h"
+#include "scene_generator.h"
+
+namespace {
+	/*
+	 * @brief command line options
+	 */
+	struct Options {
+		std::string modelPath = "../resources/bunny.obj";
+		int width = 1280;
+		int height = 720;
+		Renderer::RenderMode renderMode = Renderer::RenderMode::ScanLineZBuffer;
+		int frames = 60;
+		int warmupFrames = 5;
+		std::string cameraPath;
+		std::string outputPrefix;
+		ImageFormat imageFormat = ImageFormat::PNG;
+		std::string reportPath;
+		std::string profilePrefix;
+		bool tiledRendering = false;
+		bool faceCulling = true;
+		bool temporalCulling = false;
+		bool visibilityPersistence = false;
+		bool trivialAccept = false;
+		Renderer::SpatialIndex spatialIndex = Renderer::SpatialIndex::Octree;
+		std::string kernel;
+		bool meshCache = true;
+		/* instances of the model per axis of an instance grid, 0 to render the model once */
+		int instancesPerAxis = 0;
+		FramePipeline::Mode pipelineMode = FramePipeline::Mode::Serial;
+		bool verbose = false;
+	};
+
+	/*
+	 * @brief print the usage to stderr
+	 */
+	void printUsage(const char* program) {
+		std::cerr << "usage: " << program << " [options]\n"
+			"  --model PATH          model to render (default ../resources/bunny.obj)\n"
+			"  --width N             frame buffer width (default 1280)\n"
+			"  --height N            frame buffer height (default 720)\n"
+			"  --mode MODE           scanline, hierarchical, octree or halfspace (default scanline)\n"
+			"  --index INDEX         octree or bvh traversed by the octree mode (default octree)\n"
+			"  --instances N         render a grid of N^3 instances of the model sharing its mesh,\n"
+			"                        each culled as a whole, with the octree mode\n"
+			"  --pipeline MODE       serial, low-latency or throughput (default serial), the pipelined\n"
+			"                        modes set up the next frames while the current one is rasterized,\n"
+			"                        except in the octree mode, which sets up its triangles while it\n"
+			"                        rasterizes them and only gets the latency of the pipeline\n"
+			"  --frames N            frames along the camera path (default 60)\n"
+			"  --warmup N            frames rendered before the report at the first camera (default 5)\n"
+			"  --camera FILE         keyframes \"eyeX eyeY eyeZ targetX targetY targetZ\" per line,\n"
+			"                        default is an orbit of radius 6 around the origin\n"
+			"  --output PREFIX       write PREFIX_color_NNNN and PREFIX_depth_NNNN of every frame\n"
+			"  --format FORMAT       png or ppm (default png), ppm writes the depth as pgm\n"
+			"  --report FILE         write the CSV report to FILE instead of stdout\n"
+			"  --profile PREFIX      write the stage times of the measured frames to PREFIX.csv and\n"
+			"                        the Chrome trace PREFIX.json\n"
+			"  --tiled               render the tiles in parallel\n"
+			"  --no-cull             disable backface culling\n"
+			"  --no-cache            load and prepare the model without its mesh cache\n"
+			"  --temporal            test the octree against the reprojected previous frame first\n"
+			"  --coherent            draw the octree nodes visible in the previous frame untested\n"
+			"  --trivial-accept      write triangles in front of the z pyramid without depth tests\n"
+			"  --kernel KERNEL       half-space kernel scalar, sse4 or avx2 (default best supported)\n"
+			"  --verbose             print the statistics of every frame to stderr\n";
+	}
+
+	/*
+	 * @brief parse a positive integer option value
+	 */
+	int parseCount(const std::string& option, const char* value, int minimum) {
+		char* end = nullptr;
+		const long count = std::strtol(value, &end, 10);
+		if (end == value || *end != '\0' || count < minimum || count > 1 << 16) {
+			throw std::invalid_argument("invalid value " + std::string(value) + " of " + option);
+		}
+
+		return static_cast<int>(count);
+	}
+
+	/*
+	 * @brief parse the command line, throw std::invalid_argument on an error
+	 * @return false if the usage was requested
+	 */
+	bool parseOptions(int argc, char* argv[], Options& options) {
+		for (int i = 1; i < argc; ++i) {
+			const std::string option = argv[i];
+			if (option == "--help" || option == "-h") {
+				return false;
+			} else if (option == "--tiled") {
+				options.tiledRendering = true;
+				continue;
+			} else if (option == "--no-cull") {
+				options.faceCulling = false;
+				continue;
+			} else if (option == "--no-cache") {
+				options.meshCache = false;
+				continue;
+			} else if (option == "--temporal") {
+				options.temporalCulling = true;
+				continue;
+			} else if (option == "--coherent") {
+				options.visibilityPersistence = true;
+				continue;
+			} else if (option == "--trivial-accept") {
+				options.trivialAccept = true;
+				continue;
+			} else if (option == "--verbose") {
+				options.verbose = true;
+				continue;
+			}
+
+			if (i + 1 >= argc) {
+				throw std::invalid_argument("missing value of " + option);
+			}
+
+			const char* value = argv[++i];
+			if (option == "--model") {
+				options.modelPath = value;
+			} else if (option == "--width") {
+				options.width = parseCount(option, value, 1);
+			} else if (option == "--height") {
+				options.height = parseCount(option, value, 1);
+			} else if (option == "--instances") {
+				options.instancesPerAxis = parseCount(option, value, 1);
+			} else if (option == "--frames") {
+				options.frames = parseCount(option, value, 1);
+			} else if (option == "--warmup") {
+				options.warmupFrames = parseCount(option, value, 0);
+			} else if (option == "--camera") {
+				options.cameraPath = value;
+			} else if (option == "--output") {
+				options.outputPrefix = value;
+			} else if (option == "--report") {
+				options.reportPath = value;
+			} else if (option == "--profile") {
+				options.profilePrefix = value;
+			} else if (option == "--kernel") {
+				options.kernel = value;
+			} else if (option == "--format") {
+				if (std::strcmp(value, "png") == 0) {
+					options.imageFormat = ImageFormat::PNG;
+				} else if (std::strcmp(value, "ppm") == 0) {
+					options.imageFormat = ImageFormat::PNM;
+				} else {
+					throw std::invalid_argument("unknown image format " + std::string(value));
+				}
+			} else if (option == "--mode") {
+				bool found = false;
+				for (auto mode : { Renderer::RenderMode::ScanLineZBuffer, Renderer::RenderMode::HierarchicalZBuffer,
+					Renderer::RenderMode::OctreeHierarchicalZBuffer, Renderer::RenderMode::HalfSpaceRasterizer }) {
+					if (std::strcmp(value, Renderer::getRenderModeName(mode)) == 0) {
+						options.renderMode = mode;
+						found = true;
+					}
+				}
+
+				if (!found) {
+					throw std::invalid_argument("unknown render mode " + std::string(value));
+				}
+			} else if (option == "--pipeline") {
+				bool found = false;
+				for (auto mode : { FramePipeline::Mode::Serial, FramePipeline::Mode::LowLatency, FramePipeline::Mode::Throughput }) {
+					if (std::strcmp(value, FramePipeline::getModeName(mode)) == 0) {
+						options.pipelineMode = mode;
+						found = true;
+					}
+				}
+
+				if (!found) {
+					throw std::invalid_argument("unknown pipeline mode " + std::string(value));
+				}
+			} else if (option == "--index") {
+				if (std::strcmp(value, Renderer::getSpatialIndexName(Renderer::SpatialIndex::Octree)) == 0) {
+					options.spatialIndex = Renderer::SpatialIndex::Octree;
+				} else if (std::strcmp(value, Renderer::getSpatialIndexName(Renderer::SpatialIndex::Bvh)) == 0) {
+					options.spatialIndex = Renderer::SpatialIndex::Bvh;
+				} else {
+					throw std::invalid_argument("unknown spatial index " + std::string(value));
+				}
+			} else {
+				throw std::invalid_argument("unknown option " + option);
+			}
+		}
+
+		if (options.instancesPerAxis > 0 && options.pipelineMode != FramePipeline::Mode::Serial) {
+			throw std::invalid_argument("the pipelined modes render the model only, not --instances");
+		}
+
+		return true;
+	}
+
+	/*
+	 * @brief select the half-space kernel by name
+	 */
+	void selectKernel(Renderer& renderer, const std::string& name) {
+		for (auto kernel : { HalfSpaceRasterizer::Kernel::Scalar, HalfSpaceRasterizer::Kernel::SSE4,
+			HalfSpaceRasterizer::Kernel::AVX2 }) {
+			if (name == HalfSpaceRasterizer::getKernelName(kernel)) {
+				if (!HalfSpaceRasterizer::isKernelSupported(kernel)) {
+					throw std::invalid_argument("half-space kernel " + name + " is not supported by this processor");
+				}
+
+				renderer.setHalfSpaceKernel(kernel);
+				return;
+			}
+		}
+
+		throw std::invalid_argument("unknown half-space kernel " + name);
+	}
+
+	/*
+	 * @brief get the file name of a frame image
+	 */
+	std::string getImagePath(const Options& options, const char* buffer, int frame) {
+		char number[16];
+		std::snprintf(number, sizeof(number), "%04d", frame);
+		const char* extension = options.imageFormat == ImageFormat::PNG ? ".png" :
+			std::strcmp(buffer, "depth") == 0 ? ".pgm" : ".ppm";
+		return options.outputPrefix + "_" + buffer + "_" + number + extension;
+	}
+}
+
+/* headless entry point, see printUsage for the options */
+int main(int argc, char* argv[]) {
+	Options options;
+	try {
+		if (!parseOptions(argc, argv, options)) {
+			printUsage(argv[0]);
+			return EXIT_SUCCESS;
+		}
+	} catch (const std::invalid_argument& e) {
+		std::cerr << e.what() << std::endl;
+		printUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	try {
+		const auto loadStart = std::chrono::high_resolution_clock::now();
+		const auto loadMesh = [&]() {
+			IndexedMesh mesh;
+			Model::loadIndexedMesh(options.modelPath, mesh);
+			return mesh;
+		};
+		const std::unique_ptr<Renderer> rendererOwner(options.meshCache ?
+			new Renderer(options.modelPath, loadMesh, options.width, options.height, &std::cerr) :
+			new Renderer(loadMesh(), options.width, options.height, &std::cerr));
+		Renderer& renderer = *rendererOwner;
+		renderer.setTiledRendering(options.tiledRendering);
+		renderer.setTemporalCulling(options.temporalCulling);
+		renderer.setVisibilityPersistence(options.visibilityPersistence);
+		renderer.setTrivialAccept(options.trivialAccept);
+		renderer.setSpatialIndex(options.spatialIndex);
+		renderer.setFaceCulling(options.faceCulling ? CullingStage::FaceCulling::Back : CullingStage::FaceCulling::None);
+		if (!options.kernel.empty()) {
+			selectKernel(renderer, options.kernel);
+		}
+
+		// the instances share the prepared mesh of the renderer and its octree parameters
+		Scene scene;
+		if (options.instancesPerAxis > 0) {
+			options.renderMode = Renderer::RenderMode::OctreeHierarchicalZBuffer;
+			ThreadPool threadPool(ThreadPool::getDefaultThreadCount());
+			const uint32_t mesh = scene.addMesh(renderer.getMesh(), renderer.getOctreeConfig(), threadPool);
+			generateInstanceGrid(scene, mesh, options.instancesPerAxis);
+			std::cerr << "scene: " << scene.getInstanceCount() << " instances, "
+				<< scene.getTriangleCount() << " triangles" << std::endl;
+		}
+		const CameraPath cameraPath = options.cameraPath.empty() ?
+			CameraPath::orbit(glm::vec3(0.0f), 6.0f, 0.0f, 16) : CameraPath(options.cameraPath);
+		const glm::mat4x4 projection = CameraPath::getProjectionMatrix(1.0f * options.width / options.height);
+
+		std::ofstream reportFile;
+		if (!options.reportPath.empty()) {
+			reportFile.open(options.reportPath);
+			if (!reportFile) {
+				throw std::runtime_error("cannot open " + options.reportPath);
+			}
+		}
+		std::ostream& report = options.reportPath.empty() ? std::cout : reportFile;
+
+		std::cerr << "mode " << Renderer::getRenderModeName(options.renderMode) << ", "
+			<< options.width << "x" << options.height << ", "
+			<< "tiled rendering " << (options.tiledRendering ? "on, " : "off, ") << renderer.getThreadCount() << " threads, "
+			<< "half-space kernel " << HalfSpaceRasterizer::getKernelName(renderer.getHalfSpaceKernel()) << ", "
+			<< "pipeline " << FramePipeline::getModeName(options.pipelineMode) << std::endl;
+		if (options.renderMode == Renderer::RenderMode::OctreeHierarchicalZBuffer &&
+			options.pipelineMode != FramePipeline::Mode::Serial) {
+			std::cerr << "warning: the octree mode sets up its triangles during the rasterization, "
+				"pipeline " << FramePipeline::getModeName(options.pipelineMode) << " overlaps nothing and only adds latency" << std::endl;
+		}
+		renderer.setLog(options.verbose ? &std::cerr : nullptr);
+
+		// keep exactly the measured frames, the warmup frames are recycled
+		Profiler& profiler = Profiler::getInstance();
+		profiler.setEnabled(options.verbose || !options.profilePrefix.empty());
+		profiler.setFrameCapacity(options.frames);
+
+		// time to first frame, from the start of the load to the end of the first rendered frame
+		bool firstFrame = true;
+		const auto reportFirstFrame = [&]() {
+			if (firstFrame) {
+				firstFrame = false;
+				std::cerr << "first frame after " << std::chrono::duration<double, std::milli>(
+					std::chrono::high_resolution_clock::now() - loadStart).count() << " ms" << std::endl;
+			}
+		};
+
+		// the warmup frames stay at the first camera and are not reported
+		const CameraPath::Keyframe firstCamera = cameraPath.sample(0, options.frames);
+		const auto getCamera = [&](int frame) {
+			return frame < options.warmupFrames ? firstCamera : cameraPath.sample(frame - options.warmupFrames, options.frames);
+		};
+
+		report << "frame,mode,setup_ms,raster_ms,frame_ms,triangles_set_up,triangles_backfacing,triangles_degenerate,"
+			"triangles_outside_frustum,triangles_submitted,triangles_occluded,triangles_occluded_per_level,triangles_trivially_accepted,"
+			"nodes_visited,nodes_occluded,nodes_outside,nodes_deferred,triangles_deferred,nodes_queried,visibility_cache_hits,pixels_tested,pixels_written,pixels_covered,"
+			"overdraw,depth_complexity,instances_drawn,instances_outside,instances_occluded,latency_ms,wait_ms" << std::endl;
+		std::vector<double> frameTimes;
+		std::vector<double> latencies;
+		int64_t measureBegin = Profiler::now();
+
+		// the frame buffer holds the frame until it is released to the pipeline
+		const auto showFrame = [&](int frame) {
+			reportFirstFrame();
+			if (frame == options.warmupFrames - 1) {
+				measureBegin = Profiler::now();
+			}
+
+			if (!options.outputPrefix.empty() && frame >= options.warmupFrames) {
+				writeColorImage(getImagePath(options, "color", frame - options.warmupFrames), renderer.getFrameBuffer(), options.imageFormat);
+				writeDepthImage(getImagePath(options, "depth", frame - options.warmupFrames), renderer.getFrameBuffer(), options.imageFormat);
+			}
+		};
+
+		const auto reportFrame = [&](int frame, const Renderer::FrameTiming& timing, const Renderer::FrameStatistics& statistics,
+			uint64_t trianglesSetUp, double latency, double waitTime) {
+			if (frame < options.warmupFrames) {
+				return;
+			}
+
+			report << frame - options.warmupFrames << "," << Renderer::getRenderModeName(options.renderMode) << ","
+				<< timing.setup << "," << timing.raster << "," << timing.frame << ","
+				<< trianglesSetUp << ","
+				<< statistics.trianglesBackfacing << "," << statistics.trianglesDegenerate << ","
+				<< statistics.trianglesOutsideFrustum << "," << statistics.trianglesSubmitted << ","
+				<< statistics.trianglesOccluded << ",";
+			// levels joined by ';' within the column, the root first
+			for (size_t level = 0; level < statistics.trianglesOccludedPerLevel.size(); ++level) {
+				report << (level > 0 ? ";" : "") << statistics.trianglesOccludedPerLevel[level];
+			}
+			report << "," << statistics.trianglesTriviallyAccepted << "," << statistics.nodesVisited << "," << statistics.nodesOccluded << "," << statistics.nodesOutside << ","
+				<< statistics.nodesDeferred << "," << statistics.trianglesDeferred << ","
+				<< statistics.nodesQueried << "," << statistics.visibilityCacheHits << ","
+				<< statistics.pixelsTested << "," << statistics.pixelsWritten << "," << statistics.pixelsCovered << ","
+				<< statistics.getOverdraw() << "," << statistics.getDepthComplexity() << ","
+				<< statistics.instancesDrawn << "," << statistics.instancesOutside << "," << statistics.instancesOccluded << ","
+				<< latency << "," << waitTime << "\n";
+			frameTimes.push_back(timing.frame);
+			latencies.push_back(latency);
+		};
+
+		const int frameCount = options.warmupFrames + options.frames;
+		if (scene.getInstanceCount() > 0) {
+			for (int frame = 0; frame < frameCount; ++frame) {
+				const CameraPath::Keyframe camera = getCamera(frame);
+				const int64_t input = Profiler::now();
+				renderer.renderScene(scene, projection * CameraPath::getViewMatrix(camera), camera.eye);
+				showFrame(frame);
+				const double latency = 1e-6 * (Profiler::now() - input);
+				reportFrame(frame, renderer.getFrameTiming(), renderer.getFrameStatistics(), 0, latency,
+					latency - renderer.getFrameTiming().frame);
+			}
+		} else {
+			// the front end submits whenever a frame is free, the serial mode renders on submission
+			FramePipeline pipeline(renderer, options.pipelineMode);
+			int submitted = 0;
+			int shown = 0;
+			while (shown < frameCount) {
+				FramePipeline::Frame* frame = submitted < frameCount ? pipeline.beginFrame() : nullptr;
+				if (frame) {
+					const CameraPath::Keyframe camera = getCamera(submitted++);
+					frame->setup.renderMode = options.renderMode;
+					frame->setup.viewProjection = projection * CameraPath::getViewMatrix(camera);
+					frame->setup.cameraPosition = camera.eye;
+					pipeline.submitFrame(frame);
+					continue;
+				}
+
+				frame = pipeline.acquireFrame();
+				if (!frame) {
+					std::this_thread::yield();
+					continue;
+				}
+
+				showFrame(shown);
+				pipeline.releaseFrame(frame);
+				reportFrame(shown++, frame->timing, frame->statistics, frame->setup.statistics.trianglesSetUp,
+					frame->latency.getLatency(), frame->latency.getWaitTime());
+			}
+		}
+		const double measureTime = 1e-6 * (Profiler::now() - measureBegin);
+		report.flush();
+
+		std::sort(frameTimes.begin(), frameTimes.end());
+		double total = 0.0;
+		for (double time : frameTimes) {
+			total += time;
+		}
+
+		std::cerr << options.frames << " frames, mean " << total / frameTimes.size() << " ms, "
+			<< "min " << frameTimes.front() << " ms, "
+			<< "p50 " << Benchmark::getPercentile(frameTimes, 50.0) << " ms, "
+			<< "p95 " << Benchmark::getPercentile(frameTimes, 95.0) << " ms, "
+			<< "p99 " << Benchmark::getPercentile(frameTimes, 99.0) << " ms, "
+			<< "max " << frameTimes.back() << " ms" << std::endl;
+
+		// frames shown per second in the steady state, and the age of their input when shown
+		std::sort(latencies.begin(), latencies.end());
+		std::cerr << "pipeline " << FramePipeline::getModeName(options.pipelineMode) << ": "
+			<< 1e3 * options.frames / measureTime << " frames/s, latency "
+			<< "p50 " << Benchmark::getPercentile(latencies, 50.0) << " ms, "
+			<< "p95 " << Benchmark::getPercentile(latencies, 95.0) << " ms, "
+			<< "max " << latencies.back() << " ms" << std::endl;
+
+		if (!options.profilePrefix.empty()) {
+			std::ofstream csv(options.profilePrefix + ".csv"), trace(options.profilePrefix + ".json");
+			if (!csv || !trace) {
+				throw std::runtime_error("cannot open the profile " + options.profilePrefix);
+			}
+
+			profiler.writeCsv(csv);
+			profiler.writeChromeTrace(trace);
+		}
+	} catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <numeric>
+
+#include "hierarchical_zbuffer.h"
+#include "profiler.h"
+
+/*
+ * @brief total number of triangles passing the occlusion test
+ * @return accepted triangles of all levels
+ */
+uint64_t HierarchicalZBuffer::Statistics::getAccepted() const {
+	return std::accumulate(acceptedPerLevel.begin(), acceptedPerLevel.end(), uint64_t(0));
+}
+
+
+/*
+ * @brief total number of triangles rejected by the occlusion test
+ * @return rejected triangles of all levels
+ */
+uint64_t HierarchicalZBuffer::Statistics::getRejected() const {
+	return std::accumulate(rejectedPerLevel.begin(), rejectedPerLevel.end(), uint64_t(0));
+}
+
+
+/*
+ * @brief constructor, build the quad tree over the depth buffer of the frame buffer
+ * @param frameBuffer render target, it must outlive the hierarchical z-buffer
+ */
+HierarchicalZBuffer::HierarchicalZBuffer(FrameBuffer& frameBuffer)
+	: HierarchicalZBuffer(frameBuffer, { 0, frameBuffer.getWidth(), 0, frameBuffer.getHeight() }) { }
+
+
+/*
+ * @brief constructor, build the quad tree over a region of the depth buffer
+ * @detail only pixels inside the region are tested and written, so hierarchical z-buffers
+ *         over disjoint regions of the same frame buffer can render concurrently
+ * @param frameBuffer render target, it must outlive the hierarchical z-buffer
+ * @param region non-empty pixel region inside the frame buffer
+ */
+HierarchicalZBuffer::HierarchicalZBuffer(FrameBuffer& frameBuffer, const ScanRect& region)
+	: _frameBuffer(frameBuffer), _region(region),
+	  _quadTree(region.xr - region.xl, region.yr - region.yl,
+		  frameBuffer.getDepthBuffer() + static_cast<size_t>(region.yl) * frameBuffer.getWidth() + region.xl,
+		  frameBuffer.getWidth()) { }
+
+
+/*
+ * @brief render the triangles in submission order
+ * @param triangles triangles in screen space
+ */
+void HierarchicalZBuffer::render(const std::vector<RasterTriangle>& triangles) {
+	PROFILE_SCOPE(Rasterization);
+	beginFrame();
+	for (const auto& triangle : triangles) {
+		renderTriangle(triangle);
+	}
+}
+
+
+/*
+ * @brief render the triangles with the given indices in order
+ * @param triangles triangles in screen space
+ * @param indices indices of the triangles to render
+ */
+void HierarchicalZBuffer::render(const std::vector<RasterTriangle>& triangles, const std::vector<uint32_t>& indices) {
+	PROFILE_SCOPE(Rasterization);
+	beginFrame();
+	for (uint32_t index : indices) {
+		renderTriangle(triangles[index]);
+	}
+}
+
+
+/*
+ * @brief rebuild the quad tree from the current depth buffer and reset the counters
+ */
+void HierarchicalZBuffer::beginFrame() {
+	PROFILE_SCOPE(HiZUpdate);
+	_quadTree.buildQuadTree();
+
+	_statistics = Statistics();
+	_statistics.acceptedPerLevel.resize(_quadTree.getTreeDepth() + 1, 0);
+	_statistics.rejectedPerLevel.resize(_quadTree.getTreeDepth() + 1, 0);
+}
+
+
+/*
+ * @brief keep the nearest depths in the quad tree and write triangles in front of them untested
+ * @detail takes effect with the next beginFrame
+ * @param trivialAccept true for the two-sided quad tree
+ */
+void HierarchicalZBuffer::setTrivialAccept(bool trivialAccept) {
+	_quadTree.setTwoSided(trivialAccept);
+}
+
+
+/*
+ * @brief check whether triangles in front of the quad tree are written untested
+ * @return true if the quad tree is two-sided
+ */
+bool HierarchicalZBuffer::isTrivialAccept() const {
+	return _quadTree.isTwoSided();
+}
+
+
+/*
+ * @brief test one triangle against the quad tree and scan convert it if not hidden
+ * @detail with trivial accept a triangle in front of the nearest depth under its bounding box
+ *         is written without depth tests. The written spans mark the quad tree dirty, it is updated before the next test
+ * @param triangle triangle in screen space
+ * @return false if the triangle is rejected or covers no pixel
+ */
+bool HierarchicalZBuffer::renderTriangle(const RasterTriangle& triangle) {
+	const int width = _frameBuffer.getWidth();
+	const int height = _frameBuffer.getHeight();
+	ScanRect rect;
+	if (!setupScanBounds(triangle, width, height, rect)) {
+		return false;
+	}
+
+	rect.xl = std::max(rect.xl, _region.xl) - _region.xl;
+	rect.xr = std::min(rect.xr, _region.xr) - _region.xl;
+	rect.yl = std::max(rect.yl, _region.yl) - _region.yl;
+	rect.yr = std::min(rect.yr, _region.yr) - _region.yl;
+	if (rect.xl >= rect.xr || rect.yl >= rect.yr) {
+		return false;
+	}
+
+	++_statistics.triangles;
+
+	const float zmin = std::min(std::min(triangle.v[0].z, triangle.v[1].z), triangle.v[2].z);
+	_quadTree.updateDirty();
+	const uint32_t locCode = _quadTree.findCoveringNode(rect.xl, rect.xr, rect.yl, rect.yr);
+	const size_t level = QuadTree::getNodeTreeDepth(locCode);
+	if (zmin >= _quadTree.getNodeZ(locCode)) {
+		++_statistics.rejectedPerLevel[level];
+		return false;
+	}
+
+	++_statistics.acceptedPerLevel[level];
+
+	float* depthBuffer = _frameBuffer.getDepthBuffer();
+	uint32_t* colorBuffer = _frameBuffer.getColorBuffer();
+	const float zmax = std::max(std::max(triangle.v[0].z, triangle.v[1].z), triangle.v[2].z);
+	if (_quadTree.isTwoSided() && zmax < _quadTree.getRegionNearestZ(rect.xl, rect.xr, rect.yl, rect.yr)) {
+		++_statistics.triviallyAccepted;
+		scanTriangle(triangle, height, _region, [&](int y, int xl, int xr, float z, float dzdx) {
+			float* depthRow = depthBuffer + static_cast<size_t>(y) * width;
+			uint32_t* colorRow = colorBuffer + static_cast<size_t>(y) * width;
+			_statistics.pixelsWritten += xr - xl;
+			for (int x = xl; x < xr; ++x) {
+				depthRow[x] = z;
+				colorRow[x] = triangle.color;
+				z += dzdx;
+			}
+
+			_quadTree.markDirty(xl - _region.xl, xr - _region.xl, y - _region.yl);
+		});
+
+		return true;
+	}
+
+	scanTriangle(triangle, height, _region, [&](int y, int xl, int xr, float z, float dzdx) {
+		float* depthRow = depthBuffer + static_cast<size_t>(y) * width;
+		uint32_t* colorRow = colorBuffer + static_cast<size_t>(y) * width;
+		_statistics.pixelsTested += xr - xl;
+		int writtenXl = xr;
+		int writtenXr = xl;
+		for (int x = xl; x < xr; ++x) {
+			if (z < depthRow[x]) {
+				depthRow[x] = z;
+				colorRow[x] = triangle.color;
+				writtenXl = std::min(writtenXl, x);
+				writtenXr = x + 1;
+				++_statistics.pixelsWritten;
+			}
+			z += dzdx;
+		}
+
+		if (writtenXl < writtenXr) {
+			_quadTree.markDirty(writtenXl - _region.xl, writtenXr - _region.xl, y - _region.yl);
+		}
+	});
+
+	return true;
+}
+
+
+/*
+ * @brief check whether everything inside the pixel region nearer than zmin is hidden
+ * @detail brings the quad tree up to date with the pixels written since the last test
+ * @param rect non-empty pixel region inside the region of the quad tree
+ * @param zmin nearest depth of the tested geometry
+ * @return true if the region is entirely in front of zmin
+ */
+bool HierarchicalZBuffer::isOccluded(const ScanRect& rect, float zmin) {
+	_quadTree.updateDirty();
+	return zmin >= _quadTree.getRegionZ(
+		rect.xl - _region.xl, rect.xr - _region.xl, rect.yl - _region.yl, rect.yr - _region.yl);
+}
+
+
+/*
+ * @brief get the render target
+ * @return the frame buffer
+ */
+const FrameBuffer& HierarchicalZBuffer::getFrameBuffer() const {
+	return _frameBuffer;
+}
+
+
+/*
+ * @brief get the pixels of the frame buffer covered by the quad tree
+ * @return pixel region of the quad tree
+ */
+const ScanRect& HierarchicalZBuffer::getRegion() const {
+	return _region;
+}
+
+
+/*
+ * @brief get the quad tree over the depth buffer
+ * @return the quad tree
+ */
+const QuadTree& HierarchicalZBuffer::getQuadTree() const {
+	return _quadTree;
+}
+
+
+/*
+ * @brief get the counters of the current frame
+ * @return per frame statistics
+ */
+const HierarchicalZBuffer::Statistics& HierarchicalZBuffer::getStatistics() const {
+	return _statistics;
+}
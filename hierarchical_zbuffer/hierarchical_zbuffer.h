@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "framebuffer.h"
+#include "quadtree.h"
+#include "raster_triangle.h"
+#include "scan_triangle.h"
+
+/**
+ * @brief hierarchical z-buffer, triangles are tested against the z pyramid before scan conversion
+ * @detail a triangle is compared with the smallest quad tree node covering its screen bounding
+ *         box, if its nearest depth is behind the farthest depth of the node it is hidden.
+ *         With trivial accept the pyramid is two-sided, a triangle whose farthest depth is in
+ *         front of the nearest depth of the cells under its bounding box is entirely visible
+ *         and written without depth tests
+ */
+class HierarchicalZBuffer {
+public:
+	/*
+	 * @brief per frame counters of the occlusion test and scan conversion
+	 * @detail accepted/rejected triangles are counted at the level of the covering node
+	 */
+	struct Statistics {
+		/* triangles whose bounds overlap the region, the same count in every rasterizer */
+		uint64_t triangles = 0;
+		std::vector<uint64_t> acceptedPerLevel;
+		std::vector<uint64_t> rejectedPerLevel;
+		/* accepted triangles in front of everything under them, written without depth tests */
+		uint64_t triviallyAccepted = 0;
+		uint64_t pixelsTested = 0;
+		uint64_t pixelsWritten = 0;
+
+		uint64_t getAccepted() const;
+		uint64_t getRejected() const;
+	};
+
+	/*
+	 * @brief constructor, build the quad tree over the depth buffer of the frame buffer
+	 */
+	explicit HierarchicalZBuffer(FrameBuffer& frameBuffer);
+
+	/*
+	 * @brief constructor, build the quad tree over a region of the depth buffer
+	 */
+	HierarchicalZBuffer(FrameBuffer& frameBuffer, const ScanRect& region);
+
+	/*
+	 * @brief default destructor
+	 */
+	~HierarchicalZBuffer() = default;
+
+	/*
+	 * @brief render the triangles in submission order
+	 */
+	void render(const std::vector<RasterTriangle>& triangles);
+
+	/*
+	 * @brief render the triangles with the given indices in order
+	 */
+	void render(const std::vector<RasterTriangle>& triangles, const std::vector<uint32_t>& indices);
+
+	/*
+	 * @brief rebuild the quad tree from the current depth buffer and reset the counters
+	 */
+	void beginFrame();
+
+	/*
+	 * @brief keep the nearest depths in the quad tree and write triangles in front of them untested
+	 */
+	void setTrivialAccept(bool trivialAccept);
+
+	/*
+	 * @brief check whether triangles in front of the quad tree are written untested
+	 */
+	bool isTrivialAccept() const;
+
+	/*
+	 * @brief test one triangle against the quad tree and scan convert it if not hidden
+	 */
+	bool renderTriangle(const RasterTriangle& triangle);
+
+	/*
+	 * @brief check whether everything inside the pixel region nearer than zmin is hidden
+	 */
+	bool isOccluded(const ScanRect& rect, float zmin);
+
+	/*
+	 * @brief get the render target
+	 */
+	const FrameBuffer& getFrameBuffer() const;
+
+	/*
+	 * @brief get the pixels of the frame buffer covered by the quad tree
+	 */
+	const ScanRect& getRegion() const;
+
+	/*
+	 * @brief get the quad tree over the depth buffer
+	 */
+	const QuadTree& getQuadTree() const;
+
+	/*
+	 * @brief get the counters of the current frame
+	 */
+	const Statistics& getStatistics() const;
+
+private:
+	FrameBuffer& _frameBuffer;
+	ScanRect _region;
+	QuadTree _quadTree;
+	Statistics _statistics;
+};
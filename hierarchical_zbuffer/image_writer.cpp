@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "image_writer.h"
+
+namespace {
+	/*
+	 * @brief write 8 bit pixels as a binary PPM (3 channels) or PGM (1 channel)
+	 */
+	void writePNM(const std::string& filepath, int width, int height, int channels, const std::vector<uint8_t>& pixels) {
+		std::ofstream file(filepath, std::ios::binary);
+		if (!file) {
+			throw std::runtime_error("cannot open " + filepath);
+		}
+
+		file << (channels == 3 ? "P6" : "P5") << "\n" << width << " " << height << "\n255\n";
+		file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+		if (!file) {
+			throw std::runtime_error("cannot write " + filepath);
+		}
+	}
+
+	/*
+	 * @brief write 8 bit pixels in the format
+	 */
+	void writeImage(const std::string& filepath, int width, int height, int channels,
+		const std::vector<uint8_t>& pixels, ImageFormat format) {
+		if (format == ImageFormat::PNG) {
+			if (!stbi_write_png(filepath.c_str(), width, height, channels, pixels.data(), width * channels)) {
+				throw std::runtime_error("cannot write " + filepath);
+			}
+		} else {
+			writePNM(filepath, width, height, channels, pixels);
+		}
+	}
+}
+
+/*
+ * @brief write the color buffer of the frame buffer to an image file
+ * @detail the alpha channel is dropped
+ * @param filepath path of the image file
+ * @param frameBuffer frame buffer to write
+ * @param format image format
+ */
+void writeColorImage(const std::string& filepath, const FrameBuffer& frameBuffer, ImageFormat format) {
+	const int width = frameBuffer.getWidth();
+	const int height = frameBuffer.getHeight();
+	const uint32_t* colors = frameBuffer.getColorBuffer();
+	std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 3);
+	for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+		pixels[3 * i] = static_cast<uint8_t>(colors[i]);
+		pixels[3 * i + 1] = static_cast<uint8_t>(colors[i] >> 8);
+		pixels[3 * i + 2] = static_cast<uint8_t>(colors[i] >> 16);
+	}
+
+	writeImage(filepath, width, height, 3, pixels, format);
+}
+
+
+/*
+ * @brief write the depth buffer of the frame buffer to a gray scale image file
+ * @detail the depth of the covered pixels is stretched over [1, 255] with the nearest
+ *         pixel white, uncovered pixels (depth 1) are black
+ * @param filepath path of the image file
+ * @param frameBuffer frame buffer to write
+ * @param format image format
+ */
+void writeDepthImage(const std::string& filepath, const FrameBuffer& frameBuffer, ImageFormat format) {
+	const int width = frameBuffer.getWidth();
+	const int height = frameBuffer.getHeight();
+	const size_t count = static_cast<size_t>(width) * height;
+	const float* depths = frameBuffer.getDepthBuffer();
+
+	float nearest = 1.0f;
+	float farthest = 0.0f;
+	for (size_t i = 0; i < count; ++i) {
+		if (depths[i] < 1.0f) {
+			nearest = std::min(nearest, depths[i]);
+			farthest = std::max(farthest, depths[i]);
+		}
+	}
+
+	const float scale = farthest > nearest ? 254.0f / (farthest - nearest) : 0.0f;
+	std::vector<uint8_t> pixels(count, 0);
+	for (size_t i = 0; i < count; ++i) {
+		if (depths[i] < 1.0f) {
+			pixels[i] = static_cast<uint8_t>(255.0f - (depths[i] - nearest) * scale + 0.5f);
+		}
+	}
+
+	writeImage(filepath, width, height, 1, pixels, format);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+#include "framebuffer.h"
+
+/*
+ * @brief image file formats of the frame buffer dumps
+ */
+enum class ImageFormat {
+	/* binary PPM for the color, PGM for the depth */
+	PNM,
+	/* 8 bit PNG through stb_image_write */
+	PNG
+};
+
+/*
+ * @brief write the color buffer of the frame buffer to an image file
+ */
+void writeColorImage(const std::string& filepath, const FrameBuffer& frameBuffer, ImageFormat format);
+
+/*
+ * @brief write the depth buffer of the frame buffer to a gray scale image file
+ */
+void writeDepthImage(const std::string& filepath, const FrameBuffer& frameBuffer, ImageFormat format);
@@ -1,18 +1,25 @@
+#ifdef _WIN32
 #include <direct.h>
+#define getcwd _getcwd
+#else
+#include <unistd.h>
+#endif
 
 #include <iostream>
 #include <stdexcept>
 
 #include "application.h"
 
-/* program entry point */
-int main() {
+/* program entry point, the optional argument is the model to load */
+int main(int argc, char* argv[]) {
 	char buf[1024];
-	_getcwd(buf, 1024);
+	if (getcwd(buf, sizeof(buf)) == nullptr) {
+		buf[0] = '\0';
+	}
 	std::cout << "current directory: " << buf << std::endl;
 
 	try {
-		Application app;
+		Application app(argc > 1 ? argv[1] : "../resources/bunny.obj");
 		app.run();
 	} catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -31,4 +32,10 @@ struct Mesh {
 
 struct Triangle {
 	Vertex v[3];
+};
+
+/* positions of a triangle mesh, every 3 indices form a triangle */
+struct IndexedMesh {
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
 };
\ No newline at end of file
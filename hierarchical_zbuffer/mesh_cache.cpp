@@ -0,0 +1,425 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "mesh_cache.h"
+
+namespace {
+	const char cacheMagic[8] = { 'H', 'Z', 'B', 'C', 'A', 'C', 'H', 'E' };
+
+	/* alignment of every section in the file, the mapping itself is page aligned */
+	const uint64_t sectionAlignment = 64;
+
+	/* round offset up to the section alignment */
+	inline uint64_t alignSection(uint64_t offset) {
+		return (offset + sectionAlignment - 1) & ~(sectionAlignment - 1);
+	}
+}
+
+/*
+ * @brief destructor, unmap the file
+ */
+MeshCache::~MeshCache() {
+	close();
+}
+
+
+/*
+ * @brief map the cache file if it is valid for the source and build stamps
+ * @detail the file is rejected if it is missing, truncated, of another format version or
+ *         element layout, written for another model file or other build parameters, or if
+ *         an index or node range of its sections points outside its target
+ * @param path path of the cache file
+ * @param sourceStamp stamp of the model file, see getSourceStamp
+ * @param buildStamp hash of the parameters the mesh and the indices were prepared with
+ * @return true if the cache is mapped and its sections can be used
+ */
+bool MeshCache::open(const std::string& path, uint64_t sourceStamp, uint64_t buildStamp) {
+	close();
+	if (sourceStamp == 0) {
+		return false;
+	}
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	_file = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(Header))) {
+		close();
+		return false;
+	}
+
+	_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (_mapping == nullptr) {
+		close();
+		return false;
+	}
+
+	_data = static_cast<const uint8_t*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+	_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	const int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(Header))) {
+		::close(file);
+		return false;
+	}
+
+	void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+	_data = static_cast<const uint8_t*>(data);
+	_size = static_cast<size_t>(status.st_size);
+#endif
+	if (_data == nullptr) {
+		close();
+		return false;
+	}
+
+	uint32_t elementSizes[SectionCount];
+	_getElementSizes(elementSizes);
+	const Header& header = _getHeader();
+	bool valid = std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0 &&
+		header.version == version &&
+		std::memcmp(header.elementSizes, elementSizes, sizeof(elementSizes)) == 0 &&
+		header.sourceStamp == sourceStamp &&
+		header.buildStamp == buildStamp &&
+		header.fileSize == _size;
+	for (int section = 0; section < SectionCount && valid; ++section) {
+		const SectionEntry& entry = header.sections[section];
+		valid = entry.offset % sectionAlignment == 0 && entry.offset <= _size &&
+			entry.count <= (_size - entry.offset) / elementSizes[section];
+	}
+
+	if (!valid || !_validateSections()) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+
+/*
+ * @brief check that every index and node range of the sections stays inside its target
+ * @detail the vertex indices must address the positions, the triangle indices of both trees
+ *         the triangles, and the node ranges their triangle index arrays. Children must
+ *         follow their parent, as in the preorder and depth first layouts, so a damaged tree
+ *         cannot send the traversal around in a cycle
+ * @return true if the renderer can use the sections without further checks
+ */
+bool MeshCache::_validateSections() const {
+	const ArrayView<glm::vec3> positions = getPositions();
+	const ArrayView<uint32_t> indices = getIndices();
+	if (indices.size() % 3 != 0) {
+		return false;
+	}
+
+	for (uint32_t index : indices) {
+		if (index >= positions.size()) {
+			return false;
+		}
+	}
+
+	const size_t triangleCount = indices.size() / 3;
+	for (const ArrayView<uint32_t>& triangles : { getOctreeTriangles(), getBvhTriangles() }) {
+		for (uint32_t triangle : triangles) {
+			if (triangle >= triangleCount) {
+				return false;
+			}
+		}
+	}
+
+	const ArrayView<OctreeNode> octreeNodes = getOctreeNodes();
+	const uint64_t octreeTriangleCount = getOctreeTriangles().size();
+	for (size_t i = 0; i < octreeNodes.size(); ++i) {
+		const OctreeNode& node = octreeNodes[i];
+		if (static_cast<uint64_t>(node.firstTriangle) + node.triangleCount > octreeTriangleCount) {
+			return false;
+		}
+
+		for (int32_t child : node.children) {
+			if (child >= 0 && (static_cast<size_t>(child) <= i || static_cast<size_t>(child) >= octreeNodes.size())) {
+				return false;
+			}
+		}
+	}
+
+	const ArrayView<BvhNode> bvhNodes = getBvhNodes();
+	const uint64_t bvhTriangleCount = getBvhTriangles().size();
+	for (size_t i = 0; i < bvhNodes.size(); ++i) {
+		const BvhNode& node = bvhNodes[i];
+		const bool valid = node.triangleCount > 0 ?
+			static_cast<uint64_t>(node.offset) + node.triangleCount <= bvhTriangleCount :
+			i + 1 < node.offset && node.offset < bvhNodes.size();
+		if (!valid) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * @brief unmap the file
+ */
+void MeshCache::close() {
+#ifdef _WIN32
+	if (_data) {
+		UnmapViewOfFile(_data);
+	}
+	if (_mapping) {
+		CloseHandle(_mapping);
+	}
+	if (_file) {
+		CloseHandle(_file);
+	}
+#else
+	if (_data) {
+		munmap(const_cast<uint8_t*>(_data), _size);
+	}
+#endif
+	_data = nullptr;
+	_size = 0;
+	_file = nullptr;
+	_mapping = nullptr;
+}
+
+
+/*
+ * @brief get the vertex positions of the prepared mesh
+ * @return positions inside the mapping, empty if nothing is mapped
+ */
+ArrayView<glm::vec3> MeshCache::getPositions() const {
+	return _getSection<glm::vec3>(Positions);
+}
+
+
+/*
+ * @brief get the vertex indices of the prepared mesh, 3 per triangle
+ * @return indices inside the mapping, empty if nothing is mapped
+ */
+ArrayView<uint32_t> MeshCache::getIndices() const {
+	return _getSection<uint32_t>(Indices);
+}
+
+
+/*
+ * @brief get the octree nodes in preorder
+ * @return nodes inside the mapping, empty if nothing is mapped
+ */
+ArrayView<OctreeNode> MeshCache::getOctreeNodes() const {
+	return _getSection<OctreeNode>(OctreeNodes);
+}
+
+
+/*
+ * @brief get the triangle indices referenced by the octree nodes
+ * @return triangle indices inside the mapping, empty if nothing is mapped
+ */
+ArrayView<uint32_t> MeshCache::getOctreeTriangles() const {
+	return _getSection<uint32_t>(OctreeTriangles);
+}
+
+
+/*
+ * @brief get the bvh nodes in depth first order
+ * @return nodes inside the mapping, empty if nothing is mapped
+ */
+ArrayView<BvhNode> MeshCache::getBvhNodes() const {
+	return _getSection<BvhNode>(BvhNodes);
+}
+
+
+/*
+ * @brief get the triangle indices referenced by the bvh leaves
+ * @return triangle indices inside the mapping, empty if nothing is mapped
+ */
+ArrayView<uint32_t> MeshCache::getBvhTriangles() const {
+	return _getSection<uint32_t>(BvhTriangles);
+}
+
+
+/*
+ * @brief get the depth of the octree
+ * @return depth of the deepest octree node, 0 if nothing is mapped
+ */
+int MeshCache::getOctreeDepth() const {
+	return _data ? _getHeader().octreeDepth : 0;
+}
+
+
+/*
+ * @brief get the depth of the bvh
+ * @return depth of the deepest bvh node, 0 if nothing is mapped
+ */
+int MeshCache::getBvhDepth() const {
+	return _data ? _getHeader().bvhDepth : 0;
+}
+
+
+/*
+ * @brief write the cache file of a prepared mesh and its spatial indices
+ * @detail the file is written under a temporary name and renamed when complete, so a
+ *         reader never maps a partially written cache
+ * @param path path of the cache file
+ * @param sourceStamp stamp of the model file, see getSourceStamp
+ * @param buildStamp hash of the parameters the mesh and the indices were prepared with
+ * @param mesh mesh after the vertex cache optimization
+ * @param octree octree built over the mesh
+ * @param bvh bvh built over the mesh
+ * @return true if the file was written
+ */
+bool MeshCache::write(const std::string& path, uint64_t sourceStamp, uint64_t buildStamp,
+	const IndexedMesh& mesh, const Octree& octree, const Bvh& bvh) {
+	Header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+	header.version = version;
+	_getElementSizes(header.elementSizes);
+	header.sourceStamp = sourceStamp;
+	header.buildStamp = buildStamp;
+	header.octreeDepth = octree.getDepth();
+	header.bvhDepth = bvh.getDepth();
+
+	const void* sectionData[SectionCount] = {
+		mesh.positions.data(), mesh.indices.data(),
+		octree.getNodes().data(), octree.getTriangleIndices().data(),
+		bvh.getNodes().data(), bvh.getTriangleIndices().data()
+	};
+	const size_t sectionCounts[SectionCount] = {
+		mesh.positions.size(), mesh.indices.size(),
+		octree.getNodes().size(), octree.getTriangleIndices().size(),
+		bvh.getNodes().size(), bvh.getTriangleIndices().size()
+	};
+
+	uint64_t offset = alignSection(sizeof(Header));
+	for (int section = 0; section < SectionCount; ++section) {
+		header.sections[section].offset = offset;
+		header.sections[section].count = sectionCounts[section];
+		offset = alignSection(offset + sectionCounts[section] * header.elementSizes[section]);
+	}
+	header.fileSize = offset;
+
+	const std::string temporaryPath = path + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			return false;
+		}
+
+		const std::vector<char> padding(sectionAlignment, 0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		uint64_t written = sizeof(header);
+		for (int section = 0; section < SectionCount; ++section) {
+			file.write(padding.data(), static_cast<std::streamsize>(header.sections[section].offset - written));
+			const uint64_t size = sectionCounts[section] * header.elementSizes[section];
+			file.write(static_cast<const char*>(sectionData[section]), static_cast<std::streamsize>(size));
+			written = header.sections[section].offset + size;
+		}
+		file.write(padding.data(), static_cast<std::streamsize>(header.fileSize - written));
+
+		if (!file) {
+			file.close();
+			std::remove(temporaryPath.c_str());
+			return false;
+		}
+	}
+
+	std::remove(path.c_str());
+	if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+
+/*
+ * @brief get the path of the cache file kept next to a model
+ * @param modelPath path of the model file
+ * @return path of the cache file
+ */
+std::string MeshCache::getCachePath(const std::string& modelPath) {
+	return modelPath + ".hzbcache";
+}
+
+
+/*
+ * @brief get the stamp of a model file from its size and modification time
+ * @detail reading the whole model to hash its contents would cost a good part of the parse
+ *         the cache is there to avoid, so an edited model is recognized by its metadata
+ * @param modelPath path of the model file
+ * @return stamp of the model, 0 if the file does not exist
+ */
+uint64_t MeshCache::getSourceStamp(const std::string& modelPath) {
+#ifdef _WIN32
+	struct _stat64 status;
+	if (_stat64(modelPath.c_str(), &status) != 0) {
+		return 0;
+	}
+#else
+	struct stat status;
+	if (stat(modelPath.c_str(), &status) != 0) {
+		return 0;
+	}
+#endif
+	const int64_t size = static_cast<int64_t>(status.st_size);
+	const int64_t modified = static_cast<int64_t>(status.st_mtime);
+	return hash(&modified, sizeof(modified), hash(&size, sizeof(size)));
+}
+
+
+/*
+ * @brief FNV-1a hash of a block of bytes, continuing from seed
+ * @param data bytes to hash
+ * @param size number of bytes
+ * @param seed hash of the bytes before, the FNV offset basis for none
+ * @return hash of all bytes
+ */
+uint64_t MeshCache::hash(const void* data, size_t size, uint64_t seed) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i) {
+		seed = (seed ^ bytes[i]) * 0x100000001B3ull;
+	}
+	return seed;
+}
+
+
+/*
+ * @brief get the size of one element of each section
+ * @param elementSizes size in bytes per section as output
+ */
+void MeshCache::_getElementSizes(uint32_t* elementSizes) {
+	elementSizes[Positions] = sizeof(glm::vec3);
+	elementSizes[Indices] = sizeof(uint32_t);
+	elementSizes[OctreeNodes] = sizeof(OctreeNode);
+	elementSizes[OctreeTriangles] = sizeof(uint32_t);
+	elementSizes[BvhNodes] = sizeof(BvhNode);
+	elementSizes[BvhTriangles] = sizeof(uint32_t);
+}
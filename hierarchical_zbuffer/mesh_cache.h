@@ -0,0 +1,196 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#define GLM_FORCE_RADIANS
+#ifdef GLFW_INCLUDE_VULKAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include <glm/vec3.hpp>
+
+#include "array_view.h"
+#include "bvh.h"
+#include "mesh.h"
+#include "octree.h"
+
+/**
+ * @brief memory mapped binary file of a prepared mesh and its spatial indices
+ * @detail the cache of a model lives next to it and holds the mesh after the vertex cache
+ *         optimization together with the octree and the bvh built over it, each in a 64 byte
+ *         aligned section that is used in place. A cache is only opened if its format version,
+ *         the size and modification time of the model and the build parameters match the
+ *         ones it was written with, anything else is stale and has to be rewritten. The indices
+ *         and node ranges are checked once on open, so a damaged file is rejected instead of
+ *         read out of bounds
+ */
+class MeshCache {
+public:
+	/* bumped whenever the file layout or the preparation of the mesh changes */
+	static const uint32_t version = 2;
+
+	/*
+	 * @brief default constructor, nothing mapped
+	 */
+	MeshCache() = default;
+
+	/*
+	 * @brief destructor, unmap the file
+	 */
+	~MeshCache();
+
+	MeshCache(const MeshCache&) = delete;
+	MeshCache& operator=(const MeshCache&) = delete;
+
+	/*
+	 * @brief map the cache file if it is valid for the source and build stamps
+	 */
+	bool open(const std::string& path, uint64_t sourceStamp, uint64_t buildStamp);
+
+	/*
+	 * @brief unmap the file
+	 */
+	void close();
+
+	/*
+	 * @brief check whether a cache file is mapped
+	 */
+	bool isOpen() const {
+		return _data != nullptr;
+	}
+
+	/*
+	 * @brief get the size of the mapped file in bytes
+	 */
+	size_t getFileSize() const {
+		return _size;
+	}
+
+	/*
+	 * @brief get the vertex positions of the prepared mesh
+	 */
+	ArrayView<glm::vec3> getPositions() const;
+
+	/*
+	 * @brief get the vertex indices of the prepared mesh, 3 per triangle
+	 */
+	ArrayView<uint32_t> getIndices() const;
+
+	/*
+	 * @brief get the octree nodes in preorder
+	 */
+	ArrayView<OctreeNode> getOctreeNodes() const;
+
+	/*
+	 * @brief get the triangle indices referenced by the octree nodes
+	 */
+	ArrayView<uint32_t> getOctreeTriangles() const;
+
+	/*
+	 * @brief get the bvh nodes in depth first order
+	 */
+	ArrayView<BvhNode> getBvhNodes() const;
+
+	/*
+	 * @brief get the triangle indices referenced by the bvh leaves
+	 */
+	ArrayView<uint32_t> getBvhTriangles() const;
+
+	/*
+	 * @brief get the depth of the octree
+	 */
+	int getOctreeDepth() const;
+
+	/*
+	 * @brief get the depth of the bvh
+	 */
+	int getBvhDepth() const;
+
+	/*
+	 * @brief write the cache file of a prepared mesh and its spatial indices
+	 */
+	static bool write(const std::string& path, uint64_t sourceStamp, uint64_t buildStamp,
+		const IndexedMesh& mesh, const Octree& octree, const Bvh& bvh);
+
+	/*
+	 * @brief get the path of the cache file kept next to a model
+	 */
+	static std::string getCachePath(const std::string& modelPath);
+
+	/*
+	 * @brief get the stamp of a model file from its size and modification time
+	 */
+	static uint64_t getSourceStamp(const std::string& modelPath);
+
+	/*
+	 * @brief FNV-1a hash of a block of bytes, continuing from seed
+	 */
+	static uint64_t hash(const void* data, size_t size, uint64_t seed = 0xCBF29CE484222325ull);
+
+private:
+	enum Section {
+		Positions,
+		Indices,
+		OctreeNodes,
+		OctreeTriangles,
+		BvhNodes,
+		BvhTriangles,
+		SectionCount
+	};
+
+	struct SectionEntry {
+		uint64_t offset;
+		uint64_t count;
+	};
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		/* sizes of the section elements, catching a layout change without a version bump */
+		uint32_t elementSizes[SectionCount];
+		uint64_t sourceStamp;
+		uint64_t buildStamp;
+		uint64_t fileSize;
+		int32_t octreeDepth;
+		int32_t bvhDepth;
+		SectionEntry sections[SectionCount];
+	};
+
+	const uint8_t* _data = nullptr;
+	size_t _size = 0;
+	/* platform handles of the mapping */
+	void* _file = nullptr;
+	void* _mapping = nullptr;
+
+	/*
+	 * @brief get the header at the start of the mapped file
+	 */
+	const Header& _getHeader() const {
+		return *reinterpret_cast<const Header*>(_data);
+	}
+
+	/*
+	 * @brief get a section of the mapped file
+	 */
+	template <typename T>
+	ArrayView<T> _getSection(Section section) const {
+		if (!_data) {
+			return ArrayView<T>();
+		}
+
+		const SectionEntry& entry = _getHeader().sections[section];
+		return ArrayView<T>(reinterpret_cast<const T*>(_data + entry.offset), static_cast<size_t>(entry.count));
+	}
+
+	/*
+	 * @brief check that every index and node range of the sections stays inside its target
+	 */
+	bool _validateSections() const;
+
+	/*
+	 * @brief get the size of one element of each section
+	 */
+	static void _getElementSizes(uint32_t* elementSizes);
+};
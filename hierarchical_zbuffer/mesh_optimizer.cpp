@@ -0,0 +1,162 @@
+#include <cstdint>
+#include <limits>
+
+#include "mesh_optimizer.h"
+
+/*
+ * @brief average number of vertex transforms per triangle with a FIFO post-transform cache
+ * @detail 0.5 is the ideal of a large regular grid, 3 means no vertex is ever reused
+ * @param indices vertex indices, every 3 form a triangle
+ * @param vertexCount number of vertices referenced by the indices
+ * @param cacheSize number of entries of the simulated cache
+ * @return cache misses per triangle, 0 for an empty mesh
+ */
+float computeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize) {
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return 0.0f;
+	}
+
+	// a vertex is cached while fewer than cacheSize misses happened since it was inserted
+	const size_t notCached = std::numeric_limits<size_t>::max();
+	std::vector<size_t> insertedAt(vertexCount, notCached);
+	size_t misses = 0;
+	for (uint32_t v : indices) {
+		if (insertedAt[v] == notCached || misses - insertedAt[v] >= cacheSize) {
+			insertedAt[v] = misses;
+			++misses;
+		}
+	}
+
+	return static_cast<float>(misses) / triangleCount;
+}
+
+
+/*
+ * @brief reorder the triangles for a FIFO post-transform cache with the Tipsify algorithm
+ * @detail the triangles around a fanning vertex are emitted together, the next fanning
+ *         vertex is the oldest neighbour that stays cached until its remaining triangles
+ *         are emitted, or the latest dead end. See Sander, Nehab and Barczak,
+ *         "Fast triangle reordering for vertex locality and reduced overdraw", 2007
+ * @param indices vertex indices, every 3 form a triangle, reordered in place
+ * @param vertexCount number of vertices referenced by the indices
+ * @param cacheSize number of entries of the targeted cache
+ */
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize) {
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// triangles around every vertex in one array, liveTriangles counts those not emitted yet
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (uint32_t v : indices) {
+		++liveTriangles[v];
+	}
+
+	std::vector<uint32_t> adjacencyOffset(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+	}
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> adjacencyEnd(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		for (int k = 0; k < 3; ++k) {
+			adjacency[adjacencyEnd[indices[3 * t + k]]++] = t;
+		}
+	}
+
+	// a vertex is cached while fewer than cacheSize misses happened since cacheTime
+	std::vector<size_t> cacheTime(vertexCount, 0);
+	size_t time = cacheSize + 1;
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	size_t cursor = 0;
+
+	int64_t fanning = 0;
+	while (fanning >= 0) {
+		candidates.clear();
+		for (uint32_t a = adjacencyOffset[fanning]; a < adjacencyOffset[fanning + 1]; ++a) {
+			const uint32_t t = adjacency[a];
+			if (emitted[t]) {
+				continue;
+			}
+
+			for (int k = 0; k < 3; ++k) {
+				const uint32_t v = indices[3 * t + k];
+				output.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				--liveTriangles[v];
+				if (time - cacheTime[v] > cacheSize) {
+					cacheTime[v] = time;
+					++time;
+				}
+			}
+			emitted[t] = 1;
+		}
+
+		// prefer the oldest candidate that is still cached after fanning its remaining triangles
+		fanning = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t v : candidates) {
+			if (liveTriangles[v] == 0) {
+				continue;
+			}
+
+			int64_t priority = 0;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+				priority = static_cast<int64_t>(time - cacheTime[v]);
+			}
+
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				fanning = v;
+			}
+		}
+
+		// dead end, continue at a recently used vertex or the next vertex in index order
+		while (fanning < 0 && !deadEnds.empty()) {
+			const uint32_t v = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveTriangles[v] > 0) {
+				fanning = v;
+			}
+		}
+
+		for (; fanning < 0 && cursor < vertexCount; ++cursor) {
+			if (liveTriangles[cursor] > 0) {
+				fanning = static_cast<int64_t>(cursor);
+			}
+		}
+	}
+
+	indices.swap(output);
+}
+
+
+/*
+ * @brief renumber the vertices in the order the triangles first use them
+ * @detail the transform and the triangle setup then read the vertex arrays almost
+ *         sequentially, vertices not referenced by any triangle are dropped
+ * @param mesh mesh to reorder in place
+ */
+void optimizeVertexFetch(IndexedMesh& mesh) {
+	const uint32_t unused = std::numeric_limits<uint32_t>::max();
+	std::vector<uint32_t> remap(mesh.positions.size(), unused);
+	std::vector<glm::vec3> positions;
+	positions.reserve(mesh.positions.size());
+	for (uint32_t& v : mesh.indices) {
+		if (remap[v] == unused) {
+			remap[v] = static_cast<uint32_t>(positions.size());
+			positions.push_back(mesh.positions[v]);
+		}
+		v = remap[v];
+	}
+
+	mesh.positions.swap(positions);
+}
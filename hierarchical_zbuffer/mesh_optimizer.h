@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+/*
+ * @brief average number of vertex transforms per triangle with a FIFO post-transform cache
+ * @detail 0.5 is the ideal of a large regular grid, 3 means no vertex is ever reused
+ */
+float computeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize);
+
+/*
+ * @brief reorder the triangles for a FIFO post-transform cache with the Tipsify algorithm
+ */
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, size_t cacheSize);
+
+/*
+ * @brief renumber the vertices in the order the triangles first use them
+ */
+void optimizeVertexFetch(IndexedMesh& mesh);
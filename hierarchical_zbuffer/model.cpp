@@ -1,39 +1,88 @@
 #include "model.h"
+#include "obj_loader.h"
+#include "thread_pool.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
 /*
  * @brief constructor, load info from the file
- * @detail use assimp parse the load format
+ * @detail use assimp parse the load format. Normals are only taken from the file and no
+ *         tangents are computed, the renderer shades flat from the positions. Builds
+ *         without assimp throw
  * @param filepath the model file path
  */
 Model::Model(const std::string& filepath) {
+#ifdef DISABLE_ASSIMP
+	throw std::runtime_error("cannot load " + filepath + ", only OBJ files are supported without assimp");
+#else
 	Assimp::Importer importer;
 	const aiScene* scene = importer.ReadFile(filepath,
-		aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+		aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_FlipUVs);
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
 		throw std::runtime_error(importer.GetErrorString());
 	}
 
 	_processNode(scene->mRootNode, scene);
+#endif
 }
 
 
 /*
  * @brief get all triangle faces in vertices - indices format
+ * @detail the indices of every mesh are offset past the vertices of the meshes before it
  * @param vertices of the triangle as output
  * @param vertex indices of the triangle face as output
  */
 void Model::getFaces(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
-	
 	for (const auto& mesh : _meshes) {
+		const uint32_t offset = static_cast<uint32_t>(vertices.size());
 		vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
-		indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+		for (uint32_t index : mesh.indices) {
+			indices.push_back(offset + index);
+		}
+	}
+}
+
+
+/*
+ * @brief get the positions and indices of all meshes as one indexed mesh
+ * @param mesh indexed mesh as output, appended to
+ */
+void Model::getIndexedMesh(IndexedMesh& mesh) {
+	std::vector<Vertex> vertices;
+	const uint32_t offset = static_cast<uint32_t>(mesh.positions.size());
+	const size_t firstIndex = mesh.indices.size();
+	getFaces(vertices, mesh.indices);
+	for (size_t i = firstIndex; i < mesh.indices.size(); ++i) {
+		mesh.indices[i] += offset;
+	}
+
+	mesh.positions.reserve(mesh.positions.size() + vertices.size());
+	for (const auto& vertex : vertices) {
+		mesh.positions.push_back(vertex.position);
 	}
 }
 
 
+/*
+ * @brief load only the positions and faces of a model file as one indexed mesh
+ * @detail OBJ files are parsed in parallel by loadObj, other formats go through assimp
+ * @param filepath the model file path
+ * @param mesh indexed mesh as output, appended to
+ */
+void Model::loadIndexedMesh(const std::string& filepath, IndexedMesh& mesh) {
+	if (isObjFile(filepath)) {
+		ThreadPool threadPool(ThreadPool::getDefaultThreadCount());
+		loadObj(filepath, mesh, threadPool);
+		return;
+	}
+
+	Model(filepath).getIndexedMesh(mesh);
+}
+
+
+#ifndef DISABLE_ASSIMP
 /*
  * @brief process the current aiNode and recursively process its children
  * @param node assimp node
@@ -54,10 +103,10 @@ void Model::_processNode(aiNode* node, const aiScene* scene) {
 /*
  * @brief process the mesh to get its vertex and texture
  * @param mesh assimp mesh stored in aiNode
- * @param scene assimp scene
+ * @param scene assimp scene, materials and textures are not read
  * @return class Mesh as defined
  */
-Mesh Model::_processMesh(aiMesh* mesh, const aiScene* scene) {
+Mesh Model::_processMesh(aiMesh* mesh, const aiScene* /*scene*/) {
 	std::vector<Vertex> vertices;
 	for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
 		Vertex vertex;
@@ -88,4 +137,5 @@ Mesh Model::_processMesh(aiMesh* mesh, const aiScene* scene) {
 	std::vector<Texture> textures;
 
 	return Mesh{ vertices, indices, textures };
-}
\ No newline at end of file
+}
+#endif
\ No newline at end of file
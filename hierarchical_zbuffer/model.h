@@ -5,15 +5,16 @@
 
 #include <glm/vec3.hpp>
 
-
+#ifndef DISABLE_ASSIMP
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#endif
 
 #include "mesh.h"
 #include "object3d.h"
 
-class Model: Object3D {
+class Model: public Object3D {
 public:
 	/*
 	 * @brief constructor, load info from the file
@@ -30,10 +31,21 @@ public:
 	 */
 	void getFaces(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
 
+	/*
+	 * @brief get the positions and indices of all meshes as one indexed mesh
+	 */
+	void getIndexedMesh(IndexedMesh& mesh);
+
+	/*
+	 * @brief load only the positions and faces of a model file as one indexed mesh
+	 */
+	static void loadIndexedMesh(const std::string& filepath, IndexedMesh& mesh);
+
 private:
 	std::vector<Mesh> _meshes;
 	std::vector<Texture> _textures;
 
+#ifndef DISABLE_ASSIMP
 	/*
 	 * @brief process the current aiNode and recursively process its children 
      */
@@ -44,4 +56,5 @@ private:
      * @brief process the mesh to get its vertex and texture
      */
 	Mesh _processMesh(aiMesh* mesh, const aiScene* scene);
+#endif
 };
\ No newline at end of file
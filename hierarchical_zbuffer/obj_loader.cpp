@@ -0,0 +1,404 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "obj_loader.h"
+
+namespace {
+	/* bytes read from the file at once */
+	const size_t readBlockSize = 16 << 20;
+
+	/* bytes of a block parsed by one task, cut at the next line end */
+	const size_t segmentSize = 1 << 20;
+
+	/* powers of ten that are exact in a double */
+	const double exactPowersOf10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	/*
+	 * @brief file data read at once, allocated without clearing it
+	 */
+	struct Block {
+		std::unique_ptr<char[]> data;
+		size_t capacity = 0;
+
+		void reserve(size_t size) {
+			if (size > capacity) {
+				data.reset(new char[size]);
+				capacity = size;
+			}
+		}
+	};
+
+	/*
+	 * @brief open file and the thread reading its next block
+	 * @detail the thread is joined before the file is closed, also when the parse throws,
+	 *         so it must not refer to anything destroyed before the reader
+	 */
+	struct BlockReader {
+		FILE* file = nullptr;
+		std::thread thread;
+		/* bytes read by the thread */
+		size_t readSize = 0;
+
+		~BlockReader() {
+			join();
+			if (file) {
+				std::fclose(file);
+			}
+		}
+
+		void join() {
+			if (thread.joinable()) {
+				thread.join();
+			}
+		}
+	};
+
+	/*
+	 * @brief lines of a block parsed by one task
+	 */
+	struct Segment {
+		const char* begin;
+		const char* end;
+		/* v lines and face triangles in the segment */
+		size_t vertexCount = 0;
+		size_t triangleCount = 0;
+		/* vertices of the file before the segment and its first index in the mesh */
+		size_t firstVertex = 0;
+		size_t firstIndex = 0;
+		/* largest vertex referenced and whether any index was 0 or before the first vertex */
+		int64_t maxVertex = -1;
+		bool invalid = false;
+	};
+
+	inline bool isBlank(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline bool isDigit(char c) {
+		return c >= '0' && c <= '9';
+	}
+
+	inline const char* skipBlanks(const char* p, const char* end) {
+		while (p < end && isBlank(*p)) {
+			++p;
+		}
+		return p;
+	}
+
+	inline const char* skipToken(const char* p, const char* end) {
+		while (p < end && !isBlank(*p)) {
+			++p;
+		}
+		return p;
+	}
+
+	/* line keyword, 'v' or 'f' if the line is a vertex or a face, 0 otherwise, line moves to the keyword */
+	inline char getLineType(const char*& line, const char* end) {
+		line = skipBlanks(line, end);
+		if (end - line >= 2 && (line[0] == 'v' || line[0] == 'f') && isBlank(line[1])) {
+			return line[0];
+		}
+		return 0;
+	}
+
+	/*
+	 * @brief parse a decimal float
+	 * @detail up to 19 significant digits are accumulated exactly and scaled by one power of
+	 *         ten, anything else such as inf or nan is left to strtof. The block is terminated
+	 *         by a 0 byte, so strtof cannot run past it
+	 */
+	const char* parseFloat(const char* p, const char* end, float& value) {
+		const char* start = p;
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) {
+			negative = *p == '-';
+			++p;
+		}
+
+		uint64_t mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		bool any = false;
+		for (; p < end && isDigit(*p); ++p, any = true) {
+			if (digits < 19) {
+				mantissa = 10 * mantissa + (*p - '0');
+				digits += mantissa > 0 ? 1 : 0;
+			} else {
+				++exponent;
+			}
+		}
+		if (p < end && *p == '.') {
+			for (++p; p < end && isDigit(*p); ++p, any = true) {
+				if (digits < 19) {
+					mantissa = 10 * mantissa + (*p - '0');
+					digits += mantissa > 0 ? 1 : 0;
+					--exponent;
+				}
+			}
+		}
+
+		if (!any) {
+			char* parsed = nullptr;
+			value = std::strtof(start, &parsed);
+			return std::min(std::max(static_cast<const char*>(parsed), start), end);
+		}
+
+		if (p < end && (*p == 'e' || *p == 'E')) {
+			const char* e = p + 1;
+			bool negativeExponent = false;
+			if (e < end && (*e == '-' || *e == '+')) {
+				negativeExponent = *e == '-';
+				++e;
+			}
+			if (e < end && isDigit(*e)) {
+				int exponentValue = 0;
+				for (; e < end && isDigit(*e); ++e) {
+					exponentValue = std::min(10 * exponentValue + (*e - '0'), 1000);
+				}
+				exponent += negativeExponent ? -exponentValue : exponentValue;
+				p = e;
+			}
+		}
+
+		double result = static_cast<double>(mantissa);
+		if (exponent < 0) {
+			result = -exponent <= 22 ? result / exactPowersOf10[-exponent] : result * std::pow(10.0, exponent);
+		} else if (exponent > 0) {
+			result = exponent <= 22 ? result * exactPowersOf10[exponent] : result * std::pow(10.0, exponent);
+		}
+		value = static_cast<float>(negative ? -result : result);
+		return p;
+	}
+
+	/*
+	 * @brief parse the vertex of a face corner v, v/vt, v//vn or v/vt/vn
+	 * @return false if the corner has no vertex index
+	 */
+	bool parseCorner(const char*& p, const char* end, int64_t& index) {
+		bool negative = false;
+		if (p < end && *p == '-') {
+			negative = true;
+			++p;
+		}
+		if (p >= end || !isDigit(*p)) {
+			p = skipToken(p, end);
+			return false;
+		}
+
+		index = 0;
+		for (; p < end && isDigit(*p); ++p) {
+			index = 10 * index + (*p - '0');
+		}
+		index = negative ? -index : index;
+		p = skipToken(p, end);
+		return true;
+	}
+
+	/* triangles of a face line with the given number of corners */
+	inline size_t getFaceTriangles(size_t corners) {
+		return corners >= 3 ? corners - 2 : 0;
+	}
+
+	/*
+	 * @brief count the vertices and face triangles of a segment
+	 */
+	void countSegment(Segment& segment) {
+		for (const char* line = segment.begin; line < segment.end;) {
+			const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', segment.end - line));
+			lineEnd = lineEnd ? lineEnd : segment.end;
+			const char type = getLineType(line, lineEnd);
+			if (type == 'v') {
+				++segment.vertexCount;
+			} else if (type == 'f') {
+				size_t corners = 0;
+				for (const char* p = skipBlanks(line + 1, lineEnd); p < lineEnd; p = skipBlanks(skipToken(p, lineEnd), lineEnd)) {
+					++corners;
+				}
+				segment.triangleCount += getFaceTriangles(corners);
+			}
+			line = lineEnd + 1;
+		}
+	}
+
+	/*
+	 * @brief parse the vertices and faces of a segment into the arrays at its offsets
+	 * @param baseVertex vertices in the mesh before the file
+	 */
+	void parseSegment(Segment& segment, glm::vec3* positions, uint32_t* indices, size_t baseVertex) {
+		glm::vec3* position = positions + segment.firstVertex;
+		uint32_t* index = indices + segment.firstIndex;
+		uint32_t* indexEnd = index + 3 * segment.triangleCount;
+		int64_t vertexCount = static_cast<int64_t>(segment.firstVertex);
+		std::vector<uint32_t> corners;
+		for (const char* line = segment.begin; line < segment.end;) {
+			const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', segment.end - line));
+			lineEnd = lineEnd ? lineEnd : segment.end;
+			const char type = getLineType(line, lineEnd);
+			if (type == 'v') {
+				glm::vec3 p(0.0f);
+				const char* q = line + 1;
+				for (int axis = 0; axis < 3; ++axis) {
+					q = parseFloat(skipBlanks(q, lineEnd), lineEnd, p[axis]);
+				}
+				*position++ = p;
+				++vertexCount;
+			} else if (type == 'f') {
+				corners.clear();
+				for (const char* p = skipBlanks(line + 1, lineEnd); p < lineEnd; p = skipBlanks(p, lineEnd)) {
+					int64_t corner = 0;
+					if (!parseCorner(p, lineEnd, corner) || corner == 0 || vertexCount + corner < 0) {
+						segment.invalid = true;
+						corner = 1;
+					}
+					const int64_t vertex = corner > 0 ? corner - 1 : vertexCount + corner;
+					segment.maxVertex = std::max(segment.maxVertex, vertex);
+					corners.push_back(static_cast<uint32_t>(baseVertex + vertex));
+				}
+
+				for (size_t i = 1; i + 1 < corners.size() && index < indexEnd; ++i) {
+					*index++ = corners[0];
+					*index++ = corners[i];
+					*index++ = corners[i + 1];
+				}
+			}
+			line = lineEnd + 1;
+		}
+	}
+}
+
+/*
+ * @brief load the positions and faces of a Wavefront OBJ file, appended to mesh
+ * @detail a block is cut into segments at line ends, the segments count their vertices and
+ *         triangles in parallel, the arrays grow once by the block totals and the segments
+ *         parse in parallel into their ranges. Meanwhile a thread reads the next block
+ *         behind the incomplete last line of the current one. Relative indices are resolved
+ *         by the vertex count before each segment, so the result matches a sequential parse
+ * @param path path of the OBJ file
+ * @param mesh positions and indices as output, appended to
+ * @param threadPool threads parsing the segments
+ * @throw std::runtime_error if the file cannot be read or a face references a missing vertex
+ */
+void loadObj(const std::string& path, IndexedMesh& mesh, ThreadPool& threadPool) {
+	// the blocks outlive the reader, which may still read into one
+	Block blocks[2];
+	BlockReader reader;
+	reader.file = std::fopen(path.c_str(), "rb");
+	if (!reader.file) {
+		throw std::runtime_error("cannot open " + path);
+	}
+
+	const size_t baseVertex = mesh.positions.size();
+	size_t fileVertices = 0;
+	int64_t maxVertex = -1;
+	bool invalid = false;
+
+	// one spare byte behind the data for the terminating 0
+	blocks[0].reserve(readBlockSize + 1);
+	size_t blockSize = std::fread(blocks[0].data.get(), 1, readBlockSize, reader.file);
+	bool endOfFile = blockSize < readBlockSize;
+	std::vector<Segment> segments;
+	for (int current = 0; blockSize > 0; current ^= 1) {
+		char* block = blocks[current].data.get();
+		block[blockSize] = '\0';
+
+		// the incomplete last line moves to the front of the next block
+		size_t parsedSize = blockSize;
+		if (!endOfFile) {
+			const char* lastLineEnd = block + blockSize;
+			while (lastLineEnd > block && lastLineEnd[-1] != '\n') {
+				--lastLineEnd;
+			}
+			parsedSize = lastLineEnd - block;
+		}
+		const size_t carrySize = blockSize - parsedSize;
+		blocks[current ^ 1].reserve(carrySize + readBlockSize + 1);
+		char* next = blocks[current ^ 1].data.get();
+		std::memcpy(next, block + parsedSize, carrySize);
+
+		reader.readSize = 0;
+		if (!endOfFile) {
+			reader.thread = std::thread([&reader, next, carrySize]() {
+				reader.readSize = std::fread(next + carrySize, 1, readBlockSize, reader.file);
+			});
+		}
+
+		segments.clear();
+		const char* blockEnd = block + parsedSize;
+		for (const char* begin = block; begin < blockEnd;) {
+			const char* end = begin + std::min(segmentSize, static_cast<size_t>(blockEnd - begin));
+			while (end < blockEnd && end[-1] != '\n') {
+				++end;
+			}
+			segments.emplace_back();
+			segments.back().begin = begin;
+			segments.back().end = end;
+			begin = end;
+		}
+
+		threadPool.parallelFor(segments.size(), [&](size_t index, size_t) {
+			countSegment(segments[index]);
+		});
+
+		size_t vertexOffset = mesh.positions.size() - baseVertex;
+		size_t indexOffset = mesh.indices.size();
+		for (auto& segment : segments) {
+			segment.firstVertex = vertexOffset;
+			segment.firstIndex = indexOffset;
+			vertexOffset += segment.vertexCount;
+			indexOffset += 3 * segment.triangleCount;
+		}
+		mesh.positions.resize(baseVertex + vertexOffset);
+		mesh.indices.resize(indexOffset);
+
+		glm::vec3* positions = mesh.positions.data() + baseVertex;
+		uint32_t* indices = mesh.indices.data();
+		threadPool.parallelFor(segments.size(), [&](size_t index, size_t) {
+			parseSegment(segments[index], positions, indices, baseVertex);
+		});
+		for (const auto& segment : segments) {
+			maxVertex = std::max(maxVertex, segment.maxVertex);
+			invalid = invalid || segment.invalid;
+		}
+		fileVertices = vertexOffset;
+
+		reader.join();
+		endOfFile = endOfFile || reader.readSize < readBlockSize;
+		blockSize = carrySize + reader.readSize;
+	}
+
+	if (std::ferror(reader.file)) {
+		throw std::runtime_error("cannot read " + path);
+	}
+	if (invalid || maxVertex >= static_cast<int64_t>(fileVertices)) {
+		throw std::runtime_error("face references a missing vertex in " + path);
+	}
+}
+
+
+/*
+ * @brief check whether the file is loaded by loadObj, by its extension
+ * @param path path of the model file
+ * @return true for a .obj file in any letter case
+ */
+bool isObjFile(const std::string& path) {
+	if (path.size() < 4) {
+		return false;
+	}
+
+	std::string extension = path.substr(path.size() - 4);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) {
+		return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+	});
+	return extension == ".obj";
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+#include "mesh.h"
+#include "thread_pool.h"
+
+/*
+ * @brief load the positions and faces of a Wavefront OBJ file, appended to mesh
+ * @detail the file is read in large blocks, the next block is read while the current one
+ *         is parsed in parallel segments straight into the position and index arrays.
+ *         Only v and f lines are read, polygons are split into triangle fans
+ */
+void loadObj(const std::string& path, IndexedMesh& mesh, ThreadPool& threadPool);
+
+/*
+ * @brief check whether the file is loaded by loadObj, by its extension
+ */
+bool isObjFile(const std::string& path);
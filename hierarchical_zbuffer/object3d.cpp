@@ -1,13 +1,105 @@
 #include <cassert>
 #include <cmath>
+#include <utility>
+#include <vector>
 
 #include "object3d.h"
 
 
+/*
+ * @brief default constructor, the transform lives in the transform system of the process
+ */
+Object3D::Object3D(): Object3D(TransformSystem::getInstance()) { }
+
+
 /*
  * @brief constructor with specified name
  */
-Object3D::Object3D(std::string name): _name(name) { }
+Object3D::Object3D(std::string name): Object3D(TransformSystem::getInstance(), name) { }
+
+
+/*
+ * @brief constructor with the transform system to create the transform in
+ * @param transforms system holding the transform, must outlive the object
+ * @param name name of the object
+ */
+Object3D::Object3D(TransformSystem& transforms, std::string name)
+	: _name(name), _transforms(&transforms), _handle(transforms.create(this)) { }
+
+
+/*
+ * @brief copy constructor, copies the name and the local transform but not the hierarchy
+ * @detail the copy is created in the transform system of rhs
+ * @param rhs object to copy
+ */
+Object3D::Object3D(const Object3D& rhs): Object3D(*rhs._transforms, rhs._name) {
+	setLocalScale(rhs.getLocalScale());
+	setLocalRotation(rhs.getLocalRotation());
+	setLocalPosition(rhs.getLocalPosition());
+}
+
+
+/*
+ * @brief move constructor, takes over the transform
+ * @param rhs object to move, left without a transform
+ */
+Object3D::Object3D(Object3D&& rhs) noexcept
+	: _name(std::move(rhs._name)), _transforms(rhs._transforms), _handle(rhs._handle) {
+	rhs._handle = TransformSystem::invalid;
+	if (_handle != TransformSystem::invalid) {
+		_transforms->setOwner(_handle, this);
+	}
+}
+
+
+/*
+ * @brief copy assignment, copies the name and the local transform but not the hierarchy
+ * @param rhs object to copy
+ * @return reference to the object
+ */
+Object3D& Object3D::operator=(const Object3D& rhs) {
+	if (this != &rhs) {
+		_name = rhs._name;
+		setLocalScale(rhs.getLocalScale());
+		setLocalRotation(rhs.getLocalRotation());
+		setLocalPosition(rhs.getLocalPosition());
+	}
+
+	return *this;
+}
+
+
+/*
+ * @brief move assignment, destroys the own transform and takes over the one of rhs
+ * @param rhs object to move, left without a transform
+ * @return reference to the object
+ */
+Object3D& Object3D::operator=(Object3D&& rhs) noexcept {
+	if (this != &rhs) {
+		if (_handle != TransformSystem::invalid) {
+			_transforms->destroy(_handle);
+		}
+		_name = std::move(rhs._name);
+		_transforms = rhs._transforms;
+		_handle = rhs._handle;
+		rhs._handle = TransformSystem::invalid;
+		if (_handle != TransformSystem::invalid) {
+			_transforms->setOwner(_handle, this);
+		}
+	}
+
+	return *this;
+}
+
+
+/*
+ * @brief destructor, destroys the transform, the children become roots
+ */
+Object3D::~Object3D() {
+	if (_handle != TransformSystem::invalid) {
+		_transforms->destroy(_handle);
+	}
+}
 
 
 /*
@@ -32,37 +124,24 @@ void Object3D::setName(std::string name) {
  * @return the parent of the object or nullptr if no parent
  */
 Object3D* Object3D::getParent() const {
-	return _parent;
+	const uint32_t parent = _transforms->getParent(_handle);
+	return parent == TransformSystem::invalid ? nullptr : _transforms->getOwner(parent);
 }
 
 
 /*
  * @brief set the parent of the object
  * @param parent parent of the object, can be nullptr to detach from the parent
+ *        must live in the same transform system, a descendant of the object is ignored
  * @todo maintain the world postion/rotation/scale of the object
  */
 void Object3D::setParent(Object3D* parent, bool stayInWorld) {
-	// check whether the object is already a child of the parent
-	if (parent) {
-		for (auto child : parent->_children) {
-			if (child == this) {
-				return;
-			}
-		}
-	}
-	
 	if (stayInWorld) {
 		assert("TODO: maintain the world postion/rotation/scale of the object");
 	}
 
-	// remove relation from the current parent
-	if (_parent) {
-		_parent->_children.remove(this);
-	}
-
-	parent->_children.push_back(this);
-
-	_parent = parent;
+	assert(!parent || parent->_transforms == _transforms);
+	_transforms->setParent(_handle, parent ? parent->_handle : TransformSystem::invalid);
 }
 
 
@@ -71,7 +150,7 @@ void Object3D::setParent(Object3D* parent, bool stayInWorld) {
  * @return the number of the child of the object
  */
 uint32_t Object3D::childCount() const {
-	return static_cast<uint32_t>(_children.size());
+	return _transforms->getChildCount(_handle);
 }
 
 
@@ -80,18 +159,25 @@ uint32_t Object3D::childCount() const {
  * @return the pointer the the child object
  */
 Object3D* Object3D::getChild(int index) const {
-	auto it = _children.begin();
-	std::advance(it, index);
-	return *it;
+	std::vector<uint32_t> children;
+	_transforms->getChildren(_handle, children);
+	return _transforms->getOwner(children[index]);
 }
 
 
 /*
  * @brief get all children of the object
- * @return the list of 
+ * @return the list of the children in the order of the transform system
  */
 std::list<Object3D*> Object3D::getChildren() const {
-	return _children;
+	std::vector<uint32_t> handles;
+	_transforms->getChildren(_handle, handles);
+	std::list<Object3D*> children;
+	for (uint32_t child : handles) {
+		children.push_back(_transforms->getOwner(child));
+	}
+
+	return children;
 }
 
 
@@ -100,7 +186,7 @@ std::list<Object3D*> Object3D::getChildren() const {
  * @return the world/local position of the object
  */
 glm::vec3 Object3D::getLocalPosition() const {
-	return _localPosition;
+	return _transforms->getLocalPosition(_handle);
 }
 
 
@@ -109,40 +195,46 @@ glm::vec3 Object3D::getLocalPosition() const {
  * @param postion local position corresponding to parent
  */
 void Object3D::setLocalPosition(const glm::vec3& position) {
-	_localPosition = position;
+	_transforms->setLocalPosition(_handle, position);
 }
 
 
 /*
  * @brief get the world position of the object
+ * @detail the origin of the object in the world, the local position is not transformed by
+ *         the model matrix a second time
  * @return the world position of the object
  */
 glm::vec3 Object3D::getWorldPosition() const {
-	// the result of glm::vec4 will be (x, y, z, 1.0f)
-	// glm::vec3 use the x, y, z of the glm::vec4 to consturct self
-	return getModelMatrix() * glm::vec4(_localPosition, 1.0f);
+	// the origin of the object in the world is the translation column of the model matrix
+	return glm::vec3(getModelMatrix()[3]);
 }
 
 
 /*
  * @brief set the world position of the object
+ * @detail the local position is applied after the local scale and rotation, so the target
+ *         is brought back through the parent, the rotation and the scale instead of the
+ *         inverse model matrix, getWorldPosition then returns the position set
  * @param position world position of 3 dimension
  */
 void Object3D::setWorldPosition(const glm::vec3& position) {
-	_localPosition = glm::vec3(getModelMatrixInverse() * glm::vec4(position, 1.0f));
+	setLocalPosition(_toLocalTranslation(glm::vec4(position, 1.0f)));
 }
 
 
 /*
  * @brief translate object with world/local translation
+ * @detail a world translation is brought to the local position like in setWorldPosition,
+ *         so the world position moves by exactly the translation
  * @param translation 3d vector of the movement in world/local space
  * @param space world/local space of the translation
  */
 void Object3D::translate(const glm::vec3& translation, enum Space space) {
 	if (space == Space::Local) {
-		_localPosition += translation;
+		setLocalPosition(getLocalPosition() + translation);
 	} else {
-		_localPosition += glm::vec3(getModelMatrixInverse() * glm::vec4(translation, 0.0f));
+		setLocalPosition(getLocalPosition() + _toLocalTranslation(glm::vec4(translation, 0.0f)));
 	}
 }
 
@@ -152,7 +244,7 @@ void Object3D::translate(const glm::vec3& translation, enum Space space) {
  * @return the local rotation of the object in quaternion
  */
 glm::quat Object3D::getLocalRotation() const {
-	return _localRotation;
+	return _transforms->getLocalRotation(_handle);
 }
 
 
@@ -161,7 +253,7 @@ glm::quat Object3D::getLocalRotation() const {
  * @return the local rotation of the object in quaternion
  */
 void Object3D::setLocalRotation(const glm::quat& rotation) {
-	_localRotation = rotation;
+	_transforms->setLocalRotation(_handle, rotation);
 }
 
 
@@ -176,7 +268,7 @@ void Object3D::setLocalRotation(const glm::quat& rotation) {
  * @see https://blog.csdn.net/hzwwpgmwy/article/details/101547949
  */
 glm::vec3 Object3D::getLocalEulerAngles(enum RotateOrder order) const {
-	return quaternionToEulerAngles(_localRotation, order);
+	return quaternionToEulerAngles(getLocalRotation(), order);
 }
 
 
@@ -192,7 +284,7 @@ glm::vec3 Object3D::getLocalEulerAngles(enum RotateOrder order) const {
  */
 void Object3D::setLocalEulerAngles(const glm::vec3& eulerAngles, enum RotateOrder order) {
 	glm::quat q = eulerAnglesToQuaternion(eulerAngles, order);
-	_localRotation = q * _localRotation;
+	setLocalRotation(q * getLocalRotation());
 }
 
 
@@ -203,7 +295,7 @@ void Object3D::setLocalEulerAngles(const glm::vec3& eulerAngles, enum RotateOrde
  * @todo add world space rotate support
  */
 void Object3D::rotate(const glm::vec3& axis, float angle) {
-	_localRotation = glm::angleAxis(angle, axis) * _localRotation;
+	setLocalRotation(glm::angleAxis(angle, axis) * getLocalRotation());
 }
 
 
@@ -217,7 +309,7 @@ void Object3D::rotate(const glm::vec3& axis, float angle) {
  * @todo add world space rotate support
  */
 void Object3D::rotate(const glm::vec3& eulerAngles, const enum RotateOrder order) {
-	_localRotation = eulerAnglesToQuaternion(eulerAngles, order) * _localRotation;
+	setLocalRotation(eulerAnglesToQuaternion(eulerAngles, order) * getLocalRotation());
 }
 
 
@@ -226,7 +318,7 @@ void Object3D::rotate(const glm::vec3& eulerAngles, const enum RotateOrder order
  * @return the local scale of the object in glm::vec3
  */
 glm::vec3 Object3D::getLocalScale() const {
-		return _localScale;
+	return _transforms->getLocalScale(_handle);
 }
 
 
@@ -235,33 +327,61 @@ glm::vec3 Object3D::getLocalScale() const {
  * @param scale local scale of the object
  */
 void Object3D::setLocalScale(const glm::vec3& scale) {
-	_localScale = scale;
+	_transforms->setLocalScale(_handle, scale);
 }
 
 
 /*
  * @brief get model matrix of the object
+ * @detail cached by the transform system, the parent model matrix times the local one
  * @return model matrix to transform the object from local to world space
  */
-glm::mat4x4 Object3D::getModelMatrix() const {
-	glm::mat4x4 m(1.0f);
-
-	for (Object3D* obj = const_cast<Object3D*>(this); obj; obj = obj->_parent) {
-		m = glm::scale(m, obj->_localScale);
-		m = glm::mat4_cast(obj->_localRotation) * m;
-		m = glm::translate(m, obj->_localPosition);
-	}
-	
-	return m;
+const glm::mat4x4& Object3D::getModelMatrix() const {
+	return _transforms->getWorldMatrix(_handle);
 }
 
 
 /*
  * @brief get model matrix inverse of the object
+ * @detail cached by the transform system next to the model matrix
  * @return model matrix inverse to transform the object from world to local space
  */
-glm::mat4x4 Object3D::getModelMatrixInverse() const {
-	return glm::inverse(getModelMatrix());
+const glm::mat4x4& Object3D::getModelMatrixInverse() const {
+	return _transforms->getWorldMatrixInverse(_handle);
+}
+
+
+/*
+ * @brief get the transform system holding the transform of the object
+ * @return transform system
+ */
+TransformSystem& Object3D::getTransformSystem() const {
+	return *_transforms;
+}
+
+
+/*
+ * @brief get the handle of the transform of the object in its system
+ * @return handle of the transform
+ */
+uint32_t Object3D::getHandle() const {
+	return _handle;
+}
+
+
+/*
+ * @brief bring a world point or direction to the space the local position lives in
+ * @param world point with w = 1 or direction with w = 0 in world space
+ * @return world value before the local scale and rotation are applied
+ */
+glm::vec3 Object3D::_toLocalTranslation(const glm::vec4& world) const {
+	glm::vec4 v = world;
+	const uint32_t parent = _transforms->getParent(_handle);
+	if (parent != TransformSystem::invalid) {
+		v = _transforms->getWorldMatrixInverse(parent) * v;
+	}
+
+	return glm::vec3(glm::conjugate(getLocalRotation()) * glm::vec3(v)) / getLocalScale();
 }
 
 
@@ -13,6 +13,13 @@
 #include <glm/mat4x4.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "transform_system.h"
+
+/**
+ * @brief handle to a transform stored in a transform system
+ * @detail the object only keeps its name, the local transform, the hierarchy and the cached
+ *         world matrices live in the arrays of the system, see TransformSystem
+ */
 class Object3D {
 public:
 	/* 
@@ -31,19 +38,44 @@ public:
 	};
 
 	/*
-	 * @brief default constructor
+	 * @brief default constructor, the transform lives in the transform system of the process
 	 */
-	Object3D() = default;
+	Object3D();
 
 	/*
 	 * @brief constructor with specified name
 	 */
 	explicit Object3D(std::string name);
-	
+
 	/*
-     * @brief default destructor
-     */
-	~Object3D() = default;
+	 * @brief constructor with the transform system to create the transform in
+	 */
+	explicit Object3D(TransformSystem& transforms, std::string name = "");
+
+	/*
+	 * @brief copy constructor, copies the name and the local transform but not the hierarchy
+	 */
+	Object3D(const Object3D& rhs);
+
+	/*
+	 * @brief move constructor, takes over the transform
+	 */
+	Object3D(Object3D&& rhs) noexcept;
+
+	/*
+	 * @brief copy assignment, copies the name and the local transform but not the hierarchy
+	 */
+	Object3D& operator=(const Object3D& rhs);
+
+	/*
+	 * @brief move assignment, destroys the own transform and takes over the one of rhs
+	 */
+	Object3D& operator=(Object3D&& rhs) noexcept;
+
+	/*
+	 * @brief destructor, destroys the transform, the children become roots
+	 */
+	~Object3D();
 
 	/*
 	 * @brief get the name of the object
@@ -162,12 +194,22 @@ public:
 	/*
 	 * @brief get model matrix of the object
 	 */
-	glm::mat4x4 getModelMatrix() const;
+	const glm::mat4x4& getModelMatrix() const;
 
 	/*
 	 * @brief get model matrix inverse of the object
 	 */
-	glm::mat4x4 getModelMatrixInverse() const;
+	const glm::mat4x4& getModelMatrixInverse() const;
+
+	/*
+	 * @brief get the transform system holding the transform of the object
+	 */
+	TransformSystem& getTransformSystem() const;
+
+	/*
+	 * @brief get the handle of the transform of the object in its system
+	 */
+	uint32_t getHandle() const;
 
 	/*
 	 * @brief transform euler angles to quaternion
@@ -182,14 +224,13 @@ public:
 protected:
 	/* name of the object */
 	std::string _name;
-	/* local position of the object */
-	glm::vec3 _localPosition = glm::vec3(0.0f, 0.0f, 0.0f);
-	/* local rotation of the object */
-	glm::quat _localRotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
-	/* local scale of the object */
-	glm::vec3 _localScale = glm::vec3(1.0f, 1.0f, 1.0f);
-	/* relationship:parent */
-	Object3D* _parent = nullptr;
-	/* relationship children */
-	std::list<Object3D*> _children;
+	/* system holding the local transform, the relationship and the world matrices */
+	TransformSystem* _transforms;
+	/* handle of the transform, invalid once moved from */
+	uint32_t _handle;
+
+	/*
+	 * @brief bring a world point or direction to the space the local position lives in
+	 */
+	glm::vec3 _toLocalTranslation(const glm::vec4& world) const;
 };
\ No newline at end of file
@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <cfloat>
+
+#include <glm/common.hpp>
+
+#include "octree.h"
+
+namespace {
+	/* triangles handled by one task of the parallel build */
+	const size_t buildChunkSize = 16384;
+
+	/* deepest level whose cell code and level still fit a 64 bit sort key */
+	const int maxLevel = 19;
+
+	/* low bits of a sort key holding the level of the cell */
+	const int levelBits = 5;
+
+	/* key bits sorted by one radix sort pass */
+	const int radixBits = 8;
+	const size_t radixSize = size_t(1) << radixBits;
+
+	/* spread the low 21 bits of v to every third bit */
+	inline uint64_t spreadBits(uint64_t v) {
+		v &= 0x00000000001FFFFF;
+		v = (v | (v << 32)) & 0x001F00000000FFFF;
+		v = (v | (v << 16)) & 0x001F0000FF0000FF;
+		v = (v | (v << 8)) & 0x100F00F00F00F00F;
+		v = (v | (v << 4)) & 0x10C30C30C30C30C3;
+		v = (v | (v << 2)) & 0x1249249249249249;
+		return v;
+	}
+
+	/* level of the cell in a sort key */
+	inline int getKeyLevel(uint64_t key) {
+		return static_cast<int>(key & ((1u << levelBits) - 1));
+	}
+}
+
+/*
+ * @brief build the tree over the triangles of the mesh
+ * @detail the root cell is the bounding cube of all triangles, split into a grid of
+ *         2^maxDepth cells per axis. The cell of a triangle is given by the common prefix
+ *         of the Morton codes of its bounding box corners in that grid, so each triangle
+ *         is placed independently and the placement runs in parallel. The keys are the
+ *         cell codes padded to maxDepth levels followed by the level, which orders a cell
+ *         before its children and the children by octant, i.e. the preorder of the tree
+ * @param mesh world space mesh, node triangle indices refer to its triangles
+ * @param config build parameters
+ * @param threadPool threads computing and sorting the keys
+ */
+void Octree::build(const IndexedMesh& mesh, const Config& config, ThreadPool& threadPool) {
+	const size_t triangleCount = mesh.indices.size() / 3;
+	const size_t chunkCount = (triangleCount + buildChunkSize - 1) / buildChunkSize;
+	_config = config;
+	_config.maxDepth = std::min(std::max(_config.maxDepth, 0), maxLevel);
+	_depth = 0;
+	_nodes.clear();
+	_triangleIndices.resize(triangleCount);
+	_triangleMin.resize(triangleCount);
+	_triangleMax.resize(triangleCount);
+	_keys.resize(triangleCount);
+	_chunkMin.assign(chunkCount, glm::vec3(FLT_MAX));
+	_chunkMax.assign(chunkCount, glm::vec3(-FLT_MAX));
+
+	threadPool.parallelFor(chunkCount, [&](size_t chunk, size_t) {
+		const size_t end = std::min(triangleCount, (chunk + 1) * buildChunkSize);
+		for (size_t i = chunk * buildChunkSize; i < end; ++i) {
+			const glm::vec3& p0 = mesh.positions[mesh.indices[3 * i]];
+			const glm::vec3& p1 = mesh.positions[mesh.indices[3 * i + 1]];
+			const glm::vec3& p2 = mesh.positions[mesh.indices[3 * i + 2]];
+			_triangleMin[i] = glm::min(glm::min(p0, p1), p2);
+			_triangleMax[i] = glm::max(glm::max(p0, p1), p2);
+			_chunkMin[chunk] = glm::min(_chunkMin[chunk], _triangleMin[i]);
+			_chunkMax[chunk] = glm::max(_chunkMax[chunk], _triangleMax[i]);
+		}
+	});
+
+	if (triangleCount == 0) {
+		_nodeView = _nodes;
+		_triangleView = _triangleIndices;
+		return;
+	}
+
+	glm::vec3 sceneMin(FLT_MAX), sceneMax(-FLT_MAX);
+	for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+		sceneMin = glm::min(sceneMin, _chunkMin[chunk]);
+		sceneMax = glm::max(sceneMax, _chunkMax[chunk]);
+	}
+
+	const int maxDepth = _config.maxDepth;
+	const glm::vec3 extent = sceneMax - sceneMin;
+	const glm::vec3 center = 0.5f * (sceneMin + sceneMax);
+	const float halfSize = 0.5f * std::max(std::max(extent.x, extent.y), extent.z);
+	const glm::vec3 cubeMin = center - glm::vec3(halfSize);
+	const uint32_t gridSize = 1u << maxDepth;
+	const float scale = halfSize > 0.0f ? gridSize / (2.0f * halfSize) : 0.0f;
+	threadPool.parallelFor(chunkCount, [&](size_t chunk, size_t) {
+		const size_t end = std::min(triangleCount, (chunk + 1) * buildChunkSize);
+		for (size_t i = chunk * buildChunkSize; i < end; ++i) {
+			uint32_t lo[3], differing = 0;
+			for (int axis = 0; axis < 3; ++axis) {
+				const float a = std::max((_triangleMin[i][axis] - cubeMin[axis]) * scale, 0.0f);
+				const float b = std::max((_triangleMax[i][axis] - cubeMin[axis]) * scale, 0.0f);
+				lo[axis] = std::min(static_cast<uint32_t>(a), gridSize - 1);
+				differing |= lo[axis] ^ std::min(static_cast<uint32_t>(b), gridSize - 1);
+			}
+
+			int shift = 0;
+			while (differing >> shift) {
+				++shift;
+			}
+
+			const uint64_t code = spreadBits(lo[0] >> shift) | (spreadBits(lo[1] >> shift) << 1) | (spreadBits(lo[2] >> shift) << 2);
+			_keys[i] = (code << (3 * shift + levelBits)) | static_cast<uint64_t>(maxDepth - shift);
+			_triangleIndices[i] = static_cast<uint32_t>(i);
+		}
+	});
+
+	_sortKeys(threadPool, 3 * maxDepth + levelBits);
+	_buildNode(getRootLocCode(), center, halfSize, 0, static_cast<uint32_t>(triangleCount), 0);
+	_nodeView = _nodes;
+	_triangleView = _triangleIndices;
+}
+
+
+/*
+ * @brief use a tree built before and stored elsewhere, it must outlive this one
+ * @detail the arrays are used in place, which turns loading a cached tree into a lookup
+ * @param config parameters the tree was built with
+ * @param depth depth of the deepest node
+ * @param nodes nodes in preorder, the root at index 0
+ * @param triangleIndices triangle indices referenced by the nodes
+ */
+void Octree::assign(const Config& config, int depth, ArrayView<OctreeNode> nodes, ArrayView<uint32_t> triangleIndices) {
+	_config = config;
+	_depth = depth;
+	_nodes.clear();
+	_triangleIndices.clear();
+	_nodeView = nodes;
+	_triangleView = triangleIndices;
+}
+
+
+/*
+ * @brief get the level of the cell, the root is at level 0
+ * @param locCode location code of the cell
+ * @return level of the cell
+ */
+int Octree::getNodeTreeDepth(uint64_t locCode) {
+	int depth = 0;
+	while (locCode >= 8) {
+		locCode >>= 3;
+		++depth;
+	}
+	return depth;
+}
+
+
+/*
+ * @brief get all nodes, the root is at index 0
+ * @return the node array, empty if no triangle is in the tree
+ */
+ArrayView<OctreeNode> Octree::getNodes() const {
+	return _nodeView;
+}
+
+
+/*
+ * @brief get the triangle indices referenced by the nodes
+ * @return the triangle index array
+ */
+ArrayView<uint32_t> Octree::getTriangleIndices() const {
+	return _triangleView;
+}
+
+
+/*
+ * @brief get the parameters of the last build
+ * @return build parameters
+ */
+const Octree::Config& Octree::getConfig() const {
+	return _config;
+}
+
+
+/*
+ * @brief get the deepest level reached by the last build
+ * @return depth of the deepest node, the root is at level 0
+ */
+int Octree::getDepth() const {
+	return _depth;
+}
+
+
+/*
+ * @brief sort _keys and _triangleIndices by the low keyBits bits of the keys
+ * @detail least significant digit first radix sort. Every chunk counts its digits, the
+ *         counts are summed digit by digit and chunk by chunk into scatter offsets, so
+ *         each pass is stable and the chunks scatter in parallel. A pass whose digit is
+ *         the same for all keys is skipped
+ * @param threadPool threads counting and scattering the chunks
+ * @param keyBits significant low bits of the keys
+ */
+void Octree::_sortKeys(ThreadPool& threadPool, int keyBits) {
+	const size_t count = _keys.size();
+	const size_t chunkCount = (count + buildChunkSize - 1) / buildChunkSize;
+	_sortedKeys.resize(count);
+	_sortedTriangles.resize(count);
+	_histograms.resize(chunkCount * radixSize);
+
+	for (int shift = 0; shift < keyBits; shift += radixBits) {
+		std::fill(_histograms.begin(), _histograms.end(), 0);
+		threadPool.parallelFor(chunkCount, [&](size_t chunk, size_t) {
+			uint32_t* histogram = &_histograms[chunk * radixSize];
+			const size_t end = std::min(count, (chunk + 1) * buildChunkSize);
+			for (size_t i = chunk * buildChunkSize; i < end; ++i) {
+				++histogram[(_keys[i] >> shift) & (radixSize - 1)];
+			}
+		});
+
+		uint32_t offset = 0;
+		bool sorted = false;
+		for (size_t digit = 0; digit < radixSize && !sorted; ++digit) {
+			for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+				const uint32_t digitCount = _histograms[chunk * radixSize + digit];
+				_histograms[chunk * radixSize + digit] = offset;
+				offset += digitCount;
+			}
+			sorted = offset == count && _histograms[digit] == 0;
+		}
+		if (sorted) {
+			continue;
+		}
+
+		threadPool.parallelFor(chunkCount, [&](size_t chunk, size_t) {
+			uint32_t* offsets = &_histograms[chunk * radixSize];
+			const size_t end = std::min(count, (chunk + 1) * buildChunkSize);
+			for (size_t i = chunk * buildChunkSize; i < end; ++i) {
+				const uint32_t target = offsets[(_keys[i] >> shift) & (radixSize - 1)]++;
+				_sortedKeys[target] = _keys[i];
+				_sortedTriangles[target] = _triangleIndices[i];
+			}
+		});
+		_keys.swap(_sortedKeys);
+		_triangleIndices.swap(_sortedTriangles);
+	}
+}
+
+
+/*
+ * @brief create the node of the cell over a range of the sorted triangles
+ * @detail the range starts with the triangles whose cell is this one, followed by the
+ *         ranges of the children in octant order. A cell at maxDepth or with at most
+ *         leafSize triangles is not split and keeps the whole range
+ * @param locCode location code of the cell
+ * @param center center of the cubic cell
+ * @param halfSize half edge length of the cell
+ * @param begin first triangle of the cell in the sorted triangle index array
+ * @param end one past the last triangle of the cell
+ * @param depth level of the node
+ * @return index of the created node
+ */
+int32_t Octree::_buildNode(uint64_t locCode, const glm::vec3& center, float halfSize, uint32_t begin, uint32_t end, int depth) {
+	const int32_t index = static_cast<int32_t>(_nodes.size());
+	_nodes.emplace_back();
+	_depth = std::max(_depth, depth);
+
+	uint32_t ownEnd = end;
+	if (depth < _config.maxDepth && end - begin > static_cast<uint32_t>(_config.leafSize)) {
+		ownEnd = static_cast<uint32_t>(std::partition_point(_keys.begin() + begin, _keys.begin() + end, [&](uint64_t key) {
+			return getKeyLevel(key) == depth;
+		}) - _keys.begin());
+	}
+
+	glm::vec3 boxMin(FLT_MAX), boxMax(-FLT_MAX);
+	for (uint32_t i = begin; i < ownEnd; ++i) {
+		boxMin = glm::min(boxMin, _triangleMin[_triangleIndices[i]]);
+		boxMax = glm::max(boxMax, _triangleMax[_triangleIndices[i]]);
+	}
+
+	_nodes[index].firstTriangle = begin;
+	_nodes[index].triangleCount = ownEnd - begin;
+
+	const int digitShift = 3 * (_config.maxDepth - depth - 1) + levelBits;
+	const float childHalfSize = 0.5f * halfSize;
+	uint32_t childBegin = ownEnd;
+	for (int octant = 0; octant < 8; ++octant) {
+		const uint32_t childEnd = static_cast<uint32_t>(std::partition_point(_keys.begin() + childBegin, _keys.begin() + end, [&](uint64_t key) {
+			return static_cast<int>((key >> digitShift) & 7) <= octant;
+		}) - _keys.begin());
+
+		int32_t child = -1;
+		if (childEnd > childBegin) {
+			const glm::vec3 childCenter = center + childHalfSize * glm::vec3(
+				octant & 1 ? 1.0f : -1.0f,
+				octant & 2 ? 1.0f : -1.0f,
+				octant & 4 ? 1.0f : -1.0f);
+			child = _buildNode(getChildLocCode(locCode, octant), childCenter, childHalfSize, childBegin, childEnd, depth + 1);
+			boxMin = glm::min(boxMin, _nodes[child].boxMin);
+			boxMax = glm::max(boxMax, _nodes[child].boxMax);
+		}
+		_nodes[index].children[octant] = child;
+		childBegin = childEnd;
+	}
+
+	_nodes[index].center = center;
+	_nodes[index].boxMin = boxMin;
+	_nodes[index].boxMax = boxMax;
+	_nodes[index].locCode = locCode;
+	return index;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#ifdef GLFW_INCLUDE_VULKAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include <glm/vec3.hpp>
+
+#include "array_view.h"
+#include "mesh.h"
+#include "thread_pool.h"
+
+struct OctreeNode {
+	/* center of the cubic cell, the splitting point of the children */
+	glm::vec3 center;
+	/* bounds of all triangles in the subtree, used for culling */
+	glm::vec3 boxMin, boxMax;
+	/* child index in the node array for each octant, -1 if empty */
+	int32_t children[8];
+	/* range of the node's own triangles in the triangle index array */
+	uint32_t firstTriangle;
+	uint32_t triangleCount;
+	/* location code of the cell, see Octree */
+	uint64_t locCode;
+};
+
+/**
+ * @brief split-on-straddle octree over the triangles of an indexed mesh
+ * @detail a triangle whose bounding box fits in one octant moves down to that child,
+ *         a triangle straddling a splitting plane stays in the node. Octant i has bit 0
+ *         set for the +x half, bit 1 for the +y half and bit 2 for the +z half.
+ *         Cells are addressed by location codes like the nodes of QuadTree, the root is 1
+ *         and the children of a cell are (locCode << 3) | i.
+ *         The tree is built linearly: every triangle gets the location code of the smallest
+ *         cell holding its bounding box, the codes are radix sorted in parallel into the
+ *         preorder of the tree, and one pass over the sorted codes emits the nodes.
+ */
+class Octree {
+public:
+	/*
+	 * @brief build parameters
+	 */
+	struct Config {
+		/* levels below the root at most, up to 19 */
+		int maxDepth = 8;
+		/* a node holding at most this many triangles is not split */
+		int leafSize = 32;
+	};
+
+	/*
+	 * @brief get the location code of the root cell
+	 */
+	static uint64_t getRootLocCode() {
+		return 1;
+	}
+
+	/*
+	 * @brief get the location code of the parent cell
+	 */
+	static uint64_t getParentLocCode(uint64_t locCode) {
+		return locCode >> 3;
+	}
+
+	/*
+	 * @brief get the location code of the child cell in octant i
+	 */
+	static uint64_t getChildLocCode(uint64_t locCode, int i) {
+		return (locCode << 3) | static_cast<uint64_t>(i);
+	}
+
+	/*
+	 * @brief get the level of the cell, the root is at level 0
+	 */
+	static int getNodeTreeDepth(uint64_t locCode);
+
+	/*
+	 * @brief default constructor, an empty tree
+	 */
+	Octree() = default;
+
+	/*
+	 * @brief default destructor
+	 */
+	~Octree() = default;
+
+	/*
+	 * @brief build the tree over the triangles of the mesh
+	 */
+	void build(const IndexedMesh& mesh, const Config& config, ThreadPool& threadPool);
+
+	/*
+	 * @brief use a tree built before and stored elsewhere, it must outlive this one
+	 */
+	void assign(const Config& config, int depth, ArrayView<OctreeNode> nodes, ArrayView<uint32_t> triangleIndices);
+
+	/*
+	 * @brief get all nodes, the root is at index 0
+	 */
+	ArrayView<OctreeNode> getNodes() const;
+
+	/*
+	 * @brief get the triangle indices referenced by the nodes
+	 */
+	ArrayView<uint32_t> getTriangleIndices() const;
+
+	/*
+	 * @brief get the parameters of the last build
+	 */
+	const Config& getConfig() const;
+
+	/*
+	 * @brief get the deepest level reached by the last build
+	 */
+	int getDepth() const;
+
+private:
+	Config _config;
+	int _depth = 0;
+	std::vector<OctreeNode> _nodes;
+	std::vector<uint32_t> _triangleIndices;
+	/* the arrays handed out, the ones above or the ones given to assign */
+	ArrayView<OctreeNode> _nodeView;
+	ArrayView<uint32_t> _triangleView;
+	/* build buffers, kept between builds so a rebuild does not allocate */
+	/* bounds of each triangle */
+	std::vector<glm::vec3> _triangleMin;
+	std::vector<glm::vec3> _triangleMax;
+	/* sort key of each entry of _triangleIndices, the cell code left aligned to maxDepth and its level */
+	std::vector<uint64_t> _keys;
+	/* radix sort destination of _keys and _triangleIndices */
+	std::vector<uint64_t> _sortedKeys;
+	std::vector<uint32_t> _sortedTriangles;
+	/* per chunk digit counts, then scatter offsets of a radix sort pass */
+	std::vector<uint32_t> _histograms;
+	/* per chunk bounds of the triangles */
+	std::vector<glm::vec3> _chunkMin;
+	std::vector<glm::vec3> _chunkMax;
+
+	/*
+	 * @brief sort _keys and _triangleIndices by the low keyBits bits of the keys
+	 */
+	void _sortKeys(ThreadPool& threadPool, int keyBits);
+
+	/*
+	 * @brief create the node of the cell over a range of the sorted triangles
+	 * @return index of the created node
+	 */
+	int32_t _buildNode(uint64_t locCode, const glm::vec3& center, float halfSize, uint32_t begin, uint32_t end, int depth);
+};
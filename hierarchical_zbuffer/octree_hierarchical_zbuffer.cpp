@@ -0,0 +1,554 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "octree_hierarchical_zbuffer.h"
+#include "profiler.h"
+
+/*
+ * @brief constructor, render through the hierarchical z-buffer
+ * @param hierarchicalZBuffer z pyramid and rasterizer, it must outlive this object
+ */
+OctreeHierarchicalZBuffer::OctreeHierarchicalZBuffer(HierarchicalZBuffer& hierarchicalZBuffer)
+	: _hierarchicalZBuffer(hierarchicalZBuffer) { }
+
+
+/*
+ * @brief traverse the octree front to back and render the triangles of visible nodes
+ * @param octree octree built over the mesh
+ * @param mesh world space mesh
+ * @param colors color of each triangle
+ * @param viewProjection view projection matrix of the camera
+ * @param cameraPosition world position of the camera
+ */
+void OctreeHierarchicalZBuffer::render(const Octree& octree, const IndexedMesh& mesh,
+	const std::vector<uint32_t>& colors, const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition) {
+	_octree = &octree;
+	_bvh = nullptr;
+	_render(octree.getNodes().size(), mesh, colors, viewProjection, cameraPosition);
+}
+
+
+/*
+ * @brief traverse the bvh front to back and render the triangles of visible leaves
+ * @param bvh bvh built over the mesh
+ * @param mesh world space mesh
+ * @param colors color of each triangle
+ * @param viewProjection view projection matrix of the camera
+ * @param cameraPosition world position of the camera
+ */
+void OctreeHierarchicalZBuffer::render(const Bvh& bvh, const IndexedMesh& mesh,
+	const std::vector<uint32_t>& colors, const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition) {
+	_octree = nullptr;
+	_bvh = &bvh;
+	_render(bvh.getNodes().size(), mesh, colors, viewProjection, cameraPosition);
+}
+
+
+/*
+ * @brief start a frame of several objects, rebuild the z pyramid and reset the counters
+ * @detail the objects of the frame are rendered in a single pass without visibility
+ *         persistence, as the node histories are kept per tree and not per object
+ */
+void OctreeHierarchicalZBuffer::beginFrame() {
+	_statistics = Statistics();
+	const FrameBuffer& frameBuffer = _hierarchicalZBuffer.getFrameBuffer();
+	_clipper.setViewport(static_cast<float>(frameBuffer.getWidth()), static_cast<float>(frameBuffer.getHeight()));
+	_clipper.resetStatistics();
+	_culling.resetStatistics();
+	_hierarchicalZBuffer.beginFrame();
+}
+
+
+/*
+ * @brief test an object space bounding box against the frustum and the z pyramid of the frame
+ * @param boxMin, boxMax bounds of the box
+ * @param modelViewProjection transform of the box to clip space
+ * @return outside, occluded or visible
+ */
+OctreeHierarchicalZBuffer::NodeVisibility OctreeHierarchicalZBuffer::testBox(const glm::vec3& boxMin,
+	const glm::vec3& boxMax, const glm::mat4x4& modelViewProjection) {
+	_viewProjection = modelViewProjection;
+	_firstPass = false;
+	return _testNode(boxMin, boxMax);
+}
+
+
+/*
+ * @brief traverse the octree of one object of the frame and render the triangles of visible nodes
+ * @detail the counters add up over the objects until the end of the frame
+ * @param octree octree built over the mesh
+ * @param mesh object space mesh, shared by any number of objects
+ * @param colors color of each triangle
+ * @param modelViewProjection transform of the object to clip space
+ * @param cameraPosition position of the camera in object space
+ */
+void OctreeHierarchicalZBuffer::renderObject(const Octree& octree, const IndexedMesh& mesh,
+	const std::vector<uint32_t>& colors, const glm::mat4x4& modelViewProjection, const glm::vec3& cameraPosition) {
+	_octree = &octree;
+	_bvh = nullptr;
+	_setObject(mesh, colors, modelViewProjection, cameraPosition);
+	_trackVisibility = false;
+	_firstPass = false;
+	if (!octree.getNodes().empty()) {
+		_renderNode(0);
+	}
+}
+
+
+/*
+ * @brief finish a frame of several objects, collect the triangle counters
+ */
+void OctreeHierarchicalZBuffer::endFrame() {
+	_statistics.trianglesCulled = _culling.getStatistics().trianglesBackfacing + _culling.getStatistics().trianglesDegenerate;
+	_statistics.trianglesBackfacing = _culling.getStatistics().trianglesBackfacing;
+	_statistics.trianglesOutside += _clipper.getStatistics().trianglesCulled;
+	_statistics.trianglesClipped = _clipper.getStatistics().trianglesClipped;
+}
+
+
+/*
+ * @brief select which faces are culled
+ * @param faceCulling faces to reject
+ */
+void OctreeHierarchicalZBuffer::setFaceCulling(CullingStage::FaceCulling faceCulling) {
+	_culling.setFaceCulling(faceCulling);
+}
+
+
+/*
+ * @brief remember which nodes were visible and skip their tests in the next frames
+ * @detail switching drops the remembered visibility
+ * @param visibilityPersistence true for the coherent traversal
+ */
+void OctreeHierarchicalZBuffer::setVisibilityPersistence(bool visibilityPersistence) {
+	_visibilityPersistence = visibilityPersistence;
+	_nodeHistory.clear();
+	_queryBatch.clear();
+}
+
+
+/*
+ * @brief test against the reprojected pyramid of the previous frame first, nullptr for none
+ * @param temporalOcclusion reprojected pyramid of the frame, it must outlive its use here
+ */
+void OctreeHierarchicalZBuffer::setTemporalOcclusion(const TemporalOcclusion* temporalOcclusion) {
+	_temporalOcclusion = temporalOcclusion;
+}
+
+
+/*
+ * @brief get the counters of the last rendered frame
+ * @return per frame statistics
+ */
+const OctreeHierarchicalZBuffer::Statistics& OctreeHierarchicalZBuffer::getStatistics() const {
+	return _statistics;
+}
+
+
+/*
+ * @brief set the tree, mesh and transform traversed next
+ * @detail the forward direction of the camera is the w row of the view projection matrix
+ * @param mesh mesh the tree was built over
+ * @param colors color of each triangle
+ * @param viewProjection transform of the mesh to clip space
+ * @param cameraPosition position of the camera in the space of the mesh
+ */
+void OctreeHierarchicalZBuffer::_setObject(const IndexedMesh& mesh, const std::vector<uint32_t>& colors,
+	const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition) {
+	_mesh = &mesh;
+	_colors = &colors;
+	_viewProjection = viewProjection;
+	_cameraPosition = cameraPosition;
+	_viewDirection = glm::vec3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3]);
+}
+
+
+/*
+ * @brief traverse the tree set for the frame from its root in one or two passes
+ * @detail with a stored previous frame the deferred nodes and triangles are revisited in
+ *         their first pass order after it. The z pyramid is kept current by every written
+ *         pixel, so the second pass needs no rebuild and the result equals a single pass
+ * @param nodeCount number of nodes of the tree
+ * @param mesh world space mesh
+ * @param colors color of each triangle
+ * @param viewProjection view projection matrix of the camera
+ * @param cameraPosition world position of the camera
+ */
+void OctreeHierarchicalZBuffer::_render(size_t nodeCount, const IndexedMesh& mesh,
+	const std::vector<uint32_t>& colors, const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition) {
+	PROFILE_SCOPE(OctreeTraversal);
+	beginFrame();
+	_setObject(mesh, colors, viewProjection, cameraPosition);
+	_trackVisibility = _visibilityPersistence;
+	if (_visibilityPersistence) {
+		++_frame;
+		if (_nodeHistory.size() != nodeCount) {
+			_nodeHistory.assign(nodeCount, NodeHistory());
+		}
+	}
+
+	_firstPass = _temporalOcclusion != nullptr && _temporalOcclusion->isValid();
+	_deferredNodes.clear();
+	_deferredTriangles.clear();
+	if (nodeCount > 0) {
+		_renderNode(0);
+		_flushQueries();
+	}
+
+	_firstPass = false;
+	for (int32_t index : _deferredNodes) {
+		_queryNode(index);
+	}
+	_flushQueries();
+
+	for (const auto& deferred : _deferredTriangles) {
+		_currentNode = deferred.first;
+		_submitTriangle(deferred.second);
+	}
+
+	if (_visibilityPersistence) {
+		_pullUpVisibility();
+	}
+
+	endFrame();
+}
+
+
+/*
+ * @brief visit the node, draw it at once if it stays visible or queue its test
+ * @detail with visibility persistence a node visible in the previous frame is drawn without
+ *         a test, except that leaves are tested again every requeryInterval frames, spread
+ *         over the frames by their index. Other nodes are tested in batches of queryBatchSize,
+ *         so their tests see the pyramid of the nodes drawn meanwhile
+ * @param index index of the node in the tree
+ */
+void OctreeHierarchicalZBuffer::_renderNode(int32_t index) {
+	++_statistics.nodesVisited;
+	if (!_trackVisibility) {
+		_queryNode(index);
+		return;
+	}
+
+	const bool requery = _isLeaf(index) && (_frame + static_cast<uint32_t>(index)) % requeryInterval == 0;
+	if (_nodeHistory[index].visibleFrame + 1 == _frame && !requery) {
+		++_statistics.visibilityCacheHits;
+		_drawNode(index);
+		return;
+	}
+
+	_queryBatch.push_back(index);
+	if (_queryBatch.size() >= queryBatchSize) {
+		_flushQueries();
+	}
+}
+
+
+/*
+ * @brief test the node against the frustum and the z pyramid and draw it if visible
+ * @param index index of the node in the tree
+ */
+void OctreeHierarchicalZBuffer::_queryNode(int32_t index) {
+	++_statistics.nodesQueried;
+	const NodeVisibility visibility = _bvh ?
+		_testNode(_bvh->getNodes()[index].boxMin, _bvh->getNodes()[index].boxMax) :
+		_testNode(_octree->getNodes()[index].boxMin, _octree->getNodes()[index].boxMax);
+	switch (visibility) {
+		case NodeVisibility::Outside:
+			++_statistics.nodesOutside;
+			return;
+		case NodeVisibility::Occluded:
+			++_statistics.nodesCulled;
+			return;
+		case NodeVisibility::Deferred:
+			++_statistics.nodesDeferred;
+			_deferredNodes.push_back(index);
+			return;
+		case NodeVisibility::Visible:
+			break;
+	}
+
+	_drawNode(index);
+}
+
+
+/*
+ * @brief test the queued nodes, the visible ones are drawn and may queue more
+ */
+void OctreeHierarchicalZBuffer::_flushQueries() {
+	while (!_queryBatch.empty()) {
+		std::vector<int32_t> batch;
+		batch.swap(_queryBatch);
+		for (int32_t index : batch) {
+			_queryNode(index);
+		}
+
+		// keep the allocation if the batch queued nothing
+		if (_queryBatch.empty()) {
+			batch.clear();
+			_queryBatch.swap(batch);
+		}
+	}
+}
+
+
+/*
+ * @brief mark the nodes with a visible descendant as visible in the current frame
+ * @detail children are stored after their parent, so one backward pass suffices
+ */
+void OctreeHierarchicalZBuffer::_pullUpVisibility() {
+	int32_t children[8];
+	for (size_t index = _nodeHistory.size(); index-- > 0;) {
+		if (_nodeHistory[index].visibleFrame == _frame) {
+			continue;
+		}
+
+		const int childCount = _getChildren(static_cast<int32_t>(index), children);
+		for (int i = 0; i < childCount; ++i) {
+			const int32_t child = children[i];
+			if (_nodeHistory[child].visibleFrame == _frame) {
+				_nodeHistory[index].visibleFrame = _frame;
+				break;
+			}
+		}
+	}
+}
+
+
+/*
+ * @brief render the triangles of the node and visit its children in front to back order
+ * @detail in the octree the octant holding the camera comes first, then octant ^ 1, ^ 2,
+ *         ... ^ 7: a child on the far side of a splitting plane never precedes its mirror.
+ *         In the bvh the child on the lower side of the split axis comes first if the camera
+ *         looks along the positive axis
+ * @param index index of the node in the tree
+ */
+void OctreeHierarchicalZBuffer::_drawNode(int32_t index) {
+	_currentNode = index;
+	if (_bvh) {
+		const BvhNode& node = _bvh->getNodes()[index];
+		if (node.triangleCount > 0) {
+			_drawTriangles(_bvh->getTriangleIndices().data() + node.offset, node.triangleCount);
+			return;
+		}
+
+		const int32_t first = index + 1;
+		const int32_t second = static_cast<int32_t>(node.offset);
+		const bool lowerFirst = _viewDirection[node.axis] >= 0.0f;
+		_renderNode(lowerFirst ? first : second);
+		_renderNode(lowerFirst ? second : first);
+		return;
+	}
+
+	const OctreeNode& node = _octree->getNodes()[index];
+	_drawTriangles(_octree->getTriangleIndices().data() + node.firstTriangle, node.triangleCount);
+
+	const int nearest =
+		(_cameraPosition.x >= node.center.x ? 1 : 0) |
+		(_cameraPosition.y >= node.center.y ? 2 : 0) |
+		(_cameraPosition.z >= node.center.z ? 4 : 0);
+	for (int i = 0; i < 8; ++i) {
+		const int32_t child = node.children[nearest ^ i];
+		if (child >= 0) {
+			_renderNode(child);
+		}
+	}
+}
+
+
+/*
+ * @brief transform, cull, clip and render the triangles of the current node
+ * @param triangles indices of the triangles in the mesh
+ * @param count number of triangles
+ */
+void OctreeHierarchicalZBuffer::_drawTriangles(const uint32_t* triangles, uint32_t count) {
+	const FrameBuffer& frameBuffer = _hierarchicalZBuffer.getFrameBuffer();
+	const float width = static_cast<float>(frameBuffer.getWidth());
+	const float height = static_cast<float>(frameBuffer.getHeight());
+	for (uint32_t i = 0; i < count; ++i) {
+		const uint32_t id = triangles[i];
+		const uint32_t* corners = &_mesh->indices[3 * id];
+		++_statistics.trianglesTransformed;
+
+		glm::vec4 clip[3];
+		uint8_t outcodes[3];
+		for (int k = 0; k < 3; ++k) {
+			clip[k] = _viewProjection * glm::vec4(_mesh->positions[corners[k]], 1.0f);
+			outcodes[k] = _clipper.computeOutcode(clip[k]);
+		}
+
+		if (_culling.cullTriangle(clip)) {
+			continue;
+		}
+
+		if (outcodes[0] | outcodes[1] | outcodes[2]) {
+			_clippedTriangles.clear();
+			_clipper.clipTriangle(clip, outcodes, (*_colors)[id], _clippedTriangles);
+			for (const auto& rasterTriangle : _clippedTriangles) {
+				_renderTriangle(rasterTriangle);
+			}
+			continue;
+		}
+
+		RasterTriangle rasterTriangle;
+		for (int k = 0; k < 3; ++k) {
+			rasterTriangle.v[k] = projectToScreen(clip[k], width, height);
+		}
+
+		if (isOutsideScreen(rasterTriangle, width, height)) {
+			++_statistics.trianglesOutside;
+			continue;
+		}
+
+		rasterTriangle.color = (*_colors)[id];
+		_renderTriangle(rasterTriangle);
+	}
+}
+
+
+/*
+ * @brief check whether the node has no children
+ * @param index index of the node in the tree
+ * @return true for a leaf
+ */
+bool OctreeHierarchicalZBuffer::_isLeaf(int32_t index) const {
+	if (_bvh) {
+		return _bvh->getNodes()[index].triangleCount > 0;
+	}
+
+	const OctreeNode& node = _octree->getNodes()[index];
+	return std::all_of(node.children, node.children + 8, [](int32_t child) { return child < 0; });
+}
+
+
+/*
+ * @brief get the children of the node
+ * @param index index of the node in the tree
+ * @param children indices of the children as output, room for 8
+ * @return number of children written
+ */
+int OctreeHierarchicalZBuffer::_getChildren(int32_t index, int32_t* children) const {
+	int count = 0;
+	if (_bvh) {
+		const BvhNode& node = _bvh->getNodes()[index];
+		if (node.triangleCount == 0) {
+			children[count++] = index + 1;
+			children[count++] = static_cast<int32_t>(node.offset);
+		}
+		return count;
+	}
+
+	for (int32_t child : _octree->getNodes()[index].children) {
+		if (child >= 0) {
+			children[count++] = child;
+		}
+	}
+	return count;
+}
+
+
+/*
+ * @brief test the projected bounding box of a node against the frustum and the z pyramid
+ * @detail a box crossing the near plane cannot be projected and is always visible
+ * @param boxMin, boxMax world space bounds of the node
+ * @return visibility of the node
+ */
+OctreeHierarchicalZBuffer::NodeVisibility OctreeHierarchicalZBuffer::_testNode(const glm::vec3& boxMin,
+	const glm::vec3& boxMax) const {
+	const FrameBuffer& frameBuffer = _hierarchicalZBuffer.getFrameBuffer();
+	const int width = frameBuffer.getWidth();
+	const int height = frameBuffer.getHeight();
+
+	glm::vec3 screenMin(FLT_MAX), screenMax(-FLT_MAX);
+	int outsideAll = 0x3F;
+	bool crossNear = false;
+	for (int corner = 0; corner < 8; ++corner) {
+		const glm::vec4 clip = _viewProjection * glm::vec4(
+			corner & 1 ? boxMax.x : boxMin.x,
+			corner & 2 ? boxMax.y : boxMin.y,
+			corner & 4 ? boxMax.z : boxMin.z,
+			1.0f);
+
+		const int outside =
+			(clip.x < -clip.w ? 0x01 : 0) | (clip.x > clip.w ? 0x02 : 0) |
+			(clip.y < -clip.w ? 0x04 : 0) | (clip.y > clip.w ? 0x08 : 0) |
+			(clip.z < -clip.w ? 0x10 : 0) | (clip.z > clip.w ? 0x20 : 0);
+		outsideAll &= outside;
+
+		if (outside & 0x10 || clip.w <= 0.0f) {
+			crossNear = true;
+			continue;
+		}
+
+		const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		const glm::vec3 screen(
+			(ndc.x * 0.5f + 0.5f) * width,
+			(0.5f - ndc.y * 0.5f) * height,
+			ndc.z * 0.5f + 0.5f);
+		screenMin = glm::min(screenMin, screen);
+		screenMax = glm::max(screenMax, screen);
+	}
+
+	if (outsideAll != 0) {
+		return NodeVisibility::Outside;
+	}
+
+	if (crossNear) {
+		return NodeVisibility::Visible;
+	}
+
+	const ScanRect& region = _hierarchicalZBuffer.getRegion();
+	ScanRect rect;
+	rect.xl = std::max(static_cast<int>(std::ceil(screenMin.x - 0.5f)), region.xl);
+	rect.xr = std::min(static_cast<int>(std::ceil(screenMax.x - 0.5f)), region.xr);
+	rect.yl = std::max(static_cast<int>(std::ceil(screenMin.y - 0.5f)), region.yl);
+	rect.yr = std::min(static_cast<int>(std::ceil(screenMax.y - 0.5f)), region.yr);
+	if (rect.xl >= rect.xr || rect.yl >= rect.yr) {
+		return NodeVisibility::Outside;
+	}
+
+	if (_hierarchicalZBuffer.isOccluded(rect, screenMin.z)) {
+		return NodeVisibility::Occluded;
+	}
+
+	return _firstPass && _temporalOcclusion->isOccluded(rect, screenMin.z) ?
+		NodeVisibility::Deferred : NodeVisibility::Visible;
+}
+
+
+/*
+ * @brief render a set up triangle, or defer it if the reprojection hides it in the first pass
+ * @param triangle triangle in screen space
+ */
+void OctreeHierarchicalZBuffer::_renderTriangle(const RasterTriangle& triangle) {
+	if (_firstPass) {
+		const FrameBuffer& frameBuffer = _hierarchicalZBuffer.getFrameBuffer();
+		const ScanRect& region = _hierarchicalZBuffer.getRegion();
+		ScanRect rect;
+		if (setupScanBounds(triangle, frameBuffer.getWidth(), frameBuffer.getHeight(), rect)) {
+			rect.xl = std::max(rect.xl, region.xl);
+			rect.xr = std::min(rect.xr, region.xr);
+			rect.yl = std::max(rect.yl, region.yl);
+			rect.yr = std::min(rect.yr, region.yr);
+			const float zmin = std::min(std::min(triangle.v[0].z, triangle.v[1].z), triangle.v[2].z);
+			if (rect.xl < rect.xr && rect.yl < rect.yr && _temporalOcclusion->isOccluded(rect, zmin)) {
+				++_statistics.trianglesDeferred;
+				_deferredTriangles.emplace_back(_currentNode, triangle);
+				return;
+			}
+		}
+	}
+
+	_submitTriangle(triangle);
+}
+
+
+/*
+ * @brief render a set up triangle of the current node, the node is visible if it is not rejected
+ * @param triangle triangle in screen space
+ */
+void OctreeHierarchicalZBuffer::_submitTriangle(const RasterTriangle& triangle) {
+	if (_hierarchicalZBuffer.renderTriangle(triangle) && _trackVisibility) {
+		_nodeHistory[_currentNode].visibleFrame = _frame;
+	}
+}
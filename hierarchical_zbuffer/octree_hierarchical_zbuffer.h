@@ -0,0 +1,250 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#ifdef GLFW_INCLUDE_VULKAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "bvh.h"
+#include "clipper.h"
+#include "culling_stage.h"
+#include "hierarchical_zbuffer.h"
+#include "mesh.h"
+#include "octree.h"
+#include "temporal_occlusion.h"
+
+/**
+ * @brief hierarchical z-buffer driven by a front to back octree traversal
+ * @detail the projected bounds of every visited node are tested against the z pyramid,
+ *         a hidden node is culled with its whole subtree before its triangles are transformed.
+ *         With the reprojected pyramid of the previous frame the traversal runs twice: the
+ *         first pass defers the nodes and triangles the reprojection hides and draws the rest,
+ *         the second pass tests the deferred ones against the pyramid of what was drawn.
+ *         With visibility persistence the nodes visible in the previous frame are drawn
+ *         without a test in the manner of coherent hierarchical culling (CHC++).
+ *         A bounding volume hierarchy can be traversed in place of the octree. Several objects
+ *         can share one frame, each traversing the octree of its mesh with its own transform
+ */
+class OctreeHierarchicalZBuffer {
+public:
+	/*
+	 * @brief result of testing a bounding box against the frustum and the z pyramid
+	 */
+	enum class NodeVisibility {
+		Outside, Occluded, Deferred, Visible
+	};
+
+	/*
+	 * @brief per frame counters of the traversal
+	 */
+	struct Statistics {
+		uint64_t nodesVisited = 0;
+		/* nodes culled by the z pyramid */
+		uint64_t nodesCulled = 0;
+		/* nodes outside the view frustum */
+		uint64_t nodesOutside = 0;
+		/* triangles of visible nodes transformed to the screen */
+		uint64_t trianglesTransformed = 0;
+		/* transformed triangles rejected by facing or a zero area */
+		uint64_t trianglesCulled = 0;
+		/* culled triangles facing away from the camera */
+		uint64_t trianglesBackfacing = 0;
+		/* transformed triangles completely outside the near plane, guard band or screen */
+		uint64_t trianglesOutside = 0;
+		/* transformed triangles cut by the clipper */
+		uint64_t trianglesClipped = 0;
+		/* nodes and set up triangles hidden by the reprojected pyramid, retested in the second pass */
+		uint64_t nodesDeferred = 0;
+		uint64_t trianglesDeferred = 0;
+		/* nodes tested against the frustum and the z pyramid */
+		uint64_t nodesQueried = 0;
+		/* nodes drawn without a test as they were visible in the previous frame */
+		uint64_t visibilityCacheHits = 0;
+	};
+
+	/* nodes queued before their tests run */
+	static const size_t queryBatchSize = 16;
+	/* frames a visible leaf is drawn without a test */
+	static const uint32_t requeryInterval = 8;
+
+	/*
+	 * @brief constructor, render through the hierarchical z-buffer
+	 */
+	explicit OctreeHierarchicalZBuffer(HierarchicalZBuffer& hierarchicalZBuffer);
+
+	/*
+	 * @brief default destructor
+	 */
+	~OctreeHierarchicalZBuffer() = default;
+
+	/*
+	 * @brief traverse the octree front to back and render the triangles of visible nodes
+	 */
+	void render(const Octree& octree, const IndexedMesh& mesh, const std::vector<uint32_t>& colors,
+		const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition);
+
+	/*
+	 * @brief traverse the bvh front to back and render the triangles of visible leaves
+	 */
+	void render(const Bvh& bvh, const IndexedMesh& mesh, const std::vector<uint32_t>& colors,
+		const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition);
+
+	/*
+	 * @brief start a frame of several objects, rebuild the z pyramid and reset the counters
+	 */
+	void beginFrame();
+
+	/*
+	 * @brief test an object space bounding box against the frustum and the z pyramid of the frame
+	 */
+	NodeVisibility testBox(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::mat4x4& modelViewProjection);
+
+	/*
+	 * @brief traverse the octree of one object of the frame and render the triangles of visible nodes
+	 */
+	void renderObject(const Octree& octree, const IndexedMesh& mesh, const std::vector<uint32_t>& colors,
+		const glm::mat4x4& modelViewProjection, const glm::vec3& cameraPosition);
+
+	/*
+	 * @brief finish a frame of several objects, collect the triangle counters
+	 */
+	void endFrame();
+
+	/*
+	 * @brief select which faces are culled
+	 */
+	void setFaceCulling(CullingStage::FaceCulling faceCulling);
+
+	/*
+	 * @brief remember which nodes were visible and skip their tests in the next frames
+	 */
+	void setVisibilityPersistence(bool visibilityPersistence);
+
+	/*
+	 * @brief test against the reprojected pyramid of the previous frame first, nullptr for none
+	 */
+	void setTemporalOcclusion(const TemporalOcclusion* temporalOcclusion);
+
+	/*
+	 * @brief get the counters of the last rendered frame
+	 */
+	const Statistics& getStatistics() const;
+
+private:
+	/*
+	 * @brief visibility of a node in the earlier frames
+	 */
+	struct NodeHistory {
+		/* last frame a triangle of the subtree passed the z pyramid, 0 for never */
+		uint32_t visibleFrame = 0;
+	};
+
+	HierarchicalZBuffer& _hierarchicalZBuffer;
+	Clipper _clipper;
+	CullingStage _culling;
+	Statistics _statistics;
+
+	/* output of the clipper for one triangle */
+	std::vector<RasterTriangle> _clippedTriangles;
+
+	/* reprojected pyramid of the first pass and what it hid, in traversal order */
+	const TemporalOcclusion* _temporalOcclusion = nullptr;
+	bool _firstPass = false;
+	std::vector<int32_t> _deferredNodes;
+	/* deferred triangles with the node they belong to */
+	std::vector<std::pair<int32_t, RasterTriangle>> _deferredTriangles;
+
+	/* visibility persistence, frames are counted from 1 while it is on */
+	bool _visibilityPersistence = false;
+	/* whether the visibility of the traversed tree is remembered, never for the objects of a frame */
+	bool _trackVisibility = false;
+	uint32_t _frame = 0;
+	std::vector<NodeHistory> _nodeHistory;
+	std::vector<int32_t> _queryBatch;
+	/* node whose triangles are being rendered */
+	int32_t _currentNode = 0;
+
+	/* state of the frame being rendered, either the octree or the bvh is traversed */
+	const Octree* _octree = nullptr;
+	const Bvh* _bvh = nullptr;
+	const IndexedMesh* _mesh = nullptr;
+	const std::vector<uint32_t>* _colors = nullptr;
+	glm::mat4x4 _viewProjection;
+	glm::vec3 _cameraPosition;
+	/* forward direction of the camera, orders the children of the bvh */
+	glm::vec3 _viewDirection;
+
+	/*
+	 * @brief set the tree, mesh and transform traversed next
+	 */
+	void _setObject(const IndexedMesh& mesh, const std::vector<uint32_t>& colors,
+		const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition);
+
+	/*
+	 * @brief traverse the tree set for the frame from its root in one or two passes
+	 */
+	void _render(size_t nodeCount, const IndexedMesh& mesh, const std::vector<uint32_t>& colors,
+		const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition);
+
+	/*
+	 * @brief visit the node, draw it at once if it stays visible or queue its test
+	 */
+	void _renderNode(int32_t index);
+
+	/*
+	 * @brief test the node against the frustum and the z pyramid and draw it if visible
+	 */
+	void _queryNode(int32_t index);
+
+	/*
+	 * @brief test the queued nodes, the visible ones are drawn and may queue more
+	 */
+	void _flushQueries();
+
+	/*
+	 * @brief mark the nodes with a visible descendant as visible in the current frame
+	 */
+	void _pullUpVisibility();
+
+	/*
+	 * @brief render the triangles of the node and visit its children in front to back order
+	 */
+	void _drawNode(int32_t index);
+
+	/*
+	 * @brief transform, cull, clip and render the triangles of the current node
+	 */
+	void _drawTriangles(const uint32_t* triangles, uint32_t count);
+
+	/*
+	 * @brief check whether the node has no children
+	 */
+	bool _isLeaf(int32_t index) const;
+
+	/*
+	 * @brief get the children of the node, -1 for none, at most 8
+	 */
+	int _getChildren(int32_t index, int32_t* children) const;
+
+	/*
+	 * @brief render a set up triangle, or defer it if the reprojection hides it in the first pass
+	 */
+	void _renderTriangle(const RasterTriangle& triangle);
+
+	/*
+	 * @brief render a set up triangle of the current node, the node is visible if it is not rejected
+	 */
+	void _submitTriangle(const RasterTriangle& triangle);
+
+	/*
+	 * @brief test the projected bounding box of a node against the frustum and the z pyramid
+	 */
+	NodeVisibility _testNode(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+};
@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <utility>
+
+#include "profiler.h"
+
+namespace {
+	/*
+	 * @brief buffer of the calling thread, given back to the profiler when the thread exits
+	 */
+	struct ThreadBufferLease {
+		/* the profiler is the only owner of buffers */
+		void* buffer = nullptr;
+		std::atomic<bool>* inUse = nullptr;
+
+		~ThreadBufferLease() {
+			if (inUse) {
+				inUse->store(false, std::memory_order_release);
+			}
+		}
+	};
+
+	thread_local ThreadBufferLease threadBuffer;
+
+	/* frame of the innermost ScopedFrame of the calling thread, -1 for the current frame */
+	thread_local int64_t threadFrame = -1;
+
+	/* time every event is relative to */
+	const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+}
+
+/*
+ * @brief get the profiler of the process
+ * @return the profiler
+ */
+Profiler& Profiler::getInstance() {
+	static Profiler profiler;
+	return profiler;
+}
+
+
+/*
+ * @brief start or stop recording
+ * @param enabled true to record the scopes
+ */
+void Profiler::setEnabled(bool enabled) {
+	_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+
+/*
+ * @brief check whether the scopes are recorded
+ * @return true if recording
+ */
+bool Profiler::isEnabled() const {
+	return _enabled.load(std::memory_order_relaxed);
+}
+
+
+/*
+ * @brief set the number of frames kept per thread, dropping the recorded ones
+ * @detail the rings are resized, so no thread may record meanwhile
+ * @param frameCapacity number of frames, at least 1
+ */
+void Profiler::setFrameCapacity(size_t frameCapacity) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_frameCapacity = std::max<size_t>(frameCapacity, 1);
+	for (auto& buffer : _threadBuffers) {
+		buffer->events.assign(_frameCapacity * eventsPerFrame, Event());
+		buffer->written.store(0, std::memory_order_relaxed);
+	}
+}
+
+
+/*
+ * @brief get the number of frames kept per thread
+ * @return frame capacity
+ */
+size_t Profiler::getFrameCapacity() const {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _frameCapacity;
+}
+
+
+/*
+ * @brief get the number of a new frame whose stages may run before it begins
+ * @detail a setup running ahead records in the reserved frame with a ScopedFrame, the
+ *         rasterization begins the frame once it starts. Frames are reserved in their order
+ * @return frame number after all numbers reserved so far
+ */
+uint32_t Profiler::reserveFrame() {
+	return _lastFrame.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+
+/*
+ * @brief start the next frame, the following events are recorded for it
+ */
+void Profiler::beginFrame() {
+	beginFrame(reserveFrame());
+}
+
+
+/*
+ * @brief start a reserved frame, the following events are recorded for it
+ * @detail threads in a ScopedFrame keep recording in their frame
+ * @param frame number returned by reserveFrame
+ */
+void Profiler::beginFrame(uint32_t frame) {
+	_frame.store(frame, std::memory_order_relaxed);
+}
+
+
+/*
+ * @brief get the frame the calling thread records in
+ * @return frame of its ScopedFrame, otherwise the current frame
+ */
+uint32_t Profiler::getFrame() const {
+	return threadFrame >= 0 ? static_cast<uint32_t>(threadFrame) : _frame.load(std::memory_order_relaxed);
+}
+
+
+/*
+ * @brief record a timed scope of the calling thread in its frame
+ * @detail the event overwrites the oldest one of the ring of the thread, without a lock.
+ *         A frame with more events than its share of the ring loses its oldest ones
+ * @param stage timed stage
+ * @param begin start of the scope from now()
+ * @param end end of the scope from now()
+ */
+void Profiler::record(Stage stage, int64_t begin, int64_t end) {
+	if (!isEnabled()) {
+		return;
+	}
+
+	ThreadBuffer& buffer = _getThreadBuffer();
+	const uint64_t written = buffer.written.load(std::memory_order_relaxed);
+	buffer.events[written % buffer.events.size()] = Event{ getFrame(), buffer.thread, stage, begin, end };
+	buffer.written.store(written + 1, std::memory_order_release);
+}
+
+
+/*
+ * @brief get the events of the kept frames of all threads ordered by their begin
+ * @detail the kept frames end with the last reserved one, which may not have begun yet
+ * @return events of at most the last frame capacity frames
+ */
+std::vector<Profiler::Event> Profiler::getEvents() const {
+	std::vector<Event> events, threadEvents;
+	const uint32_t frame = _lastFrame.load(std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (const auto& buffer : _threadBuffers) {
+		_copyEvents(*buffer, threadEvents);
+		for (const Event& event : threadEvents) {
+			if (frame - event.frame < _frameCapacity) {
+				events.push_back(event);
+			}
+		}
+	}
+
+	std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+		return a.begin < b.begin || (a.begin == b.begin && a.end > b.end);
+	});
+
+	return events;
+}
+
+
+/*
+ * @brief get the time spent in a stage in a frame summed over the threads
+ * @detail a thread records its frames in order, so every ring is only read back from its
+ *         newest event to the first one of an earlier frame
+ * @param frame frame number
+ * @param stage stage to sum
+ * @return milliseconds, 0 if the frame is no longer kept
+ */
+double Profiler::getStageMilliseconds(uint32_t frame, Stage stage) const {
+	int64_t nanoseconds = 0;
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (const auto& buffer : _threadBuffers) {
+		const uint64_t written = buffer->written.load(std::memory_order_acquire);
+		const size_t capacity = buffer->events.size();
+		for (uint64_t i = written; i > 0 && written - i < capacity; --i) {
+			const Event& event = buffer->events[(i - 1) % capacity];
+			const int32_t age = static_cast<int32_t>(frame - event.frame);
+			if (age > 0) {
+				break;
+			}
+
+			nanoseconds += age == 0 && event.stage == stage ? event.end - event.begin : 0;
+		}
+	}
+
+	return 1e-6 * nanoseconds;
+}
+
+
+/*
+ * @brief write the kept events as CSV
+ * @detail times in microseconds with nanosecond digits, the stream format is restored
+ * @param out output stream
+ */
+void Profiler::writeCsv(std::ostream& out) const {
+	const std::ios::fmtflags flags = out.flags();
+	const std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(3) << "frame,thread,stage,begin_us,duration_us\n";
+	for (const Event& event : getEvents()) {
+		out << event.frame << "," << event.thread << "," << getStageName(event.stage) << ","
+			<< 1e-3 * event.begin << "," << 1e-3 * (event.end - event.begin) << "\n";
+	}
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+
+/*
+ * @brief write the kept events in the Chrome trace event format
+ * @detail complete events ("ph": "X") with one track per thread, loadable in
+ *         chrome://tracing and Perfetto
+ * @param out output stream
+ */
+void Profiler::writeChromeTrace(std::ostream& out) const {
+	const std::ios::fmtflags flags = out.flags();
+	const std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	for (const Event& event : getEvents()) {
+		out << (first ? "\n" : ",\n") << "{\"name\":\"" << getStageName(event.stage)
+			<< "\",\"cat\":\"renderer\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+			<< ",\"ts\":" << 1e-3 * event.begin << ",\"dur\":" << 1e-3 * (event.end - event.begin)
+			<< ",\"args\":{\"frame\":" << event.frame << "}}";
+		first = false;
+	}
+	out << "\n]}\n";
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+
+/*
+ * @brief get the current time in nanoseconds since the start of the process
+ * @return monotonic time stamp
+ */
+int64_t Profiler::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+
+/*
+ * @brief get the name of a stage
+ * @param stage stage
+ * @return lower case name
+ */
+const char* Profiler::getStageName(Stage stage) {
+	switch (stage) {
+		case Stage::Frame:
+			return "frame";
+		case Stage::Transform:
+			return "transform";
+		case Stage::TriangleSetup:
+			return "triangle setup";
+		case Stage::Culling:
+			return "culling";
+		case Stage::Clipping:
+			return "clipping";
+		case Stage::Binning:
+			return "binning";
+		case Stage::Rasterization:
+			return "rasterization";
+		case Stage::HiZUpdate:
+			return "hi-z update";
+		case Stage::OctreeTraversal:
+			return "octree traversal";
+		case Stage::Reprojection:
+			return "reprojection";
+		default:
+			return "unknown";
+	}
+}
+
+
+/*
+ * @brief get the buffer of the calling thread, taken on its first event
+ * @detail the buffer of an exited thread is reused with its thread number and its events,
+ *         so short lived threads do not add up. Only taking a buffer locks the profiler
+ * @return buffer of the calling thread
+ */
+Profiler::ThreadBuffer& Profiler::_getThreadBuffer() {
+	if (threadBuffer.buffer == nullptr) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		ThreadBuffer* free = nullptr;
+		for (const auto& buffer : _threadBuffers) {
+			bool inUse = false;
+			if (buffer->inUse.compare_exchange_strong(inUse, true, std::memory_order_acquire)) {
+				free = buffer.get();
+				break;
+			}
+		}
+
+		if (free == nullptr) {
+			std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+			buffer->thread = static_cast<uint32_t>(_threadBuffers.size());
+			buffer->events.resize(_frameCapacity * eventsPerFrame);
+			free = buffer.get();
+			_threadBuffers.push_back(std::move(buffer));
+		}
+
+		threadBuffer.buffer = free;
+		threadBuffer.inUse = &free->inUse;
+	}
+
+	return *static_cast<ThreadBuffer*>(threadBuffer.buffer);
+}
+
+
+/*
+ * @brief copy the events of a ring still in it, oldest first
+ * @detail the owner keeps recording meanwhile, the events it overwrote during the copy are
+ *         dropped afterwards
+ * @param buffer ring of a thread
+ * @param events copied events as output
+ */
+void Profiler::_copyEvents(const ThreadBuffer& buffer, std::vector<Event>& events) {
+	events.clear();
+	const size_t capacity = buffer.events.size();
+	const uint64_t written = buffer.written.load(std::memory_order_acquire);
+	const uint64_t first = written > capacity ? written - capacity : 0;
+	for (uint64_t i = first; i < written; ++i) {
+		events.push_back(buffer.events[i % capacity]);
+	}
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	const uint64_t rewritten = buffer.written.load(std::memory_order_relaxed);
+	const uint64_t valid = rewritten > capacity ? rewritten - capacity : 0;
+	if (valid > first) {
+		events.erase(events.begin(), events.begin() + static_cast<ptrdiff_t>(std::min(valid, written) - first));
+	}
+}
+
+
+/*
+ * @brief constructor, record the events of the calling thread in a frame
+ * @param frame frame number, usually reserved by Profiler::reserveFrame
+ */
+ScopedFrame::ScopedFrame(uint32_t frame) : _previous(threadFrame) {
+	threadFrame = frame;
+}
+
+
+/*
+ * @brief destructor, record in the frame of the enclosing scope again
+ */
+ScopedFrame::~ScopedFrame() {
+	threadFrame = _previous;
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+/**
+ * @brief per stage wall clock profiler keeping the last frames of every thread
+ * @detail stages are timed by PROFILE_SCOPE and recorded into a fixed ring of events owned
+ *         by the recording thread, which writes it without a lock and never allocates after
+ *         its first event. The export keeps the events of the last frames that are still in
+ *         the rings. The ring of an exiting thread is handed to the next new thread. Scopes
+ *         belong at the stage level, not around single triangles or objects. Defining
+ *         DISABLE_PROFILER compiles all PROFILE_ macros to nothing
+ */
+class Profiler {
+public:
+	/*
+	 * @brief pipeline stages, nested stages overlap their parent
+	 */
+	enum class Stage : uint8_t {
+		Frame,
+		Transform,
+		TriangleSetup,
+		Culling,
+		Clipping,
+		Binning,
+		Rasterization,
+		HiZUpdate,
+		OctreeTraversal,
+		Reprojection,
+		Count
+	};
+
+	/*
+	 * @brief one timed scope, times in nanoseconds since the start of the process
+	 */
+	struct Event {
+		uint32_t frame;
+		uint32_t thread;
+		Stage stage;
+		int64_t begin;
+		int64_t end;
+	};
+
+	/*
+	 * @brief get the profiler of the process
+	 */
+	static Profiler& getInstance();
+
+	Profiler(const Profiler&) = delete;
+	Profiler& operator=(const Profiler&) = delete;
+
+	/*
+	 * @brief start or stop recording
+	 */
+	void setEnabled(bool enabled);
+
+	/*
+	 * @brief check whether the scopes are recorded
+	 */
+	bool isEnabled() const;
+
+	/*
+	 * @brief set the number of frames kept per thread, dropping the recorded ones
+	 */
+	void setFrameCapacity(size_t frameCapacity);
+
+	/*
+	 * @brief get the number of frames kept per thread
+	 */
+	size_t getFrameCapacity() const;
+
+	/*
+	 * @brief get the number of a new frame whose stages may run before it begins
+	 */
+	uint32_t reserveFrame();
+
+	/*
+	 * @brief start the next frame, the following events are recorded for it
+	 */
+	void beginFrame();
+
+	/*
+	 * @brief start a reserved frame, the following events are recorded for it
+	 */
+	void beginFrame(uint32_t frame);
+
+	/*
+	 * @brief get the frame the calling thread records in
+	 */
+	uint32_t getFrame() const;
+
+	/*
+	 * @brief record a timed scope of the calling thread in its frame
+	 */
+	void record(Stage stage, int64_t begin, int64_t end);
+
+	/*
+	 * @brief get the events of the kept frames of all threads ordered by their begin
+	 */
+	std::vector<Event> getEvents() const;
+
+	/*
+	 * @brief get the time spent in a stage in a frame summed over the threads
+	 */
+	double getStageMilliseconds(uint32_t frame, Stage stage) const;
+
+	/*
+	 * @brief write the kept events as CSV
+	 */
+	void writeCsv(std::ostream& out) const;
+
+	/*
+	 * @brief write the kept events in the Chrome trace event format
+	 */
+	void writeChromeTrace(std::ostream& out) const;
+
+	/*
+	 * @brief get the current time in nanoseconds since the start of the process
+	 */
+	static int64_t now();
+
+	/*
+	 * @brief get the name of a stage
+	 */
+	static const char* getStageName(Stage stage);
+
+private:
+	/* events kept per thread for each kept frame */
+	static const size_t eventsPerFrame = 512;
+
+	struct ThreadBuffer {
+		uint32_t thread = 0;
+		/* cleared by the owning thread when it exits, the buffer is then reused */
+		std::atomic<bool> inUse{ true };
+		/* events recorded so far, the ring holds the last ones, written by the owner only */
+		std::atomic<uint64_t> written{ 0 };
+		/* ring of events indexed by their number modulo the capacity */
+		std::vector<Event> events;
+	};
+
+	std::atomic<bool> _enabled{ true };
+	/* the current frame and the last reserved one, which is ahead while stages run ahead */
+	std::atomic<uint32_t> _frame{ 0 };
+	std::atomic<uint32_t> _lastFrame{ 0 };
+
+	/* guards the capacity and the list of buffers, not their content */
+	mutable std::mutex _mutex;
+	size_t _frameCapacity = 64;
+	std::vector<std::unique_ptr<ThreadBuffer>> _threadBuffers;
+
+	/*
+	 * @brief constructor, recording enabled
+	 */
+	Profiler() = default;
+
+	/*
+	 * @brief get the buffer of the calling thread, taken on its first event
+	 */
+	ThreadBuffer& _getThreadBuffer();
+
+	/*
+	 * @brief copy the events of a ring still in it, oldest first
+	 */
+	static void _copyEvents(const ThreadBuffer& buffer, std::vector<Event>& events);
+};
+
+/**
+ * @brief records the time between its construction and destruction as a stage
+ */
+class ScopedTimer {
+public:
+	explicit ScopedTimer(Profiler::Stage stage)
+		: _stage(stage), _begin(Profiler::getInstance().isEnabled() ? Profiler::now() : -1) { }
+
+	~ScopedTimer() {
+		if (_begin >= 0) {
+			Profiler::getInstance().record(_stage, _begin, Profiler::now());
+		}
+	}
+
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+	Profiler::Stage _stage;
+	int64_t _begin;
+};
+
+/**
+ * @brief records the events of the calling thread in a given frame instead of the current one
+ * @detail for stages running ahead of the current frame on other threads, scopes may nest
+ */
+class ScopedFrame {
+public:
+	explicit ScopedFrame(uint32_t frame);
+
+	~ScopedFrame();
+
+	ScopedFrame(const ScopedFrame&) = delete;
+	ScopedFrame& operator=(const ScopedFrame&) = delete;
+
+private:
+	/* frame of the enclosing scope */
+	int64_t _previous;
+};
+
+#ifndef DISABLE_PROFILER
+#define PROFILE_CONCATENATE_(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_(a, b)
+#define PROFILE_SCOPE(stage) ScopedTimer PROFILE_CONCATENATE(profileScope, __LINE__)(Profiler::Stage::stage)
+#define PROFILE_RESERVE_FRAME() Profiler::getInstance().reserveFrame()
+#define PROFILE_BEGIN_FRAME(...) Profiler::getInstance().beginFrame(__VA_ARGS__)
+#define PROFILE_FRAME(frame) ScopedFrame PROFILE_CONCATENATE(profileFrame, __LINE__)(frame)
+#else
+#define PROFILE_SCOPE(stage)
+#define PROFILE_RESERVE_FRAME() 0u
+#define PROFILE_BEGIN_FRAME(...)
+#define PROFILE_FRAME(frame)
+#endif
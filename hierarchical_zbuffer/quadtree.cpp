@@ -1,72 +1,479 @@
+#include <algorithm>
+
 #include "quadtree.h"
 
-QuadTree::QuadTree(int Width, int Height) {
-	width = Width;
-	height = Height;
-	frameBuffer = new float[width * height];
-	zBuffer = new float[width*height];
-	memset(zBuffer, FLT_MIN, width*height * sizeof(float));
-	root = new QuadTreeNode(1);
+namespace {
+	/* spread the low 16 bits of v to the even bits */
+	inline uint32_t spreadBits(uint32_t v) {
+		v &= 0x0000FFFF;
+		v = (v | (v << 8)) & 0x00FF00FF;
+		v = (v | (v << 4)) & 0x0F0F0F0F;
+		v = (v | (v << 2)) & 0x33333333;
+		v = (v | (v << 1)) & 0x55555555;
+		return v;
+	}
 
-	buildQuadTree();
+	/* gather the even bits of v to the low 16 bits */
+	inline uint32_t compactBits(uint32_t v) {
+		v &= 0x55555555;
+		v = (v | (v >> 1)) & 0x33333333;
+		v = (v | (v >> 2)) & 0x0F0F0F0F;
+		v = (v | (v >> 4)) & 0x00FF00FF;
+		v = (v | (v >> 8)) & 0x0000FFFF;
+		return v;
+	}
 }
 
-void QuadTree::buildQuadTree() {
-	root->box = new QuadBoundingBox{ 0, width, 0, height, (width + 1) / 2, (height + 1) / 2 };
-	root->z = FLT_MIN;
-	splitNode(root);
+
+/*
+ * @brief constructor, allocate the pyramid levels above a width x height z-buffer
+ * @param width width of the z-buffer
+ * @param height height of the z-buffer
+ * @param zBuffer z-buffer stored row by row, it must outlive the quad tree
+ * @param stride distance between two rows of the z-buffer, at least width
+ */
+QuadTree::QuadTree(int width, int height, const float* zBuffer, int stride)
+	: _width(width), _height(height), _depth(0), _zBuffer(zBuffer), _stride(stride) {
+	while ((1 << _depth) < std::max(width, height)) {
+		++_depth;
+	}
+
+	size_t offset = 0;
+	for (size_t level = 0; level <= _depth; ++level) {
+		const int cellSize = 1 << (_depth - level);
+		_levelWidth.push_back((width + cellSize - 1) / cellSize);
+		_levelHeight.push_back((height + cellSize - 1) / cellSize);
+		_levelOffset.push_back(offset);
+		if (level < _depth) {
+			offset += static_cast<size_t>(_levelWidth.back()) * _levelHeight.back();
+		}
+	}
+
+	_levels.resize(offset, 1.0f);
+	_dirtyFlags.resize(offset, 0);
+	_dirtyCells.resize(_depth);
 }
 
-void QuadTree::splitNode(QuadTreeNode* node) {
-	QuadBoundingBox* box = node->box;
-	if (box->xr - box->xl <= 1 && box->yr - box->yl <= 1)
-		return;
 
-	for (int i = 0; i < 4; ++i) {
-		if ((box->xr <= box->centerX && i & 1) ||
-			box->yr <= box->centerY && i & 2)
+/*
+ * @brief rebuild all pyramid levels from the z-buffer
+ * @detail every cell takes the farthest, and if two-sided the nearest, depth of its existing
+ *         children, bottom up
+ */
+void QuadTree::buildQuadTree() {
+	for (size_t level = _depth; level-- > 0;) {
+		const int w = _levelWidth[level];
+		const int h = _levelHeight[level];
+		const int childWidth = _levelWidth[level + 1];
+		const int childHeight = _levelHeight[level + 1];
+		int childPitch;
+		const float* child = _getLevel(level + 1, childPitch);
+		float* cell = &_levels[_levelOffset[level]];
+
+		for (int y = 0; y < h; ++y) {
+			const float* row0 = child + static_cast<size_t>(2 * y) * childPitch;
+			const float* row1 = 2 * y + 1 < childHeight ? row0 + childPitch : row0;
+			for (int x = 0; x < w; ++x) {
+				const int x0 = 2 * x;
+				const int x1 = x0 + 1 < childWidth ? x0 + 1 : x0;
+				cell[static_cast<size_t>(y) * w + x] =
+					std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+			}
+		}
+
+		if (!_twoSided) {
 			continue;
-		QuadTreeNode* nodeTemp = new QuadTreeNode((node->locCode << 2) | i);
-		switch (i) {
-		case 0:
-			nodeTemp->box = new QuadBoundingBox{ box->xl, box->centerX, box->yl, box->centerY, (box->xl + box->centerX + 1) / 2, (box->yl + box->centerY + 1) / 2 };
-			break;
-		case 1:
-			nodeTemp->box = new QuadBoundingBox{ box->centerX, box->xr, box->yl, box->centerY, (box->centerX + box->xr + 1) / 2, (box->yl + box->centerY + 1) / 2 };
-			break;
-		case 2:
-			nodeTemp->box = new QuadBoundingBox{ box->xl, box->centerX, box->centerY, box->yr, (box->xl + box->centerX + 1) / 2, (box->centerY + box->yr + 1) / 2 };
-			break;
-		case 3:
-			nodeTemp->box = new QuadBoundingBox{ box->centerX, box->xr, box->centerY, box->yr, (box->centerX + box->xr + 1) / 2, (box->centerY + box->yr + 1) / 2 };
-			break;
 		}
-		nodeTemp->z = node->z;
-		node->childExists |= (1 << i);
-		nodes[nodeTemp->locCode] = *nodeTemp;
-	}
-	// ӽڵ
-	for (int i = 0; i < 3; ++i) {
-		if (node->childExists&(1 << i)) {
-			const uint32_t locCodeChild = (node->locCode << 2) | i;
-			// splitNode(&nodes[locCodeChild]);
-			auto* child = lookupNode(locCodeChild);
-			splitNode(child);
+
+		const float* nearestChild = _getNearestLevel(level + 1, childPitch);
+		float* nearestCell = &_nearestLevels[_levelOffset[level]];
+		for (int y = 0; y < h; ++y) {
+			const float* row0 = nearestChild + static_cast<size_t>(2 * y) * childPitch;
+			const float* row1 = 2 * y + 1 < childHeight ? row0 + childPitch : row0;
+			for (int x = 0; x < w; ++x) {
+				const int x0 = 2 * x;
+				const int x1 = x0 + 1 < childWidth ? x0 + 1 : x0;
+				nearestCell[static_cast<size_t>(y) * w + x] =
+					std::min(std::min(row0[x0], row0[x1]), std::min(row1[x0], row1[x1]));
+			}
 		}
 	}
+
+	std::fill(_dirtyFlags.begin(), _dirtyFlags.end(), 0);
+	for (auto& cells : _dirtyCells) {
+		cells.clear();
+	}
+	_dirty = false;
 }
 
-QuadTreeNode* QuadTree::getParentNode(QuadTreeNode* node) {
-	const uint32_t locCodeParent = node->locCode >> 2;
-	return lookupNode(locCodeParent);
+
+/*
+ * @brief keep the nearest depth of every cell too, from the next rebuild on
+ * @detail until the rebuild the nearest depths are 0, so nothing is proven visible
+ * @param twoSided true to keep the nearest depths
+ */
+void QuadTree::setTwoSided(bool twoSided) {
+	_twoSided = twoSided;
+	if (twoSided) {
+		_nearestLevels.assign(_levels.size(), 0.0f);
+	} else {
+		_nearestLevels.clear();
+		_nearestLevels.shrink_to_fit();
+	}
 }
 
-QuadTreeNode* QuadTree::lookupNode(uint32_t locCode) {
-	return &nodes[locCode];
+
+/*
+ * @brief find the smallest node covering the pixel region [xl, xr) x [yl, yr)
+ * @detail the level follows from the highest bit in which the corner pixels differ
+ * @param xl, xr non-empty column range inside the z-buffer
+ * @param yl, yr non-empty row range inside the z-buffer
+ * @return location code of the covering node
+ */
+uint32_t QuadTree::findCoveringNode(int xl, int xr, int yl, int yr) const {
+	uint32_t diff = static_cast<uint32_t>((xl ^ (xr - 1)) | (yl ^ (yr - 1)));
+	size_t shift = 0;
+	for (; diff != 0; diff >>= 1) {
+		++shift;
+	}
+
+	return getLocCode(_depth - shift, xl >> shift, yl >> shift);
 }
 
-size_t QuadTree::getNodeTreeDepth(const QuadTreeNode* node) {
-	int depth = 0;
-	for (uint32_t lc = node->locCode; lc != 1; lc >>= 2, ++depth);
+
+/*
+ * @brief get a conservative farthest depth of the pixel region [xl, xr) x [yl, yr)
+ * @detail picks the level whose cells are at least as large as the region, so the region
+ *         overlaps at most 2 x 2 cells, which is much tighter than the single covering node
+ *         when the region straddles the boundary of a coarse cell
+ * @param xl, xr non-empty column range inside the z-buffer
+ * @param yl, yr non-empty row range inside the z-buffer
+ * @return farthest depth of the overlapped cells
+ */
+float QuadTree::getRegionZ(int xl, int xr, int yl, int yr) const {
+	const size_t shift = _getRegionShift(xl, xr, yl, yr);
+	if (shift >= _depth) {
+		return _levels.empty() ? _zBuffer[0] : _levels[0];
+	}
+
+	int pitch;
+	const float* cells = _getLevel(_depth - shift, pitch);
+	float z = 0.0f;
+	for (int y = yl >> shift; y <= (yr - 1) >> shift; ++y) {
+		for (int x = xl >> shift; x <= (xr - 1) >> shift; ++x) {
+			z = std::max(z, cells[static_cast<size_t>(y) * pitch + x]);
+		}
+	}
+
+	return z;
+}
+
+
+/*
+ * @brief get a conservative nearest depth of the pixel region [xl, xr) x [yl, yr)
+ * @detail reads the same at most 2 x 2 cells as getRegionZ
+ * @param xl, xr non-empty column range inside the z-buffer
+ * @param yl, yr non-empty row range inside the z-buffer
+ * @return nearest depth of the overlapped cells, 0 if the pyramid is not two-sided
+ */
+float QuadTree::getRegionNearestZ(int xl, int xr, int yl, int yr) const {
+	if (!_twoSided) {
+		return 0.0f;
+	}
+
+	const size_t shift = _getRegionShift(xl, xr, yl, yr);
+	if (shift >= _depth) {
+		return _nearestLevels.empty() ? _zBuffer[0] : _nearestLevels[0];
+	}
+
+	int pitch;
+	const float* cells = _getNearestLevel(_depth - shift, pitch);
+	float z = 1.0f;
+	for (int y = yl >> shift; y <= (yr - 1) >> shift; ++y) {
+		for (int x = xl >> shift; x <= (xr - 1) >> shift; ++x) {
+			z = std::min(z, cells[static_cast<size_t>(y) * pitch + x]);
+		}
+	}
+
+	return z;
+}
+
+
+/*
+ * @brief mark the cells over the written pixels [xl, xr) of row y of the z-buffer dirty
+ * @detail only the cells of the level above the pixels are queued, their ancestors are
+ *         queued by updateDirty if their depth changes
+ * @param xl, xr non-empty column range inside the z-buffer
+ * @param y row inside the z-buffer
+ */
+void QuadTree::markDirty(int xl, int xr, int y) {
+	if (_depth == 0) {
+		return;
+	}
+
+	for (int x = xl >> 1; x <= (xr - 1) >> 1; ++x) {
+		_markCellDirty(_depth - 1, x, y >> 1);
+	}
+	_dirty = true;
+}
+
+
+/*
+ * @brief recompute the dirty cells bottom up, stopping at ancestors whose depths are unchanged
+ * @detail a cell shared by many written pixels or dirty children is recomputed once.
+ *         As writes only decrease depths, the nearest depth of the cells above the pixels
+ *         is lowered into the ancestors directly, the farthest depth is recomputed from the
+ *         children of every dirty cell
+ */
+void QuadTree::updateDirty() {
+	if (!_dirty) {
+		return;
+	}
+
+	for (size_t level = _depth; level-- > 0;) {
+		const int w = _levelWidth[level];
+		const int childWidth = _levelWidth[level + 1];
+		const int childHeight = _levelHeight[level + 1];
+		int childPitch;
+		const float* child = _getLevel(level + 1, childPitch);
+		float* cell = &_levels[_levelOffset[level]];
+		uint8_t* flag = &_dirtyFlags[_levelOffset[level]];
+		const bool pixelChildren = level + 1 == _depth;
+
+		for (uint32_t packed : _dirtyCells[level]) {
+			const int x = static_cast<int>(packed & 0xFFFF);
+			const int y = static_cast<int>(packed >> 16);
+			const int x0 = 2 * x;
+			const int x1 = x0 + 1 < childWidth ? x0 + 1 : x0;
+			const float* row0 = child + static_cast<size_t>(2 * y) * childPitch;
+			const float* row1 = 2 * y + 1 < childHeight ? row0 + childPitch : row0;
+			const float z = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+			if (pixelChildren && _twoSided) {
+				_lowerNearestZ(level, x, y, std::min(std::min(row0[x0], row0[x1]), std::min(row1[x0], row1[x1])));
+			}
+
+			const size_t index = static_cast<size_t>(y) * w + x;
+			flag[index] = 0;
+			if (cell[index] != z) {
+				cell[index] = z;
+				if (level > 0) {
+					_markCellDirty(level - 1, x >> 1, y >> 1);
+				}
+			}
+		}
+		_dirtyCells[level].clear();
+
+		/* only this update queues cells above the pixel level */
+		if (level > 0 && _dirtyCells[level - 1].empty()) {
+			break;
+		}
+	}
+	_dirty = false;
+}
+
+
+/*
+ * @brief get the level of the node, the root is at level 0
+ * @param locCode location code of the node
+ * @return level of the node
+ */
+size_t QuadTree::getNodeTreeDepth(uint32_t locCode) {
+	size_t depth = 0;
+	if (locCode >= (1u << 16)) { locCode >>= 16; depth += 8; }
+	if (locCode >= (1u << 8)) { locCode >>= 8; depth += 4; }
+	if (locCode >= (1u << 4)) { locCode >>= 4; depth += 2; }
+	if (locCode >= (1u << 2)) { depth += 1; }
 	return depth;
-}
\ No newline at end of file
+}
+
+
+/*
+ * @brief get the location code of the node at level with cell coordinate (x, y)
+ * @param level level of the node, the root is at level 0
+ * @param x column of the cell in the level
+ * @param y row of the cell in the level
+ * @return location code of the node
+ */
+uint32_t QuadTree::getLocCode(size_t level, int x, int y) {
+	return (1u << (2 * level)) | spreadBits(static_cast<uint32_t>(x)) | (spreadBits(static_cast<uint32_t>(y)) << 1);
+}
+
+
+/*
+ * @brief check whether the node covers at least one pixel of the z-buffer
+ * @param locCode location code of the node
+ * @return true if the node exists
+ */
+bool QuadTree::nodeExists(uint32_t locCode) const {
+	size_t level;
+	int x, y;
+	_decodeLocCode(locCode, level, x, y);
+	return level <= _depth && x < _levelWidth[level] && y < _levelHeight[level];
+}
+
+
+/*
+ * @brief get the farthest depth inside the node
+ * @param locCode location code of an existing node
+ * @return farthest depth inside the node
+ */
+float QuadTree::getNodeZ(uint32_t locCode) const {
+	size_t level;
+	int x, y;
+	_decodeLocCode(locCode, level, x, y);
+
+	int pitch;
+	const float* cells = _getLevel(level, pitch);
+	return cells[static_cast<size_t>(y) * pitch + x];
+}
+
+
+/*
+ * @brief get the nearest depth inside the node
+ * @param locCode location code of an existing node
+ * @return nearest depth inside the node, 0 if the pyramid is not two-sided
+ */
+float QuadTree::getNodeNearestZ(uint32_t locCode) const {
+	if (!_twoSided) {
+		return 0.0f;
+	}
+
+	size_t level;
+	int x, y;
+	_decodeLocCode(locCode, level, x, y);
+
+	int pitch;
+	const float* cells = _getNearestLevel(level, pitch);
+	return cells[static_cast<size_t>(y) * pitch + x];
+}
+
+
+/*
+ * @brief get the pixel region covered by the node, clamped to the z-buffer
+ * @param locCode location code of an existing node
+ * @return covered pixels in [xl, xr) x [yl, yr)
+ */
+QuadBoundingBox QuadTree::getNodeBox(uint32_t locCode) const {
+	size_t level;
+	int x, y;
+	_decodeLocCode(locCode, level, x, y);
+
+	const int shift = static_cast<int>(_depth - level);
+	const int cellSize = 1 << shift;
+	QuadBoundingBox box;
+	box.xl = x << shift;
+	box.yl = y << shift;
+	box.xr = std::min(box.xl + cellSize, _width);
+	box.yr = std::min(box.yl + cellSize, _height);
+	box.centerX = std::min(box.xl + cellSize / 2, box.xr);
+	box.centerY = std::min(box.yl + cellSize / 2, box.yr);
+	return box;
+}
+
+
+/*
+ * @brief get the bytes used by the pyramid levels, the z-buffer excluded
+ * @return memory footprint in bytes
+ */
+size_t QuadTree::getMemoryFootprint() const {
+	size_t dirtyCells = 0;
+	for (const auto& cells : _dirtyCells) {
+		dirtyCells += cells.capacity();
+	}
+
+	return (_levels.size() + _nearestLevels.size()) * sizeof(float) + _dirtyFlags.size() * sizeof(uint8_t) + dirtyCells * sizeof(uint32_t) +
+		(_levelWidth.size() + _levelHeight.size()) * sizeof(int) +
+		_levelOffset.size() * sizeof(size_t);
+}
+
+
+/*
+ * @brief get the first cell of the level and the distance between its rows
+ * @param level level of the pyramid, the pixel level is the z-buffer
+ * @param pitch distance between two rows of the level as output
+ * @return first cell of the level
+ */
+const float* QuadTree::_getLevel(size_t level, int& pitch) const {
+	if (level == _depth) {
+		pitch = _stride;
+		return _zBuffer;
+	}
+
+	pitch = _levelWidth[level];
+	return &_levels[_levelOffset[level]];
+}
+
+
+/*
+ * @brief get the first nearest depth of the level and the distance between its rows
+ * @param level level of the pyramid, the pixel level is the z-buffer
+ * @param pitch distance between two rows of the level as output
+ * @return first nearest depth of the level
+ */
+const float* QuadTree::_getNearestLevel(size_t level, int& pitch) const {
+	if (level == _depth) {
+		pitch = _stride;
+		return _zBuffer;
+	}
+
+	pitch = _levelWidth[level];
+	return &_nearestLevels[_levelOffset[level]];
+}
+
+
+/*
+ * @brief get the shift from pixels to the cells of the level at least as large as the region
+ * @param xl, xr non-empty column range
+ * @param yl, yr non-empty row range
+ * @return log2 of the cell size, at least the tree depth for the root
+ */
+size_t QuadTree::_getRegionShift(int xl, int xr, int yl, int yr) {
+	const int extent = std::max(xr - xl, yr - yl);
+	size_t shift = 0;
+	while ((1 << shift) < extent) {
+		++shift;
+	}
+
+	return shift;
+}
+
+
+/*
+ * @brief lower the nearest depth of the cell and its ancestors to z
+ * @detail stops at the first ancestor already as near as z
+ * @param level level of the cell above the pixels
+ * @param x column of the cell in the level
+ * @param y row of the cell in the level
+ * @param z new nearest depth of a part of the cell
+ */
+void QuadTree::_lowerNearestZ(size_t level, int x, int y, float z) {
+	for (;;) {
+		float& nearestZ = _nearestLevels[_levelOffset[level] + static_cast<size_t>(y) * _levelWidth[level] + x];
+		if (nearestZ <= z) {
+			return;
+		}
+
+		nearestZ = z;
+		if (level == 0) {
+			return;
+		}
+		--level;
+		x >>= 1;
+		y >>= 1;
+	}
+}
+
+
+/*
+ * @brief split a location code to its level and cell coordinate
+ * @param locCode location code of the node
+ * @param level level of the node as output
+ * @param x column of the cell in the level as output
+ * @param y row of the cell in the level as output
+ */
+void QuadTree::_decodeLocCode(uint32_t locCode, size_t& level, int& x, int& y) {
+	level = getNodeTreeDepth(locCode);
+	const uint32_t morton = locCode ^ (1u << (2 * level));
+	x = static_cast<int>(compactBits(morton));
+	y = static_cast<int>(compactBits(morton >> 1));
+}
@@ -1,7 +1,8 @@
 #pragma once
-#include "mesh.h"
-#include <climits>
-#include <unordered_map>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 
 struct QuadBoundingBox {
 	int xl, xr;
@@ -9,34 +10,200 @@ struct QuadBoundingBox {
 	int centerX, centerY;
 };
 
-class QuadTreeNode {
-public:
-	QuadBoundingBox* box;
-	float z;
-	uint32_t locCode;
-	uint8_t childExists;
-	QuadTreeNode() {}
-	QuadTreeNode(uint32_t LocCode) {
-		locCode = LocCode;
-		childExists = 0;
-	}
-};
-
+/**
+ * @brief implicit hierarchical z pyramid
+ * @detail nodes are addressed by Morton style location codes, the root is 1 and the
+ *         children of a node are (locCode << 2) | i, where bit 0 of i selects the right
+ *         half and bit 1 selects the bottom half. A node at level l covers a square of
+ *         2^(depth - l) pixels and stores the farthest depth inside it, which proves geometry
+ *         behind it hidden. A two-sided pyramid also stores the nearest depth, which proves
+ *         geometry in front of it visible.
+ *         The pixel level is the z-buffer itself, the coarser levels are stored row by
+ *         row in one contiguous array, so parent and child lookups are index arithmetic.
+ *         Written pixels only mark their cells dirty, updateDirty recomputes the dirty cells
+ *         and the ancestors whose depth changed, so its cost follows the pixels written
+ *         and not the size of the z-buffer. Until then the pyramid is stale but conservative,
+ *         as writes only decrease depths.
+ */
 class QuadTree {
 public:
-	QuadTree(int Width, int Height);
+	/*
+	 * @brief constructor, allocate the pyramid levels above a width x height z-buffer
+	 */
+	QuadTree(int width, int height, const float* zBuffer, int stride);
+
+	/*
+	 * @brief default destructor
+	 */
+	~QuadTree() = default;
+
+	/*
+	 * @brief rebuild all pyramid levels from the z-buffer
+	 */
 	void buildQuadTree();
-	void splitNode(QuadTreeNode* node);
-	//void search
 
-	QuadTreeNode* getParentNode(QuadTreeNode* node);
-	QuadTreeNode* lookupNode(uint32_t locCode);
-	size_t getNodeTreeDepth(const QuadTreeNode* node);
+	/*
+	 * @brief keep the nearest depth of every cell too, from the next rebuild on
+	 */
+	void setTwoSided(bool twoSided);
+
+	/*
+	 * @brief check whether the nearest depths are kept
+	 */
+	bool isTwoSided() const {
+		return _twoSided;
+	}
+
+	/*
+	 * @brief get the location code of the root node
+	 */
+	static uint32_t getRootLocCode() {
+		return 1;
+	}
+
+	/*
+	 * @brief get the location code of the parent node
+	 */
+	static uint32_t getParentLocCode(uint32_t locCode) {
+		return locCode >> 2;
+	}
+
+	/*
+	 * @brief get the location code of the i-th child node
+	 */
+	static uint32_t getChildLocCode(uint32_t locCode, int i) {
+		return (locCode << 2) | static_cast<uint32_t>(i);
+	}
+
+	/*
+	 * @brief get the level of the node, the root is at level 0
+	 */
+	static size_t getNodeTreeDepth(uint32_t locCode);
+
+	/*
+	 * @brief get the location code of the node at level with cell coordinate (x, y)
+	 */
+	static uint32_t getLocCode(size_t level, int x, int y);
+
+	/*
+	 * @brief find the smallest node covering the pixel region [xl, xr) x [yl, yr)
+	 */
+	uint32_t findCoveringNode(int xl, int xr, int yl, int yr) const;
+
+	/*
+	 * @brief get a conservative farthest depth of the pixel region [xl, xr) x [yl, yr)
+	 */
+	float getRegionZ(int xl, int xr, int yl, int yr) const;
+
+	/*
+	 * @brief get a conservative nearest depth of the pixel region [xl, xr) x [yl, yr)
+	 */
+	float getRegionNearestZ(int xl, int xr, int yl, int yr) const;
+
+	/*
+	 * @brief mark the cells over the written pixels [xl, xr) of row y of the z-buffer dirty
+	 */
+	void markDirty(int xl, int xr, int y);
+
+	/*
+	 * @brief recompute the dirty cells bottom up, stopping at ancestors whose depth is unchanged
+	 */
+	void updateDirty();
+
+	/*
+	 * @brief check whether written pixels are not yet in the pyramid
+	 */
+	bool isDirty() const {
+		return _dirty;
+	}
+
+	/*
+	 * @brief get the level of the pixel nodes
+	 */
+	size_t getTreeDepth() const {
+		return _depth;
+	}
+
+	/*
+	 * @brief check whether the node covers at least one pixel of the z-buffer
+	 */
+	bool nodeExists(uint32_t locCode) const;
+
+	/*
+	 * @brief get the farthest depth inside the node
+	 */
+	float getNodeZ(uint32_t locCode) const;
+
+	/*
+	 * @brief get the nearest depth inside the node
+	 */
+	float getNodeNearestZ(uint32_t locCode) const;
+
+	/*
+	 * @brief get the pixel region covered by the node, clamped to the z-buffer
+	 */
+	QuadBoundingBox getNodeBox(uint32_t locCode) const;
+
+	/*
+	 * @brief get the bytes used by the pyramid levels, the z-buffer excluded
+	 */
+	size_t getMemoryFootprint() const;
 
 private:
-	QuadTreeNode* root;
-	float* frameBuffer;
-	float* zBuffer;
-	int width, height;
-	std::unordered_map<uint32_t, QuadTreeNode> nodes;
-};
\ No newline at end of file
+	int _width, _height;
+	/* level of the pixel nodes */
+	size_t _depth;
+	/* finest level, owned by the frame buffer */
+	const float* _zBuffer;
+	/* distance between two rows of the z-buffer */
+	int _stride;
+	/* cells per row/column and start offset of each level in _levels */
+	std::vector<int> _levelWidth;
+	std::vector<int> _levelHeight;
+	std::vector<size_t> _levelOffset;
+	/* farthest and nearest depth of the levels above the pixels, level 0 first */
+	std::vector<float> _levels;
+	std::vector<float> _nearestLevels;
+	bool _twoSided = false;
+	/* per cell of _levels whether it is queued in _dirtyCells */
+	std::vector<uint8_t> _dirtyFlags;
+	/* dirty cells per level as y << 16 | x */
+	std::vector<std::vector<uint32_t>> _dirtyCells;
+	bool _dirty = false;
+
+	/*
+	 * @brief get the first cell of the level and the distance between its rows
+	 */
+	const float* _getLevel(size_t level, int& pitch) const;
+
+	/*
+	 * @brief get the first nearest depth of the level and the distance between its rows
+	 */
+	const float* _getNearestLevel(size_t level, int& pitch) const;
+
+	/*
+	 * @brief get the shift from pixels to the cells of the level at least as large as the region
+	 */
+	static size_t _getRegionShift(int xl, int xr, int yl, int yr);
+
+	/*
+	 * @brief queue the cell at (x, y) of the level for the next update
+	 */
+	void _markCellDirty(size_t level, int x, int y) {
+		uint8_t& flag = _dirtyFlags[_levelOffset[level] + static_cast<size_t>(y) * _levelWidth[level] + x];
+		if (flag == 0) {
+			flag = 1;
+			_dirtyCells[level].push_back(static_cast<uint32_t>(y) << 16 | static_cast<uint32_t>(x));
+		}
+	}
+
+	/*
+	 * @brief lower the nearest depth of the cell and its ancestors to z
+	 */
+	void _lowerNearestZ(size_t level, int x, int y, float z);
+
+	/*
+	 * @brief split a location code to its level and cell coordinate
+	 */
+	static void _decodeLocCode(uint32_t locCode, size_t& level, int& x, int& y);
+};
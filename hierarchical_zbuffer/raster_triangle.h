@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#ifdef GLFW_INCLUDE_VULKAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+/*
+ * @brief triangle after transform, ready for rasterization
+ * @detail x, y are in pixels with the origin at the top left corner of the screen,
+ *         z is the window space depth in [0, 1], smaller value is nearer
+ */
+struct RasterTriangle {
+	glm::vec3 v[3];
+	uint32_t color;
+};
+
+/*
+ * @brief map a clip space point inside the near plane to the screen
+ */
+inline glm::vec3 projectToScreen(const glm::vec4& clip, float width, float height) {
+	const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+	return glm::vec3(
+		(ndc.x * 0.5f + 0.5f) * width,
+		(0.5f - ndc.y * 0.5f) * height,
+		ndc.z * 0.5f + 0.5f);
+}
+
+/*
+ * @brief check whether the screen space triangle lies completely outside one side
+ *        of the screen or behind the far plane
+ */
+inline bool isOutsideScreen(const RasterTriangle& triangle, float width, float height) {
+	const glm::vec3& a = triangle.v[0];
+	const glm::vec3& b = triangle.v[1];
+	const glm::vec3& c = triangle.v[2];
+	return (a.x < 0.0f && b.x < 0.0f && c.x < 0.0f) || (a.x > width && b.x > width && c.x > width) ||
+		(a.y < 0.0f && b.y < 0.0f && c.y < 0.0f) || (a.y > height && b.y > height && c.y > height) ||
+		(a.z > 1.0f && b.z > 1.0f && c.z > 1.0f);
+}
@@ -0,0 +1,911 @@
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include "mesh_optimizer.h"
+#include "profiler.h"
+#include "renderer.h"
+
+namespace {
+	/* entries of the post-transform cache the triangle order is optimized for */
+	const size_t vertexCacheSize = 16;
+
+	/*
+	 * @brief milliseconds elapsed since start
+	 */
+	double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+/*
+ * @brief pixels written per covered pixel, 1 without overdraw
+ * @return overdraw, 0 if nothing is covered
+ */
+double Renderer::FrameStatistics::getOverdraw() const {
+	return pixelsCovered > 0 ? static_cast<double>(pixelsWritten) / pixelsCovered : 0.0;
+}
+
+
+/*
+ * @brief depth tests per covered pixel
+ * @return depth complexity, 0 if nothing is covered
+ */
+double Renderer::FrameStatistics::getDepthComplexity() const {
+	return pixelsCovered > 0 ? static_cast<double>(pixelsTested) / pixelsCovered : 0.0;
+}
+
+
+/*
+ * @brief octree nodes drawn untested per node drawn untested or tested
+ * @return hit rate of the visibility persistence, 0 without octree nodes
+ */
+double Renderer::FrameStatistics::getVisibilityCacheHitRate() const {
+	const uint64_t lookups = visibilityCacheHits + nodesQueried;
+	return lookups > 0 ? static_cast<double>(visibilityCacheHits) / lookups : 0.0;
+}
+
+
+/*
+ * @brief constructor, reorder the mesh and build the acceleration structures
+ * @param mesh world space mesh, reordered for the vertex cache
+ * @param width width of the frame buffer
+ * @param height height of the frame buffer
+ * @param log stream the load and per frame statistics are printed to, nullptr for none
+ */
+Renderer::Renderer(IndexedMesh mesh, int width, int height, std::ostream* log)
+	: _width(width), _height(height), _log(log), _mesh(std::move(mesh)),
+	  _frameBuffer(width, height), _scanLineZBuffer(width, height) {
+	_prepareMesh();
+	_shadeTriangles();
+	_buildSpatialIndices();
+}
+
+
+/*
+ * @brief constructor, map the prepared mesh and its spatial indices from the cache of a model
+ * @detail the octree and bvh nodes are used in place in the mapping, the mesh is copied
+ *         out as the transform stage keeps its own layout anyway. If the cache is missing
+ *         or stale the mesh is loaded, prepared as by the other constructor and the cache
+ *         is rewritten for the next start
+ * @param modelPath model file the cache is kept next to and validated against
+ * @param loadMesh loads the world space mesh of the model, only called without a valid cache
+ * @param width width of the frame buffer
+ * @param height height of the frame buffer
+ * @param log stream the load and per frame statistics are printed to, nullptr for none
+ */
+Renderer::Renderer(const std::string& modelPath, const std::function<IndexedMesh()>& loadMesh,
+	int width, int height, std::ostream* log)
+	: _width(width), _height(height), _log(log),
+	  _frameBuffer(width, height), _scanLineZBuffer(width, height) {
+	const auto loadStart = std::chrono::high_resolution_clock::now();
+	const std::string cachePath = MeshCache::getCachePath(modelPath);
+	const uint64_t sourceStamp = MeshCache::getSourceStamp(modelPath);
+	if (_meshCache.open(cachePath, sourceStamp, _getCacheBuildStamp())) {
+		const ArrayView<glm::vec3> positions = _meshCache.getPositions();
+		const ArrayView<uint32_t> indices = _meshCache.getIndices();
+		_mesh.positions.assign(positions.begin(), positions.end());
+		_mesh.indices.assign(indices.begin(), indices.end());
+		_octree.assign(_octreeConfig, _meshCache.getOctreeDepth(), _meshCache.getOctreeNodes(), _meshCache.getOctreeTriangles());
+		_bvh.assign(_bvhConfig, _meshCache.getBvhDepth(), _meshCache.getBvhNodes(), _meshCache.getBvhTriangles());
+		_shadeTriangles();
+		if (_log) {
+			*_log << "cache: mapped " << cachePath << ", " << _meshCache.getFileSize() << " bytes, "
+				<< _mesh.positions.size() << " vertices, " << _mesh.indices.size() / 3 << " triangles, "
+				<< _octree.getNodes().size() << " octree and " << _bvh.getNodes().size() << " bvh nodes in "
+				<< millisecondsSince(loadStart) << " ms" << std::endl;
+		}
+		return;
+	}
+
+	_mesh = loadMesh();
+	if (_log) {
+		*_log << "model: loaded " << modelPath << " in " << millisecondsSince(loadStart) << " ms" << std::endl;
+	}
+	_prepareMesh();
+	_shadeTriangles();
+	_buildSpatialIndices();
+
+	const bool written = MeshCache::write(cachePath, sourceStamp, _getCacheBuildStamp(), _mesh, _octree, _bvh);
+	if (_log) {
+		*_log << "cache: " << (written ? "wrote " : "cannot write ") << cachePath << std::endl;
+	}
+}
+
+
+/*
+ * @brief render a frame with the render mode
+ * @param renderMode engine to render with
+ * @param viewProjection view projection matrix of the camera
+ * @param cameraPosition world position of the camera
+ */
+void Renderer::renderFrame(RenderMode renderMode, const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition) {
+	auto start = std::chrono::high_resolution_clock::now();
+	_frameSetup.renderMode = renderMode;
+	_frameSetup.viewProjection = viewProjection;
+	_frameSetup.cameraPosition = cameraPosition;
+	{
+		PROFILE_SCOPE(Frame);
+		setupFrame(_frameSetup);
+		PROFILE_BEGIN_FRAME(_frameSetup.frame);
+		_rasterize(_frameSetup);
+	}
+
+	_finishFrame(start);
+}
+
+
+/*
+ * @brief render a frame of the instances of a scene instead of the mesh
+ * @detail the instances are culled as a whole against the frustum and the z pyramid before
+ *         any of their triangles are transformed, the visible ones traverse the octree of their
+ *         shared mesh front to back. The scene is rendered on the calling thread in one pass,
+ *         without the tiling, the temporal culling or the visibility persistence
+ * @param scene instances of shared meshes
+ * @param viewProjection view projection matrix of the camera
+ * @param cameraPosition world position of the camera
+ */
+void Renderer::renderScene(Scene& scene, const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition) {
+	PROFILE_BEGIN_FRAME();
+	auto start = std::chrono::high_resolution_clock::now();
+	_frameTiming = FrameTiming();
+	_frameStatistics = FrameStatistics();
+	{
+		PROFILE_SCOPE(Frame);
+		_frameBuffer.clear(1.0f, FrameBuffer::packColor(_clearColor.r, _clearColor.g, _clearColor.b));
+		_renderInstances(scene, viewProjection, cameraPosition);
+	}
+
+	_finishFrame(start);
+}
+
+
+/*
+ * @brief transform, cull and set up the triangles of a frame without touching the frame buffer
+ * @detail runs on the setup thread pool and only writes the transform stage and the setup,
+ *         so it may run on one thread while rasterFrame rasterizes another setup on a second
+ *         one. The setters must not be called while either runs. The setup reserves the
+ *         profiler frame of the setup and records its stages in it, also ahead of the
+ *         frame the rasterization is in. The octree mode sets up nothing here, its traversal
+ *         in rasterFrame transforms, culls and sets up the triangles of the visible nodes
+ * @param setup frame with its render mode and camera, the triangles, counters and profiler
+ *        frame as output
+ */
+void Renderer::setupFrame(FrameSetup& setup) {
+	auto start = std::chrono::high_resolution_clock::now();
+	setup.frame = PROFILE_RESERVE_FRAME();
+	PROFILE_FRAME(setup.frame);
+	if (setup.renderMode == RenderMode::OctreeHierarchicalZBuffer) {
+		// the traversal culls and sets up the triangles of the visible nodes itself
+		setup.triangles.clear();
+		setup.statistics = TransformStage::Statistics();
+		setup.time = 0.0;
+		return;
+	}
+
+	_transformStage.transform(setup.viewProjection, static_cast<float>(_width), static_cast<float>(_height));
+	_transformStage.setupTriangles(_triangleColors, setup.triangles);
+	setup.statistics = _transformStage.getStatistics();
+	setup.time = millisecondsSince(start);
+}
+
+
+/*
+ * @brief clear the frame buffer and rasterize a frame set up by setupFrame
+ * @detail the setup time of the frame counts towards its frame time as in renderFrame, even
+ *         if the setup ran ahead on another thread. The profiler frame reserved by the setup
+ *         begins, so the stages of both are recorded in it
+ * @param setup frame set up by setupFrame, only read
+ */
+void Renderer::rasterFrame(const FrameSetup& setup) {
+	PROFILE_BEGIN_FRAME(setup.frame);
+	const auto start = std::chrono::high_resolution_clock::now() -
+		std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<double, std::milli>(setup.time));
+	{
+		PROFILE_SCOPE(Frame);
+		_rasterize(setup);
+	}
+
+	_finishFrame(start);
+}
+
+
+/*
+ * @brief render the tiles in parallel instead of the whole screen on the calling thread
+ * @param tiledRendering true for tile-binned rendering on the thread pool
+ */
+void Renderer::setTiledRendering(bool tiledRendering) {
+	_tiledRendering = tiledRendering;
+}
+
+
+/*
+ * @brief check whether the tiles are rendered in parallel
+ * @return true for tile-binned rendering
+ */
+bool Renderer::isTiledRendering() const {
+	return _tiledRendering;
+}
+
+
+/*
+ * @brief select which faces are culled in all render modes
+ * @param faceCulling faces to reject
+ */
+void Renderer::setFaceCulling(CullingStage::FaceCulling faceCulling) {
+	_faceCulling = faceCulling;
+	_transformStage.setFaceCulling(faceCulling);
+	_octreeHierarchicalZBuffer.setFaceCulling(faceCulling);
+	_tileRenderer.setFaceCulling(faceCulling);
+}
+
+
+/*
+ * @brief get which faces are culled
+ * @return face culling mode
+ */
+CullingStage::FaceCulling Renderer::getFaceCulling() const {
+	return _faceCulling;
+}
+
+
+/*
+ * @brief test the octree against the reprojected previous frame before the current one
+ * @detail the stored frame is dropped, the first octree frame after a switch renders in one pass
+ * @param temporalCulling true for the two pass traversal
+ */
+void Renderer::setTemporalCulling(bool temporalCulling) {
+	_temporalCulling = temporalCulling;
+	_temporalOcclusion.reset();
+	_octreeHierarchicalZBuffer.setTemporalOcclusion(temporalCulling ? &_temporalOcclusion : nullptr);
+	_tileRenderer.setTemporalOcclusion(temporalCulling ? &_temporalOcclusion : nullptr);
+}
+
+
+/*
+ * @brief check whether the octree is tested against the previous frame first
+ * @return true for the two pass traversal
+ */
+bool Renderer::isTemporalCulling() const {
+	return _temporalCulling;
+}
+
+
+/*
+ * @brief select the spatial index traversed by the octree render mode
+ * @detail the remembered visibility of the nodes is dropped
+ * @param spatialIndex octree or bvh
+ */
+void Renderer::setSpatialIndex(SpatialIndex spatialIndex) {
+	_spatialIndex = spatialIndex;
+	setVisibilityPersistence(_visibilityPersistence);
+}
+
+
+/*
+ * @brief get the spatial index traversed by the octree render mode
+ * @return octree or bvh
+ */
+Renderer::SpatialIndex Renderer::getSpatialIndex() const {
+	return _spatialIndex;
+}
+
+
+/*
+ * @brief remember the visible octree nodes and draw them untested in the next frames
+ * @param visibilityPersistence true for the coherent traversal
+ */
+void Renderer::setVisibilityPersistence(bool visibilityPersistence) {
+	_visibilityPersistence = visibilityPersistence;
+	_octreeHierarchicalZBuffer.setVisibilityPersistence(visibilityPersistence);
+	_tileRenderer.setVisibilityPersistence(visibilityPersistence);
+}
+
+
+/*
+ * @brief check whether the visible octree nodes are remembered
+ * @return true for the coherent traversal
+ */
+bool Renderer::isVisibilityPersistence() const {
+	return _visibilityPersistence;
+}
+
+
+/*
+ * @brief keep the nearest depths in the z pyramid and write triangles in front of them untested
+ * @param trivialAccept true for the two-sided z pyramid
+ */
+void Renderer::setTrivialAccept(bool trivialAccept) {
+	_trivialAccept = trivialAccept;
+	_hierarchicalZBuffer.setTrivialAccept(trivialAccept);
+	_tileRenderer.setTrivialAccept(trivialAccept);
+}
+
+
+/*
+ * @brief check whether triangles in front of the z pyramid are written untested
+ * @return true for the two-sided z pyramid
+ */
+bool Renderer::isTrivialAccept() const {
+	return _trivialAccept;
+}
+
+
+/*
+ * @brief select the kernel of the half-space rasterizers
+ * @param kernel kernel to use, unsupported kernels fall back to the best supported one
+ */
+void Renderer::setHalfSpaceKernel(HalfSpaceRasterizer::Kernel kernel) {
+	_halfSpaceRasterizer.setKernel(kernel);
+	_tileRenderer.setHalfSpaceKernel(kernel);
+}
+
+
+/*
+ * @brief get the kernel of the half-space rasterizers
+ * @return kernel in use
+ */
+HalfSpaceRasterizer::Kernel Renderer::getHalfSpaceKernel() const {
+	return _halfSpaceRasterizer.getKernel();
+}
+
+
+/*
+ * @brief set the stream the per frame statistics are printed to
+ * @param log output stream, nullptr for none
+ */
+void Renderer::setLog(std::ostream* log) {
+	_log = log;
+}
+
+
+/*
+ * @brief get the number of worker threads
+ * @return thread count of the pool
+ */
+size_t Renderer::getThreadCount() const {
+	return _threadPool.getThreadCount();
+}
+
+
+/*
+ * @brief get the octree parameters, also the ones of the shared meshes of a scene
+ * @return octree build parameters
+ */
+const Octree::Config& Renderer::getOctreeConfig() const {
+	return _octreeConfig;
+}
+
+
+/*
+ * @brief get the mesh in render order
+ * @return mesh after the vertex cache reordering
+ */
+const IndexedMesh& Renderer::getMesh() const {
+	return _mesh;
+}
+
+
+/*
+ * @brief get the frame buffer of the last frame
+ * @return frame buffer
+ */
+const FrameBuffer& Renderer::getFrameBuffer() const {
+	return _frameBuffer;
+}
+
+
+/*
+ * @brief get the frame buffer of the last frame to draw over, it is cleared by the next frame
+ * @return frame buffer
+ */
+FrameBuffer& Renderer::getFrameBuffer() {
+	return _frameBuffer;
+}
+
+
+/*
+ * @brief get the times of the last frame
+ * @return frame timing in milliseconds
+ */
+const Renderer::FrameTiming& Renderer::getFrameTiming() const {
+	return _frameTiming;
+}
+
+
+/*
+ * @brief get the work counters of the last frame
+ * @return frame statistics
+ */
+const Renderer::FrameStatistics& Renderer::getFrameStatistics() const {
+	return _frameStatistics;
+}
+
+
+/*
+ * @brief get the transform and setup counters of the last frame
+ * @return statistics of the transform stage, stale in the octree mode
+ */
+const TransformStage::Statistics& Renderer::getTransformStatistics() const {
+	return _transformStatistics;
+}
+
+
+/*
+ * @brief get the name of a render mode
+ * @param renderMode render mode
+ * @return short lower case name
+ */
+const char* Renderer::getRenderModeName(RenderMode renderMode) {
+	switch (renderMode) {
+		case RenderMode::ScanLineZBuffer:
+			return "scanline";
+		case RenderMode::HierarchicalZBuffer:
+			return "hierarchical";
+		case RenderMode::OctreeHierarchicalZBuffer:
+			return "octree";
+		case RenderMode::HalfSpaceRasterizer:
+			return "halfspace";
+	}
+
+	return "unknown";
+}
+
+
+/*
+ * @brief get the name of a spatial index
+ * @param spatialIndex spatial index
+ * @return lower case name
+ */
+const char* Renderer::getSpatialIndexName(SpatialIndex spatialIndex) {
+	switch (spatialIndex) {
+		case SpatialIndex::Octree:
+			return "octree";
+		case SpatialIndex::Bvh:
+			return "bvh";
+	}
+
+	return "unknown";
+}
+
+
+/*
+ * @brief reorder the triangles for the post-transform cache, then the vertices for fetching
+ */
+void Renderer::_prepareMesh() {
+	const float acmrBefore = computeACMR(_mesh.indices, _mesh.positions.size(), vertexCacheSize);
+	optimizeVertexCache(_mesh.indices, _mesh.positions.size(), vertexCacheSize);
+	optimizeVertexFetch(_mesh);
+	const float acmrAfter = computeACMR(_mesh.indices, _mesh.positions.size(), vertexCacheSize);
+	if (_log) {
+		*_log << "mesh: " << _mesh.positions.size() << " vertices, " << _mesh.indices.size() / 3
+			<< " triangles, ACMR " << acmrBefore << " -> " << acmrAfter << std::endl;
+	}
+}
+
+
+/*
+ * @brief shade the triangles and hand the mesh to the transform stage
+ */
+void Renderer::_shadeTriangles() {
+	shadeTriangles(_mesh, _triangleColors);
+	_transformStage.setMesh(_mesh.positions, _mesh.indices);
+}
+
+
+/*
+ * @brief build the octree and the bvh over the prepared mesh
+ */
+void Renderer::_buildSpatialIndices() {
+	auto buildStart = std::chrono::high_resolution_clock::now();
+	_octree.build(_mesh, _octreeConfig, _threadPool);
+	if (_log) {
+		*_log << "octree: " << _octree.getNodes().size() << " nodes, depth " << _octree.getDepth()
+			<< ", built in " << millisecondsSince(buildStart) << " ms" << std::endl;
+	}
+
+	buildStart = std::chrono::high_resolution_clock::now();
+	_bvh.build(_mesh, _bvhConfig);
+	if (_log) {
+		*_log << "bvh: " << _bvh.getNodes().size() << " nodes, depth " << _bvh.getDepth()
+			<< ", built in " << millisecondsSince(buildStart) << " ms" << std::endl;
+	}
+}
+
+
+/*
+ * @brief hash of everything the cached mesh and spatial indices depend on besides the model
+ * @return build stamp of the mesh cache
+ */
+uint64_t Renderer::_getCacheBuildStamp() const {
+	uint64_t stamp = MeshCache::hash(&vertexCacheSize, sizeof(vertexCacheSize));
+	stamp = MeshCache::hash(&_octreeConfig.maxDepth, sizeof(_octreeConfig.maxDepth), stamp);
+	stamp = MeshCache::hash(&_octreeConfig.leafSize, sizeof(_octreeConfig.leafSize), stamp);
+	stamp = MeshCache::hash(&_bvhConfig.leafSize, sizeof(_bvhConfig.leafSize), stamp);
+	stamp = MeshCache::hash(&_bvhConfig.binCount, sizeof(_bvhConfig.binCount), stamp);
+	stamp = MeshCache::hash(&_bvhConfig.nodeCost, sizeof(_bvhConfig.nodeCost), stamp);
+	return MeshCache::hash(&_bvhConfig.triangleCost, sizeof(_bvhConfig.triangleCost), stamp);
+}
+
+
+/*
+ * @brief clear the frame buffer and rasterize a set up frame with its render mode
+ * @detail culled triangles never reached the setup, triangles crossing the near plane or
+ *         the guard band were clipped
+ * @param setup frame set up by setupFrame
+ */
+void Renderer::_rasterize(const FrameSetup& setup) {
+	_frameTiming = FrameTiming();
+	_frameStatistics = FrameStatistics();
+	_frameTiming.setup = setup.time;
+	_transformStatistics = setup.statistics;
+	if (setup.renderMode != RenderMode::OctreeHierarchicalZBuffer) {
+		_collectSetupStatistics();
+		if (_log) {
+			_logSetup();
+		}
+	}
+
+	_frameBuffer.clear(1.0f, FrameBuffer::packColor(_clearColor.r, _clearColor.g, _clearColor.b));
+	switch (setup.renderMode) {
+		case RenderMode::ScanLineZBuffer:
+			_renderWithScanLineZBuffer(setup.triangles);
+			break;
+		case RenderMode::HierarchicalZBuffer:
+			_renderWithHierarchicalZBuffer(setup.triangles);
+			break;
+		case RenderMode::OctreeHierarchicalZBuffer:
+			_renderWithOctreeHierarchicalZBuffer(setup.viewProjection, setup.cameraPosition);
+			break;
+		case RenderMode::HalfSpaceRasterizer:
+			_renderWithHalfSpaceRasterizer(setup.triangles);
+			break;
+	}
+}
+
+
+/*
+ * @brief log the counters of the transform and the triangle setup
+ */
+void Renderer::_logSetup() const {
+	const auto& statistics = _transformStatistics;
+	*_log << "+ transform: " << statistics.vertices << " vertices, "
+		<< statistics.verticesClipped << " outside near plane or guard band, "
+		<< statistics.trianglesSetUp << "/" << statistics.triangles << " triangles set up, "
+		<< statistics.trianglesClipped << " clipped, " << statistics.trianglesCulled << " culled, "
+		<< statistics.trianglesOutsideScreen << " outside screen" << std::endl;
+	*_log << "+ culling: " << statistics.culling.trianglesBackfacing << " backfacing, "
+		<< statistics.culling.trianglesDegenerate << " degenerate, "
+		<< statistics.trianglesOutsideFrustum << " outside frustum ("
+		<< statistics.culling.boundsCulledSphere + statistics.culling.boundsCulledBox << "/"
+		<< statistics.culling.boundsTested << " clusters)" << std::endl;
+}
+
+
+/*
+ * @brief render with the active edge table scan-line z-buffer
+ * @param triangles screen space triangles of the setup
+ */
+void Renderer::_renderWithScanLineZBuffer(const std::vector<RasterTriangle>& triangles) {
+	auto start = std::chrono::high_resolution_clock::now();
+	ScanLineZBuffer::Statistics statistics;
+	if (_tiledRendering) {
+		_tileRenderer.renderScanLine(triangles);
+		statistics = _tileRenderer.getScanLineStatistics();
+	} else {
+		_scanLineZBuffer.render(triangles, _frameBuffer);
+		statistics = _scanLineZBuffer.getStatistics();
+	}
+	_frameTiming.raster = millisecondsSince(start);
+	_frameStatistics.trianglesSubmitted = statistics.triangles;
+	_frameStatistics.pixelsTested = statistics.pixelsTested;
+	_frameStatistics.pixelsWritten = statistics.pixelsWritten;
+
+	if (_log) {
+		*_log << "+ scan-line: " << statistics.polygons << " polygons, "
+			<< statistics.spans << " spans, "
+			<< statistics.pixelsWritten << "/" << statistics.pixelsTested << " pixels written/tested, "
+			<< 1e-3 * statistics.pixelsTested / _frameTiming.raster << " Mpixels/s" << std::endl;
+	}
+}
+
+
+/*
+ * @brief render with the block based half-space rasterizer
+ * @param triangles screen space triangles of the setup
+ */
+void Renderer::_renderWithHalfSpaceRasterizer(const std::vector<RasterTriangle>& triangles) {
+	auto start = std::chrono::high_resolution_clock::now();
+	HalfSpaceRasterizer::Statistics statistics;
+	if (_tiledRendering) {
+		_tileRenderer.renderHalfSpace(triangles);
+		statistics = _tileRenderer.getHalfSpaceStatistics();
+	} else {
+		_halfSpaceRasterizer.render(triangles);
+		statistics = _halfSpaceRasterizer.getStatistics();
+	}
+	_frameTiming.raster = millisecondsSince(start);
+	_frameStatistics.trianglesSubmitted = statistics.triangles;
+	_frameStatistics.pixelsTested = statistics.pixelsTested;
+	_frameStatistics.pixelsWritten = statistics.pixelsWritten;
+
+	if (_log) {
+		*_log << "+ half-space (" << HalfSpaceRasterizer::getKernelName(_halfSpaceRasterizer.getKernel()) << "): "
+			<< statistics.blocks << " blocks, "
+			<< statistics.blocksRejected << " rejected, "
+			<< statistics.blocksAccepted << " accepted, "
+			<< statistics.pixelsWritten << "/" << statistics.pixelsTested << " pixels written/tested, "
+			<< 1e-3 * statistics.pixelsTested / _frameTiming.raster << " Mpixels/s" << std::endl;
+	}
+}
+
+
+/*
+ * @brief render with the quad tree hierarchical z-buffer
+ * @param triangles screen space triangles of the setup
+ */
+void Renderer::_renderWithHierarchicalZBuffer(const std::vector<RasterTriangle>& triangles) {
+	auto start = std::chrono::high_resolution_clock::now();
+	HierarchicalZBuffer::Statistics statistics;
+	if (_tiledRendering) {
+		_tileRenderer.renderHierarchical(triangles);
+		statistics = _tileRenderer.getHierarchicalStatistics();
+	} else {
+		_hierarchicalZBuffer.render(triangles);
+		statistics = _hierarchicalZBuffer.getStatistics();
+	}
+	_frameTiming.raster = millisecondsSince(start);
+	_frameStatistics.trianglesSubmitted = statistics.triangles;
+	_frameStatistics.trianglesOccluded = statistics.getRejected();
+	_frameStatistics.trianglesOccludedPerLevel = statistics.rejectedPerLevel;
+	_frameStatistics.trianglesTriviallyAccepted = statistics.triviallyAccepted;
+	_frameStatistics.pixelsTested = statistics.pixelsTested;
+	_frameStatistics.pixelsWritten = statistics.pixelsWritten;
+
+	if (_log) {
+		*_log << "+ hierarchical: " << statistics.getAccepted() << " accepted, "
+			<< statistics.triviallyAccepted << " trivially, "
+			<< statistics.getRejected() << " rejected, "
+			<< statistics.pixelsWritten << "/" << statistics.pixelsTested << " pixels written/tested" << std::endl;
+		*_log << "  accepted/rejected per level:";
+		for (size_t level = 0; level < statistics.acceptedPerLevel.size(); ++level) {
+			*_log << " " << statistics.acceptedPerLevel[level] << "/" << statistics.rejectedPerLevel[level];
+		}
+		*_log << std::endl;
+	}
+}
+
+
+/*
+ * @brief render with the front to back octree or bvh traversal and the hierarchical z-buffer
+ * @detail the reprojection of the previous frame and keeping this one are timed with the traversal
+ * @param viewProjection view projection matrix of the camera
+ * @param cameraPosition world position of the camera
+ */
+void Renderer::_renderWithOctreeHierarchicalZBuffer(const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition) {
+	auto start = std::chrono::high_resolution_clock::now();
+	OctreeHierarchicalZBuffer::Statistics statistics;
+	HierarchicalZBuffer::Statistics triangleStatistics;
+	if (_temporalCulling) {
+		_temporalOcclusion.reproject(viewProjection);
+	}
+
+	if (_tiledRendering) {
+		if (_spatialIndex == SpatialIndex::Bvh) {
+			_tileRenderer.renderBvh(_bvh, _mesh, _triangleColors, viewProjection, cameraPosition);
+		} else {
+			_tileRenderer.renderOctree(_octree, _mesh, _triangleColors, viewProjection, cameraPosition);
+		}
+		statistics = _tileRenderer.getOctreeStatistics();
+		triangleStatistics = _tileRenderer.getHierarchicalStatistics();
+	} else {
+		if (_spatialIndex == SpatialIndex::Bvh) {
+			_octreeHierarchicalZBuffer.render(_bvh, _mesh, _triangleColors, viewProjection, cameraPosition);
+		} else {
+			_octreeHierarchicalZBuffer.render(_octree, _mesh, _triangleColors, viewProjection, cameraPosition);
+		}
+		statistics = _octreeHierarchicalZBuffer.getStatistics();
+		triangleStatistics = _hierarchicalZBuffer.getStatistics();
+	}
+
+	if (_temporalCulling) {
+		_temporalOcclusion.store(_frameBuffer, viewProjection);
+	}
+	_frameTiming.raster = millisecondsSince(start);
+	_collectTraversalStatistics(statistics, triangleStatistics);
+
+	if (_log) {
+		_logTraversal(getSpatialIndexName(_spatialIndex), statistics, triangleStatistics);
+		if (_visibilityPersistence) {
+			*_log << "+ visibility cache: " << statistics.visibilityCacheHits << " hits, "
+				<< statistics.nodesQueried << " nodes queried, hit rate "
+				<< _frameStatistics.getVisibilityCacheHitRate() << std::endl;
+		}
+		if (_temporalCulling) {
+			*_log << "+ temporal: " << statistics.nodesDeferred << " nodes, "
+				<< statistics.trianglesDeferred << " triangles deferred by the previous frame" << std::endl;
+		}
+	}
+}
+
+
+/*
+ * @brief cull the instances of a scene as a whole and traverse the octrees of the visible ones
+ * @detail the world bounds of all instances are tested against the frustum in batches, the
+ *         survivors are sorted front to back by the distance of the camera to their box. Each
+ *         is then tested against the z pyramid of the instances drawn before it by the object
+ *         space box of its mesh, which is tighter than its world box. The transforms and bounds
+ *         of the instances moved since the last frame are updated first
+ * @param scene instances of shared meshes
+ * @param viewProjection view projection matrix of the camera
+ * @param cameraPosition world position of the camera
+ */
+void Renderer::_renderInstances(Scene& scene, const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition) {
+	auto start = std::chrono::high_resolution_clock::now();
+	scene.update();
+	_frameTiming.setup = millisecondsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	const BoundingVolumes& bounds = scene.getBounds();
+	const size_t instanceCount = bounds.size();
+	_instanceVisible.resize(instanceCount);
+	_instanceCulling.setViewProjection(viewProjection);
+	_instanceCulling.cullBounds(bounds, 0, instanceCount, _instanceVisible.data());
+
+	_instanceOrder.clear();
+	for (size_t i = 0; i < instanceCount; ++i) {
+		if (!_instanceVisible[i]) {
+			++_frameStatistics.instancesOutside;
+			continue;
+		}
+
+		const glm::vec3 boxMin(bounds.minX[i], bounds.minY[i], bounds.minZ[i]);
+		const glm::vec3 boxMax(bounds.maxX[i], bounds.maxY[i], bounds.maxZ[i]);
+		const glm::vec3 offset = glm::max(glm::max(boxMin - cameraPosition, cameraPosition - boxMax), glm::vec3(0.0f));
+		_instanceOrder.emplace_back(glm::dot(offset, offset), static_cast<uint32_t>(i));
+	}
+	std::sort(_instanceOrder.begin(), _instanceOrder.end());
+
+	{
+		PROFILE_SCOPE(OctreeTraversal);
+		_octreeHierarchicalZBuffer.beginFrame();
+		for (const auto& entry : _instanceOrder) {
+			const Scene::Instance& instance = scene.getInstance(entry.second);
+			const Scene::SharedMesh& mesh = scene.getMesh(instance.mesh);
+			const glm::mat4x4 modelViewProjection = viewProjection * instance.transform.getModelMatrix();
+			switch (_octreeHierarchicalZBuffer.testBox(mesh.boundMin, mesh.boundMax, modelViewProjection)) {
+				case OctreeHierarchicalZBuffer::NodeVisibility::Outside:
+					++_frameStatistics.instancesOutside;
+					continue;
+				case OctreeHierarchicalZBuffer::NodeVisibility::Occluded:
+					++_frameStatistics.instancesOccluded;
+					continue;
+				default:
+					break;
+			}
+
+			++_frameStatistics.instancesDrawn;
+			const glm::vec3 objectCamera = glm::vec3(instance.transform.getModelMatrixInverse() * glm::vec4(cameraPosition, 1.0f));
+			_octreeHierarchicalZBuffer.renderObject(mesh.octree, mesh.mesh, mesh.colors, modelViewProjection, objectCamera);
+		}
+		_octreeHierarchicalZBuffer.endFrame();
+	}
+
+	_frameTiming.raster = millisecondsSince(start);
+	const OctreeHierarchicalZBuffer::Statistics& statistics = _octreeHierarchicalZBuffer.getStatistics();
+	const HierarchicalZBuffer::Statistics& triangleStatistics = _hierarchicalZBuffer.getStatistics();
+	_collectTraversalStatistics(statistics, triangleStatistics);
+
+	if (_log) {
+		*_log << "+ instances: " << _frameStatistics.instancesDrawn << "/" << instanceCount << " drawn, "
+			<< _frameStatistics.instancesOutside << " outside, "
+			<< _frameStatistics.instancesOccluded << " occluded" << std::endl;
+		_logTraversal("octree", statistics, triangleStatistics);
+	}
+}
+
+
+/*
+ * @brief copy the counters of the octree traversal and the z pyramid
+ * @param statistics counters of the traversal
+ * @param triangleStatistics counters of the z pyramid and the scan conversion
+ */
+void Renderer::_collectTraversalStatistics(const OctreeHierarchicalZBuffer::Statistics& statistics,
+	const HierarchicalZBuffer::Statistics& triangleStatistics) {
+	_frameStatistics.trianglesSubmitted = triangleStatistics.triangles;
+	_frameStatistics.trianglesBackfacing = statistics.trianglesBackfacing;
+	_frameStatistics.trianglesDegenerate = statistics.trianglesCulled - statistics.trianglesBackfacing;
+	_frameStatistics.trianglesOutsideFrustum = statistics.trianglesOutside;
+	_frameStatistics.trianglesOccluded = triangleStatistics.getRejected();
+	_frameStatistics.trianglesOccludedPerLevel = triangleStatistics.rejectedPerLevel;
+	_frameStatistics.trianglesTriviallyAccepted = triangleStatistics.triviallyAccepted;
+	_frameStatistics.nodesVisited = statistics.nodesVisited;
+	_frameStatistics.nodesOccluded = statistics.nodesCulled;
+	_frameStatistics.nodesOutside = statistics.nodesOutside;
+	_frameStatistics.nodesDeferred = statistics.nodesDeferred;
+	_frameStatistics.trianglesDeferred = statistics.trianglesDeferred;
+	_frameStatistics.nodesQueried = statistics.nodesQueried;
+	_frameStatistics.visibilityCacheHits = statistics.visibilityCacheHits;
+	_frameStatistics.pixelsTested = triangleStatistics.pixelsTested;
+	_frameStatistics.pixelsWritten = triangleStatistics.pixelsWritten;
+}
+
+
+/*
+ * @brief log the counters of the octree traversal and the z pyramid
+ * @param name name of the traversed tree
+ * @param statistics counters of the traversal
+ * @param triangleStatistics counters of the z pyramid and the scan conversion
+ */
+void Renderer::_logTraversal(const char* name, const OctreeHierarchicalZBuffer::Statistics& statistics,
+	const HierarchicalZBuffer::Statistics& triangleStatistics) const {
+	*_log << "+ " << name << ": " << statistics.nodesVisited << " nodes visited, "
+		<< statistics.nodesCulled << " culled, "
+		<< statistics.nodesOutside << " outside, "
+		<< statistics.trianglesTransformed << " triangles transformed, "
+		<< statistics.trianglesCulled << " culled, "
+		<< statistics.trianglesClipped << " clipped, "
+		<< triangleStatistics.getAccepted() << " accepted, "
+		<< triangleStatistics.triviallyAccepted << " trivially, "
+		<< triangleStatistics.getRejected() << " rejected" << std::endl;
+}
+
+
+/*
+ * @brief time the frame, count the covered pixels and log the frame
+ * @param start start of the frame
+ */
+void Renderer::_finishFrame(std::chrono::high_resolution_clock::time_point start) {
+	_frameTiming.frame = millisecondsSince(start);
+
+	// outside the frame time, a pass over the depth buffer only the statistics need
+	const float* depth = _frameBuffer.getDepthBuffer();
+	_frameStatistics.pixelsCovered = static_cast<size_t>(_width) * _height -
+		std::count(depth, depth + static_cast<size_t>(_width) * _height, 1.0f);
+
+	if (_log) {
+		*_log << "+ overdraw: " << _frameStatistics.getOverdraw() << ", depth complexity "
+			<< _frameStatistics.getDepthComplexity() << ", " << _frameStatistics.pixelsCovered << " pixels covered" << std::endl;
+		*_log << "+ render time: " << _frameTiming.frame << " ms" << std::endl;
+		_logStages();
+	}
+}
+
+
+/*
+ * @brief copy the facing and frustum counters of the triangle setup
+ * @detail frustum rejections are the triangles of the culled clusters, the ones the clipper
+ *         found completely outside one plane and the unclipped ones completely outside one side
+ *         of the screen, the same triangles the octree traversal counts as outside
+ */
+void Renderer::_collectSetupStatistics() {
+	const TransformStage::Statistics& statistics = _transformStatistics;
+	_frameStatistics.trianglesBackfacing = statistics.culling.trianglesBackfacing;
+	_frameStatistics.trianglesDegenerate = statistics.culling.trianglesDegenerate;
+	_frameStatistics.trianglesOutsideFrustum = statistics.trianglesOutsideFrustum + statistics.trianglesCulled +
+		statistics.trianglesOutsideScreen;
+}
+
+
+/*
+ * @brief log the profiled stage times of the current frame
+ * @detail times are summed over the threads, stages that did not run are left out
+ */
+void Renderer::_logStages() const {
+	const Profiler& profiler = Profiler::getInstance();
+	if (!profiler.isEnabled()) {
+		return;
+	}
+
+	const uint32_t frame = profiler.getFrame();
+	*_log << "+ stages:";
+	for (uint8_t stage = 0; stage < static_cast<uint8_t>(Profiler::Stage::Count); ++stage) {
+		const double milliseconds = profiler.getStageMilliseconds(frame, static_cast<Profiler::Stage>(stage));
+		if (milliseconds > 0.0) {
+			*_log << " " << Profiler::getStageName(static_cast<Profiler::Stage>(stage)) << " " << milliseconds << " ms";
+		}
+	}
+	*_log << std::endl;
+}
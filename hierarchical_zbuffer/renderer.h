@@ -0,0 +1,457 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#ifdef GLFW_INCLUDE_VULKAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "bvh.h"
+#include "culling_stage.h"
+#include "framebuffer.h"
+#include "halfspace_rasterizer.h"
+#include "hierarchical_zbuffer.h"
+#include "mesh.h"
+#include "mesh_cache.h"
+#include "octree.h"
+#include "octree_hierarchical_zbuffer.h"
+#include "raster_triangle.h"
+#include "scanline_zbuffer.h"
+#include "scene.h"
+#include "temporal_occlusion.h"
+#include "thread_pool.h"
+#include "tile_renderer.h"
+#include "transform_stage.h"
+
+/**
+ * @brief software renderer of one mesh into its own frame buffer
+ * @detail owns every render engine and the per frame pipeline from the vertex transform
+ *         to the depth buffer, without any window or graphics api. The application shows
+ *         the frame buffer in a window, the headless driver writes it to files
+ */
+class Renderer {
+public:
+	/*
+	 * @brief render mode
+	 */
+	enum class RenderMode {
+		ScanLineZBuffer,
+		HierarchicalZBuffer,
+		OctreeHierarchicalZBuffer,
+		HalfSpaceRasterizer
+	};
+
+	/*
+	 * @brief spatial index traversed by the octree render mode
+	 */
+	enum class SpatialIndex {
+		Octree,
+		Bvh
+	};
+
+	/*
+	 * @brief wall clock times of the last frame in milliseconds
+	 */
+	struct FrameTiming {
+		/* vertex transform, culling and triangle setup, 0 in the octree mode, the transform
+		 * and bounds update of the moved instances when rendering a scene */
+		double setup = 0.0;
+		/* rasterization, or the whole traversal in the octree mode */
+		double raster = 0.0;
+		/* clear, setup and rasterization */
+		double frame = 0.0;
+	};
+
+	/*
+	 * @brief work counters of the last frame, comparable across the render modes
+	 * @detail in the tiled rendering the counters after the binning count a triangle once
+	 *         per tile it overlaps, and the octree counters once per tile traversal
+	 */
+	struct FrameStatistics {
+		/* triangles facing away from the camera */
+		uint64_t trianglesBackfacing = 0;
+		/* triangles with a zero or undefined area */
+		uint64_t trianglesDegenerate = 0;
+		/* triangles of culled clusters, completely outside the clip volume or one side of the screen */
+		uint64_t trianglesOutsideFrustum = 0;
+		/* triangles after culling and clipping whose bounds overlap the screen */
+		uint64_t trianglesSubmitted = 0;
+		/* submitted triangles rejected by the z pyramid before the scan conversion */
+		uint64_t trianglesOccluded = 0;
+		/* occluded triangles by the level of the pyramid node rejecting them, the root first */
+		std::vector<uint64_t> trianglesOccludedPerLevel;
+		/* submitted triangles in front of the z pyramid, written without depth tests */
+		uint64_t trianglesTriviallyAccepted = 0;
+		/* octree nodes traversed, rejected by the z pyramid and outside the frustum */
+		uint64_t nodesVisited = 0;
+		uint64_t nodesOccluded = 0;
+		uint64_t nodesOutside = 0;
+		/* octree nodes and triangles hidden by the reprojected previous frame, then retested */
+		uint64_t nodesDeferred = 0;
+		uint64_t trianglesDeferred = 0;
+		/* octree nodes tested, and drawn untested since they were visible in the previous frame */
+		uint64_t nodesQueried = 0;
+		uint64_t visibilityCacheHits = 0;
+		/* scene instances drawn, outside the frustum and hidden by the z pyramid as a whole */
+		uint64_t instancesDrawn = 0;
+		uint64_t instancesOutside = 0;
+		uint64_t instancesOccluded = 0;
+		/* pixels depth tested */
+		uint64_t pixelsTested = 0;
+		/* pixels passing the depth test */
+		uint64_t pixelsWritten = 0;
+		/* pixels covered at the end of the frame */
+		uint64_t pixelsCovered = 0;
+
+		/* pixels written per covered pixel */
+		double getOverdraw() const;
+		/* depth tests per covered pixel */
+		double getDepthComplexity() const;
+		/* octree nodes drawn untested per node drawn untested or tested */
+		double getVisibilityCacheHitRate() const;
+	};
+
+	/*
+	 * @brief a frame between the triangle setup and the rasterization
+	 * @detail filled by the caller with the camera, completed by setupFrame and consumed by
+	 *         rasterFrame, so the setup of one frame can run while another is rasterized
+	 */
+	struct FrameSetup {
+		RenderMode renderMode = RenderMode::ScanLineZBuffer;
+		glm::mat4x4 viewProjection = glm::mat4x4(1.0f);
+		glm::vec3 cameraPosition = glm::vec3(0.0f);
+		/* screen space triangles, empty in the octree mode which culls during its traversal */
+		std::vector<RasterTriangle> triangles;
+		TransformStage::Statistics statistics;
+		/* wall clock time of the setup in milliseconds */
+		double time = 0.0;
+		/* profiler frame reserved by the setup, the rasterization begins it */
+		uint32_t frame = 0;
+	};
+
+	/*
+	 * @brief constructor, reorder the mesh and build the acceleration structures
+	 */
+	Renderer(IndexedMesh mesh, int width, int height, std::ostream* log = nullptr);
+
+	/*
+	 * @brief constructor, map the prepared mesh and its spatial indices from the cache of a model
+	 */
+	Renderer(const std::string& modelPath, const std::function<IndexedMesh()>& loadMesh,
+		int width, int height, std::ostream* log = nullptr);
+
+	/*
+	 * @brief default destructor
+	 */
+	~Renderer() = default;
+
+	/*
+	 * @brief render a frame with the render mode
+	 */
+	void renderFrame(RenderMode renderMode, const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition);
+
+	/*
+	 * @brief render a frame of the instances of a scene instead of the mesh
+	 */
+	void renderScene(Scene& scene, const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition);
+
+	/*
+	 * @brief transform, cull and set up the triangles of a frame without touching the frame buffer
+	 */
+	void setupFrame(FrameSetup& setup);
+
+	/*
+	 * @brief clear the frame buffer and rasterize a frame set up by setupFrame
+	 */
+	void rasterFrame(const FrameSetup& setup);
+
+	/*
+	 * @brief render the tiles in parallel instead of the whole screen on the calling thread
+	 */
+	void setTiledRendering(bool tiledRendering);
+
+	/*
+	 * @brief check whether the tiles are rendered in parallel
+	 */
+	bool isTiledRendering() const;
+
+	/*
+	 * @brief select which faces are culled in all render modes
+	 */
+	void setFaceCulling(CullingStage::FaceCulling faceCulling);
+
+	/*
+	 * @brief get which faces are culled
+	 */
+	CullingStage::FaceCulling getFaceCulling() const;
+
+	/*
+	 * @brief select the spatial index traversed by the octree render mode
+	 */
+	void setSpatialIndex(SpatialIndex spatialIndex);
+
+	/*
+	 * @brief get the spatial index traversed by the octree render mode
+	 */
+	SpatialIndex getSpatialIndex() const;
+
+	/*
+	 * @brief test the octree against the reprojected previous frame before the current one
+	 */
+	void setTemporalCulling(bool temporalCulling);
+
+	/*
+	 * @brief check whether the octree is tested against the previous frame first
+	 */
+	bool isTemporalCulling() const;
+
+	/*
+	 * @brief remember the visible octree nodes and draw them untested in the next frames
+	 */
+	void setVisibilityPersistence(bool visibilityPersistence);
+
+	/*
+	 * @brief check whether the visible octree nodes are remembered
+	 */
+	bool isVisibilityPersistence() const;
+
+	/*
+	 * @brief keep the nearest depths in the z pyramid and write triangles in front of them untested
+	 */
+	void setTrivialAccept(bool trivialAccept);
+
+	/*
+	 * @brief check whether triangles in front of the z pyramid are written untested
+	 */
+	bool isTrivialAccept() const;
+
+	/*
+	 * @brief select the kernel of the half-space rasterizers
+	 */
+	void setHalfSpaceKernel(HalfSpaceRasterizer::Kernel kernel);
+
+	/*
+	 * @brief get the kernel of the half-space rasterizers
+	 */
+	HalfSpaceRasterizer::Kernel getHalfSpaceKernel() const;
+
+	/*
+	 * @brief set the stream the per frame statistics are printed to, nullptr for none
+	 */
+	void setLog(std::ostream* log);
+
+	/*
+	 * @brief get the number of worker threads
+	 */
+	size_t getThreadCount() const;
+
+	/*
+	 * @brief get the octree parameters, also the ones of the shared meshes of a scene
+	 */
+	const Octree::Config& getOctreeConfig() const;
+
+	/*
+	 * @brief get the mesh in render order
+	 */
+	const IndexedMesh& getMesh() const;
+
+	/*
+	 * @brief get the frame buffer of the last frame
+	 */
+	const FrameBuffer& getFrameBuffer() const;
+
+	/*
+	 * @brief get the frame buffer of the last frame to draw over, it is cleared by the next frame
+	 */
+	FrameBuffer& getFrameBuffer();
+
+	/*
+	 * @brief get the times of the last frame
+	 */
+	const FrameTiming& getFrameTiming() const;
+
+	/*
+	 * @brief get the work counters of the last frame
+	 */
+	const FrameStatistics& getFrameStatistics() const;
+
+	/*
+	 * @brief get the transform and setup counters of the last frame
+	 */
+	const TransformStage::Statistics& getTransformStatistics() const;
+
+	/*
+	 * @brief get the name of a render mode
+	 */
+	static const char* getRenderModeName(RenderMode renderMode);
+
+	/*
+	 * @brief get the name of a spatial index
+	 */
+	static const char* getSpatialIndexName(SpatialIndex spatialIndex);
+
+private:
+	int _width;
+	int _height;
+	glm::vec3 _clearColor = glm::vec3(0.0f, 0.0f, 0.0f);
+	std::ostream* _log;
+
+	/* triangle data: local space, ordered for the post-transform cache */
+	IndexedMesh _mesh;
+
+	/* flat shaded color of each triangle */
+	std::vector<uint32_t> _triangleColors;
+
+	/* triangle data: screen space, rebuilt every frame by renderFrame */
+	FrameSetup _frameSetup;
+
+	/* transform and setup counters of the last rasterized frame */
+	TransformStage::Statistics _transformStatistics;
+
+	/* software frame buffer */
+	FrameBuffer _frameBuffer;
+
+	/* scan-line z-buffer engine */
+	ScanLineZBuffer _scanLineZBuffer;
+
+	/* block based half-space rasterizer with a runtime selected simd kernel */
+	HalfSpaceRasterizer _halfSpaceRasterizer{ _frameBuffer };
+
+	/* hierarchical z-buffer engine over the depth buffer of _frameBuffer */
+	HierarchicalZBuffer _hierarchicalZBuffer{ _frameBuffer };
+
+	/* mapped cache the spatial indices point into, closed if they were built */
+	MeshCache _meshCache;
+
+	/* spatial octree over _mesh */
+	Octree::Config _octreeConfig;
+	Octree _octree;
+
+	/* surface area heuristic bvh over _mesh, the alternative to _octree */
+	Bvh::Config _bvhConfig;
+	Bvh _bvh;
+
+	/* octree traversal on top of the hierarchical z-buffer */
+	OctreeHierarchicalZBuffer _octreeHierarchicalZBuffer{ _hierarchicalZBuffer };
+
+	/* worker threads of the tiled rendering and the spatial index build */
+	ThreadPool _threadPool{ ThreadPool::getDefaultThreadCount() };
+
+	/* worker threads of the triangle setup, apart so a setup can overlap a rasterization */
+	ThreadPool _setupThreadPool{ ThreadPool::getDefaultThreadCount() };
+
+	/* tile-binned rendering of all render modes on _threadPool */
+	TileRenderer _tileRenderer{ _frameBuffer, _threadPool };
+
+	/* per frame transform of the vertices of _mesh */
+	TransformStage _transformStage{ _setupThreadPool };
+
+	/* depth of the previous octree frame reprojected to the current camera */
+	TemporalOcclusion _temporalOcclusion{ _width, _height };
+
+	/* frustum test of the scene instances and the front to back order of the visible ones */
+	CullingStage _instanceCulling;
+	std::vector<uint8_t> _instanceVisible;
+	std::vector<std::pair<float, uint32_t>> _instanceOrder;
+
+	bool _tiledRendering = false;
+	bool _temporalCulling = false;
+	bool _visibilityPersistence = false;
+	bool _trivialAccept = false;
+	SpatialIndex _spatialIndex = SpatialIndex::Octree;
+	CullingStage::FaceCulling _faceCulling = CullingStage::FaceCulling::Back;
+	FrameTiming _frameTiming;
+	FrameStatistics _frameStatistics;
+
+	/*
+	 * @brief reorder the triangles for the post-transform cache, then the vertices for fetching
+	 */
+	void _prepareMesh();
+
+	/*
+	 * @brief shade the triangles and hand the mesh to the transform stage
+	 */
+	void _shadeTriangles();
+
+	/*
+	 * @brief build the octree and the bvh over the prepared mesh
+	 */
+	void _buildSpatialIndices();
+
+	/*
+	 * @brief hash of everything the cached mesh and spatial indices depend on besides the model
+	 */
+	uint64_t _getCacheBuildStamp() const;
+
+	/*
+	 * @brief clear the frame buffer and rasterize a set up frame with its render mode
+	 */
+	void _rasterize(const FrameSetup& setup);
+
+	/*
+	 * @brief render with the active edge table scan-line z-buffer
+	 */
+	void _renderWithScanLineZBuffer(const std::vector<RasterTriangle>& triangles);
+
+	/*
+	 * @brief render with the block based half-space rasterizer
+	 */
+	void _renderWithHalfSpaceRasterizer(const std::vector<RasterTriangle>& triangles);
+
+	/*
+	 * @brief render with the quad tree hierarchical z-buffer
+	 */
+	void _renderWithHierarchicalZBuffer(const std::vector<RasterTriangle>& triangles);
+
+	/*
+	 * @brief render with the front to back octree or bvh traversal and the hierarchical z-buffer
+	 */
+	void _renderWithOctreeHierarchicalZBuffer(const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition);
+
+	/*
+	 * @brief cull the instances of a scene as a whole and traverse the octrees of the visible ones
+	 */
+	void _renderInstances(Scene& scene, const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition);
+
+	/*
+	 * @brief copy the counters of the octree traversal and the z pyramid
+	 */
+	void _collectTraversalStatistics(const OctreeHierarchicalZBuffer::Statistics& statistics,
+		const HierarchicalZBuffer::Statistics& triangleStatistics);
+
+	/*
+	 * @brief log the counters of the octree traversal and the z pyramid
+	 */
+	void _logTraversal(const char* name, const OctreeHierarchicalZBuffer::Statistics& statistics,
+		const HierarchicalZBuffer::Statistics& triangleStatistics) const;
+
+	/*
+	 * @brief time the frame, count the covered pixels and log the frame
+	 */
+	void _finishFrame(std::chrono::high_resolution_clock::time_point start);
+
+	/*
+	 * @brief copy the facing and frustum counters of the triangle setup
+	 */
+	void _collectSetupStatistics();
+
+	/*
+	 * @brief log the counters of the transform and the triangle setup
+	 */
+	void _logSetup() const;
+
+	/*
+	 * @brief log the profiled stage times of the current frame
+	 */
+	void _logStages() const;
+};
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/geometric.hpp>
+
+#include "raster_triangle.h"
+
+/*
+ * @brief pixel region [xl, xr) x [yl, yr)
+ */
+struct ScanRect {
+	int xl, xr;
+	int yl, yr;
+};
+
+/*
+ * @brief depth plane of a screen space triangle, z(x, y) = z0 + dzdx * (x - x0) + dzdy * (y - y0)
+ */
+struct ScanPlane {
+	float x0, y0, z0;
+	float dzdx, dzdy;
+};
+
+/*
+ * @brief edge of a triangle crossing the scan lines [ymin, ymin + dy)
+ */
+struct ScanEdge {
+	/* x at the center of scan line ymin */
+	float x;
+	/* x increment per scan line */
+	float dx;
+	int ymin;
+	int dy;
+};
+
+/*
+ * @brief compute the depth plane of the triangle
+ * @return false if the triangle is parallel to the view direction
+ */
+inline bool setupScanPlane(const RasterTriangle& triangle, ScanPlane& plane) {
+	const glm::vec3& v0 = triangle.v[0];
+	const glm::vec3 n = glm::cross(triangle.v[1] - v0, triangle.v[2] - v0);
+	if (std::fabs(n.z) < 1e-8f) {
+		return false;
+	}
+
+	plane = { v0.x, v0.y, v0.z, -n.x / n.z, -n.y / n.z };
+	return true;
+}
+
+/*
+ * @brief compute the edge from p to q, clipped to the scan lines [0, height)
+ * @detail pixel centers are sampled at (x + 0.5, y + 0.5), an edge covers the scan lines
+ *         whose centers lie in [ymin, ymax)
+ * @return false if the edge crosses no scan line on the screen
+ */
+inline bool setupScanEdge(glm::vec3 p, glm::vec3 q, int height, ScanEdge& edge) {
+	if (p.y > q.y) {
+		std::swap(p, q);
+	}
+
+	int ymin = static_cast<int>(std::ceil(p.y - 0.5f));
+	int ymax = static_cast<int>(std::ceil(q.y - 0.5f));
+	if (ymin >= ymax || ymax <= 0 || ymin >= height) {
+		return false;
+	}
+
+	const float dx = (q.x - p.x) / (q.y - p.y);
+	float x = p.x + (ymin + 0.5f - p.y) * dx;
+	if (ymin < 0) {
+		x -= ymin * dx;
+		ymin = 0;
+	}
+	ymax = std::min(ymax, height);
+
+	edge = { x, dx, ymin, ymax - ymin };
+	return true;
+}
+
+/*
+ * @brief compute the pixels whose centers lie inside the screen bounding box of the triangle
+ * @return false if no pixel center of the screen is inside the bounding box
+ */
+inline bool setupScanBounds(const RasterTriangle& triangle, int width, int height, ScanRect& rect) {
+	const glm::vec3& a = triangle.v[0];
+	const glm::vec3& b = triangle.v[1];
+	const glm::vec3& c = triangle.v[2];
+	rect.xl = std::max(static_cast<int>(std::ceil(std::min(std::min(a.x, b.x), c.x) - 0.5f)), 0);
+	rect.xr = std::min(static_cast<int>(std::ceil(std::max(std::max(a.x, b.x), c.x) - 0.5f)), width);
+	rect.yl = std::max(static_cast<int>(std::ceil(std::min(std::min(a.y, b.y), c.y) - 0.5f)), 0);
+	rect.yr = std::min(static_cast<int>(std::ceil(std::max(std::max(a.y, b.y), c.y) - 0.5f)), height);
+	return rect.xl < rect.xr && rect.yl < rect.yr;
+}
+
+/*
+ * @brief depth at (x, y) on the plane
+ */
+inline float evaluateScanPlane(const ScanPlane& plane, float x, float y) {
+	return plane.z0 + plane.dzdx * (x - plane.x0) + plane.dzdy * (y - plane.y0);
+}
+
+/*
+ * @brief walk the spans of one triangle inside the clip rectangle from top to bottom
+ * @detail the edges and the depth are stepped exactly like the active edge table of
+ *         ScanLineZBuffer, so both produce the same depths. Rows above the clip rectangle
+ *         are stepped but not visited, so clipping rows does not change the result
+ * @param triangle triangle in screen space
+ * @param height height of the screen
+ * @param clip pixels to visit, inside [0, width) x [0, height)
+ * @param visitSpan callable as visitSpan(y, xl, xr, z, dzdx), z is the depth of pixel xl
+ */
+template <typename SpanVisitor>
+inline void scanTriangle(const RasterTriangle& triangle, int height, const ScanRect& clip, SpanVisitor&& visitSpan) {
+	ScanPlane plane;
+	if (!setupScanPlane(triangle, plane)) {
+		return;
+	}
+
+	ScanEdge edges[3];
+	int edgeCount = 0;
+	for (int i = 0; i < 3; ++i) {
+		if (setupScanEdge(triangle.v[i], triangle.v[(i + 1) % 3], height, edges[edgeCount])) {
+			++edgeCount;
+		}
+	}
+
+	if (edgeCount < 2) {
+		return;
+	}
+
+	// edges in the order the edge table bucket would hand them out
+	std::stable_sort(edges, edges + edgeCount, [](const ScanEdge& a, const ScanEdge& b) {
+		return a.ymin < b.ymin;
+	});
+
+	float xl = 0.0f, dxl = 0.0f, xr = 0.0f, dxr = 0.0f, zl = 0.0f;
+	int dyl = 0, dyr = 0;
+	int next = 0;
+	const int ystart = edges[0].ymin;
+	for (int y = ystart; y < clip.yr; ++y) {
+		bool activated = false;
+		for (; next < edgeCount && edges[next].ymin == y; ++next) {
+			if (dyl == 0) {
+				xl = edges[next].x; dxl = edges[next].dx; dyl = edges[next].dy;
+			} else {
+				xr = edges[next].x; dxr = edges[next].dx; dyr = edges[next].dy;
+			}
+			activated = true;
+		}
+
+		if (activated) {
+			if (y == ystart && (xr < xl || (xr == xl && dxr < dxl))) {
+				std::swap(xl, xr);
+				std::swap(dxl, dxr);
+				std::swap(dyl, dyr);
+			}
+			zl = evaluateScanPlane(plane, xl, y + 0.5f);
+		}
+
+		if (y >= clip.yl) {
+			const int xs = std::max(static_cast<int>(std::ceil(xl - 0.5f)), clip.xl);
+			const int xe = std::min(static_cast<int>(std::ceil(xr - 0.5f)), clip.xr);
+			if (xs < xe) {
+				visitSpan(y, xs, xe, zl + plane.dzdx * (xs + 0.5f - xl), plane.dzdx);
+			}
+		}
+
+		--dyl;
+		--dyr;
+		if (dyl <= 0 && dyr <= 0) {
+			break;
+		}
+
+		zl += plane.dzdx * dxl + plane.dzdy;
+		xl += dxl;
+		xr += dxr;
+		dyl = std::max(dyl, 0);
+		dyr = std::max(dyr, 0);
+	}
+}
@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <cmath>
+
+#include "profiler.h"
+#include "scanline_zbuffer.h"
+
+/*
+ * @brief constructor, allocate one bucket per scan line
+ * @param width width of the target frame buffer
+ * @param height height of the target frame buffer
+ */
+ScanLineZBuffer::ScanLineZBuffer(int width, int height)
+	: ScanLineZBuffer(width, height, { 0, width, 0, height }) { }
+
+
+/*
+ * @brief constructor, render only the pixels inside a region of the frame buffer
+ * @detail scan lines above the region are stepped but not filled, so the depths inside
+ *         the region are the same as rendering the whole frame buffer. Engines over
+ *         disjoint regions of the same frame buffer can render concurrently
+ * @param width width of the target frame buffer
+ * @param height height of the target frame buffer
+ * @param region non-empty pixel region inside the frame buffer
+ */
+ScanLineZBuffer::ScanLineZBuffer(int width, int height, const ScanRect& region)
+	: _width(width), _height(height), _region(region), _polygonTable(region.yr), _edgeTable(region.yr) { }
+
+
+/*
+ * @brief scan convert the triangles into the depth/color buffer of the frame buffer
+ * @param triangles triangles in screen space
+ * @param frameBuffer target frame buffer, it is not cleared here
+ */
+void ScanLineZBuffer::render(const std::vector<RasterTriangle>& triangles, FrameBuffer& frameBuffer) {
+	_render(triangles, nullptr, triangles.size(), frameBuffer);
+}
+
+
+/*
+ * @brief scan convert the triangles with the given indices into the frame buffer
+ * @param triangles triangles in screen space
+ * @param indices indices of the triangles to render, in submission order
+ * @param frameBuffer target frame buffer, it is not cleared here
+ */
+void ScanLineZBuffer::render(const std::vector<RasterTriangle>& triangles, const std::vector<uint32_t>& indices,
+	FrameBuffer& frameBuffer) {
+	_render(triangles, indices.data(), indices.size(), frameBuffer);
+}
+
+
+/*
+ * @brief get the counters of the last rendered frame
+ * @return per frame statistics
+ */
+const ScanLineZBuffer::Statistics& ScanLineZBuffer::getStatistics() const {
+	return _statistics;
+}
+
+
+/*
+ * @brief scan convert triangles[indices[i]] for i in [0, count), all triangles if indices is null
+ * @param triangles triangles in screen space
+ * @param indices indices of the triangles to render or null
+ * @param count number of triangles to render
+ * @param frameBuffer target frame buffer
+ */
+void ScanLineZBuffer::_render(const std::vector<RasterTriangle>& triangles, const uint32_t* indices, size_t count,
+	FrameBuffer& frameBuffer) {
+	PROFILE_SCOPE(Rasterization);
+	_statistics = Statistics();
+
+	_buildTables(triangles, indices, count);
+
+	_activeEdgeTable.clear();
+	for (int y = 0; y < _region.yr; ++y) {
+		_activate(y);
+		if (y >= _region.yl) {
+			_scan(y, frameBuffer);
+		}
+		_advance();
+	}
+}
+
+
+/*
+ * @brief fill the classified polygon table and edge table
+ * @detail edges above the screen are clipped to scan line 0, see setupScanEdge,
+ *         polygon ids are positions in the rendered sequence
+ * @param triangles triangles in screen space
+ * @param indices indices of the triangles to render or null
+ * @param count number of triangles to render
+ */
+void ScanLineZBuffer::_buildTables(const std::vector<RasterTriangle>& triangles, const uint32_t* indices, size_t count) {
+	for (auto& bucket : _polygonTable) {
+		bucket.clear();
+	}
+
+	for (auto& bucket : _edgeTable) {
+		bucket.clear();
+	}
+
+	_activeSlot.resize(count);
+
+	for (uint32_t id = 0; id < count; ++id) {
+		const RasterTriangle& triangle = triangles[indices != nullptr ? indices[id] : id];
+		ScanRect rect;
+		if (setupScanBounds(triangle, _width, _height, rect) && rect.xl < _region.xr && rect.xr > _region.xl &&
+			rect.yl < _region.yr && rect.yr > _region.yl) {
+			++_statistics.triangles;
+		}
+
+		ScanPlane plane;
+		if (!setupScanPlane(triangle, plane)) {
+			continue;
+		}
+
+		int yminPolygon = _region.yr;
+		for (int i = 0; i < 3; ++i) {
+			ScanEdge edge;
+			if (!setupScanEdge(triangle.v[i], triangle.v[(i + 1) % 3], _region.yr, edge)) {
+				continue;
+			}
+
+			_edgeTable[edge.ymin].push_back({ id, edge.x, edge.dx, edge.dy });
+			yminPolygon = std::min(yminPolygon, edge.ymin);
+			++_statistics.edges;
+		}
+
+		if (yminPolygon == _region.yr) {
+			continue;
+		}
+
+		_polygonTable[yminPolygon].push_back({ id, plane, triangle.color });
+		++_statistics.polygons;
+	}
+}
+
+
+/*
+ * @brief move polygons and edges starting at scan line y into the active edge table
+ * @detail a new polygon brings two edges, a polygon whose short edge ends brings the
+ *         following edge, so every edge fills the empty side of its pair
+ * @param y current scan line
+ */
+void ScanLineZBuffer::_activate(int y) {
+	const size_t firstNew = _activeEdgeTable.size();
+	for (const auto& polygon : _polygonTable[y]) {
+		ActiveEdgePair pair;
+		pair.id = polygon.id;
+		pair.dyl = pair.dyr = 0;
+		pair.plane = polygon.plane;
+		pair.color = polygon.color;
+
+		_activeSlot[polygon.id] = static_cast<uint32_t>(_activeEdgeTable.size());
+		_activeEdgeTable.push_back(pair);
+	}
+
+	for (const auto& edge : _edgeTable[y]) {
+		ActiveEdgePair& pair = _activeEdgeTable[_activeSlot[edge.id]];
+		if (pair.dyl == 0) {
+			pair.xl = edge.x;
+			pair.dxl = edge.dx;
+			pair.dyl = edge.dy;
+		} else {
+			pair.xr = edge.x;
+			pair.dxr = edge.dx;
+			pair.dyr = edge.dy;
+		}
+	}
+
+	// the two edges of a new polygon start at the same scan line, order them by x
+	for (size_t i = firstNew; i < _activeEdgeTable.size(); ++i) {
+		ActiveEdgePair& pair = _activeEdgeTable[i];
+		if (pair.xr < pair.xl || (pair.xr == pair.xl && pair.dxr < pair.dxl)) {
+			std::swap(pair.xl, pair.xr);
+			std::swap(pair.dxl, pair.dxr);
+			std::swap(pair.dyl, pair.dyr);
+		}
+	}
+
+	// depth at the left edge is evaluated once per edge, then stepped incrementally
+	const float yc = y + 0.5f;
+	for (const auto& edge : _edgeTable[y]) {
+		ActiveEdgePair& pair = _activeEdgeTable[_activeSlot[edge.id]];
+		pair.zl = evaluateScanPlane(pair.plane, pair.xl, yc);
+	}
+}
+
+
+/*
+ * @brief fill the spans of all active edge pairs on scan line y
+ * @param y current scan line
+ * @param frameBuffer target frame buffer
+ */
+void ScanLineZBuffer::_scan(int y, FrameBuffer& frameBuffer) {
+	float* depthRow = frameBuffer.getDepthBuffer() + static_cast<size_t>(y) * _width;
+	uint32_t* colorRow = frameBuffer.getColorBuffer() + static_cast<size_t>(y) * _width;
+
+	for (const auto& pair : _activeEdgeTable) {
+		const int xl = std::max(static_cast<int>(std::ceil(pair.xl - 0.5f)), _region.xl);
+		const int xr = std::min(static_cast<int>(std::ceil(pair.xr - 0.5f)), _region.xr);
+		if (xl >= xr) {
+			continue;
+		}
+
+		++_statistics.spans;
+		_statistics.pixelsTested += xr - xl;
+
+		const float dzdx = pair.plane.dzdx;
+		float z = pair.zl + dzdx * (xl + 0.5f - pair.xl);
+		for (int x = xl; x < xr; ++x) {
+			if (z < depthRow[x]) {
+				depthRow[x] = z;
+				colorRow[x] = pair.color;
+				++_statistics.pixelsWritten;
+			}
+			z += dzdx;
+		}
+	}
+}
+
+
+/*
+ * @brief step all active edge pairs to the next scan line and retire finished ones
+ */
+void ScanLineZBuffer::_advance() {
+	for (size_t i = 0; i < _activeEdgeTable.size();) {
+		ActiveEdgePair& pair = _activeEdgeTable[i];
+		--pair.dyl;
+		--pair.dyr;
+		if (pair.dyl <= 0 && pair.dyr <= 0) {
+			pair = _activeEdgeTable.back();
+			_activeSlot[pair.id] = static_cast<uint32_t>(i);
+			_activeEdgeTable.pop_back();
+			continue;
+		}
+
+		pair.zl += pair.plane.dzdx * pair.dxl + pair.plane.dzdy;
+		pair.xl += pair.dxl;
+		pair.xr += pair.dxr;
+		// a finished edge is replaced by the next edge of the polygon at the next scan line
+		if (pair.dyl <= 0) {
+			pair.dyl = 0;
+		}
+		if (pair.dyr <= 0) {
+			pair.dyr = 0;
+		}
+		++i;
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "framebuffer.h"
+#include "raster_triangle.h"
+#include "scan_triangle.h"
+
+/**
+ * @brief scan-line z-buffer with classified polygon/edge tables and an active edge table
+ * @detail every scan line walks the active edge pairs from left to right, the depth
+ *         along a span and between scan lines is stepped incrementally by dz/dx and dz/dy
+ */
+class ScanLineZBuffer {
+public:
+	/*
+	 * @brief per frame counters of the scan conversion
+	 */
+	struct Statistics {
+		/* triangles whose bounds overlap the region, the same count in every rasterizer */
+		uint64_t triangles = 0;
+		uint64_t polygons = 0;
+		uint64_t edges = 0;
+		uint64_t spans = 0;
+		uint64_t pixelsTested = 0;
+		uint64_t pixelsWritten = 0;
+	};
+
+	/*
+	 * @brief constructor, allocate one bucket per scan line
+	 */
+	ScanLineZBuffer(int width, int height);
+
+	/*
+	 * @brief constructor, render only the pixels inside a region of the frame buffer
+	 */
+	ScanLineZBuffer(int width, int height, const ScanRect& region);
+
+	/*
+	 * @brief default destructor
+	 */
+	~ScanLineZBuffer() = default;
+
+	/*
+	 * @brief scan convert the triangles into the depth/color buffer of the frame buffer
+	 */
+	void render(const std::vector<RasterTriangle>& triangles, FrameBuffer& frameBuffer);
+
+	/*
+	 * @brief scan convert the triangles with the given indices into the frame buffer
+	 */
+	void render(const std::vector<RasterTriangle>& triangles, const std::vector<uint32_t>& indices,
+		FrameBuffer& frameBuffer);
+
+	/*
+	 * @brief get the counters of the last rendered frame
+	 */
+	const Statistics& getStatistics() const;
+
+private:
+	/* entry of the classified polygon table, bucketed by its top scan line */
+	struct ClassifiedPolygon {
+		uint32_t id;
+		ScanPlane plane;
+		uint32_t color;
+	};
+
+	/* entry of the classified edge table, bucketed by its top scan line */
+	struct ClassifiedEdge {
+		uint32_t id;
+		/* x at the center of the top scan line */
+		float x;
+		/* x increment per scan line */
+		float dx;
+		/* number of scan lines crossed */
+		int dy;
+	};
+
+	/* entry of the active edge table, one pair per active polygon */
+	struct ActiveEdgePair {
+		uint32_t id;
+		float xl, dxl;
+		int dyl;
+		float xr, dxr;
+		int dyr;
+		/* depth at (xl, y) */
+		float zl;
+		ScanPlane plane;
+		uint32_t color;
+	};
+
+	int _width;
+	int _height;
+	ScanRect _region;
+
+	std::vector<std::vector<ClassifiedPolygon>> _polygonTable;
+	std::vector<std::vector<ClassifiedEdge>> _edgeTable;
+	std::vector<ActiveEdgePair> _activeEdgeTable;
+	/* polygon id -> slot in the active edge table */
+	std::vector<uint32_t> _activeSlot;
+
+	Statistics _statistics;
+
+	/*
+	 * @brief scan convert triangles[indices[i]] for i in [0, count), all triangles if indices is null
+	 */
+	void _render(const std::vector<RasterTriangle>& triangles, const uint32_t* indices, size_t count,
+		FrameBuffer& frameBuffer);
+
+	/*
+	 * @brief fill the classified polygon table and edge table
+	 */
+	void _buildTables(const std::vector<RasterTriangle>& triangles, const uint32_t* indices, size_t count);
+
+	/*
+	 * @brief move polygons and edges starting at scan line y into the active edge table
+	 */
+	void _activate(int y);
+
+	/*
+	 * @brief fill the spans of all active edge pairs on scan line y
+	 */
+	void _scan(int y, FrameBuffer& frameBuffer);
+
+	/*
+	 * @brief step all active edge pairs to the next scan line and retire finished ones
+	 */
+	void _advance();
+};
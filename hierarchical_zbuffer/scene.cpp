@@ -0,0 +1,214 @@
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include "framebuffer.h"
+#include "scene.h"
+
+/*
+ * @brief flat shade every triangle of a mesh with a fixed directional light
+ * @detail two sided lambert shading, the light is fixed in the space of the mesh
+ * @param mesh mesh to shade
+ * @param colors packed color of each triangle as output
+ */
+void shadeTriangles(const IndexedMesh& mesh, std::vector<uint32_t>& colors) {
+	const glm::vec3 lightDirection = glm::normalize(glm::vec3(1.0f, 1.0f, 1.0f));
+	colors.clear();
+	colors.reserve(mesh.indices.size() / 3);
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+		const glm::vec3& p0 = mesh.positions[mesh.indices[i]];
+		const glm::vec3& p1 = mesh.positions[mesh.indices[i + 1]];
+		const glm::vec3& p2 = mesh.positions[mesh.indices[i + 2]];
+		glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+		float intensity = 0.2f;
+		if (glm::length(n) > 0.0f) {
+			intensity += 0.8f * std::fabs(glm::dot(glm::normalize(n), lightDirection));
+		}
+		colors.push_back(FrameBuffer::packColor(intensity, intensity, intensity));
+	}
+}
+
+
+/*
+ * @brief add a mesh the instances can share, shade it and build its octree
+ * @param mesh object space mesh, already in render order
+ * @param config octree build parameters
+ * @param threadPool threads building the octree
+ * @return index of the mesh
+ */
+uint32_t Scene::addMesh(IndexedMesh mesh, const Octree::Config& config, ThreadPool& threadPool) {
+	std::unique_ptr<SharedMesh> sharedMesh(new SharedMesh());
+	sharedMesh->mesh = std::move(mesh);
+	shadeTriangles(sharedMesh->mesh, sharedMesh->colors);
+	sharedMesh->octree.build(sharedMesh->mesh, config, threadPool);
+
+	const std::vector<glm::vec3>& positions = sharedMesh->mesh.positions;
+	if (!positions.empty()) {
+		sharedMesh->boundMin = sharedMesh->boundMax = positions[0];
+		for (const glm::vec3& position : positions) {
+			sharedMesh->boundMin = glm::min(sharedMesh->boundMin, position);
+			sharedMesh->boundMax = glm::max(sharedMesh->boundMax, position);
+		}
+	}
+
+	_meshes.push_back(std::move(sharedMesh));
+	return static_cast<uint32_t>(_meshes.size() - 1);
+}
+
+
+/*
+ * @brief add an instance of a shared mesh
+ * @param mesh index of the shared mesh
+ * @param transform placement of the mesh, copied without its parent and children
+ * @return index of the instance
+ */
+size_t Scene::addInstance(uint32_t mesh, const Object3D& transform) {
+	if (mesh >= _meshes.size()) {
+		throw std::out_of_range("no shared mesh " + std::to_string(mesh));
+	}
+
+	const uint32_t index = static_cast<uint32_t>(_instances.size());
+	_instances.push_back(Instance{Object3D(_transforms), mesh});
+	const uint32_t handle = _instances.back().transform.getHandle();
+	if (handle >= _handleInstance.size()) {
+		_handleInstance.resize(handle + 1, TransformSystem::invalid);
+	}
+	_handleInstance[handle] = index;
+
+	const glm::vec3 origin(0.0f);
+	_bounds.add(&origin, 1);
+	setTransform(index, transform);
+	return index;
+}
+
+
+/*
+ * @brief set the local transform of an instance
+ * @detail only the name, position, rotation and scale are copied, the parent of the instance
+ *         is kept. The bounds follow at the next update
+ * @param instance index of the instance
+ * @param transform new placement of the mesh
+ */
+void Scene::setTransform(size_t instance, const Object3D& transform) {
+	_instances[instance].transform = transform;
+}
+
+
+/*
+ * @brief get the transform of an instance to move it or attach it to another one
+ * @detail parents must be transforms of the same scene, see getTransformSystem
+ * @param instance index of the instance
+ * @return transform of the instance
+ */
+Object3D& Scene::getTransform(size_t instance) {
+	return _instances[instance].transform;
+}
+
+
+/*
+ * @brief get the transform system holding the transforms of the instances
+ * @detail objects created in it can be parents of instances without being instances
+ * @return transform system of the scene
+ */
+TransformSystem& Scene::getTransformSystem() {
+	return _transforms;
+}
+
+
+/*
+ * @brief update the world matrices and the world space bounds of the moved instances
+ * @detail one pass over the dirty transforms, then only the changed instances are bounded
+ */
+void Scene::update() {
+	_transforms.takeChanged(_changedHandles);
+	for (uint32_t handle : _changedHandles) {
+		if (handle < _handleInstance.size() && _handleInstance[handle] != TransformSystem::invalid) {
+			_updateBounds(_handleInstance[handle]);
+		}
+	}
+}
+
+
+/*
+ * @brief get the number of shared meshes
+ * @return mesh count
+ */
+size_t Scene::getMeshCount() const {
+	return _meshes.size();
+}
+
+
+/*
+ * @brief get a shared mesh
+ * @param mesh index of the mesh
+ * @return shared mesh
+ */
+const Scene::SharedMesh& Scene::getMesh(uint32_t mesh) const {
+	return *_meshes[mesh];
+}
+
+
+/*
+ * @brief get the number of instances
+ * @return instance count
+ */
+size_t Scene::getInstanceCount() const {
+	return _instances.size();
+}
+
+
+/*
+ * @brief get an instance
+ * @param instance index of the instance
+ * @return instance
+ */
+const Scene::Instance& Scene::getInstance(size_t instance) const {
+	return _instances[instance];
+}
+
+
+/*
+ * @brief get the world space bounds of all instances, in instance order
+ * @return bounding spheres and boxes
+ */
+const BoundingVolumes& Scene::getBounds() const {
+	return _bounds;
+}
+
+
+/*
+ * @brief get the number of triangles of all instances
+ * @return triangles drawn if nothing was culled
+ */
+uint64_t Scene::getTriangleCount() const {
+	uint64_t triangles = 0;
+	for (const Instance& instance : _instances) {
+		triangles += _meshes[instance.mesh]->mesh.indices.size() / 3;
+	}
+
+	return triangles;
+}
+
+
+/*
+ * @brief transform the object space bounds of the mesh of an instance to the world
+ * @detail the world box bounds the 8 transformed corners, the sphere is fitted to them
+ * @param instance index of the instance
+ */
+void Scene::_updateBounds(size_t instance) {
+	const SharedMesh& mesh = *_meshes[_instances[instance].mesh];
+	const glm::mat4x4& modelMatrix = _instances[instance].transform.getModelMatrix();
+	glm::vec3 corners[8];
+	for (int corner = 0; corner < 8; ++corner) {
+		corners[corner] = glm::vec3(modelMatrix * glm::vec4(
+			corner & 1 ? mesh.boundMax.x : mesh.boundMin.x,
+			corner & 2 ? mesh.boundMax.y : mesh.boundMin.y,
+			corner & 4 ? mesh.boundMax.z : mesh.boundMin.z,
+			1.0f));
+	}
+
+	_bounds.set(instance, corners, 8);
+}
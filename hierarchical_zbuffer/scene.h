@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#ifdef GLFW_INCLUDE_VULKAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include <glm/vec3.hpp>
+
+#include "culling_stage.h"
+#include "mesh.h"
+#include "object3d.h"
+#include "octree.h"
+#include "thread_pool.h"
+#include "transform_system.h"
+
+/*
+ * @brief flat shade every triangle of a mesh with a fixed directional light
+ */
+void shadeTriangles(const IndexedMesh& mesh, std::vector<uint32_t>& colors);
+
+/**
+ * @brief instances of a small set of shared meshes
+ * @detail a mesh is stored once in its own space with its triangle colors and octree, an
+ *         instance only holds its transform, the index of its mesh and its world space bounds.
+ *         The transforms live in the transform system of the scene, the bounds are kept as
+ *         structure of arrays so the frustum test of all instances runs in batches. Both are
+ *         brought up to date by update, only for the instances whose world matrix changed
+ */
+class Scene {
+public:
+	/*
+	 * @brief geometry shared by any number of instances
+	 */
+	struct SharedMesh {
+		/* object space mesh in render order */
+		IndexedMesh mesh;
+		/* flat shaded color of each triangle */
+		std::vector<uint32_t> colors;
+		Octree octree;
+		/* object space bounds of the vertices */
+		glm::vec3 boundMin = glm::vec3(0.0f);
+		glm::vec3 boundMax = glm::vec3(0.0f);
+	};
+
+	/*
+	 * @brief placement of a shared mesh in the world
+	 */
+	struct Instance {
+		/* handle to the transform in the transform system of the scene */
+		Object3D transform;
+		uint32_t mesh;
+	};
+
+	/*
+	 * @brief default constructor, an empty scene
+	 */
+	Scene() = default;
+
+	/*
+	 * @brief default destructor
+	 */
+	~Scene() = default;
+
+	Scene(const Scene&) = delete;
+	Scene& operator=(const Scene&) = delete;
+
+	/*
+	 * @brief add a mesh the instances can share, shade it and build its octree
+	 */
+	uint32_t addMesh(IndexedMesh mesh, const Octree::Config& config, ThreadPool& threadPool);
+
+	/*
+	 * @brief add an instance of a shared mesh
+	 */
+	size_t addInstance(uint32_t mesh, const Object3D& transform);
+
+	/*
+	 * @brief set the local transform of an instance
+	 */
+	void setTransform(size_t instance, const Object3D& transform);
+
+	/*
+	 * @brief get the transform of an instance to move it or attach it to another one
+	 */
+	Object3D& getTransform(size_t instance);
+
+	/*
+	 * @brief get the transform system holding the transforms of the instances
+	 */
+	TransformSystem& getTransformSystem();
+
+	/*
+	 * @brief update the world matrices and the world space bounds of the moved instances
+	 */
+	void update();
+
+	/*
+	 * @brief get the number of shared meshes
+	 */
+	size_t getMeshCount() const;
+
+	/*
+	 * @brief get a shared mesh
+	 */
+	const SharedMesh& getMesh(uint32_t mesh) const;
+
+	/*
+	 * @brief get the number of instances
+	 */
+	size_t getInstanceCount() const;
+
+	/*
+	 * @brief get an instance
+	 */
+	const Instance& getInstance(size_t instance) const;
+
+	/*
+	 * @brief get the world space bounds of all instances, in instance order
+	 */
+	const BoundingVolumes& getBounds() const;
+
+	/*
+	 * @brief get the number of triangles of all instances
+	 */
+	uint64_t getTriangleCount() const;
+
+private:
+	/* meshes are held by pointer, the views of an octree point into its own arrays */
+	std::vector<std::unique_ptr<SharedMesh>> _meshes;
+	/* declared before the instances, which destroy their transforms in it */
+	TransformSystem _transforms;
+	std::vector<Instance> _instances;
+	BoundingVolumes _bounds;
+	/* instance of each transform handle */
+	std::vector<uint32_t> _handleInstance;
+	std::vector<uint32_t> _changedHandles;
+
+	/*
+	 * @brief transform the object space bounds of the mesh of an instance to the world
+	 */
+	void _updateBounds(size_t instance);
+};
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "scene_generator.h"
+
+/*
+ * @brief regular grid of axis aligned cubes filling a box centered at the origin
+ * @detail a ray through the grid crosses about cubesPerAxis cubes, so the depth complexity
+ *         grows linearly with cubesPerAxis from any view direction. The faces are counter
+ *         clockwise seen from outside the cube
+ * @param cubesPerAxis number of cubes along each axis
+ * @param extent half size of the box holding the grid
+ * @param fill edge length of a cube relative to the grid spacing, in (0, 1]
+ * @return cube mesh with 8 vertices and 12 triangles per cube
+ */
+IndexedMesh generateCubeGrid(int cubesPerAxis, float extent, float fill) {
+	// corner i of a cube is at the bits (x, y, z) of i, the faces list their corners
+	// counter clockwise seen from outside
+	static const uint32_t faces[6][4] = {
+		{ 0, 4, 6, 2 }, { 1, 3, 7, 5 },
+		{ 0, 1, 5, 4 }, { 2, 6, 7, 3 },
+		{ 0, 2, 3, 1 }, { 4, 5, 7, 6 }
+	};
+
+	IndexedMesh mesh;
+	const float spacing = 2.0f * extent / cubesPerAxis;
+	const float halfSize = 0.5f * fill * spacing;
+	for (int z = 0; z < cubesPerAxis; ++z) {
+		for (int y = 0; y < cubesPerAxis; ++y) {
+			for (int x = 0; x < cubesPerAxis; ++x) {
+				const glm::vec3 center = glm::vec3(-extent) + spacing * (glm::vec3(x, y, z) + 0.5f);
+				const uint32_t first = static_cast<uint32_t>(mesh.positions.size());
+				for (int corner = 0; corner < 8; ++corner) {
+					const glm::vec3 sign((corner & 1) ? 1.0f : -1.0f, (corner & 2) ? 1.0f : -1.0f, (corner & 4) ? 1.0f : -1.0f);
+					mesh.positions.push_back(center + halfSize * sign);
+				}
+
+				for (const auto& face : faces) {
+					for (uint32_t corner : { face[0], face[1], face[2], face[0], face[2], face[3] }) {
+						mesh.indices.push_back(first + corner);
+					}
+				}
+			}
+		}
+	}
+
+	return mesh;
+}
+
+
+/*
+ * @brief regular grid of instances of a shared mesh filling a box centered at the origin
+ * @detail the angle of an instance is a hash of its grid cell, the grid is the same on every run
+ * @param scene scene holding the shared mesh, the instances are added to it
+ * @param mesh index of the shared mesh
+ * @param instancesPerAxis number of instances along each axis
+ * @param extent half size of the box holding the grid
+ * @param fill largest side of the bounds of an instance relative to the grid spacing, in (0, 1]
+ */
+void generateInstanceGrid(Scene& scene, uint32_t mesh, int instancesPerAxis, float extent, float fill) {
+	const Scene::SharedMesh& sharedMesh = scene.getMesh(mesh);
+	const glm::vec3 size = sharedMesh.boundMax - sharedMesh.boundMin;
+	const glm::vec3 center = 0.5f * (sharedMesh.boundMin + sharedMesh.boundMax);
+	const float spacing = 2.0f * extent / instancesPerAxis;
+	const float largestSide = std::max(std::max(size.x, size.y), size.z);
+	const float scale = largestSide > 0.0f ? fill * spacing / largestSide : 1.0f;
+
+	for (int z = 0; z < instancesPerAxis; ++z) {
+		for (int y = 0; y < instancesPerAxis; ++y) {
+			for (int x = 0; x < instancesPerAxis; ++x) {
+				uint32_t hash = static_cast<uint32_t>((x * instancesPerAxis + y) * instancesPerAxis + z) * 2654435761u;
+				hash ^= hash >> 16;
+				const float angle = 6.28318530718f * (hash & 0xFFFF) / 65536.0f;
+
+				// place the origin of the mesh so that its center lands on the cell center
+				Object3D transform;
+				transform.setLocalScale(glm::vec3(scale));
+				transform.setLocalRotation(glm::angleAxis(angle, glm::vec3(0.0f, 1.0f, 0.0f)));
+				const glm::vec3 cellCenter = glm::vec3(-extent) + spacing * (glm::vec3(x, y, z) + 0.5f);
+				const glm::vec3 offset = glm::vec3(transform.getModelMatrix() * glm::vec4(center, 0.0f));
+				transform.setWorldPosition(cellCenter - offset);
+				scene.addInstance(mesh, transform);
+			}
+		}
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+
+#include "mesh.h"
+#include "scene.h"
+
+/*
+ * @brief regular grid of axis aligned cubes filling a box centered at the origin
+ * @detail a ray through the grid crosses about cubesPerAxis cubes, so the depth complexity
+ *         grows linearly with cubesPerAxis from any view direction
+ */
+IndexedMesh generateCubeGrid(int cubesPerAxis, float extent = 2.0f, float fill = 0.5f);
+
+/*
+ * @brief regular grid of instances of a shared mesh filling a box centered at the origin
+ * @detail every instance is scaled to fill its grid cell like a cube of generateCubeGrid and
+ *         turned about the y axis by a fixed pseudo random angle, so the instances overlap
+ *         each other from any view direction without repeating one silhouette
+ */
+void generateInstanceGrid(Scene& scene, uint32_t mesh, int instancesPerAxis, float extent = 2.0f, float fill = 0.5f);
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief bounded lock-free queue between one producer thread and one consumer thread
+ * @detail a ring of slots indexed by two ever increasing counters, the producer only writes
+ *         the tail and the consumer only the head. The release store of a counter publishes
+ *         the slot it passed, the acquire load on the other side sees it. Each counter sits
+ *         on its own cache line, so the two threads do not invalidate each other on every
+ *         operation. Neither side ever blocks, a full or empty queue is reported instead
+ */
+template <typename T>
+class SpscQueue {
+public:
+	/*
+	 * @brief constructor, a queue holding at most capacity values
+	 */
+	explicit SpscQueue(size_t capacity) : _slots(capacity > 0 ? capacity : 1) { }
+
+	/*
+	 * @brief default destructor
+	 */
+	~SpscQueue() = default;
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	/*
+	 * @brief append a value, only called by the producer
+	 * @return false if the queue is full
+	 */
+	bool tryPush(const T& value) {
+		const size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail - _head.load(std::memory_order_acquire) == _slots.size()) {
+			return false;
+		}
+
+		_slots[tail % _slots.size()] = value;
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*
+	 * @brief remove the oldest value, only called by the consumer
+	 * @return false if the queue is empty
+	 */
+	bool tryPop(T& value) {
+		const size_t head = _head.load(std::memory_order_relaxed);
+		if (head == _tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+
+		value = _slots[head % _slots.size()];
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/*
+	 * @brief get the number of values the queue holds at most
+	 */
+	size_t getCapacity() const {
+		return _slots.size();
+	}
+
+private:
+	/* cache line size the counters are padded to */
+	static const size_t cacheLineSize = 64;
+
+	std::vector<T> _slots;
+	char _padding0[cacheLineSize];
+	/* values popped, written by the consumer */
+	std::atomic<size_t> _head{ 0 };
+	char _padding1[cacheLineSize - sizeof(std::atomic<size_t>)];
+	/* values pushed, written by the producer */
+	std::atomic<size_t> _tail{ 0 };
+	char _padding2[cacheLineSize - sizeof(std::atomic<size_t>)];
+};
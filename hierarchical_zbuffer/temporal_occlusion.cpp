@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "profiler.h"
+#include "temporal_occlusion.h"
+
+/*
+ * @brief constructor, no previous frame is stored
+ * @param width width of the frame buffers
+ * @param height height of the frame buffers
+ */
+TemporalOcclusion::TemporalOcclusion(int width, int height)
+	: _width(width), _height(height),
+	  _cellsX((width + cellSize - 1) / cellSize), _cellsY((height + cellSize - 1) / cellSize),
+	  _previousDepth(static_cast<size_t>(_cellsX) * _cellsY, 1.0f),
+	  _splatDepth(static_cast<size_t>(_cellsX) * _cellsY, -1.0f),
+	  _reprojectedDepth(static_cast<size_t>(_cellsX) * _cellsY, 1.0f),
+	  _quadTree(_cellsX, _cellsY, _reprojectedDepth.data(), _cellsX) { }
+
+
+/*
+ * @brief keep the farthest depth per cell of the finished frame and its camera for the next frame
+ * @param frameBuffer frame buffer of the finished frame, of the size of this object
+ * @param viewProjection view projection matrix the frame was rendered with
+ */
+void TemporalOcclusion::store(const FrameBuffer& frameBuffer, const glm::mat4x4& viewProjection) {
+	std::fill(_previousDepth.begin(), _previousDepth.end(), 0.0f);
+	const float* depth = frameBuffer.getDepthBuffer();
+	for (int y = 0; y < _height; ++y) {
+		float* cells = &_previousDepth[static_cast<size_t>(y / cellSize) * _cellsX];
+		const float* depthRow = depth + static_cast<size_t>(y) * _width;
+		for (int x = 0; x < _width; ++x) {
+			cells[x / cellSize] = std::max(cells[x / cellSize], depthRow[x]);
+		}
+	}
+
+	_previousViewProjection = viewProjection;
+	_valid = true;
+}
+
+
+/*
+ * @brief forget the stored frame, nothing is occluded until the next store
+ */
+void TemporalOcclusion::reset() {
+	_valid = false;
+}
+
+
+/*
+ * @brief check whether a frame is stored to reproject
+ * @return true after a store
+ */
+bool TemporalOcclusion::isValid() const {
+	return _valid;
+}
+
+
+/*
+ * @brief build the z pyramid of the stored frame seen by the camera of the new frame
+ * @detail a cell center is mapped from the old to the new normalized device coordinates by
+ *         one matrix, which is linear along a row. Cells landing behind the new camera or off
+ *         the screen are dropped, and a hole takes the farthest of its 8 neighbors, so the
+ *         cracks of a slowly moving camera do not open the coarse levels
+ * @param viewProjection view projection matrix of the new frame
+ */
+void TemporalOcclusion::reproject(const glm::mat4x4& viewProjection) {
+	PROFILE_SCOPE(Reprojection);
+	if (!_valid) {
+		return;
+	}
+
+	const glm::mat4x4 reprojection = viewProjection * glm::inverse(_previousViewProjection);
+	const glm::vec4 stepX = reprojection[0] * (2.0f * cellSize / _width);
+	const float width = static_cast<float>(_width);
+	const float height = static_cast<float>(_height);
+	std::fill(_splatDepth.begin(), _splatDepth.end(), -1.0f);
+	for (int y = 0; y < _cellsY; ++y) {
+		const float ndcY = 1.0f - 2.0f * (y + 0.5f) * cellSize / _height;
+		glm::vec4 rowClip = reprojection[0] * (1.0f * cellSize / _width - 1.0f) + reprojection[1] * ndcY + reprojection[3];
+		const float* depthRow = &_previousDepth[static_cast<size_t>(y) * _cellsX];
+		for (int x = 0; x < _cellsX; ++x, rowClip += stepX) {
+			if (depthRow[x] >= 1.0f) {
+				continue;
+			}
+
+			const glm::vec4 clip = rowClip + reprojection[2] * (2.0f * depthRow[x] - 1.0f);
+			if (clip.w <= 0.0f || clip.z < -clip.w) {
+				continue;
+			}
+
+			const glm::vec3 screen = projectToScreen(clip, width, height);
+			if (!(screen.x >= 0.0f && screen.x < width && screen.y >= 0.0f && screen.y < height)) {
+				continue;
+			}
+
+			float& depth = _splatDepth[static_cast<size_t>(screen.y) / cellSize * _cellsX + static_cast<size_t>(screen.x) / cellSize];
+			depth = std::max(depth, std::min(screen.z, 1.0f));
+		}
+	}
+
+	for (int y = 0; y < _cellsY; ++y) {
+		for (int x = 0; x < _cellsX; ++x) {
+			const size_t cell = static_cast<size_t>(y) * _cellsX + x;
+			if (_splatDepth[cell] >= 0.0f) {
+				_reprojectedDepth[cell] = _splatDepth[cell];
+				continue;
+			}
+
+			float farthest = -1.0f;
+			for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, _cellsY - 1); ++ny) {
+				for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, _cellsX - 1); ++nx) {
+					farthest = std::max(farthest, _splatDepth[static_cast<size_t>(ny) * _cellsX + nx]);
+				}
+			}
+
+			_reprojectedDepth[cell] = farthest >= 0.0f ? farthest : 1.0f;
+		}
+	}
+
+	_quadTree.buildQuadTree();
+}
+
+
+/*
+ * @brief check whether the reprojected depth hides everything inside the pixel region nearer than zmin
+ * @detail always false without a stored frame, the region is widened to whole cells
+ * @param rect non-empty pixel region inside the frame buffer
+ * @param zmin nearest depth of the tested geometry
+ * @return true if the region is entirely in front of zmin
+ */
+bool TemporalOcclusion::isOccluded(const ScanRect& rect, float zmin) const {
+	return _valid && zmin >= _quadTree.getRegionZ(rect.xl / cellSize, (rect.xr + cellSize - 1) / cellSize,
+		rect.yl / cellSize, (rect.yr + cellSize - 1) / cellSize);
+}
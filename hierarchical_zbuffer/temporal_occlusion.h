@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/mat4x4.hpp>
+
+#include "framebuffer.h"
+#include "quadtree.h"
+#include "scan_triangle.h"
+
+/**
+ * @brief z pyramid of the previous frame reprojected to the current camera
+ * @detail the previous depth buffer is kept at the pyramid level of cellSize x cellSize pixel
+ *         cells. Every covered cell center is unprojected with the previous camera at the
+ *         farthest depth of the cell and splatted into the current view keeping the farthest
+ *         depth per cell, holes take the farthest depth splatted around them. The result
+ *         guesses the depth of the frame before it is drawn, it is no bound: geometry it
+ *         rejects has to be tested again against the real z pyramid once the geometry it
+ *         accepted is drawn
+ */
+class TemporalOcclusion {
+public:
+	/* pixels per side of the cells the previous frame is reprojected at */
+	static const int cellSize = 4;
+
+	/*
+	 * @brief constructor, no previous frame is stored
+	 */
+	TemporalOcclusion(int width, int height);
+
+	/*
+	 * @brief default destructor
+	 */
+	~TemporalOcclusion() = default;
+
+	TemporalOcclusion(const TemporalOcclusion&) = delete;
+	TemporalOcclusion& operator=(const TemporalOcclusion&) = delete;
+
+	/*
+	 * @brief keep the farthest depth per cell of the finished frame and its camera for the next frame
+	 */
+	void store(const FrameBuffer& frameBuffer, const glm::mat4x4& viewProjection);
+
+	/*
+	 * @brief forget the stored frame, nothing is occluded until the next store
+	 */
+	void reset();
+
+	/*
+	 * @brief check whether a frame is stored to reproject
+	 */
+	bool isValid() const;
+
+	/*
+	 * @brief build the z pyramid of the stored frame seen by the camera of the new frame
+	 */
+	void reproject(const glm::mat4x4& viewProjection);
+
+	/*
+	 * @brief check whether the reprojected depth hides everything inside the pixel region nearer than zmin
+	 */
+	bool isOccluded(const ScanRect& rect, float zmin) const;
+
+private:
+	int _width, _height;
+	/* cells per row and column */
+	int _cellsX, _cellsY;
+	bool _valid = false;
+	glm::mat4x4 _previousViewProjection;
+	/* farthest depth per cell of the stored frame */
+	std::vector<float> _previousDepth;
+	/* farthest depth splatted to each cell of the current view, negative for none */
+	std::vector<float> _splatDepth;
+	/* splatted depth with the holes filled, the finest level of the pyramid */
+	std::vector<float> _reprojectedDepth;
+	QuadTree _quadTree;
+};
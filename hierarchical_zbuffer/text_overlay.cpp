@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <cstdint>
+
+#include <stb_easy_font.h>
+
+#include "text_overlay.h"
+
+namespace {
+	/* height of a text line of stb_easy_font in font units */
+	const int lineHeight = 12;
+
+	/* vertex of the quads generated by stb_easy_font */
+	struct FontVertex {
+		float x, y, z;
+		uint8_t color[4];
+	};
+
+	/*
+	 * @brief copy a line to a null terminated buffer, characters the font lacks become '?'
+	 */
+	void toFontText(const std::string& line, std::vector<char>& text) {
+		text.clear();
+		for (char c : line) {
+			text.push_back(c < 32 || c > 126 ? '?' : c);
+		}
+		text.push_back('\0');
+	}
+
+	/*
+	 * @brief fill the pixels [xl, xr) x [yl, yr) clamped to the frame buffer
+	 */
+	template <typename Shade>
+	void fillRect(FrameBuffer& frameBuffer, int xl, int xr, int yl, int yr, Shade shade) {
+		const int width = frameBuffer.getWidth();
+		xl = std::max(xl, 0);
+		xr = std::min(xr, width);
+		yl = std::max(yl, 0);
+		yr = std::min(yr, frameBuffer.getHeight());
+		uint32_t* colors = frameBuffer.getColorBuffer();
+		for (int y = yl; y < yr; ++y) {
+			for (int x = xl; x < xr; ++x) {
+				uint32_t& color = colors[static_cast<size_t>(y) * width + x];
+				color = shade(color);
+			}
+		}
+	}
+}
+
+/*
+ * @brief draw lines of text on a darkened panel over the color buffer of the frame buffer
+ * @detail the glyphs are the axis aligned quads of stb_easy_font filled in white, the depth
+ *         buffer is left untouched. Only printable ASCII is drawn
+ * @param frameBuffer frame buffer to draw over
+ * @param lines text lines, top to bottom
+ * @param x left pixel of the panel
+ * @param y top pixel of the panel
+ * @param scale pixels per font unit
+ */
+void drawTextOverlay(FrameBuffer& frameBuffer, const std::vector<std::string>& lines, int x, int y, int scale) {
+	const int margin = 2 * scale;
+	int panelWidth = 0;
+	std::vector<char> text;
+	for (const std::string& line : lines) {
+		toFontText(line, text);
+		panelWidth = std::max(panelWidth, stb_easy_font_width(text.data()));
+	}
+
+	const int panelHeight = static_cast<int>(lines.size()) * lineHeight;
+	fillRect(frameBuffer, x, x + panelWidth * scale + 2 * margin, y, y + panelHeight * scale + 2 * margin,
+		[](uint32_t color) { return ((color >> 2) & 0x003F3F3Fu) | 0xFF000000u; });
+
+	// a glyph has at most 16 quads of 4 vertices, the buffer grows to the longest line
+	std::vector<FontVertex> vertices;
+	for (size_t i = 0; i < lines.size(); ++i) {
+		toFontText(lines[i], text);
+		vertices.resize(std::max(vertices.size(), 4 * 16 * text.size()));
+		const int quads = stb_easy_font_print(0.0f, 0.0f, text.data(), nullptr, vertices.data(),
+			static_cast<int>(vertices.size() * sizeof(FontVertex)));
+		const int lineX = x + margin;
+		const int lineY = y + margin + static_cast<int>(i) * lineHeight * scale;
+		for (int quad = 0; quad < quads; ++quad) {
+			const FontVertex* corners = &vertices[4 * quad];
+			const float xl = std::min(corners[0].x, corners[2].x), xr = std::max(corners[0].x, corners[2].x);
+			const float yl = std::min(corners[0].y, corners[2].y), yr = std::max(corners[0].y, corners[2].y);
+			fillRect(frameBuffer,
+				lineX + static_cast<int>(xl * scale), lineX + static_cast<int>(xr * scale),
+				lineY + static_cast<int>(yl * scale), lineY + static_cast<int>(yr * scale),
+				[](uint32_t) { return 0xFFFFFFFFu; });
+		}
+	}
+}
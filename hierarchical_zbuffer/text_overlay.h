@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "framebuffer.h"
+
+/*
+ * @brief draw lines of text on a darkened panel over the color buffer of the frame buffer
+ */
+void drawTextOverlay(FrameBuffer& frameBuffer, const std::vector<std::string>& lines, int x, int y, int scale = 2);
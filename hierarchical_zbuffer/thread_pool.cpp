@@ -0,0 +1,178 @@
+#include <algorithm>
+
+#include "profiler.h"
+#include "thread_pool.h"
+
+/*
+ * @brief constructor, start threadCount - 1 worker threads
+ * @param threadCount number of threads running a parallel loop, the caller included
+ */
+ThreadPool::ThreadPool(size_t threadCount) {
+	threadCount = std::max<size_t>(threadCount, 1);
+	for (size_t i = 0; i < threadCount; ++i) {
+		_queues.emplace_back(new WorkQueue());
+	}
+
+	for (size_t i = 1; i < threadCount; ++i) {
+		_threads.emplace_back(&ThreadPool::_workerLoop, this, i);
+	}
+}
+
+
+/*
+ * @brief destructor, join all worker threads
+ */
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_startCondition.notify_all();
+
+	for (auto& thread : _threads) {
+		thread.join();
+	}
+}
+
+
+/*
+ * @brief get the number of threads running a parallel loop, the caller included
+ * @return number of threads
+ */
+size_t ThreadPool::getThreadCount() const {
+	return _queues.size();
+}
+
+
+/*
+ * @brief run task(index, thread) for every index in [0, count) and wait for all of them
+ * @detail indices are dealt out in contiguous blocks, so neighbouring indices tend to run
+ *         on the same thread unless they are stolen
+ * @param count number of indices
+ * @param task callable as task(index, thread), thread is in [0, getThreadCount())
+ */
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t, size_t)>& task) {
+	const size_t threadCount = _queues.size();
+	if (threadCount == 1 || count <= 1) {
+		for (size_t i = 0; i < count; ++i) {
+			task(i, 0);
+		}
+		return;
+	}
+
+	for (size_t thread = 0; thread < threadCount; ++thread) {
+		WorkQueue& queue = *_queues[thread];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		for (size_t i = count * thread / threadCount; i < count * (thread + 1) / threadCount; ++i) {
+			queue.indices.push_back(i);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_task = &task;
+		_frame = Profiler::getInstance().getFrame();
+		++_generation;
+	}
+	_startCondition.notify_all();
+
+	_runTasks(0, task);
+
+	// the queues are empty here, wait for the tasks still running on the workers
+	std::unique_lock<std::mutex> lock(_mutex);
+	_doneCondition.wait(lock, [this]() { return _busyThreads == 0; });
+	_task = nullptr;
+}
+
+
+/*
+ * @brief default number of threads, one per hardware thread
+ * @return number of hardware threads, at least 1
+ */
+size_t ThreadPool::getDefaultThreadCount() {
+	return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+
+/*
+ * @brief wait for loops and take part in them
+ * @param thread index of the worker thread
+ */
+void ThreadPool::_workerLoop(size_t thread) {
+	uint64_t generation = 0;
+	for (;;) {
+		const std::function<void(size_t, size_t)>* task = nullptr;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_startCondition.wait(lock, [&]() { return _stop || _generation != generation; });
+			if (_stop) {
+				return;
+			}
+
+			generation = _generation;
+			// a late wake up after the loop has finished finds no task
+			if (_task == nullptr) {
+				continue;
+			}
+
+			task = _task;
+			++_busyThreads;
+		}
+
+		{
+			// the loop and its frame stay until this thread is no longer busy
+			PROFILE_FRAME(_frame);
+			_runTasks(thread, *task);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			--_busyThreads;
+		}
+		_doneCondition.notify_one();
+	}
+}
+
+
+/*
+ * @brief run tasks until no queue has any index left
+ * @param thread index of the running thread
+ * @param task task of the running loop
+ */
+void ThreadPool::_runTasks(size_t thread, const std::function<void(size_t, size_t)>& task) {
+	size_t index;
+	while (_popIndex(thread, index)) {
+		task(index, thread);
+	}
+}
+
+
+/*
+ * @brief pop an index of the own queue or steal one from another queue
+ * @param thread index of the running thread
+ * @param index popped index as output
+ * @return false if all queues are empty
+ */
+bool ThreadPool::_popIndex(size_t thread, size_t& index) {
+	{
+		WorkQueue& queue = *_queues[thread];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.indices.empty()) {
+			index = queue.indices.front();
+			queue.indices.pop_front();
+			return true;
+		}
+	}
+
+	for (size_t i = 1; i < _queues.size(); ++i) {
+		WorkQueue& victim = *_queues[(thread + i) % _queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.indices.empty()) {
+			index = victim.indices.back();
+			victim.indices.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
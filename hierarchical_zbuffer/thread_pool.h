@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief fixed size thread pool running parallel loops with work stealing
+ * @detail every thread owns a queue filled with a contiguous block of the loop indices,
+ *         it pops from the front of its own queue and steals from the back of the others
+ *         once it runs dry. The calling thread takes part as thread 0. The workers record
+ *         their profiler events in the frame of the calling thread.
+ */
+class ThreadPool {
+public:
+	/*
+	 * @brief constructor, start threadCount - 1 worker threads
+	 */
+	explicit ThreadPool(size_t threadCount);
+
+	/*
+	 * @brief destructor, join all worker threads
+	 */
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/*
+	 * @brief get the number of threads running a parallel loop, the caller included
+	 */
+	size_t getThreadCount() const;
+
+	/*
+	 * @brief run task(index, thread) for every index in [0, count) and wait for all of them
+	 */
+	void parallelFor(size_t count, const std::function<void(size_t, size_t)>& task);
+
+	/*
+	 * @brief default number of threads, one per hardware thread
+	 */
+	static size_t getDefaultThreadCount();
+
+private:
+	struct WorkQueue {
+		std::mutex mutex;
+		std::deque<size_t> indices;
+	};
+
+	std::vector<std::thread> _threads;
+	std::vector<std::unique_ptr<WorkQueue>> _queues;
+
+	/* state of the running loop, guarded by _mutex */
+	std::mutex _mutex;
+	std::condition_variable _startCondition;
+	std::condition_variable _doneCondition;
+	const std::function<void(size_t, size_t)>* _task = nullptr;
+	uint32_t _frame = 0;
+	uint64_t _generation = 0;
+	size_t _busyThreads = 0;
+	bool _stop = false;
+
+	/*
+	 * @brief wait for loops and take part in them
+	 */
+	void _workerLoop(size_t thread);
+
+	/*
+	 * @brief run tasks until no queue has any index left
+	 */
+	void _runTasks(size_t thread, const std::function<void(size_t, size_t)>& task);
+
+	/*
+	 * @brief pop an index of the own queue or steal one from another queue
+	 */
+	bool _popIndex(size_t thread, size_t& index);
+};
@@ -0,0 +1,334 @@
+#include <algorithm>
+#include <cmath>
+
+#include "profiler.h"
+#include "tile_renderer.h"
+
+namespace {
+	/* number of consecutive triangles binned by one task */
+	const size_t binChunkSize = 4096;
+}
+
+/*
+ * @brief constructor, split the frame buffer into tiles of tileSize x tileSize pixels
+ * @detail tiles on the right and bottom border are cut to the frame buffer
+ * @param frameBuffer render target, it must outlive the renderer
+ * @param threadPool threads rendering the tiles, it must outlive the renderer
+ * @param tileSize edge length of a tile in pixels
+ */
+TileRenderer::TileRenderer(FrameBuffer& frameBuffer, ThreadPool& threadPool, int tileSize)
+	: _frameBuffer(frameBuffer), _threadPool(threadPool), _tileSize(std::max(tileSize, 1)) {
+	const int width = frameBuffer.getWidth();
+	const int height = frameBuffer.getHeight();
+	_tilesX = (width + _tileSize - 1) / _tileSize;
+	_tilesY = (height + _tileSize - 1) / _tileSize;
+
+	_tiles.resize(static_cast<size_t>(_tilesX) * _tilesY);
+	for (int ty = 0; ty < _tilesY; ++ty) {
+		for (int tx = 0; tx < _tilesX; ++tx) {
+			Tile& tile = _tiles[static_cast<size_t>(ty) * _tilesX + tx];
+			tile.rect.xl = tx * _tileSize;
+			tile.rect.xr = std::min(tile.rect.xl + _tileSize, width);
+			tile.rect.yl = ty * _tileSize;
+			tile.rect.yr = std::min(tile.rect.yl + _tileSize, height);
+			tile.scanLineZBuffer.reset(new ScanLineZBuffer(width, height, tile.rect));
+			tile.halfSpaceRasterizer.reset(new HalfSpaceRasterizer(frameBuffer, tile.rect));
+			tile.hierarchicalZBuffer.reset(new HierarchicalZBuffer(frameBuffer, tile.rect));
+			tile.octreeHierarchicalZBuffer.reset(new OctreeHierarchicalZBuffer(*tile.hierarchicalZBuffer));
+		}
+	}
+}
+
+
+/*
+ * @brief render the triangles with one scan-line z-buffer per tile
+ * @param triangles triangles in screen space
+ */
+void TileRenderer::renderScanLine(const std::vector<RasterTriangle>& triangles) {
+	_binTriangles(triangles);
+	_threadPool.parallelFor(_tiles.size(), [&](size_t index, size_t) {
+		Tile& tile = _tiles[index];
+		tile.scanLineZBuffer->render(triangles, tile.triangles, _frameBuffer);
+	});
+}
+
+
+/*
+ * @brief render the triangles with one half-space rasterizer per tile
+ * @param triangles triangles in screen space
+ */
+void TileRenderer::renderHalfSpace(const std::vector<RasterTriangle>& triangles) {
+	_binTriangles(triangles);
+	_threadPool.parallelFor(_tiles.size(), [&](size_t index, size_t) {
+		Tile& tile = _tiles[index];
+		tile.halfSpaceRasterizer->render(triangles, tile.triangles);
+	});
+}
+
+
+/*
+ * @brief render the triangles with one hierarchical z-buffer per tile
+ * @param triangles triangles in screen space
+ */
+void TileRenderer::renderHierarchical(const std::vector<RasterTriangle>& triangles) {
+	_binTriangles(triangles);
+	_threadPool.parallelFor(_tiles.size(), [&](size_t index, size_t) {
+		Tile& tile = _tiles[index];
+		tile.hierarchicalZBuffer->render(triangles, tile.triangles);
+	});
+}
+
+
+/*
+ * @brief traverse the octree front to back in every tile against its own z pyramid
+ * @detail nodes projecting outside a tile are skipped by that tile, triangles of nodes
+ *         overlapping several tiles are transformed once per tile
+ * @param octree octree built over the mesh
+ * @param mesh world space mesh
+ * @param colors color of each triangle
+ * @param viewProjection view projection matrix of the camera
+ * @param cameraPosition world position of the camera
+ */
+void TileRenderer::renderOctree(const Octree& octree, const IndexedMesh& mesh,
+	const std::vector<uint32_t>& colors, const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition) {
+	_statistics = Statistics();
+	_statistics.tiles = _tiles.size();
+	_threadPool.parallelFor(_tiles.size(), [&](size_t index, size_t) {
+		_tiles[index].octreeHierarchicalZBuffer->render(octree, mesh, colors, viewProjection, cameraPosition);
+	});
+}
+
+
+/*
+ * @brief traverse the bvh front to back in every tile against its own z pyramid
+ * @param bvh bvh built over the mesh
+ * @param mesh world space mesh
+ * @param colors color of each triangle
+ * @param viewProjection view projection matrix of the camera
+ * @param cameraPosition world position of the camera
+ */
+void TileRenderer::renderBvh(const Bvh& bvh, const IndexedMesh& mesh,
+	const std::vector<uint32_t>& colors, const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition) {
+	_statistics = Statistics();
+	_statistics.tiles = _tiles.size();
+	_threadPool.parallelFor(_tiles.size(), [&](size_t index, size_t) {
+		_tiles[index].octreeHierarchicalZBuffer->render(bvh, mesh, colors, viewProjection, cameraPosition);
+	});
+}
+
+
+/*
+ * @brief select the kernel of the half-space rasterizers
+ * @param kernel kernel to use, unsupported kernels fall back to the best supported one
+ */
+void TileRenderer::setHalfSpaceKernel(HalfSpaceRasterizer::Kernel kernel) {
+	for (auto& tile : _tiles) {
+		tile.halfSpaceRasterizer->setKernel(kernel);
+	}
+}
+
+
+/*
+ * @brief select which faces the octree traversal culls
+ * @param faceCulling faces to reject
+ */
+void TileRenderer::setFaceCulling(CullingStage::FaceCulling faceCulling) {
+	for (auto& tile : _tiles) {
+		tile.octreeHierarchicalZBuffer->setFaceCulling(faceCulling);
+	}
+}
+
+
+/*
+ * @brief let the octree traversal of every tile remember the visible nodes of its region
+ * @param visibilityPersistence true for the coherent traversal
+ */
+void TileRenderer::setVisibilityPersistence(bool visibilityPersistence) {
+	for (auto& tile : _tiles) {
+		tile.octreeHierarchicalZBuffer->setVisibilityPersistence(visibilityPersistence);
+	}
+}
+
+
+/*
+ * @brief let the hierarchical z-buffer of every tile write triangles in front of it untested
+ * @param trivialAccept true for two-sided quad trees
+ */
+void TileRenderer::setTrivialAccept(bool trivialAccept) {
+	for (auto& tile : _tiles) {
+		tile.hierarchicalZBuffer->setTrivialAccept(trivialAccept);
+	}
+}
+
+
+/*
+ * @brief let the octree traversal of every tile test the reprojected pyramid first, nullptr for none
+ * @detail the pyramid covers the whole frame buffer and is only read by the tiles
+ * @param temporalOcclusion reprojected pyramid of the frame
+ */
+void TileRenderer::setTemporalOcclusion(const TemporalOcclusion* temporalOcclusion) {
+	for (auto& tile : _tiles) {
+		tile.octreeHierarchicalZBuffer->setTemporalOcclusion(temporalOcclusion);
+	}
+}
+
+
+/*
+ * @brief get the counters of the last rendered frame
+ * @return per frame statistics
+ */
+const TileRenderer::Statistics& TileRenderer::getStatistics() const {
+	return _statistics;
+}
+
+
+/*
+ * @brief get the scan-line counters of the last frame summed over the tiles
+ * @return summed statistics, a triangle binned to n tiles counts n times
+ */
+ScanLineZBuffer::Statistics TileRenderer::getScanLineStatistics() const {
+	ScanLineZBuffer::Statistics sum;
+	for (const auto& tile : _tiles) {
+		const auto& statistics = tile.scanLineZBuffer->getStatistics();
+		sum.triangles += statistics.triangles;
+		sum.polygons += statistics.polygons;
+		sum.edges += statistics.edges;
+		sum.spans += statistics.spans;
+		sum.pixelsTested += statistics.pixelsTested;
+		sum.pixelsWritten += statistics.pixelsWritten;
+	}
+
+	return sum;
+}
+
+
+/*
+ * @brief get the half-space rasterizer counters of the last frame summed over the tiles
+ * @return summed statistics, a triangle binned to n tiles counts n times
+ */
+HalfSpaceRasterizer::Statistics TileRenderer::getHalfSpaceStatistics() const {
+	HalfSpaceRasterizer::Statistics sum;
+	for (const auto& tile : _tiles) {
+		const auto& statistics = tile.halfSpaceRasterizer->getStatistics();
+		sum.triangles += statistics.triangles;
+		sum.blocks += statistics.blocks;
+		sum.blocksRejected += statistics.blocksRejected;
+		sum.blocksAccepted += statistics.blocksAccepted;
+		sum.pixelsTested += statistics.pixelsTested;
+		sum.pixelsWritten += statistics.pixelsWritten;
+	}
+
+	return sum;
+}
+
+
+/*
+ * @brief get the hierarchical z-buffer counters of the last frame summed over the tiles
+ * @return summed statistics, levels are counted from the root of each tile
+ */
+HierarchicalZBuffer::Statistics TileRenderer::getHierarchicalStatistics() const {
+	HierarchicalZBuffer::Statistics sum;
+	for (const auto& tile : _tiles) {
+		const auto& statistics = tile.hierarchicalZBuffer->getStatistics();
+		sum.triangles += statistics.triangles;
+		sum.triviallyAccepted += statistics.triviallyAccepted;
+		sum.pixelsTested += statistics.pixelsTested;
+		sum.pixelsWritten += statistics.pixelsWritten;
+
+		const size_t levels = std::max(sum.acceptedPerLevel.size(), statistics.acceptedPerLevel.size());
+		sum.acceptedPerLevel.resize(levels, 0);
+		sum.rejectedPerLevel.resize(levels, 0);
+		for (size_t level = 0; level < statistics.acceptedPerLevel.size(); ++level) {
+			sum.acceptedPerLevel[level] += statistics.acceptedPerLevel[level];
+			sum.rejectedPerLevel[level] += statistics.rejectedPerLevel[level];
+		}
+	}
+
+	return sum;
+}
+
+
+/*
+ * @brief get the octree traversal counters of the last frame summed over the tiles
+ * @return summed statistics
+ */
+OctreeHierarchicalZBuffer::Statistics TileRenderer::getOctreeStatistics() const {
+	OctreeHierarchicalZBuffer::Statistics sum;
+	for (const auto& tile : _tiles) {
+		const auto& statistics = tile.octreeHierarchicalZBuffer->getStatistics();
+		sum.nodesVisited += statistics.nodesVisited;
+		sum.nodesCulled += statistics.nodesCulled;
+		sum.nodesOutside += statistics.nodesOutside;
+		sum.trianglesTransformed += statistics.trianglesTransformed;
+		sum.trianglesCulled += statistics.trianglesCulled;
+		sum.trianglesBackfacing += statistics.trianglesBackfacing;
+		sum.trianglesOutside += statistics.trianglesOutside;
+		sum.nodesDeferred += statistics.nodesDeferred;
+		sum.trianglesDeferred += statistics.trianglesDeferred;
+		sum.nodesQueried += statistics.nodesQueried;
+		sum.visibilityCacheHits += statistics.visibilityCacheHits;
+		sum.trianglesClipped += statistics.trianglesClipped;
+	}
+
+	return sum;
+}
+
+
+/*
+ * @brief bin the triangles to the tiles they overlap
+ * @detail chunks of triangles are binned in parallel into their own bins, the bins of
+ *         every tile are then joined in chunk order, so each tile sees its triangles in
+ *         submission order. The bounds are widened by one pixel in x since the stepped
+ *         edges may round across the pixel center at the bounding box
+ * @param triangles triangles in screen space
+ */
+void TileRenderer::_binTriangles(const std::vector<RasterTriangle>& triangles) {
+	const int width = _frameBuffer.getWidth();
+	const int height = _frameBuffer.getHeight();
+	const size_t chunkCount = (triangles.size() + binChunkSize - 1) / binChunkSize;
+	if (_bins.size() < chunkCount * _tiles.size()) {
+		_bins.resize(chunkCount * _tiles.size());
+	}
+
+	_threadPool.parallelFor(chunkCount, [&](size_t chunk, size_t) {
+		PROFILE_SCOPE(Binning);
+		std::vector<uint32_t>* bins = &_bins[chunk * _tiles.size()];
+		for (size_t i = 0; i < _tiles.size(); ++i) {
+			bins[i].clear();
+		}
+
+		const size_t end = std::min(triangles.size(), (chunk + 1) * binChunkSize);
+		for (size_t id = chunk * binChunkSize; id < end; ++id) {
+			ScanRect rect;
+			if (!setupScanBounds(triangles[id], width, height, rect)) {
+				continue;
+			}
+
+			const int txl = std::max(rect.xl - 1, 0) / _tileSize;
+			const int txr = std::min(rect.xr, width - 1) / _tileSize;
+			const int tyl = rect.yl / _tileSize;
+			const int tyr = (rect.yr - 1) / _tileSize;
+			for (int ty = tyl; ty <= tyr; ++ty) {
+				for (int tx = txl; tx <= txr; ++tx) {
+					bins[static_cast<size_t>(ty) * _tilesX + tx].push_back(static_cast<uint32_t>(id));
+				}
+			}
+		}
+	});
+
+	_threadPool.parallelFor(_tiles.size(), [&](size_t index, size_t) {
+		PROFILE_SCOPE(Binning);
+		Tile& tile = _tiles[index];
+		tile.triangles.clear();
+		for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+			const std::vector<uint32_t>& bin = _bins[chunk * _tiles.size() + index];
+			tile.triangles.insert(tile.triangles.end(), bin.begin(), bin.end());
+		}
+	});
+
+	_statistics = Statistics();
+	_statistics.tiles = _tiles.size();
+	for (const auto& tile : _tiles) {
+		_statistics.binnedTriangles += tile.triangles.size();
+	}
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#ifdef GLFW_INCLUDE_VULKAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "bvh.h"
+#include "culling_stage.h"
+#include "framebuffer.h"
+#include "halfspace_rasterizer.h"
+#include "hierarchical_zbuffer.h"
+#include "mesh.h"
+#include "octree.h"
+#include "octree_hierarchical_zbuffer.h"
+#include "raster_triangle.h"
+#include "scan_triangle.h"
+#include "scanline_zbuffer.h"
+#include "temporal_occlusion.h"
+#include "thread_pool.h"
+
+/**
+ * @brief screen split into tiles rendered in parallel by the thread pool
+ * @detail triangles are binned to the tiles they overlap, keeping submission order, then
+ *         every tile renders its bin with engines restricted to its own pixels, so tiles
+ *         never share a pixel and need no synchronization
+ */
+class TileRenderer {
+public:
+	/*
+	 * @brief per frame counters of the binning
+	 */
+	struct Statistics {
+		uint64_t tiles = 0;
+		/* triangle/tile pairs produced by the binning */
+		uint64_t binnedTriangles = 0;
+	};
+
+	/*
+	 * @brief constructor, split the frame buffer into tiles of tileSize x tileSize pixels
+	 */
+	TileRenderer(FrameBuffer& frameBuffer, ThreadPool& threadPool, int tileSize = 64);
+
+	/*
+	 * @brief default destructor
+	 */
+	~TileRenderer() = default;
+
+	/*
+	 * @brief render the triangles with one scan-line z-buffer per tile
+	 */
+	void renderScanLine(const std::vector<RasterTriangle>& triangles);
+
+	/*
+	 * @brief render the triangles with one hierarchical z-buffer per tile
+	 */
+	void renderHierarchical(const std::vector<RasterTriangle>& triangles);
+
+	/*
+	 * @brief render the triangles with one half-space rasterizer per tile
+	 */
+	void renderHalfSpace(const std::vector<RasterTriangle>& triangles);
+
+	/*
+	 * @brief traverse the octree front to back in every tile against its own z pyramid
+	 */
+	void renderOctree(const Octree& octree, const IndexedMesh& mesh, const std::vector<uint32_t>& colors,
+		const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition);
+
+	/*
+	 * @brief traverse the bvh front to back in every tile against its own z pyramid
+	 */
+	void renderBvh(const Bvh& bvh, const IndexedMesh& mesh, const std::vector<uint32_t>& colors,
+		const glm::mat4x4& viewProjection, const glm::vec3& cameraPosition);
+
+	/*
+	 * @brief select the kernel of the half-space rasterizers
+	 */
+	void setHalfSpaceKernel(HalfSpaceRasterizer::Kernel kernel);
+
+	/*
+	 * @brief select which faces the octree traversal culls
+	 */
+	void setFaceCulling(CullingStage::FaceCulling faceCulling);
+
+	/*
+	 * @brief let the octree traversal of every tile remember the visible nodes of its region
+	 */
+	void setVisibilityPersistence(bool visibilityPersistence);
+
+	/*
+	 * @brief let the hierarchical z-buffer of every tile write triangles in front of it untested
+	 */
+	void setTrivialAccept(bool trivialAccept);
+
+	/*
+	 * @brief let the octree traversal of every tile test the reprojected pyramid first, nullptr for none
+	 */
+	void setTemporalOcclusion(const TemporalOcclusion* temporalOcclusion);
+
+	/*
+	 * @brief get the counters of the last rendered frame
+	 */
+	const Statistics& getStatistics() const;
+
+	/*
+	 * @brief get the scan-line counters of the last frame summed over the tiles
+	 */
+	ScanLineZBuffer::Statistics getScanLineStatistics() const;
+
+	/*
+	 * @brief get the half-space rasterizer counters of the last frame summed over the tiles
+	 */
+	HalfSpaceRasterizer::Statistics getHalfSpaceStatistics() const;
+
+	/*
+	 * @brief get the hierarchical z-buffer counters of the last frame summed over the tiles
+	 */
+	HierarchicalZBuffer::Statistics getHierarchicalStatistics() const;
+
+	/*
+	 * @brief get the octree traversal counters of the last frame summed over the tiles
+	 */
+	OctreeHierarchicalZBuffer::Statistics getOctreeStatistics() const;
+
+private:
+	struct Tile {
+		ScanRect rect;
+		std::unique_ptr<ScanLineZBuffer> scanLineZBuffer;
+		std::unique_ptr<HalfSpaceRasterizer> halfSpaceRasterizer;
+		std::unique_ptr<HierarchicalZBuffer> hierarchicalZBuffer;
+		std::unique_ptr<OctreeHierarchicalZBuffer> octreeHierarchicalZBuffer;
+		/* indices of the triangles overlapping the tile in submission order */
+		std::vector<uint32_t> triangles;
+	};
+
+	FrameBuffer& _frameBuffer;
+	ThreadPool& _threadPool;
+	int _tileSize;
+	int _tilesX;
+	int _tilesY;
+	std::vector<Tile> _tiles;
+
+	/* per chunk of triangles and per tile bins, chunk major */
+	std::vector<std::vector<uint32_t>> _bins;
+
+	Statistics _statistics;
+
+	/*
+	 * @brief bin the triangles to the tiles they overlap
+	 */
+	void _binTriangles(const std::vector<RasterTriangle>& triangles);
+};
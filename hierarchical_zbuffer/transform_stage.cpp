@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <cassert>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define TRANSFORM_STAGE_SSE2
+#include <emmintrin.h>
+#endif
+
+#include "profiler.h"
+#include "transform_stage.h"
+
+namespace {
+	/* vertices transformed by one task, a multiple of the vector width */
+	const size_t transformChunkSize = 16384;
+
+	/* triangles set up by one task, a multiple of clusterSize */
+	const size_t setupChunkSize = 4096;
+
+	/* consecutive triangles sharing one bounding volume for frustum culling */
+	const size_t clusterSize = 256;
+}
+
+/*
+ * @brief constructor, run the transform and the setup on the thread pool
+ * @param threadPool worker threads, it must outlive the stage
+ * @param guardBand extent of the clipper guard band in normalized device coordinates
+ */
+TransformStage::TransformStage(ThreadPool& threadPool, float guardBand)
+	: _threadPool(threadPool), _guardBand(guardBand) { }
+
+
+/*
+ * @brief set the mesh to transform, every 3 indices form a triangle
+ * @param positions object space vertex positions
+ * @param indices vertex indices of the triangles
+ */
+void TransformStage::setMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices) {
+	const size_t count = positions.size();
+	_positionX.resize(count);
+	_positionY.resize(count);
+	_positionZ.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		_positionX[i] = positions[i].x;
+		_positionY[i] = positions[i].y;
+		_positionZ[i] = positions[i].z;
+	}
+
+	_indices = indices;
+
+	// triangles are ordered for the vertex cache, so consecutive ones stay close in space
+	_clusterBounds.clear();
+	std::vector<glm::vec3> points;
+	for (size_t first = 0; first < indices.size(); first += 3 * clusterSize) {
+		const size_t last = std::min(indices.size() / 3 * 3, first + 3 * clusterSize);
+		points.clear();
+		for (size_t i = first; i < last; ++i) {
+			points.push_back(positions[indices[i]]);
+		}
+		_clusterBounds.add(points.data(), points.size());
+	}
+
+	_clipX.resize(count);
+	_clipY.resize(count);
+	_clipZ.resize(count);
+	_clipW.resize(count);
+	_screenX.resize(count);
+	_screenY.resize(count);
+	_screenZ.resize(count);
+	_outcodes.assign(count, 0);
+	_statistics = Statistics();
+}
+
+
+/*
+ * @brief transform all vertices to clip space and screen space
+ * @detail the results are the same as projectToScreen and Clipper::computeOutcode, vertex by vertex
+ * @param viewProjection view projection matrix of the camera
+ * @param width width of the screen
+ * @param height height of the screen
+ */
+void TransformStage::transform(const glm::mat4x4& viewProjection, float width, float height) {
+	_width = width;
+	_height = height;
+	_culling.setViewProjection(viewProjection);
+
+	const size_t count = _positionX.size();
+	_threadPool.parallelFor((count + transformChunkSize - 1) / transformChunkSize, [&](size_t chunk, size_t) {
+		PROFILE_SCOPE(Transform);
+		_transformRange(viewProjection, chunk * transformChunkSize, std::min(count, (chunk + 1) * transformChunkSize));
+	});
+
+	_statistics.vertices = count;
+	_statistics.verticesClipped = count - std::count(_outcodes.begin(), _outcodes.end(), 0);
+}
+
+
+/*
+ * @brief assemble the triangles from the cached vertices in index order
+ * @detail clusters outside the frustum are skipped, the triangles of the others are culled
+ *         by facing and area in batches. Triangles with all vertices inside the near plane
+ *         and inside the guard band are then gathered as is and dropped if completely
+ *         outside one side of the screen, the others go through the clipper
+ *         after the rest of their chunk
+ * @param colors color of each triangle
+ * @param triangles screen space triangles as output
+ */
+void TransformStage::setupTriangles(const std::vector<uint32_t>& colors, std::vector<RasterTriangle>& triangles) {
+	const size_t triangleCount = _indices.size() / 3;
+	const size_t chunkCount = (triangleCount + setupChunkSize - 1) / setupChunkSize;
+	_culling.resetStatistics();
+	_clusterVisible.resize(_clusterBounds.size());
+	{
+		PROFILE_SCOPE(Culling);
+		_culling.cullBounds(_clusterBounds, 0, _clusterBounds.size(), _clusterVisible.data());
+	}
+
+	_setupChunks.resize(chunkCount, SetupChunk(_guardBand));
+	for (auto& setupChunk : _setupChunks) {
+		setupChunk.clipper.setViewport(_width, _height);
+		setupChunk.clipper.resetStatistics();
+		setupChunk.culling.setFaceCulling(_culling.getFaceCulling());
+		setupChunk.culling.resetStatistics();
+		setupChunk.trianglesOutsideFrustum = 0;
+		setupChunk.trianglesOutsideScreen = 0;
+	}
+
+	_threadPool.parallelFor(chunkCount, [&](size_t chunk, size_t) {
+		PROFILE_SCOPE(TriangleSetup);
+		SetupChunk& setupChunk = _setupChunks[chunk];
+		setupChunk.triangles.clear();
+		setupChunk.crossingTriangles.clear();
+		const size_t end = std::min(triangleCount, (chunk + 1) * setupChunkSize);
+		for (size_t first = chunk * setupChunkSize; first < end; first += clusterSize) {
+			const size_t last = std::min(end, first + clusterSize);
+			if (!_clusterVisible[first / clusterSize]) {
+				setupChunk.trianglesOutsideFrustum += last - first;
+				continue;
+			}
+
+			for (size_t batch = first; batch < last; batch += CullingStage::batchSize) {
+				_setupBatch(setupChunk, colors, batch, std::min(last, batch + CullingStage::batchSize));
+			}
+		}
+
+		PROFILE_SCOPE(Clipping);
+		for (const uint32_t i : setupChunk.crossingTriangles) {
+			const uint32_t* corners = &_indices[3 * i];
+			const glm::vec4 clip[3] = {
+				getClipPosition(corners[0]), getClipPosition(corners[1]), getClipPosition(corners[2])
+			};
+			if (!setupChunk.culling.cullTriangle(clip)) {
+				const uint8_t outcodes[3] = { _outcodes[corners[0]], _outcodes[corners[1]], _outcodes[corners[2]] };
+				setupChunk.clipper.clipTriangle(clip, outcodes, colors[i], setupChunk.triangles);
+			}
+		}
+	});
+
+	triangles.clear();
+	for (const auto& setupChunk : _setupChunks) {
+		triangles.insert(triangles.end(), setupChunk.triangles.begin(), setupChunk.triangles.end());
+	}
+
+	_statistics.triangles = triangleCount;
+	_statistics.trianglesSetUp = triangles.size();
+	_statistics.trianglesCulled = 0;
+	_statistics.trianglesClipped = 0;
+	_statistics.trianglesOutsideFrustum = 0;
+	_statistics.trianglesOutsideScreen = 0;
+	_statistics.culling = _culling.getStatistics();
+	uint64_t trianglesEmitted = 0;
+	for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+		const SetupChunk& setupChunk = _setupChunks[chunk];
+		_statistics.trianglesCulled += setupChunk.clipper.getStatistics().trianglesCulled;
+		_statistics.trianglesClipped += setupChunk.clipper.getStatistics().trianglesClipped;
+		_statistics.trianglesOutsideFrustum += setupChunk.trianglesOutsideFrustum;
+		_statistics.trianglesOutsideScreen += setupChunk.trianglesOutsideScreen;
+		trianglesEmitted += setupChunk.clipper.getStatistics().trianglesEmitted;
+		_statistics.culling.trianglesTested += setupChunk.culling.getStatistics().trianglesTested;
+		_statistics.culling.trianglesBackfacing += setupChunk.culling.getStatistics().trianglesBackfacing;
+		_statistics.culling.trianglesDegenerate += setupChunk.culling.getStatistics().trianglesDegenerate;
+	}
+
+	// every triangle is rejected for one reason, clipped or set up unclipped
+	assert(_statistics.triangles == _statistics.trianglesOutsideFrustum + _statistics.culling.trianglesBackfacing +
+		_statistics.culling.trianglesDegenerate + _statistics.trianglesCulled + _statistics.trianglesOutsideScreen +
+		_statistics.trianglesClipped + (_statistics.trianglesSetUp - trianglesEmitted));
+}
+
+
+/*
+ * @brief select which faces are culled before the triangle setup
+ * @param faceCulling faces to reject
+ */
+void TransformStage::setFaceCulling(CullingStage::FaceCulling faceCulling) {
+	_culling.setFaceCulling(faceCulling);
+}
+
+
+/*
+ * @brief get which faces are culled before the triangle setup
+ * @return face culling mode
+ */
+CullingStage::FaceCulling TransformStage::getFaceCulling() const {
+	return _culling.getFaceCulling();
+}
+
+
+/*
+ * @brief get the number of vertices of the mesh
+ * @return vertex count
+ */
+size_t TransformStage::getVertexCount() const {
+	return _positionX.size();
+}
+
+
+/*
+ * @brief get the cached clip space position of a vertex
+ * @param vertex index of the vertex
+ * @return clip space position of the last transform
+ */
+glm::vec4 TransformStage::getClipPosition(uint32_t vertex) const {
+	return glm::vec4(_clipX[vertex], _clipY[vertex], _clipZ[vertex], _clipW[vertex]);
+}
+
+
+/*
+ * @brief get the cached screen space position of a vertex
+ * @param vertex index of the vertex
+ * @return screen space position of the last transform, only valid for visible vertices
+ */
+glm::vec3 TransformStage::getScreenPosition(uint32_t vertex) const {
+	return glm::vec3(_screenX[vertex], _screenY[vertex], _screenZ[vertex]);
+}
+
+
+/*
+ * @brief check whether the vertex is inside the near plane
+ * @param vertex index of the vertex
+ * @return true if the vertex has a screen space position
+ */
+bool TransformStage::isVertexVisible(uint32_t vertex) const {
+	return (_outcodes[vertex] & Clipper::Near) == 0;
+}
+
+
+/*
+ * @brief get the cached clipper outcode of a vertex
+ * @param vertex index of the vertex
+ * @return combination of Clipper::Plane bits of the last transform
+ */
+uint8_t TransformStage::getOutcode(uint32_t vertex) const {
+	return _outcodes[vertex];
+}
+
+
+/*
+ * @brief get the counters of the last frame
+ * @return per frame statistics
+ */
+const TransformStage::Statistics& TransformStage::getStatistics() const {
+	return _statistics;
+}
+
+
+/*
+ * @brief cull and assemble the triangles [first, last), at most one batch
+ * @param setupChunk state of the setup task, the triangles are appended to it and the ones
+ *        to clip are queued
+ * @param colors color of each triangle
+ * @param first first triangle of the batch
+ * @param last end of the batch
+ */
+void TransformStage::_setupBatch(SetupChunk& setupChunk, const std::vector<uint32_t>& colors, size_t first, size_t last) {
+	CullingStage::TriangleBatch batch;
+	uint32_t screenMask = 0;
+	uint32_t clipMask = 0;
+	for (int lane = 0; lane < CullingStage::batchSize; ++lane) {
+		const uint32_t* corners = first + lane < last ? &_indices[3 * (first + lane)] : nullptr;
+		if (corners && (_outcodes[corners[0]] | _outcodes[corners[1]] | _outcodes[corners[2]]) == 0) {
+			for (int k = 0; k < 3; ++k) {
+				batch.x[k][lane] = _screenX[corners[k]];
+				batch.y[k][lane] = _screenY[corners[k]];
+			}
+			screenMask |= 1u << lane;
+			continue;
+		}
+
+		for (int k = 0; k < 3; ++k) {
+			batch.x[k][lane] = 0.0f;
+			batch.y[k][lane] = 0.0f;
+		}
+
+		if (corners) {
+			clipMask |= 1u << lane;
+		}
+	}
+
+	const uint32_t accepted = setupChunk.culling.cullTriangles(batch, screenMask);
+	for (size_t i = first; i < last; ++i) {
+		const uint32_t lane = 1u << (i - first);
+		const uint32_t* corners = &_indices[3 * i];
+		if (clipMask & lane) {
+			setupChunk.crossingTriangles.push_back(static_cast<uint32_t>(i));
+			continue;
+		}
+
+		if (!(accepted & lane)) {
+			continue;
+		}
+
+		RasterTriangle triangle;
+		for (int k = 0; k < 3; ++k) {
+			triangle.v[k] = glm::vec3(_screenX[corners[k]], _screenY[corners[k]], _screenZ[corners[k]]);
+		}
+
+		if (isOutsideScreen(triangle, _width, _height)) {
+			++setupChunk.trianglesOutsideScreen;
+			continue;
+		}
+
+		triangle.color = colors[i];
+		setupChunk.triangles.push_back(triangle);
+	}
+}
+
+
+/*
+ * @brief transform the vertices [first, last)
+ * @detail clip = (m[0] * x + m[1] * y) + (m[2] * z + m[3]) in the order glm multiplies,
+ *         so the cache matches glm and projectToScreen bit for bit and the outcodes match
+ *         Clipper::computeOutcode
+ * @param viewProjection view projection matrix of the camera
+ * @param first first vertex, a multiple of 4
+ * @param last end of the range
+ */
+void TransformStage::_transformRange(const glm::mat4x4& viewProjection, size_t first, size_t last) {
+	const glm::mat4x4& m = viewProjection;
+	size_t i = first;
+
+#ifdef TRANSFORM_STAGE_SSE2
+	__m128 column[4][4];
+	for (int c = 0; c < 4; ++c) {
+		for (int r = 0; r < 4; ++r) {
+			column[c][r] = _mm_set1_ps(m[c][r]);
+		}
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	const __m128 guardBand = _mm_set1_ps(_guardBand);
+	const __m128 width = _mm_set1_ps(_width);
+	const __m128 height = _mm_set1_ps(_height);
+	for (; i + 4 <= last; i += 4) {
+		const __m128 x = _mm_loadu_ps(&_positionX[i]);
+		const __m128 y = _mm_loadu_ps(&_positionY[i]);
+		const __m128 z = _mm_loadu_ps(&_positionZ[i]);
+
+		__m128 clip[4];
+		for (int r = 0; r < 4; ++r) {
+			clip[r] = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(column[0][r], x), _mm_mul_ps(column[1][r], y)),
+				_mm_add_ps(_mm_mul_ps(column[2][r], z), column[3][r]));
+		}
+
+		// written so that nan compares as in the scalar test
+		const __m128 limit = _mm_mul_ps(guardBand, clip[3]);
+		const __m128 negativeLimit = _mm_xor_ps(limit, signBit);
+		const int nearBits = _mm_movemask_ps(
+			_mm_or_ps(_mm_cmplt_ps(clip[2], _mm_xor_ps(clip[3], signBit)), _mm_cmple_ps(clip[3], zero)));
+		const int leftBits = _mm_movemask_ps(_mm_cmplt_ps(clip[0], negativeLimit));
+		const int rightBits = _mm_movemask_ps(_mm_cmpgt_ps(clip[0], limit));
+		const int bottomBits = _mm_movemask_ps(_mm_cmplt_ps(clip[1], negativeLimit));
+		const int topBits = _mm_movemask_ps(_mm_cmpgt_ps(clip[1], limit));
+
+		const __m128 ndcX = _mm_div_ps(clip[0], clip[3]);
+		const __m128 ndcY = _mm_div_ps(clip[1], clip[3]);
+		const __m128 ndcZ = _mm_div_ps(clip[2], clip[3]);
+		_mm_storeu_ps(&_clipX[i], clip[0]);
+		_mm_storeu_ps(&_clipY[i], clip[1]);
+		_mm_storeu_ps(&_clipZ[i], clip[2]);
+		_mm_storeu_ps(&_clipW[i], clip[3]);
+		_mm_storeu_ps(&_screenX[i], _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ndcX, half), half), width));
+		_mm_storeu_ps(&_screenY[i], _mm_mul_ps(_mm_sub_ps(half, _mm_mul_ps(ndcY, half)), height));
+		_mm_storeu_ps(&_screenZ[i], _mm_add_ps(_mm_mul_ps(ndcZ, half), half));
+		for (int k = 0; k < 4; ++k) {
+			_outcodes[i + k] = static_cast<uint8_t>(
+				((nearBits >> k) & 1 ? Clipper::Near : 0) |
+				((leftBits >> k) & 1 ? Clipper::Left : 0) | ((rightBits >> k) & 1 ? Clipper::Right : 0) |
+				((bottomBits >> k) & 1 ? Clipper::Bottom : 0) | ((topBits >> k) & 1 ? Clipper::Top : 0));
+		}
+	}
+#endif
+
+	for (; i < last; ++i) {
+		const float x = _positionX[i];
+		const float y = _positionY[i];
+		const float z = _positionZ[i];
+		float clip[4];
+		for (int r = 0; r < 4; ++r) {
+			clip[r] = (m[0][r] * x + m[1][r] * y) + (m[2][r] * z + m[3][r]);
+		}
+
+		_clipX[i] = clip[0];
+		_clipY[i] = clip[1];
+		_clipZ[i] = clip[2];
+		_clipW[i] = clip[3];
+		_screenX[i] = (clip[0] / clip[3] * 0.5f + 0.5f) * _width;
+		_screenY[i] = (0.5f - clip[1] / clip[3] * 0.5f) * _height;
+		_screenZ[i] = clip[2] / clip[3] * 0.5f + 0.5f;
+		const float limit = _guardBand * clip[3];
+		_outcodes[i] = static_cast<uint8_t>(
+			(clip[2] < -clip[3] || clip[3] <= 0.0f ? Clipper::Near : 0) |
+			(clip[0] < -limit ? Clipper::Left : 0) | (clip[0] > limit ? Clipper::Right : 0) |
+			(clip[1] < -limit ? Clipper::Bottom : 0) | (clip[1] > limit ? Clipper::Top : 0));
+	}
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#ifdef GLFW_INCLUDE_VULKAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "clipper.h"
+#include "culling_stage.h"
+#include "raster_triangle.h"
+#include "thread_pool.h"
+
+/**
+ * @brief per frame vertex transform of an indexed mesh
+ * @detail positions are kept as structure of arrays and transformed 4 at a time, once per
+ *         vertex and frame. The clip space and screen space results stay cached until the
+ *         next transform, triangle setup gathers its corners from the cache by index. The
+ *         transform also computes the clipper outcode of every vertex, only triangles with
+ *         a vertex outside the near plane or the guard band are clipped. Culled
+ *         triangles never reach the setup
+ */
+class TransformStage {
+public:
+	/*
+	 * @brief per frame counters of the transform and the triangle setup
+	 */
+	struct Statistics {
+		uint64_t vertices = 0;
+		/* vertices outside the near plane or the guard band */
+		uint64_t verticesClipped = 0;
+		uint64_t triangles = 0;
+		/* triangles completely outside the near plane or one side of the guard band */
+		uint64_t trianglesCulled = 0;
+		/* unclipped triangles completely outside one side of the screen or behind the far plane */
+		uint64_t trianglesOutsideScreen = 0;
+		/* triangles cut by the clipper */
+		uint64_t trianglesClipped = 0;
+		/* triangles of clusters outside the frustum */
+		uint64_t trianglesOutsideFrustum = 0;
+		/* facing, area and cluster bounds rejections */
+		CullingStage::Statistics culling;
+		/* triangles handed to the rasterizers */
+		uint64_t trianglesSetUp = 0;
+	};
+
+	/*
+	 * @brief constructor, run the transform and the setup on the thread pool
+	 */
+	explicit TransformStage(ThreadPool& threadPool, float guardBand = 8.0f);
+
+	/*
+	 * @brief default destructor
+	 */
+	~TransformStage() = default;
+
+	/*
+	 * @brief set the mesh to transform, every 3 indices form a triangle
+	 */
+	void setMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+
+	/*
+	 * @brief transform all vertices to clip space and screen space
+	 */
+	void transform(const glm::mat4x4& viewProjection, float width, float height);
+
+	/*
+	 * @brief assemble the triangles from the cached vertices in index order
+	 */
+	void setupTriangles(const std::vector<uint32_t>& colors, std::vector<RasterTriangle>& triangles);
+
+	/*
+	 * @brief select which faces are culled before the triangle setup
+	 */
+	void setFaceCulling(CullingStage::FaceCulling faceCulling);
+
+	/*
+	 * @brief get which faces are culled before the triangle setup
+	 */
+	CullingStage::FaceCulling getFaceCulling() const;
+
+	/*
+	 * @brief get the number of vertices of the mesh
+	 */
+	size_t getVertexCount() const;
+
+	/*
+	 * @brief get the cached clip space position of a vertex
+	 */
+	glm::vec4 getClipPosition(uint32_t vertex) const;
+
+	/*
+	 * @brief get the cached screen space position of a vertex
+	 */
+	glm::vec3 getScreenPosition(uint32_t vertex) const;
+
+	/*
+	 * @brief check whether the vertex is inside the near plane
+	 */
+	bool isVertexVisible(uint32_t vertex) const;
+
+	/*
+	 * @brief get the cached clipper outcode of a vertex
+	 */
+	uint8_t getOutcode(uint32_t vertex) const;
+
+	/*
+	 * @brief get the counters of the last frame
+	 */
+	const Statistics& getStatistics() const;
+
+private:
+	ThreadPool& _threadPool;
+
+	/* object space positions */
+	std::vector<float> _positionX;
+	std::vector<float> _positionY;
+	std::vector<float> _positionZ;
+	std::vector<uint32_t> _indices;
+
+	/* post-transform cache, rebuilt by transform() */
+	std::vector<float> _clipX;
+	std::vector<float> _clipY;
+	std::vector<float> _clipZ;
+	std::vector<float> _clipW;
+	std::vector<float> _screenX;
+	std::vector<float> _screenY;
+	std::vector<float> _screenZ;
+	std::vector<uint8_t> _outcodes;
+	float _width = 0.0f;
+	float _height = 0.0f;
+	float _guardBand;
+
+	/*
+	 * @brief state of one setup task
+	 */
+	struct SetupChunk {
+		/* triangles of the chunk, joined in order */
+		std::vector<RasterTriangle> triangles;
+		/* triangles crossing the near plane or the guard band, clipped after the others */
+		std::vector<uint32_t> crossingTriangles;
+		Clipper clipper;
+		CullingStage culling;
+		uint64_t trianglesOutsideFrustum = 0;
+		uint64_t trianglesOutsideScreen = 0;
+
+		explicit SetupChunk(float guardBand) : clipper(guardBand) { }
+	};
+
+	std::vector<SetupChunk> _setupChunks;
+
+	/* bounds of consecutive triangle clusters and their frustum test of this frame */
+	BoundingVolumes _clusterBounds;
+	std::vector<uint8_t> _clusterVisible;
+	CullingStage _culling;
+
+	Statistics _statistics;
+
+	/*
+	 * @brief cull and assemble the triangles [first, last), at most one batch
+	 */
+	void _setupBatch(SetupChunk& setupChunk, const std::vector<uint32_t>& colors, size_t first, size_t last);
+
+	/*
+	 * @brief transform the vertices [first, last)
+	 */
+	void _transformRange(const glm::mat4x4& viewProjection, size_t first, size_t last);
+};
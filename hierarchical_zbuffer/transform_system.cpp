@@ -0,0 +1,410 @@
+#include <algorithm>
+#include <type_traits>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "transform_system.h"
+
+namespace {
+	/* destroyed slots tolerated before any compaction */
+	const size_t minimumFreeSlots = 64;
+}
+
+const uint32_t TransformSystem::invalid;
+
+/*
+ * @brief get the transform system of the objects not created in a system of their own
+ * @return the transform system of the process
+ */
+TransformSystem& TransformSystem::getInstance() {
+	static TransformSystem transformSystem;
+	return transformSystem;
+}
+
+
+/*
+ * @brief create an identity transform without parent
+ * @detail a root is appended after all slots, which keeps the parent before child order
+ * @param owner object referring to the transform
+ * @return handle of the transform
+ */
+uint32_t TransformSystem::create(Object3D* owner) {
+	uint32_t handle;
+	if (!_freeHandles.empty()) {
+		handle = _freeHandles.back();
+		_freeHandles.pop_back();
+	} else {
+		handle = static_cast<uint32_t>(_handleSlot.size());
+		_handleSlot.push_back(invalid);
+	}
+
+	const uint32_t slot = static_cast<uint32_t>(_slotHandle.size());
+	_handleSlot[handle] = slot;
+	_localPosition.push_back(glm::vec3(0.0f));
+	_localRotation.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+	_localScale.push_back(glm::vec3(1.0f));
+	_parent.push_back(invalid);
+	_childCount.push_back(0);
+	_worldMatrix.push_back(glm::mat4x4(1.0f));
+	_worldMatrixInverse.push_back(glm::mat4x4(1.0f));
+	_dirty.push_back(0);
+	_changed.push_back(0);
+	_owner.push_back(owner);
+	_slotHandle.push_back(handle);
+	return handle;
+}
+
+
+/*
+ * @brief destroy a transform, its children become roots
+ * @detail the slot is left free and compacted away later, so destroying does not move slots
+ * @param handle handle of the transform
+ */
+void TransformSystem::destroy(uint32_t handle) {
+	const uint32_t slot = _handleSlot[handle];
+	if (_childCount[slot] > 0) {
+		for (uint32_t child = slot + 1; child < _parent.size(); ++child) {
+			if (_parent[child] == slot) {
+				_parent[child] = invalid;
+				_markDirty(child);
+			}
+		}
+	}
+	if (_parent[slot] != invalid) {
+		--_childCount[_parent[slot]];
+	}
+
+	_parent[slot] = invalid;
+	_childCount[slot] = 0;
+	_dirty[slot] = 0;
+	_changed[slot] = 0;
+	_owner[slot] = nullptr;
+	_slotHandle[slot] = invalid;
+	_handleSlot[handle] = invalid;
+	_freeHandles.push_back(handle);
+	++_freeSlots;
+
+	if (_freeSlots >= minimumFreeSlots && 2 * _freeSlots >= _slotHandle.size()) {
+		std::vector<uint32_t> order;
+		order.reserve(_slotHandle.size() - _freeSlots);
+		for (uint32_t i = 0; i < _slotHandle.size(); ++i) {
+			if (_slotHandle[i] != invalid) {
+				order.push_back(i);
+			}
+		}
+		_permute(order);
+	}
+}
+
+
+/*
+ * @brief get the object owning a transform
+ * @param handle handle of the transform
+ * @return owner given at the creation or by setOwner
+ */
+Object3D* TransformSystem::getOwner(uint32_t handle) const {
+	return _owner[_handleSlot[handle]];
+}
+
+
+/*
+ * @brief set the object owning a transform, after the object moved
+ * @param handle handle of the transform
+ * @param owner new owner
+ */
+void TransformSystem::setOwner(uint32_t handle, Object3D* owner) {
+	_owner[_handleSlot[handle]] = owner;
+}
+
+
+/*
+ * @brief set the parent of a transform, invalid to detach it
+ * @detail a parent behind the transform moves the subtree of the transform after all
+ *         slots it precedes, keeping the order of the other slots and within the subtree
+ * @param handle handle of the transform
+ * @param parent handle of the new parent, invalid for none
+ * @return false if the parent is the transform itself or one of its descendants
+ */
+bool TransformSystem::setParent(uint32_t handle, uint32_t parent) {
+	uint32_t slot = _handleSlot[handle];
+	const uint32_t parentSlot = parent == invalid ? invalid : _handleSlot[parent];
+	for (uint32_t ancestor = parentSlot; ancestor != invalid; ancestor = _parent[ancestor]) {
+		if (ancestor == slot) {
+			return false;
+		}
+	}
+
+	if (_parent[slot] == parentSlot) {
+		return true;
+	}
+	if (_parent[slot] != invalid) {
+		--_childCount[_parent[slot]];
+	}
+
+	if (parentSlot != invalid && parentSlot > slot) {
+		// descendants follow the transform, so one pass finds the whole subtree
+		std::vector<uint8_t> inSubtree(_parent.size() - slot, 0);
+		inSubtree[0] = 1;
+		std::vector<uint32_t> order(slot), subtree(1, slot);
+		for (uint32_t i = 0; i < slot; ++i) {
+			order[i] = i;
+		}
+		for (uint32_t i = slot + 1; i < _parent.size(); ++i) {
+			const uint32_t up = _parent[i];
+			if (up != invalid && up >= slot && inSubtree[up - slot]) {
+				inSubtree[i - slot] = 1;
+				subtree.push_back(i);
+			} else {
+				order.push_back(i);
+			}
+		}
+		order.insert(order.end(), subtree.begin(), subtree.end());
+		_permute(order);
+		slot = _handleSlot[handle];
+	}
+
+	const uint32_t newParentSlot = parent == invalid ? invalid : _handleSlot[parent];
+	_parent[slot] = newParentSlot;
+	if (newParentSlot != invalid) {
+		++_childCount[newParentSlot];
+	}
+	_markDirty(slot);
+	return true;
+}
+
+
+/*
+ * @brief get the parent of a transform
+ * @param handle handle of the transform
+ * @return handle of the parent, invalid for a root
+ */
+uint32_t TransformSystem::getParent(uint32_t handle) const {
+	const uint32_t parentSlot = _parent[_handleSlot[handle]];
+	return parentSlot == invalid ? invalid : _slotHandle[parentSlot];
+}
+
+
+/*
+ * @brief get the number of children of a transform
+ * @param handle handle of the transform
+ * @return child count
+ */
+uint32_t TransformSystem::getChildCount(uint32_t handle) const {
+	return _childCount[_handleSlot[handle]];
+}
+
+
+/*
+ * @brief get the children of a transform in slot order
+ * @detail children are not linked, the slots after the transform are scanned
+ * @param handle handle of the transform
+ * @param children handles of the children as output
+ */
+void TransformSystem::getChildren(uint32_t handle, std::vector<uint32_t>& children) const {
+	children.clear();
+	const uint32_t slot = _handleSlot[handle];
+	uint32_t remaining = _childCount[slot];
+	for (uint32_t i = slot + 1; i < _parent.size() && remaining > 0; ++i) {
+		if (_parent[i] == slot) {
+			children.push_back(_slotHandle[i]);
+			--remaining;
+		}
+	}
+}
+
+
+/*
+ * @brief set the position of a transform relative to its parent
+ * @param handle handle of the transform
+ * @param position local position
+ */
+void TransformSystem::setLocalPosition(uint32_t handle, const glm::vec3& position) {
+	const uint32_t slot = _handleSlot[handle];
+	_localPosition[slot] = position;
+	_markDirty(slot);
+}
+
+
+/*
+ * @brief set the rotation of a transform relative to its parent
+ * @param handle handle of the transform
+ * @param rotation local rotation
+ */
+void TransformSystem::setLocalRotation(uint32_t handle, const glm::quat& rotation) {
+	const uint32_t slot = _handleSlot[handle];
+	_localRotation[slot] = rotation;
+	_markDirty(slot);
+}
+
+
+/*
+ * @brief set the scale of a transform relative to its parent
+ * @param handle handle of the transform
+ * @param scale local scale
+ */
+void TransformSystem::setLocalScale(uint32_t handle, const glm::vec3& scale) {
+	const uint32_t slot = _handleSlot[handle];
+	_localScale[slot] = scale;
+	_markDirty(slot);
+}
+
+
+/*
+ * @brief get the cached local to world matrix, updating the dirty transforms first
+ * @param handle handle of the transform
+ * @return world matrix, valid until the next change of the system
+ */
+const glm::mat4x4& TransformSystem::getWorldMatrix(uint32_t handle) {
+	if (_firstDirty != invalid && _firstDirty <= _handleSlot[handle]) {
+		update();
+	}
+
+	return _worldMatrix[_handleSlot[handle]];
+}
+
+
+/*
+ * @brief get the cached world to local matrix, updating the dirty transforms first
+ * @param handle handle of the transform
+ * @return inverse world matrix, valid until the next change of the system
+ */
+const glm::mat4x4& TransformSystem::getWorldMatrixInverse(uint32_t handle) {
+	if (_firstDirty != invalid && _firstDirty <= _handleSlot[handle]) {
+		update();
+	}
+
+	return _worldMatrixInverse[_handleSlot[handle]];
+}
+
+
+/*
+ * @brief recompute the world matrices of the changed transforms and their descendants
+ * @detail a single pass from the first dirty slot, a parent is always finished before its
+ *         children. The inverse is composed from the inverted local factors instead of
+ *         inverting the world matrix
+ */
+void TransformSystem::update() {
+	if (_firstDirty == invalid) {
+		return;
+	}
+
+	const uint32_t first = _firstDirty;
+	const uint32_t slotCount = static_cast<uint32_t>(_parent.size());
+	for (uint32_t slot = first; slot < slotCount; ++slot) {
+		const uint32_t parent = _parent[slot];
+		if (!_dirty[slot] && (parent == invalid || !_dirty[parent])) {
+			continue;
+		}
+
+		const glm::mat4x4 rotation = glm::mat4_cast(_localRotation[slot]);
+		glm::mat4x4 local = glm::scale(rotation, _localScale[slot]);
+		local = glm::translate(local, _localPosition[slot]);
+		glm::mat4x4 localInverse = glm::translate(glm::mat4x4(1.0f), -_localPosition[slot]);
+		localInverse = glm::scale(localInverse, 1.0f / _localScale[slot]);
+		localInverse = localInverse * glm::transpose(rotation);
+
+		if (parent == invalid) {
+			_worldMatrix[slot] = local;
+			_worldMatrixInverse[slot] = localInverse;
+		} else {
+			_worldMatrix[slot] = _worldMatrix[parent] * local;
+			_worldMatrixInverse[slot] = localInverse * _worldMatrixInverse[parent];
+		}
+
+		_dirty[slot] = 1;
+		if (!_changed[slot]) {
+			_changed[slot] = 1;
+			_changedHandles.push_back(_slotHandle[slot]);
+		}
+	}
+
+	std::fill(_dirty.begin() + first, _dirty.end(), static_cast<uint8_t>(0));
+	_firstDirty = invalid;
+}
+
+
+/*
+ * @brief get the handles whose world matrix changed since the last call and forget them
+ * @detail brings the world matrices up to date first, destroyed transforms are left out
+ * @param handles changed handles as output
+ */
+void TransformSystem::takeChanged(std::vector<uint32_t>& handles) {
+	update();
+	handles.clear();
+	for (uint32_t handle : _changedHandles) {
+		const uint32_t slot = _handleSlot[handle];
+		if (slot != invalid && _changed[slot]) {
+			_changed[slot] = 0;
+			handles.push_back(handle);
+		}
+	}
+	_changedHandles.clear();
+}
+
+
+/*
+ * @brief get the number of live transforms
+ * @return transform count
+ */
+size_t TransformSystem::size() const {
+	return _slotHandle.size() - _freeSlots;
+}
+
+
+/*
+ * @brief mark the local transform of a slot as changed
+ * @param slot slot of the transform
+ */
+void TransformSystem::_markDirty(uint32_t slot) {
+	_dirty[slot] = 1;
+	_firstDirty = std::min(_firstDirty, slot);
+}
+
+
+/*
+ * @brief reorder the slots
+ * @param order old slot of each new slot, slots left out are dropped and must be free
+ */
+void TransformSystem::_permute(const std::vector<uint32_t>& order) {
+	std::vector<uint32_t> newSlot(_parent.size(), invalid);
+	for (uint32_t i = 0; i < order.size(); ++i) {
+		newSlot[order[i]] = i;
+	}
+
+	const auto gather = [&order](auto& values) {
+		typename std::remove_reference<decltype(values)>::type reordered;
+		reordered.reserve(order.size());
+		for (uint32_t slot : order) {
+			reordered.push_back(values[slot]);
+		}
+		values.swap(reordered);
+	};
+	gather(_localPosition);
+	gather(_localRotation);
+	gather(_localScale);
+	gather(_parent);
+	gather(_childCount);
+	gather(_worldMatrix);
+	gather(_worldMatrixInverse);
+	gather(_dirty);
+	gather(_changed);
+	gather(_owner);
+	gather(_slotHandle);
+
+	_firstDirty = invalid;
+	_freeSlots = 0;
+	for (uint32_t slot = 0; slot < _parent.size(); ++slot) {
+		if (_parent[slot] != invalid) {
+			_parent[slot] = newSlot[_parent[slot]];
+		}
+		if (_slotHandle[slot] != invalid) {
+			_handleSlot[_slotHandle[slot]] = slot;
+		} else {
+			++_freeSlots;
+		}
+		if (_dirty[slot] && _firstDirty == invalid) {
+			_firstDirty = slot;
+		}
+	}
+}
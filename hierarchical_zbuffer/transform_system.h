@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#ifdef GLFW_INCLUDE_VULKAN
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#endif
+
+#include <glm/vec3.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat4x4.hpp>
+
+class Object3D;
+
+/**
+ * @brief storage of the transforms of a set of objects
+ * @detail every field of the transforms lives in its own contiguous array, indexed by a slot.
+ *         The slots are ordered parent before child, so the world matrices are brought up to
+ *         date by one linear pass from the first dirty slot: a slot is recomputed if it or its
+ *         parent was, and clean subtrees cost a flag test per slot. The world matrices and
+ *         their inverses are cached until a local transform changes. Objects refer to their
+ *         transform by a stable handle, slots move when reparenting has to restore the order
+ *         and when destroyed transforms are compacted away. Not thread safe
+ */
+class TransformSystem {
+public:
+	/* handle and slot of no transform */
+	static const uint32_t invalid = 0xFFFFFFFFu;
+
+	/*
+	 * @brief default constructor, no transforms
+	 */
+	TransformSystem() = default;
+
+	/*
+	 * @brief default destructor
+	 */
+	~TransformSystem() = default;
+
+	TransformSystem(const TransformSystem&) = delete;
+	TransformSystem& operator=(const TransformSystem&) = delete;
+
+	/*
+	 * @brief get the transform system of the objects not created in a system of their own
+	 */
+	static TransformSystem& getInstance();
+
+	/*
+	 * @brief create an identity transform without parent
+	 */
+	uint32_t create(Object3D* owner);
+
+	/*
+	 * @brief destroy a transform, its children become roots
+	 */
+	void destroy(uint32_t handle);
+
+	/*
+	 * @brief get the object owning a transform
+	 */
+	Object3D* getOwner(uint32_t handle) const;
+
+	/*
+	 * @brief set the object owning a transform, after the object moved
+	 */
+	void setOwner(uint32_t handle, Object3D* owner);
+
+	/*
+	 * @brief set the parent of a transform, invalid to detach it
+	 */
+	bool setParent(uint32_t handle, uint32_t parent);
+
+	/*
+	 * @brief get the parent of a transform, invalid for a root
+	 */
+	uint32_t getParent(uint32_t handle) const;
+
+	/*
+	 * @brief get the number of children of a transform
+	 */
+	uint32_t getChildCount(uint32_t handle) const;
+
+	/*
+	 * @brief get the children of a transform in slot order
+	 */
+	void getChildren(uint32_t handle, std::vector<uint32_t>& children) const;
+
+	/*
+	 * @brief get the position of a transform relative to its parent
+	 */
+	const glm::vec3& getLocalPosition(uint32_t handle) const {
+		return _localPosition[_handleSlot[handle]];
+	}
+
+	/*
+	 * @brief set the position of a transform relative to its parent
+	 */
+	void setLocalPosition(uint32_t handle, const glm::vec3& position);
+
+	/*
+	 * @brief get the rotation of a transform relative to its parent
+	 */
+	const glm::quat& getLocalRotation(uint32_t handle) const {
+		return _localRotation[_handleSlot[handle]];
+	}
+
+	/*
+	 * @brief set the rotation of a transform relative to its parent
+	 */
+	void setLocalRotation(uint32_t handle, const glm::quat& rotation);
+
+	/*
+	 * @brief get the scale of a transform relative to its parent
+	 */
+	const glm::vec3& getLocalScale(uint32_t handle) const {
+		return _localScale[_handleSlot[handle]];
+	}
+
+	/*
+	 * @brief set the scale of a transform relative to its parent
+	 */
+	void setLocalScale(uint32_t handle, const glm::vec3& scale);
+
+	/*
+	 * @brief get the cached local to world matrix, updating the dirty transforms first
+	 */
+	const glm::mat4x4& getWorldMatrix(uint32_t handle);
+
+	/*
+	 * @brief get the cached world to local matrix, updating the dirty transforms first
+	 */
+	const glm::mat4x4& getWorldMatrixInverse(uint32_t handle);
+
+	/*
+	 * @brief recompute the world matrices of the changed transforms and their descendants
+	 */
+	void update();
+
+	/*
+	 * @brief get the handles whose world matrix changed since the last call and forget them
+	 */
+	void takeChanged(std::vector<uint32_t>& handles);
+
+	/*
+	 * @brief get the number of live transforms
+	 */
+	size_t size() const;
+
+private:
+	/* local transform per slot, the local matrix is rotation * scale * translation */
+	std::vector<glm::vec3> _localPosition;
+	std::vector<glm::quat> _localRotation;
+	std::vector<glm::vec3> _localScale;
+	/* slot of the parent, always lower than the slot of the child */
+	std::vector<uint32_t> _parent;
+	std::vector<uint32_t> _childCount;
+	/* cached world matrices */
+	std::vector<glm::mat4x4> _worldMatrix;
+	std::vector<glm::mat4x4> _worldMatrixInverse;
+	/* local transform changed, or world matrix recomputed during the pass */
+	std::vector<uint8_t> _dirty;
+	/* world matrix changed since the last takeChanged */
+	std::vector<uint8_t> _changed;
+	std::vector<Object3D*> _owner;
+	std::vector<uint32_t> _slotHandle;
+
+	std::vector<uint32_t> _handleSlot;
+	std::vector<uint32_t> _freeHandles;
+	/* slots of destroyed transforms, compacted away once they are half of all slots */
+	size_t _freeSlots = 0;
+	/* lowest dirty slot, invalid if the world matrices are up to date */
+	uint32_t _firstDirty = invalid;
+	std::vector<uint32_t> _changedHandles;
+
+	/*
+	 * @brief mark the local transform of a slot as changed
+	 */
+	void _markDirty(uint32_t slot);
+
+	/*
+	 * @brief reorder the slots, order lists the old slot of each new slot, missing slots are dropped
+	 */
+	void _permute(const std::vector<uint32_t>& order);
+};